@@ -14,6 +14,7 @@
 #include <cstdint>
 #include <string>
 #include <array>
+#include <IpAddress.hpp>
 
 namespace libspeedwire {
 
@@ -42,6 +43,7 @@ namespace libspeedwire {
         static bool resideOnSameSubnet(const struct in_addr& host1, const struct in_addr& host2, const uint32_t prefix_length);
         static bool resideOnSameSubnet(const struct in6_addr& host1, const struct in6_addr& host2, const uint32_t prefix_length);
         static bool resideOnSameSubnet(const std::string& host1, const std::string& host2, const uint32_t prefix_length);
+        static bool resideOnSameSubnet(const IpAddress& host1, const IpAddress& host2, const uint32_t prefix_length);
 
         // type casts for bsd socket address information
         static struct sockaddr& toSockAddr(struct sockaddr_in& src);
@@ -0,0 +1,133 @@
+#ifndef __LIBSPEEDWIRE_ARCHIVEPRODUCER_HPP__
+#define __LIBSPEEDWIRE_ARCHIVEPRODUCER_HPP__
+
+#include <cstdint>
+#include <string>
+#include <MappedFile.hpp>
+#include <MeasurementValues.hpp>
+#include <BatchProducer.hpp>
+#include <Producer.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Struct describing the header at the start of each archive segment file. The header is followed by four
+     *  columns of capacity entries each: 64-bit unix epoch timestamps in ms, double values, 32-bit device serial
+     *  numbers and 32-bit measurement ids. Only the first count entries of each column are valid.
+     */
+    typedef struct ArchiveSegmentHeader {
+        char     magic[8];              //!< File magic "SWARCHV1".
+        uint32_t headerSize;            //!< Size of the header area in bytes, i.e. offset of the first column.
+        uint32_t reserved;              //!< Reserved, 0.
+        uint64_t capacity;              //!< Number of entries per column.
+        uint64_t startTime;             //!< Segment start time; all timestamps are >= startTime. It is lowered for late values.
+        uint64_t endTime;               //!< Segment end time; all timestamps are < endTime.
+        volatile uint64_t count;        //!< Number of committed entries; it is written after the entries themselves.
+        uint64_t timesOffset;           //!< File offset of the timestamp column.
+        uint64_t valuesOffset;          //!< File offset of the value column.
+        uint64_t devicesOffset;         //!< File offset of the device serial number column.
+        uint64_t measurementsOffset;    //!< File offset of the measurement id column.
+    } ArchiveSegmentHeader;
+
+
+    /**
+     *  Struct providing read access to the committed entries of an archive segment; the pointers refer
+     *  directly into the mapped segment file.
+     */
+    typedef struct ArchiveSpan {
+        const uint64_t* times;          //!< Timestamp column.
+        const double*   values;         //!< Value column.
+        const uint32_t* devices;        //!< Device serial number column.
+        const uint32_t* measurements;   //!< Measurement id column.
+        size_t          length;         //!< Number of entries.
+    } ArchiveSpan;
+
+
+    /**
+     *  Class ArchiveProducer archives all produced values into append-only columnar segment files. Each segment file
+     *  is preallocated to its full size and memory-mapped, such that values are written directly into the page cache.
+     *  A new segment is started whenever the segment duration has elapsed or the current segment is full; values older
+     *  than the current segment are appended to it. On close, a segment that is not full is truncated to its entries.
+     *
+     *  Entries become visible to readers on flush(), when the committed entry count in the segment header is updated.
+     *  As the count is written after the entries themselves, a crash leaves a consistent segment containing all values
+     *  up to the last flush. With sync_on_flush, entries and header are additionally written to the storage device in
+     *  this order, which extends the guarantee to power failures at the cost of two synchronous writes per flush.
+     */
+    class ArchiveProducer : public Producer, public BatchProducer {
+    protected:
+        std::string directory;          //!< Directory receiving the segment files.
+        std::string filePrefix;         //!< Segment file name prefix.
+        uint64_t    segmentDuration;    //!< Segment duration in ms.
+        size_t      segmentCapacity;    //!< Number of entries per segment.
+        bool        syncOnFlush;        //!< Write entries to the storage device on each flush.
+
+        MappedFile  file;               //!< Current segment file.
+        ArchiveSegmentHeader* header;   //!< Header of the current segment.
+        uint64_t*   times;              //!< Timestamp column of the current segment.
+        double*     values;             //!< Value column of the current segment.
+        uint32_t*   devices;            //!< Device serial number column of the current segment.
+        uint32_t*   measurements;       //!< Measurement id column of the current segment.
+        size_t      uncommitted;        //!< Number of entries written after the committed count.
+        uint64_t    currentTime;        //!< Unix epoch time in ms captured with the first value after a flush.
+        uint64_t    droppedCount;       //!< Number of values that could not be archived.
+
+        bool openSegment(const uint64_t time);
+        void closeSegment(void);
+        bool writeCompacted(const std::string& path);
+        uint64_t expandTime(const uint32_t time_in_ms);
+        void append(const uint32_t serial, const uint32_t measurement_id, const double value, const uint64_t time);
+
+    public:
+        ArchiveProducer(const std::string& directory, const std::string& file_prefix = "speedwire", const uint64_t segment_duration_in_ms = 3600000,
+                        const size_t segment_capacity = 1024 * 1024, const bool sync_on_flush = false);
+        virtual ~ArchiveProducer(void);
+
+        virtual void flush(void);
+        virtual void produce(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value, const uint32_t time_in_ms = 0);
+        virtual void produce(const RecordBatch& batch);
+        void produceAt(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value, const uint64_t time_in_ms);
+
+        /** Get the path of the current segment file, or an empty string if there is no open segment. */
+        const std::string& getSegmentPath(void) const { return file.getPath(); }
+
+        /** Get the number of values that could not be archived. */
+        uint64_t getDroppedCount(void) const { return droppedCount; }
+
+        static size_t   getSegmentSize(const size_t capacity);
+        static uint32_t getMeasurementId(const MeasurementType& type, const Wire wire);
+    };
+
+
+    /**
+     *  Class ArchiveReader maps an archive segment file read-only and provides zero-copy access to its committed entries.
+     *  Segments can be read while they are written.
+     */
+    class ArchiveReader {
+    protected:
+        MappedFile file;                        //!< Mapped segment file.
+        const ArchiveSegmentHeader* header;     //!< Segment header, or nullptr if no valid segment is open.
+
+    public:
+        ArchiveReader(void);
+        ~ArchiveReader(void);
+
+        bool open(const std::string& path);
+        void close(void);
+
+        /** Check if a valid segment is open. */
+        bool isOpen(void) const { return header != nullptr; }
+
+        /** Get the segment start time in ms since unix epoch. */
+        uint64_t getStartTime(void) const { return (header != nullptr ? header->startTime : 0); }
+
+        /** Get the segment end time in ms since unix epoch. */
+        uint64_t getEndTime(void) const { return (header != nullptr ? header->endTime : 0); }
+
+        ArchiveSpan getSpan(void) const;
+        size_t getMeasurementValues(const uint32_t serial, const uint32_t measurement_id, MeasurementValues& values) const;
+    };
+
+}   // namespace libspeedwire
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef __LIBSPEEDWIRE_ARROWFILEWRITER_HPP__
+#define __LIBSPEEDWIRE_ARROWFILEWRITER_HPP__
+
+#include <cstdint>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <MeasurementValues.hpp>
+#include <ArchiveProducer.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Enumeration of the supported arrow column types.
+     */
+    enum class ArrowType {
+        TIMESTAMP_MS,       //!< 64-bit signed timestamp in ms since unix epoch, without time zone.
+        UINT32,             //!< 32-bit unsigned integer.
+        DOUBLE              //!< 64-bit floating point value.
+    };
+
+
+    /**
+     *  Struct describing a single column of an arrow schema.
+     */
+    typedef struct ArrowColumn {
+        std::string name;   //!< Column name.
+        ArrowType   type;   //!< Column type.
+        ArrowColumn(const std::string& n, const ArrowType t) : name(n), type(t) {}
+    } ArrowColumn;
+
+
+    /**
+     *  Class ArrowFileWriter writes columnar data in the Apache Arrow IPC file format (also known as Feather V2),
+     *  such that it can be read by pyarrow, pandas, polars and similar tools without any parsing.
+     *
+     *  The flatbuffer metadata is encoded natively. Column data is written as is from contiguous memory, without
+     *  null bitmaps and without compression; hence the host must be little endian. Each call to writeBatch()
+     *  writes one arrow record batch.
+     */
+    class ArrowFileWriter {
+    protected:
+        //! Struct describing the location of a record batch in the file.
+        typedef struct Block {
+            uint64_t offset;            //!< File offset of the encapsulated message.
+            uint32_t metadataLength;    //!< Length of the message prefix and metadata.
+            uint64_t bodyLength;        //!< Length of the message body.
+        } Block;
+
+        std::vector<ArrowColumn> schema;    //!< Column definitions.
+        std::vector<Block>       batches;   //!< Locations of all record batches written so far.
+        std::vector<uint8_t>     metadata;  //!< Reused flatbuffer encoding buffer.
+        FILE*                    file;      //!< Output file, or nullptr if no file is open.
+        uint64_t                 position;  //!< Current file offset.
+
+        bool write(const void* data, const size_t length);
+        bool writeMessage(const uint64_t body_length);
+
+    public:
+        ArrowFileWriter(const std::vector<ArrowColumn>& schema);
+        ~ArrowFileWriter(void);
+
+        bool open(const std::string& path);
+        bool writeBatch(const void* const columns[], const size_t length);
+        bool close(void);
+
+        static size_t getTypeSize(const ArrowType type);
+
+        static bool exportMeasurementValues(const std::string& path, const MeasurementValues& values, const unsigned long time_scale = 1);
+        static bool exportArchiveSpan(const std::string& path, const ArchiveSpan& span);
+    };
+
+}   // namespace libspeedwire
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef __LIBSPEEDWIRE_ASYNCPRODUCER_HPP__
+#define __LIBSPEEDWIRE_ASYNCPRODUCER_HPP__
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <Producer.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Enumeration describing the behaviour of the AsyncProducer if its queue is full.
+     */
+    enum class OverflowPolicy {
+        DROP_OLDEST,    //!< Discard the oldest queued value to make room for the new value.
+        DROP_NEWEST,    //!< Discard the new value.
+        BLOCK           //!< Wait until the worker thread made room for the new value.
+    };
+
+
+    /**
+     *  Class AsyncProducer decouples the receive path from slow producers. Values passed to produce() are copied into
+     *  a bounded lock-free multi-producer ring of preallocated records and handed to the wrapped producer by a background
+     *  worker thread. The worker flushes the wrapped producer whenever the configured batch size is reached, the oldest
+     *  unflushed value is older than the configured maximum delay, or flush() has been called. With the BLOCK policy,
+     *  producing threads sleep on a condition variable until the worker made room. Values produced after stop() are
+     *  counted as dropped; values produced concurrently with stop() are either passed to the wrapped producer or
+     *  counted as dropped.
+     */
+    class AsyncProducer : public Producer {
+
+    protected:
+
+        //! Struct holding a single queued value.
+        typedef struct Record {
+            SpeedwireDevice device;     //!< The device generating the value.
+            MeasurementType type;       //!< The measurement type.
+            Wire            wire;       //!< The wire.
+            double          value;      //!< The value.
+            uint32_t        time;       //!< The measurement timestamp.
+            Record(void) : type(Direction::NO_DIRECTION, Type::NO_TYPE, Quantity::NO_QUANTITY, "", 1), wire(Wire::NO_WIRE), value(0.0), time(0) {}
+        } Record;
+
+        //! Struct holding a ring cell; the sequence number synchronizes producers and consumers of the cell.
+        typedef struct Cell {
+            std::atomic<size_t> sequence;   //!< Cell sequence number.
+            Record              record;     //!< Preallocated record.
+        } Cell;
+
+        Producer&               producer;           //!< Reference to the wrapped producer.
+        const OverflowPolicy    overflowPolicy;     //!< Behaviour if the queue is full.
+        const size_t            batchSize;          //!< Number of values after which the wrapped producer is flushed.
+        const unsigned long     maxDelayInMs;       //!< Maximum time a value is held before the wrapped producer is flushed.
+        size_t                  mask;               //!< Ring capacity - 1; the capacity is a power of 2.
+        std::unique_ptr<Cell[]> cells;              //!< Ring cells.
+        std::atomic<size_t>     enqueuePos;         //!< Next enqueue position.
+        std::atomic<size_t>     dequeuePos;         //!< Next dequeue position.
+
+        std::atomic<uint64_t>   enqueuedCount;      //!< Number of values enqueued.
+        std::atomic<uint64_t>   droppedCount;       //!< Number of values dropped due to overflow.
+        std::atomic<uint64_t>   producedCount;      //!< Number of values passed to the wrapped producer.
+        std::atomic<size_t>     maxQueueDepth;      //!< High watermark of the queue depth.
+
+        std::atomic<bool>       flushRequested;     //!< flush() has been called.
+        std::atomic<bool>       running;            //!< The worker thread shall keep running.
+        std::atomic<int>        numBlocked;         //!< Number of producing threads waiting for room in the queue.
+        std::atomic<int>        numProducing;       //!< Number of threads inside produce().
+        std::mutex              mutex;              //!< Mutex for the condition variables.
+        std::condition_variable condition;          //!< Condition variable to wake up the worker thread.
+        std::condition_variable space;              //!< Condition variable to wake up producing threads waiting for room.
+        std::thread             worker;             //!< Worker thread.
+        Record                  current;            //!< Copy of the value passed to the wrapped producer; used by the worker thread only.
+
+        bool tryEnqueue(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value, const uint32_t time);
+        bool dequeue(const bool discard);
+        bool waitForSpace(void);
+        void run(void);
+
+    public:
+
+        AsyncProducer(Producer& producer, const size_t capacity = 1024, const OverflowPolicy policy = OverflowPolicy::DROP_OLDEST, const size_t batch_size = 64, const unsigned long max_delay_in_ms = 1000);
+        virtual ~AsyncProducer(void);
+
+        void stop(void);
+
+        virtual void flush(void);
+        virtual void produce(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value, const uint32_t time_in_ms = 0);
+
+        size_t   getQueueDepth(void) const;
+        size_t   getMaxQueueDepth(void) const { return maxQueueDepth.load(); }
+        size_t   getCapacity(void) const { return mask + 1; }
+        uint64_t getEnqueuedCount(void) const { return enqueuedCount.load(); }
+        uint64_t getDroppedCount(void) const { return droppedCount.load(); }
+        uint64_t getProducedCount(void) const { return producedCount.load(); }
+    };
+
+}   // namespace libspeedwire
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef __LIBSPEEDWIRE_BATCHPRODUCER_HPP__
+#define __LIBSPEEDWIRE_BATCHPRODUCER_HPP__
+
+#include <cstdint>
+#include <vector>
+#include <MeasurementType.hpp>
+#include <SpeedwireDevice.hpp>
+#include <Producer.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Class RecordBatch holds a batch of produced values in columnar layout. Devices and measurement definitions are
+     *  stored once in small tables; each record refers to them by index. Clearing the batch keeps all allocated memory,
+     *  including the table entries and their strings, which are overwritten in place when the batch is refilled. Hence
+     *  a batch instance can be reused for each packet or tick without further allocations. Only the first
+     *  getDeviceCount() and getMeasurementCount() table entries are in use.
+     */
+    class RecordBatch {
+    protected:
+        size_t numDevices = 0;                          //!< Number of device table entries in use.
+        size_t numMeasurements = 0;                     //!< Number of measurement table entries in use.
+
+    public:
+        std::vector<SpeedwireDevice> deviceTable;       //!< Table of devices referenced by the records.
+        std::vector<MeasurementType> typeTable;         //!< Table of measurement types referenced by the records.
+        std::vector<Wire>            wireTable;         //!< Table of wires, parallel to typeTable.
+
+        std::vector<uint32_t> deviceIndex;              //!< Column of device table indexes.
+        std::vector<uint32_t> measurementIndex;         //!< Column of measurement type/wire table indexes.
+        std::vector<double>   values;                   //!< Column of values.
+        std::vector<uint32_t> times;                    //!< Column of timestamps.
+
+        /** Get the number of records. */
+        size_t size(void) const { return values.size(); }
+
+        /** Get the number of device table entries in use. */
+        size_t getDeviceCount(void) const { return numDevices; }
+
+        /** Get the number of measurement table entries in use. */
+        size_t getMeasurementCount(void) const { return numMeasurements; }
+
+        /** Remove all records and release all table entries for reuse, while keeping the allocated memory. */
+        void clear(void) {
+            numDevices = 0;
+            numMeasurements = 0;
+            deviceIndex.clear();
+            measurementIndex.clear();
+            values.clear();
+            times.clear();
+        }
+
+        /**
+         *  Find or add the given device in the device table.
+         *  @param device The device.
+         *  @return The device table index.
+         */
+        uint32_t addDevice(const SpeedwireDevice& device) {
+            for (size_t i = 0; i < numDevices; ++i) {
+                if (deviceTable[i].deviceAddress.serialNumber == device.deviceAddress.serialNumber &&
+                    deviceTable[i].deviceAddress.susyID == device.deviceAddress.susyID) {
+                    return (uint32_t)i;
+                }
+            }
+            if (numDevices < deviceTable.size()) {
+                deviceTable[numDevices] = device;       // assignment reuses the string capacity of the released entry
+            }
+            else {
+                deviceTable.push_back(device);
+            }
+            return (uint32_t)(numDevices++);
+        }
+
+        /**
+         *  Find or add the given measurement type and wire in the measurement table.
+         *  @param type The measurement type.
+         *  @param wire The wire.
+         *  @return The measurement table index.
+         */
+        uint32_t addMeasurement(const MeasurementType& type, const Wire wire) {
+            for (size_t i = 0; i < numMeasurements; ++i) {
+                const MeasurementType& t = typeTable[i];
+                if (wireTable[i] == wire && t.quantity == type.quantity && t.type == type.type && t.direction == type.direction &&
+                    t.divisor == type.divisor && t.unit == type.unit) {
+                    return (uint32_t)i;
+                }
+            }
+            if (numMeasurements < typeTable.size()) {
+                typeTable[numMeasurements] = type;      // assignment reuses the string capacity of the released entry
+                wireTable[numMeasurements] = wire;
+            }
+            else {
+                typeTable.push_back(type);
+                wireTable.push_back(wire);
+            }
+            return (uint32_t)(numMeasurements++);
+        }
+
+        /**
+         *  Append a record.
+         *  @param device The device generating the value.
+         *  @param type The measurement type of the value.
+         *  @param wire The wire of the value.
+         *  @param value The value.
+         *  @param time The timestamp of the value.
+         */
+        void add(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value, const uint32_t time) {
+            deviceIndex.push_back(addDevice(device));
+            measurementIndex.push_back(addMeasurement(type, wire));
+            values.push_back(value);
+            times.push_back(time);
+        }
+
+        /** Get the device of the given record. */
+        const SpeedwireDevice& getDevice(const size_t record) const { return deviceTable[deviceIndex[record]]; }
+
+        /** Get the measurement type of the given record. */
+        const MeasurementType& getMeasurementType(const size_t record) const { return typeTable[measurementIndex[record]]; }
+
+        /** Get the wire of the given record. */
+        Wire getWire(const size_t record) const { return wireTable[measurementIndex[record]]; }
+    };
+
+
+    /**
+     *  Interface to be implemented by any producer receiving whole record batches.
+     */
+    class BatchProducer {
+    public:
+        /** Virtual destructor. */
+        virtual ~BatchProducer(void) {}
+
+        /**
+         * Callback to produce the given record batch to the next stage in the processing pipeline.
+         * @param batch The record batch; it is only valid for the duration of the call.
+         */
+        virtual void produce(const RecordBatch& batch) = 0;
+    };
+
+
+    /**
+     *  Class BatchingProducer implements the Producer interface by collecting all produced values into a RecordBatch;
+     *  on flush() the batch is passed to a BatchProducer. This connects existing processors like CalculatedValueProcessor
+     *  to batch-oriented writers.
+     */
+    class BatchingProducer : public Producer {
+    protected:
+        BatchProducer& batchProducer;   //!< Reference to the batch producer receiving the batches.
+        RecordBatch    batch;           //!< Reused record batch.
+
+    public:
+        BatchingProducer(BatchProducer& batch_producer);
+        virtual ~BatchingProducer(void);
+
+        virtual void flush(void);
+        virtual void produce(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value, const uint32_t time_in_ms = 0);
+    };
+
+
+    /**
+     *  Class ProducerBatchAdapter implements the BatchProducer interface on top of an existing Producer
+     *  by producing each record individually, followed by a single flush().
+     */
+    class ProducerBatchAdapter : public BatchProducer {
+    protected:
+        Producer& producer;             //!< Reference to the wrapped producer.
+
+    public:
+        ProducerBatchAdapter(Producer& producer);
+        virtual ~ProducerBatchAdapter(void);
+
+        virtual void produce(const RecordBatch& batch);
+    };
+
+}   // namespace libspeedwire
+
+#endif
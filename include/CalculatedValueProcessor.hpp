@@ -6,6 +6,7 @@
 #include <Producer.hpp>
 #include <ObisData.hpp>
 #include <SpeedwireData.hpp>
+#include <ExpressionEngine.hpp>
 
 namespace libspeedwire {
 
@@ -15,6 +16,10 @@ namespace libspeedwire {
      *
      *  The class is implemented as an ObisConsumer and SpeedwireConsumer. Values are passed on the obis_consumer and
      *  speedwire_consumer configured
+     *
+     *  In addition to the built-in derived values, site-specific derived values can be defined as formulas of the
+     *  ExpressionEngine returned by getExpressionEngine(); all elements of both data maps are bound as inputs by their
+     *  description. The formulas are evaluated at the end of each packet.
      */
     class CalculatedValueProcessor : public ObisConsumer, SpeedwireConsumer {
 
@@ -23,12 +28,17 @@ namespace libspeedwire {
         ObisDataMap& obis_data_map;       //!< Reference to the data map, where all received obis values reside
         SpeedwireDataMap& speedwire_data_map;  //!< Reference to the data map, where all received inverter values reside
         Producer& producer;            //!< Reference to producer to receive the consumed and calculated values
+        ExpressionEngine expressions;  //!< Engine evaluating user-defined formulas
+
+        void produceExpressions(ExpressionEngine& engine, const SpeedwireDevice& device, const uint32_t timestamp);
 
     public:
 
         CalculatedValueProcessor(ObisDataMap& obis_map, SpeedwireDataMap& speedwire_map, Producer& producer);
         ~CalculatedValueProcessor(void);
 
+        ExpressionEngine& getExpressionEngine(void) { return expressions; }
+
         virtual void consume(const SpeedwireDevice& device, ObisData& element);
         virtual void consume(const SpeedwireDevice& device, SpeedwireData& element);
 
@@ -0,0 +1,66 @@
+#ifndef __LIBSPEEDWIRE_ENERGYINTEGRATIONPROCESSOR_HPP__
+#define __LIBSPEEDWIRE_ENERGYINTEGRATIONPROCESSOR_HPP__
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <Consumer.hpp>
+#include <ObisData.hpp>
+#include <SpeedwireData.hpp>
+#include <Measurement.hpp>
+#include <Producer.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Class EnergyIntegrationProcessor turns power measurements received from emeter packets and inverter reply packets
+     *  into energy counters by trapezoidal integration. Each device and power measurement has its own accumulator;
+     *  updates are O(1) per value. Intervals longer than the configured maximum gap are not integrated, i.e. the energy
+     *  during data gaps is not estimated. Inverter timestamps in seconds are converted to milliseconds, such that all
+     *  accumulators integrate and produce timestamps in ms. Accumulated energies are produced at the end of each packet
+     *  and can be checkpointed to a file and restored after a restart.
+     */
+    class EnergyIntegrationProcessor : public ObisConsumer, SpeedwireConsumer {
+
+    protected:
+
+        //! Struct holding the integration state of a single power measurement of a given speedwire device.
+        typedef struct IntegrationState {
+            uint32_t        serialNumber;   //!< Serial number of the speedwire device.
+            double          energy;         //!< Accumulated energy in the power unit times hours, e.g. Wh.
+            double          lastValue;      //!< Most recent power value.
+            uint32_t        lastTime;       //!< Timestamp of the most recent power value in ms.
+            bool            lastIsValid;    //!< The most recent power value has been initialized.
+            bool            changed;        //!< The energy changed since it was produced last.
+            bool            typeIsValid;    //!< The output measurement type has been initialized.
+            MeasurementType type;           //!< Output measurement type.
+            Wire            wire;           //!< Output wire.
+            IntegrationState(void);
+        } IntegrationState;
+
+        Producer&     producer;                         //!< Reference to producer to receive the energy counters.
+        unsigned long maxGapInMs;                       //!< Maximum interval between two power values to be integrated.
+        std::map<uint64_t, IntegrationState> states;    //!< Integration states for all known devices and power measurements.
+
+        void process(const SpeedwireDevice& device, const uint32_t key, const unsigned long time_scale, const Measurement& measurement);
+        void produceEnergies(const SpeedwireDevice& device);
+
+    public:
+
+        EnergyIntegrationProcessor(Producer& producer, const unsigned long max_gap_in_ms);
+        ~EnergyIntegrationProcessor(void);
+
+        double getEnergy(const uint32_t serial_number, const uint32_t key) const;
+
+        bool saveCheckpoint(const std::string& path) const;
+        bool restoreCheckpoint(const std::string& path);
+
+        virtual void consume(const SpeedwireDevice& device, ObisData& element);
+        virtual void consume(const SpeedwireDevice& device, SpeedwireData& element);
+        virtual void endOfObisData(const SpeedwireDevice& device, const uint32_t time);
+        virtual void endOfSpeedwireData(const SpeedwireDevice& device, const uint32_t time);
+    };
+
+}   // namespace libspeedwire
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef __LIBSPEEDWIRE_EXPRESSIONENGINE_HPP__
+#define __LIBSPEEDWIRE_EXPRESSIONENGINE_HPP__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <Measurement.hpp>
+#include <ObisData.hpp>
+#include <SpeedwireData.hpp>
+#include <SpeedwireDevice.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Class ExpressionEngine evaluates derived values defined by formulas like
+     *  "signed_active_power_l1 = positive_active_power_l1 - negative_active_power_l1".
+     *
+     *  Formulas are compiled once into a flat list of stack machine instructions, where each variable reference is
+     *  pre-resolved to a slot index. Input slots are bound to measurements, e.g. the elements of an ObisDataMap, and read
+     *  the newest measurement value directly, without any map lookup. A dependency graph orders the formulas such that
+     *  outputs can be used as inputs of later formulas, and only formulas with at least one changed input are recomputed.
+     *
+     *  Supported syntax: numbers, variable names, + - * /, unary -, parentheses and the functions min(a,b), max(a,b), abs(a)
+     *  and mean(x); mean(x) takes a variable name and yields the mean of all values held by its bound measurement.
+     *  Formulas are separated by newlines or semicolons; text following a # is a comment.
+     *
+     *  Output timestamps are the newest timestamp of all inputs in emeter time, i.e. the lower 32 bits of the unix epoch
+     *  time in ms; inputs bound to inverter measurements are converted from inverter time in seconds.
+     */
+    class ExpressionEngine {
+    public:
+
+        //! Instruction opcodes of the stack machine.
+        enum class OpCode : uint8_t {
+            LOAD,       //!< Push the value of a slot.
+            CONSTANT,   //!< Push a constant.
+            ADD,        //!< Pop b, a; push a + b.
+            SUB,        //!< Pop b, a; push a - b.
+            MUL,        //!< Pop b, a; push a * b.
+            DIV,        //!< Pop b, a; push a / b, or 0 if b is 0.
+            NEG,        //!< Pop a; push -a.
+            MIN,        //!< Pop b, a; push min(a, b).
+            MAX,        //!< Pop b, a; push max(a, b).
+            ABS,        //!< Pop a; push abs(a).
+            MEAN        //!< Push the mean of all values of the measurement bound to a slot, or the value of the slot.
+        };
+
+        //! Single stack machine instruction.
+        typedef struct {
+            OpCode   op;        //!< Opcode.
+            uint32_t slot;      //!< Slot index for LOAD.
+            double   constant;  //!< Constant value for CONSTANT.
+        } Instruction;
+
+    protected:
+
+        //! Struct holding a variable slot; a slot is either an input bound to a measurement or the output of a formula.
+        typedef struct Slot {
+            std::string        name;        //!< Variable name.
+            const Measurement* input;       //!< Bound measurement, or NULL.
+            int                formula;     //!< Index of the formula computing this slot, or -1 for inputs.
+            double             value;       //!< Current value.
+            uint32_t           time;        //!< Timestamp of the current value in emeter time.
+            uint32_t           inputTime;   //!< Timestamp of the newest value of the bound measurement, in its own time domain.
+            bool               inSeconds;   //!< The bound measurement holds inverter timestamps in seconds.
+            bool               valid;       //!< The slot holds a value.
+            bool               changed;     //!< The value changed during the current evaluation.
+            bool               used;        //!< The slot is referenced by any formula.
+            bool               hasDevice;   //!< Outputs are produced with the device given below.
+            SpeedwireDevice    device;      //!< Output device.
+            MeasurementType    type;        //!< Output measurement type.
+            Wire               wire;        //!< Output wire.
+            Slot(const std::string& n);
+        } Slot;
+
+        //! Struct holding a compiled formula.
+        typedef struct {
+            uint32_t              output;   //!< Output slot index.
+            size_t                begin;    //!< Index of the first instruction.
+            size_t                end;      //!< Index behind the last instruction.
+            std::vector<uint32_t> inputs;   //!< Slot indexes referenced by the formula.
+        } Formula;
+
+        std::vector<Slot>            slots;         //!< All variable slots.
+        std::map<std::string, uint32_t> slotIndex;  //!< Map from variable name to slot index; used at compile time only.
+        std::vector<Instruction>     instructions;  //!< Flat instruction list of all formulas.
+        std::vector<Formula>         formulas;      //!< Formulas in dependency order.
+        std::vector<uint32_t>        usedInputs;    //!< Input slots referenced by any formula.
+        std::vector<double>          stack;         //!< Preallocated evaluation stack.
+
+        uint32_t getOrCreateSlot(const std::string& name);
+        void rollback(const size_t num_slots, const size_t num_instructions, const size_t num_formulas, const std::vector<bool>& used);
+        bool sortFormulas(void);
+        double execute(const Formula& formula);
+
+    public:
+
+        ExpressionEngine(void);
+        ~ExpressionEngine(void);
+
+        void bindInput(const std::string& name, const Measurement& measurement, const bool is_inverter_time = false);
+        void bindInputs(const ObisDataMap& map);
+        void bindInputs(const SpeedwireDataMap& map);
+        void bindOutput(const std::string& name, const MeasurementType& type, const Wire wire);
+        void bindOutput(const std::string& name, const SpeedwireDevice& device, const MeasurementType& type, const Wire wire);
+
+        bool compile(const std::string& text);
+        void clear(void);
+
+        size_t evaluate(void);
+
+        size_t getNumberOfFormulas(void) const { return formulas.size(); }
+        size_t getOutputSlot(const size_t formula_index) const { return formulas[formula_index].output; }
+        const std::vector<Instruction>& getInstructions(void) const { return instructions; }
+
+        int    findSlot(const std::string& name) const;
+        double getValue(const size_t slot) const { return slots[slot].value; }
+        bool   isValid(const size_t slot) const { return slots[slot].valid; }
+        bool   isChanged(const size_t slot) const { return slots[slot].changed; }
+        uint32_t getTime(const size_t slot) const { return slots[slot].time; }
+        bool   hasOutputDevice(const size_t slot) const { return slots[slot].hasDevice; }
+        const SpeedwireDevice& getOutputDevice(const size_t slot) const { return slots[slot].device; }
+        const MeasurementType& getOutputType(const size_t slot) const { return slots[slot].type; }
+        Wire   getOutputWire(const size_t slot) const { return slots[slot].wire; }
+    };
+
+}   // namespace libspeedwire
+
+#endif
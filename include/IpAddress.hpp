@@ -0,0 +1,90 @@
+#ifndef __LIBSPEEDWIRE_IPADDRESS_HPP__
+#define __LIBSPEEDWIRE_IPADDRESS_HPP__
+
+#ifdef _WIN32
+#include <Winsock2.h>
+#include <ws2ipdef.h>
+#include <inaddr.h>
+#include <in6addr.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <functional>
+
+namespace libspeedwire {
+
+    /**
+     *  Class IpAddress is a compact value type holding an ipv4 or ipv6 address in binary form.
+     *
+     *  The address is kept in its socket address form with port 0, such that it can be passed to socket calls without
+     *  any conversion. Instances are comparable and hashable and can therefore be used as keys in ordered and unordered
+     *  maps. Instances can be implicitly constructed from address strings in dot or colon notation; an empty or invalid
+     *  string results in an invalid address. Strings are only produced by toString().
+     */
+    class IpAddress {
+    protected:
+        union {
+            struct sockaddr     sa;         //!< Generic socket address; sa_family is AF_UNSPEC for an invalid address.
+            struct sockaddr_in  v4;         //!< Ipv4 socket address.
+            struct sockaddr_in6 v6;         //!< Ipv6 socket address.
+        } addr;
+
+    public:
+        IpAddress(void);
+        IpAddress(const std::string& ip_address);
+        IpAddress(const char* const ip_address);
+        IpAddress(const struct in_addr& address);
+        IpAddress(const struct in6_addr& address);
+        IpAddress(const struct sockaddr& address);
+
+        /** Check if this is a valid ipv4 or ipv6 address. */
+        bool isValid(void) const { return (addr.sa.sa_family == AF_INET || addr.sa.sa_family == AF_INET6); }
+
+        /** Check if this is an ipv4 address. */
+        bool isIpv4(void) const { return (addr.sa.sa_family == AF_INET); }
+
+        /** Check if this is an ipv6 address. */
+        bool isIpv6(void) const { return (addr.sa.sa_family == AF_INET6); }
+
+        bool isAny(void) const;
+
+        /** Get the ipv4 address; only meaningful if isIpv4() is true. */
+        const struct in_addr& getInAddress(void) const { return addr.v4.sin_addr; }
+
+        /** Get the ipv6 address; only meaningful if isIpv6() is true. */
+        const struct in6_addr& getIn6Address(void) const { return addr.v6.sin6_addr; }
+
+        /** Get the socket address with port 0. */
+        const struct sockaddr& getSockAddr(void) const { return addr.sa; }
+
+        /** Get the ipv4 socket address with port 0; only meaningful if isIpv4() is true. */
+        const struct sockaddr_in& getSockAddrIn(void) const { return addr.v4; }
+
+        /** Get the ipv6 socket address with port 0; only meaningful if isIpv6() is true. */
+        const struct sockaddr_in6& getSockAddrIn6(void) const { return addr.v6; }
+
+        std::string toString(void) const;
+        size_t      hash(void) const;
+
+        bool operator==(const IpAddress& rhs) const;
+        bool operator!=(const IpAddress& rhs) const { return !(*this == rhs); }
+        bool operator<(const IpAddress& rhs) const;
+    };
+
+}   // namespace libspeedwire
+
+
+namespace std {
+
+    /** Hash function for IpAddress instances, such that they can be used as keys in unordered containers. */
+    template<> struct hash<libspeedwire::IpAddress> {
+        size_t operator()(const libspeedwire::IpAddress& address) const { return address.hash(); }
+    };
+
+}   // namespace std
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef __LIBSPEEDWIRE_LINEPROTOCOLPRODUCER_HPP__
+#define __LIBSPEEDWIRE_LINEPROTOCOLPRODUCER_HPP__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <Producer.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Interface to be implemented by any consumer of encoded InfluxDB line protocol data, e.g. an http or file writer.
+     */
+    class LineProtocolWriter {
+    public:
+        /** Virtual destructor. */
+        virtual ~LineProtocolWriter(void) {}
+
+        /**
+         * Callback to write a block of complete lines.
+         * @param data Pointer to the encoded lines; the data is only valid for the duration of the call.
+         * @param length Number of bytes.
+         */
+        virtual void write(const char* data, const size_t length) = 0;
+    };
+
+
+    /**
+     *  Class LineProtocolEncoder encodes measurement values into InfluxDB line protocol using a reusable buffer.
+     *  Lines have the form "<measurement>,class=<device class>,serial=<serial>,susyid=<susyid> <field>=<value> <time>",
+     *  where the field name is MeasurementType::getFullName(wire) and the timestamp is in milliseconds since unix epoch.
+     *
+     *  The line prefix up to and including "=" is precomputed once per device and measurement. Integers are formatted
+     *  digit pair-wise; values that are exact at the decimal resolution given by the measurement divisor are formatted
+     *  as scaled integers, other values fall back to the shortest 15, 16 or 17 digit round-trip representation. Non-finite
+     *  values are skipped. After warm-up, encoding does not allocate memory.
+     */
+    class LineProtocolEncoder {
+    protected:
+        //! Struct holding a precomputed line prefix together with the device properties not covered by its cache key.
+        typedef struct Prefix {
+            uint16_t    susyID;                                 //!< Susy id of the device.
+            std::string deviceClass;                            //!< Device class of the device.
+            std::string line;                                   //!< Line prefix up to and including "=".
+        } Prefix;
+
+        std::string measurementName;                            //!< Escaped line protocol measurement name.
+        std::unordered_map<uint64_t, Prefix> prefixes;          //!< Cache of precomputed line prefixes.
+        std::vector<char> buffer;                               //!< Encoded lines.
+        size_t length;                                          //!< Number of valid bytes in the buffer.
+
+        const std::string& getPrefix(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire);
+
+    public:
+
+        LineProtocolEncoder(const std::string& measurement_name = "speedwire", const size_t initial_capacity = 64 * 1024);
+
+        void encode(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value, const uint64_t time_in_ms);
+
+        const char* data(void) const { return buffer.data(); }
+        size_t size(void) const { return length; }
+        void clear(void) { length = 0; }
+
+        static size_t formatUnsigned(char* out, uint64_t value);
+        static size_t formatDouble(char* out, const double value, const unsigned long divisor);
+        static void appendEscaped(std::string& out, const std::string& in, const bool is_measurement);
+    };
+
+
+    /**
+     *  Class LineProtocolProducer implements the Producer interface by encoding all produced values into InfluxDB line
+     *  protocol and passing them as a single block to a LineProtocolWriter on flush(). Truncated 32-bit timestamps are
+     *  expanded to 64-bit unix epoch milliseconds; a timestamp of 0 is replaced by the current time.
+     */
+    class LineProtocolProducer : public Producer {
+    protected:
+        LineProtocolWriter& writer;     //!< Reference to the writer receiving the encoded lines.
+        LineProtocolEncoder encoder;    //!< Line protocol encoder.
+        size_t   maxBufferSize;         //!< Buffer size above which the encoded lines are written without waiting for flush().
+        uint64_t currentTime;           //!< Unix epoch time in ms captured with the first value after a flush.
+
+    public:
+        LineProtocolProducer(LineProtocolWriter& writer, const std::string& measurement_name = "speedwire", const size_t max_buffer_size = 64 * 1024);
+        virtual ~LineProtocolProducer(void);
+
+        virtual void flush(void);
+        virtual void produce(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value, const uint32_t time_in_ms = 0);
+    };
+
+}   // namespace libspeedwire
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef __LIBSPEEDWIRE_MAPPEDFILE_HPP__
+#define __LIBSPEEDWIRE_MAPPEDFILE_HPP__
+
+#include <cstdint>
+#include <string>
+
+namespace libspeedwire {
+
+    /**
+     *  Class MappedFile maps a file of fixed size into memory. Files opened for writing are created and
+     *  preallocated to their full size, such that later writes to the mapping cannot fail due to lack of disk space.
+     */
+    class MappedFile {
+    protected:
+        std::string path;       //!< File path.
+        uint8_t*    address;    //!< Start address of the mapping, or nullptr if the file is not mapped.
+        size_t      length;     //!< Size of the mapping in bytes.
+        bool        writable;   //!< The mapping is writable.
+#ifdef _WIN32
+        void*       file;       //!< File handle.
+        void*       mapping;    //!< File mapping handle.
+#else
+        int         fd;         //!< File descriptor.
+#endif
+
+    public:
+        MappedFile(void);
+        ~MappedFile(void);
+
+        bool create(const std::string& path, const size_t size);
+        bool open(const std::string& path);
+        bool sync(const size_t offset, const size_t size, const bool blocking);
+        void close(void);
+
+        /** Check if the file is mapped. */
+        bool isOpen(void) const { return address != nullptr; }
+
+        /** Get the start address of the mapping. */
+        uint8_t* data(void) const { return address; }
+
+        /** Get the size of the mapping in bytes. */
+        size_t size(void) const { return length; }
+
+        /** Get the file path. */
+        const std::string& getPath(void) const { return path; }
+    };
+
+}   // namespace libspeedwire
+
+#endif
@@ -216,7 +216,7 @@ namespace libspeedwire {
          *  @return reference to the index out of bound element.
          */
         static const T& getIndexOutOfBoundsElement(void) {
-            static const T el;
+            static const T el = T();
             return el;
         }
 
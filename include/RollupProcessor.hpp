@@ -0,0 +1,85 @@
+#ifndef __LIBSPEEDWIRE_ROLLUPPROCESSOR_HPP__
+#define __LIBSPEEDWIRE_ROLLUPPROCESSOR_HPP__
+
+#include <cstdint>
+#include <map>
+#include <vector>
+#include <Consumer.hpp>
+#include <ObisData.hpp>
+#include <SpeedwireData.hpp>
+#include <Measurement.hpp>
+#include <RingBuffer.hpp>
+#include <WindowAggregate.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Class RollupProcessor implements multi-resolution incremental rollups of obis elements received from emeter
+     *  packets and inverter reply packets. Raw values are aggregated into buckets of the finest resolution; each
+     *  closed bucket is merged into the open bucket of the next coarser resolution, such that no resolution is ever
+     *  recomputed from raw values. Energy counters are rolled up as deltas, all other quantities as time-weighted means.
+     *  Each resolution keeps a bounded history of closed buckets.
+     */
+    class RollupProcessor : public ObisConsumer, SpeedwireConsumer {
+    public:
+
+        //! Class holding the aggregate of a single rollup bucket.
+        class RollupBucket {
+        public:
+            uint32_t        startTime;  //!< Start timestamp of the bucket, in the time domain of the measurement.
+            bool            isDelta;    //!< True if the aggregate holds energy counter deltas.
+            WindowAggregate aggregate;  //!< Aggregate of all values inside the bucket.
+
+            RollupBucket(void) : startTime(0), isDelta(false) {}
+
+            /** Get the representative value: the energy delta for counters, the time-weighted mean otherwise. */
+            double getValue(void) const { return (isDelta ? aggregate.sum : aggregate.getTimeWeightedMean()); }
+        };
+
+    protected:
+
+        //! Struct holding the rollup buckets of a single resolution.
+        typedef struct RollupLevel {
+            uint32_t                 resolution;    //!< Bucket length in timestamp units.
+            RingBuffer<RollupBucket> buckets;       //!< Bounded history of closed buckets.
+            RollupBucket             open;          //!< The currently open bucket.
+            bool                     openIsValid;   //!< The open bucket has been initialized.
+            RollupLevel(void) : resolution(0), buckets(0), openIsValid(false) {}
+        } RollupLevel;
+
+        //! Struct holding the rollup state of a single measurement of a given speedwire device.
+        typedef struct RollupState {
+            bool     isCounter;                     //!< True if the measurement is an energy counter.
+            double   previousCounter;               //!< Previous counter value, used to calculate deltas.
+            bool     previousCounterIsValid;        //!< The previous counter value has been initialized.
+            std::vector<RollupLevel> levels;        //!< Rollup levels from finest to coarsest resolution.
+            RollupState(void) : isCounter(false), previousCounter(0.0), previousCounterIsValid(false) {}
+        } RollupState;
+
+        std::vector<unsigned long> resolutionsInMs;     //!< Bucket lengths in milliseconds, from finest to coarsest.
+        std::vector<size_t>        capacities;          //!< Maximum number of closed buckets per resolution.
+        std::map<uint64_t, RollupState> states;         //!< Rollup states for all known devices and measurements.
+
+        RollupState& findOrCreateState(const uint32_t serial_number, const uint32_t key, const unsigned long time_scale, const Measurement& measurement);
+        void process(const uint32_t serial_number, const uint32_t key, const unsigned long time_scale, const Measurement& measurement);
+        void mergeIntoLevel(RollupState& state, const size_t level_index, const RollupBucket& bucket);
+
+    public:
+
+        RollupProcessor(void);
+        RollupProcessor(const std::vector<unsigned long>& resolutions_in_ms, const std::vector<size_t>& bucket_capacities);
+        ~RollupProcessor(void);
+
+        const std::vector<unsigned long>& getResolutions(void) const { return resolutionsInMs; }
+
+        size_t getRollups(const uint32_t serial_number, const uint32_t key, const unsigned long resolution_in_ms, std::vector<RollupBucket>& buckets, const bool include_open_bucket = false) const;
+        size_t getRollups(const SpeedwireDevice& device, const ObisType& type, const unsigned long resolution_in_ms, std::vector<RollupBucket>& buckets, const bool include_open_bucket = false) const;
+        size_t getRollups(const SpeedwireDevice& device, const SpeedwireRawData& data, const unsigned long resolution_in_ms, std::vector<RollupBucket>& buckets, const bool include_open_bucket = false) const;
+
+        virtual void consume(const SpeedwireDevice& device, ObisData& element);
+        virtual void consume(const SpeedwireDevice& device, SpeedwireData& element);
+    };
+
+}   // namespace libspeedwire
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef __LIBSPEEDWIRE_SHAREDVALUETABLE_HPP__
+#define __LIBSPEEDWIRE_SHAREDVALUETABLE_HPP__
+
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <Producer.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Struct describing the header at the start of a shared value table.
+     */
+    typedef struct SharedValueTableHeader {
+        char     magic[8];                      //!< Table magic "SWLIVEV1"; it is written last during initialization.
+        uint32_t capacity;                      //!< Number of slots; it is a power of 2.
+        uint32_t slotSize;                      //!< Size of a slot in bytes.
+        std::atomic<uint32_t> usedSlots;        //!< Number of slots holding a value.
+        uint32_t reserved;                      //!< Reserved, 0.
+        std::atomic<uint64_t> updateCount;      //!< Incremented on each flush of the publisher.
+        uint8_t  padding[32];                   //!< Padding to 64 bytes.
+    } SharedValueTableHeader;
+
+
+    /**
+     *  Struct describing a single slot of a shared value table. Each slot is protected by its own sequence lock:
+     *  the sequence number is odd while the publisher updates the slot and 0 if the slot has never been used.
+     *  All fields are atomics such that concurrent reads are well-defined.
+     */
+    typedef struct SharedValueSlot {
+        std::atomic<uint32_t> sequence;         //!< Sequence lock counter.
+        std::atomic<uint32_t> susyID;           //!< Device susy id.
+        std::atomic<uint64_t> key;              //!< Device serial number in the upper 32 bits, measurement id in the lower 32 bits.
+        std::atomic<uint64_t> value;            //!< Bit pattern of the double value.
+        std::atomic<uint64_t> time;             //!< Measurement time in ms since unix epoch.
+        uint8_t padding[32];                    //!< Padding to 64 bytes, such that each slot occupies its own cache line.
+    } SharedValueSlot;
+
+
+    /**
+     *  Struct holding a consistent copy of a single shared value.
+     */
+    typedef struct SharedValue {
+        uint32_t serialNumber;                  //!< Device serial number.
+        uint32_t susyID;                        //!< Device susy id.
+        uint32_t measurementId;                 //!< Measurement id, see ArchiveProducer::getMeasurementId().
+        double   value;                         //!< Latest value.
+        uint64_t time;                          //!< Time of the latest value in ms since unix epoch.
+    } SharedValue;
+
+
+    /**
+     *  Class SharedValuePublisher implements the Producer interface by writing the latest value and timestamp of each
+     *  device and measurement into a table in named shared memory. Any number of local processes can read the table
+     *  using SharedValueReader, without running their own receive and filter pipeline.
+     *
+     *  There must be a single publisher per table. Slots are assigned on first use by open addressing and never removed;
+     *  values of a full table are dropped.
+     */
+    class SharedValuePublisher : public Producer {
+    protected:
+        std::string name;                       //!< Shared memory object name.
+        bool        removeOnClose;              //!< Remove the shared memory object in the destructor.
+        size_t      size;                       //!< Size of the mapping in bytes.
+        SharedValueTableHeader* header;         //!< Table header, or nullptr if the table could not be created.
+        SharedValueSlot* slots;                 //!< Table slots.
+        uint64_t    currentTime;                //!< Unix epoch time in ms captured with the first value after a flush.
+        uint64_t    droppedCount;               //!< Number of values dropped due to a full table.
+#ifdef _WIN32
+        void*       mapping;                    //!< File mapping handle.
+#endif
+
+    public:
+        SharedValuePublisher(const std::string& name, const size_t capacity = 1024, const bool remove_on_close = true);
+        virtual ~SharedValuePublisher(void);
+
+        /** Check if the shared memory table has been created successfully. */
+        bool isOpen(void) const { return header != nullptr; }
+
+        /** Get the number of values dropped due to a full table. */
+        uint64_t getDroppedCount(void) const { return droppedCount; }
+
+        bool publish(const uint32_t serial, const uint32_t susy_id, const uint32_t measurement_id, const double value, const uint64_t time);
+
+        virtual void flush(void);
+        virtual void produce(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value, const uint32_t time_in_ms = 0);
+    };
+
+
+    /**
+     *  Class SharedValueReader maps a shared value table read-only. Reads never block the publisher and never take locks;
+     *  a read of a slot is retried only while the publisher is updating exactly this slot.
+     */
+    class SharedValueReader {
+    protected:
+        size_t size;                            //!< Size of the mapping in bytes.
+        const SharedValueTableHeader* header;   //!< Table header, or nullptr if no table is open.
+        const SharedValueSlot* slots;           //!< Table slots.
+#ifdef _WIN32
+        void*  mapping;                         //!< File mapping handle.
+#endif
+
+        bool readSlot(const SharedValueSlot& slot, SharedValue& value, uint32_t& sequence) const;
+
+    public:
+        SharedValueReader(void);
+        ~SharedValueReader(void);
+
+        bool open(const std::string& name);
+        void close(void);
+
+        /** Check if a table is open. */
+        bool isOpen(void) const { return header != nullptr; }
+
+        /** Get the update counter; it is incremented on each flush of the publisher. */
+        uint64_t getUpdateCount(void) const { return (header != nullptr ? header->updateCount.load(std::memory_order_acquire) : 0); }
+
+        bool read(const uint32_t serial, const uint32_t measurement_id, SharedValue& value) const;
+        size_t snapshot(std::vector<SharedValue>& values) const;
+    };
+
+}   // namespace libspeedwire
+
+#endif
@@ -78,17 +78,17 @@ namespace libspeedwire {
         bool login(const Credentials& credentials, const int timeout_in_ms);
         bool loginAnyToAny(const Credentials& credentials, const int timeout_in_ms);
         bool login(const SpeedwireDevice& dst_peer, const Credentials& credentials, const int timeout_in_ms = 1000);
-        bool login(const std::string& if_address, const SpeedwireAddress& dst, const SpeedwireAddress& src, const Credentials& credentials, const int timeout_in_ms = 1000);
+        bool login(const IpAddress& if_address, const SpeedwireAddress& dst, const SpeedwireAddress& src, const Credentials& credentials, const int timeout_in_ms = 1000);
 
         // synchronous logoff command methods - send command requests and wait for the response
         bool logoff(void);
         bool logoffAnyFromAny(void);
         bool logoff(const SpeedwireDevice& dst_peer);
-        bool logoff(const std::string& if_address, const SpeedwireAddress& dst, const SpeedwireAddress& src);
+        bool logoff(const IpAddress& if_address, const SpeedwireAddress& dst, const SpeedwireAddress& src);
 
         // asynchronous send command methods - send command requests and return immediately
-        SpeedwireCommandTokenIndex sendLoginRequest(const std::string& if_address, const SpeedwireAddress& dst, const SpeedwireAddress& src, const Credentials& credentials);
-        bool sendLogoffRequest(const std::string& if_address, const SpeedwireAddress& dst, const SpeedwireAddress& src);
+        SpeedwireCommandTokenIndex sendLoginRequest(const IpAddress& if_address, const SpeedwireAddress& dst, const SpeedwireAddress& src, const Credentials& credentials);
+        bool sendLogoffRequest(const IpAddress& if_address, const SpeedwireAddress& dst, const SpeedwireAddress& src);
     };
 
 }   // namespace libspeedwire
@@ -3,14 +3,22 @@
 
 #include <cstdint>
 #include <string>
+#include <atomic>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <mutex>
 #include <SpeedwireDiscovery.hpp>
 #include <SpeedwireHeader.hpp>
 #include <SpeedwireSocket.hpp>
+#include <SpeedwireResponseDemultiplexer.hpp>
+#include <SpeedwireRequestTemplates.hpp>
+#include <SpeedwirePacketIdAllocator.hpp>
 
 namespace libspeedwire {
 
+    class SpeedwireResponseCache;
+
     enum class Command : uint32_t {
         NONE                  = 0x00000000,
 
@@ -79,44 +87,108 @@ namespace libspeedwire {
         uint16_t    susyid;             //!< Susyid of the speedwire device the query was send to
         uint32_t    serialnumber;       //!< Serial number of the speedwire device the query was send to
         uint16_t    packetid;           //!< Packet identifier of the query packet
-        std::string peer_ip_address;    //!< IP address of the speedwire device the query was send to
+        IpAddress   peer_ip_address;    //!< IP address of the speedwire device the query was send to
         Command     command;            //!< Command identifier of the query
         uint32_t    create_time;        //!< Creation time of the query as lower 32-bit of unix epoch timestamp
     } SpeedwireCommandToken;
 
 
     /**
-     *  Class SpeedwireCommandTokenRepository holds SpeedwireCommandTokens from when the command is send
-     *  to the peer until the corresponding reply is received.
+     *  Type SpeedwireCommandTokenIndex is a handle to a token in the SpeedwireCommandTokenRepository. The lower 16 bits
+     *  hold the slot index and the upper bits hold the generation of the slot. A handle stays valid until its token is
+     *  removed or expired; it is not affected by the removal of other tokens. Negative values denote an invalid handle.
      */
     typedef int SpeedwireCommandTokenIndex;
 
+
+    /**
+     *  Struct SpeedwireQueryRequest describes a query to be sent by SpeedwireCommand::sendQueryRequests().
+     */
+    typedef struct SpeedwireQueryRequest {
+        const SpeedwireDevice*     peer;            //!< Device to be queried
+        Command                    command;         //!< Query command
+        uint32_t                   firstRegister;   //!< First register of the query
+        uint32_t                   lastRegister;    //!< Last register of the query
+        SpeedwireCommandTokenIndex token;           //!< Returns the command token, or -1 if the request could not be sent
+
+        SpeedwireQueryRequest(const SpeedwireDevice& _peer, const Command _command, const uint32_t first_register, const uint32_t last_register) :
+            peer(&_peer), command(_command), firstRegister(first_register), lastRegister(last_register), token(-1) {}
+    } SpeedwireQueryRequest;
+
+    /**
+     *  Class SpeedwireCommandTokenRepository holds SpeedwireCommandTokens from when the command is send
+     *  to the peer until the corresponding reply is received. Tokens are stored in a slot map and indexed by
+     *  (susyid, serialnumber, packetid) in a hash table, such that add, find and remove take constant time.
+     *  For expiry, tokens are additionally linked into a timer wheel by their creation time. If a packet id allocator
+     *  is set, the packet id of a token is released to it whenever the token is removed or expires.
+     *  All methods are synchronized, so query engines polled on different threads can share one repository; at()
+     *  therefore returns a copy of the token.
+     */
     class SpeedwireCommandTokenRepository {
     public:
-        SpeedwireCommandTokenIndex add(const uint16_t susyid, const uint32_t serialnumber, const uint16_t packetid, const std::string& peer_ip_address, const Command command);
+        SpeedwireCommandTokenIndex add(const uint16_t susyid, const uint32_t serialnumber, const uint16_t packetid, const IpAddress& peer_ip_address, const Command command);
         int  find(const uint16_t susyid, const uint32_t serialnumber, const uint16_t packetid) const;
         void remove(const SpeedwireCommandTokenIndex index);
         void clear(void);
         int  expire(const int timeout_in_ms);
-        const SpeedwireCommandToken& at(const SpeedwireCommandTokenIndex index) const;
+        int  expire(const int timeout_in_ms, const uint32_t now);
+        bool isValid(const SpeedwireCommandTokenIndex index) const;
+        SpeedwireCommandToken at(const SpeedwireCommandTokenIndex index) const;
         int  size(void) const;
-        bool needs_login;
+        std::atomic<bool> needs_login;
+
+        /** Set the allocator receiving the packet ids of removed and expired tokens, or nullptr. */
+        void setPacketIdAllocator(SpeedwirePacketIdAllocator* allocator) { packet_ids = allocator; }
+
+        SpeedwireCommandTokenRepository(void);
 
-        SpeedwireCommandTokenRepository(void) { needs_login = false; }
+        /** Get the key identifying replies to a token, i.e. (susyid, serialnumber, packetid). */
+        static uint64_t getKey(const uint16_t susyid, const uint32_t serialnumber, const uint16_t packetid) {
+            return ((uint64_t)susyid << 48) | ((uint64_t)serialnumber << 16) | (uint64_t)(packetid | 0x8000);
+        }
 
     protected:
-        std::vector<SpeedwireCommandToken> token;
+        static const size_t   max_slots = 0x10000;          //!< Maximum number of tokens; limited by the 16-bit slot index of a handle.
+        static const uint32_t wheel_granularity = 64;       //!< Timer wheel bucket width in ms; a power of 2.
+        static const uint32_t wheel_size = 256;             //!< Number of timer wheel buckets; a power of 2.
+        static const uint32_t none = 0xffffffff;            //!< Invalid slot index.
+
+        //! Struct holding a token slot together with its free list and timer wheel links.
+        typedef struct Slot {
+            SpeedwireCommandToken token;    //!< The token.
+            uint16_t generation;            //!< Incremented whenever the slot is released; stale handles do not match.
+            bool     used;                  //!< The slot holds a token.
+            uint32_t prev;                  //!< Previous slot in the same timer wheel bucket.
+            uint32_t next;                  //!< Next slot in the same timer wheel bucket or in the free list.
+        } Slot;
+
+        std::vector<Slot> slots;                            //!< Token slots.
+        std::vector<uint32_t> wheel;                        //!< Timer wheel buckets, each the head of a list of slots.
+        std::unordered_map<uint64_t, uint32_t> index_map;   //!< Map of (susyid, serialnumber, packetid) to slot index.
+        uint32_t free_list;                                 //!< Head of the list of unused slots.
+        uint32_t wheel_time;                                //!< No token has a creation time before this time.
+        int      num_tokens;                                //!< Number of tokens.
+        SpeedwirePacketIdAllocator* packet_ids;             //!< Allocator receiving released packet ids, or nullptr.
+        mutable std::mutex mutex;                           //!< Mutex protecting all members except needs_login.
+
+        uint32_t getSlotIndex(const SpeedwireCommandTokenIndex index) const;
+        void release(const uint32_t slot_index, const bool release_packet_id = true);
     };
 
 
 
     /**
      *  Class SpeedwireCommand holds functionality to send commands to peers and to check a reply packet for validity
+     *
+     *  The packet id allocator, the response demultiplexer, the token repository and the request templates are
+     *  synchronized, and batched sends are serialized, so an instance can be shared by query engines polled on
+     *  different threads. The optional response cache is not synchronized and must only be set if query() and
+     *  queryDeviceType() are called from a single thread.
      */
     class SpeedwireCommand {
     public:
         typedef int SocketIndex;
-        typedef std::map<std::string, SocketIndex> SocketMap;
+        typedef std::unordered_map<IpAddress, SocketIndex> SocketMap;
 
     protected:
         const LocalHost& localhost;
@@ -124,11 +196,30 @@ namespace libspeedwire {
         std::vector<SpeedwireSocket> sockets;
         SocketMap socket_map;
 
-        static uint16_t packet_id;
+        // the demultiplexer routes replies received on the unicast sockets to their pending requests
+        SpeedwireResponseDemultiplexer demultiplexer;
+
+        // packet id counter for requests that are not matched to a device, e.g. discovery requests
+        static std::atomic<uint16_t> packet_id;
+
+        // per-device packet id spaces for requests matched by command tokens
+        SpeedwirePacketIdAllocator packet_ids;
 
         // query tokens are used to match inverter command requests with their responses
         SpeedwireCommandTokenRepository token_repository;
 
+        // optional cache serving replies of slow-changing registers
+        SpeedwireResponseCache* response_cache;
+
+        // prebuilt request packets; only the packet id and login time are patched per request
+        SpeedwireRequestTemplates request_templates;
+
+        // batched query requests: packet buffer and datagrams reused across calls
+        std::vector<uint8_t> batch_buffer;
+        std::vector<SpeedwireSocket::Datagram> batch_datagrams;
+        std::vector<std::pair<size_t, uint16_t> > batch_requests;
+        std::mutex batch_mutex;
+
     public:
         SpeedwireCommand(const LocalHost& localhost, const std::vector<SpeedwireDevice>& devices);
         ~SpeedwireCommand(void);
@@ -136,13 +227,18 @@ namespace libspeedwire {
         // synchronous command methods - send command requests and wait for the response
         int32_t query(const SpeedwireDevice& peer, const Command command, const uint32_t first_register, const uint32_t last_register, void* udp_buffer, const size_t udp_buffer_size, const int timeout_in_ms = 1000);
         SpeedwireDevice queryDeviceType(const SpeedwireDevice& peer, const int timeout_in_ms = 1000);
+        std::vector<SpeedwireDevice> queryDeviceTypes(const std::vector<SpeedwireDevice>& peers, const int timeout_in_ms = 1000);
+
+        // augment the device information with the device class and model found in a device type reply packet
+        static void parseDeviceTypeReply(const void* udp_packet, const int32_t nbytes, SpeedwireDevice& info);
 
         // asynchronous send command method - send command requests and return immediately
         SpeedwireCommandTokenIndex sendQueryRequest(const SpeedwireDevice& peer, const Command command, const uint32_t first_register, const uint32_t last_register);
+        int sendQueryRequests(std::vector<SpeedwireQueryRequest>& requests);
 
         // synchronous receive method - receive command reply packet for the given command token; this method will block until the packet is received or it times out
         // (for asynchronous receive handling, see class SpeedwireReceiveDispatcher)
-        int32_t receiveResponse(const SpeedwireCommandTokenIndex index, SpeedwireSocket& socket, void* udp_buffer, const size_t udp_buffer_size, const int poll_timeout_in_ms);
+        int32_t receiveResponse(const SpeedwireCommandTokenIndex index, void* udp_buffer, const size_t udp_buffer_size, const int poll_timeout_in_ms);
 
         // find SpeedwireCommandToken for the reply packet
         int findCommandToken(const SpeedwireHeader& speedwire_packet) const;   // convenience method => returns index
@@ -154,13 +250,27 @@ namespace libspeedwire {
         // get token repository
         SpeedwireCommandTokenRepository& getTokenRepository(void);
 
+        // get the index of the unicast socket for the given interface, -1 if it could not be opened, or 0 if the interface is unknown
+        SocketIndex getSocketIndex(const IpAddress& interface_ip_address) const;
+
         // get socket map
         const SocketMap& getSocketMap(void) const { return socket_map; }
 
-        // increment packet id and return it
+        // get the response demultiplexer
+        SpeedwireResponseDemultiplexer& getDemultiplexer(void) { return demultiplexer; }
+
+        // get unicast command sockets
+        const std::vector<SpeedwireSocket>& getSockets(void) const { return sockets; }
+
+        // get the packet id allocator
+        SpeedwirePacketIdAllocator& getPacketIdAllocator(void) { return packet_ids; }
+
+        // set the response cache used by query() and queryDeviceType(), or nullptr to disable caching
+        void setResponseCache(SpeedwireResponseCache* cache) { response_cache = cache; }
+
+        // increment packet id and return it; this is thread-safe
         static uint16_t getIncrementedPacketID(void) {
-            packet_id = (packet_id + 1) | 0x8000;
-            return packet_id;
+            return (uint16_t)((packet_id.fetch_add(1) + 1) | 0x8000);
         }
     };
 
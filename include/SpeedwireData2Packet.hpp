@@ -2,6 +2,7 @@
 #define __LIBSPEEDWIRE_SPEEDWIREDATA2PACKET_H__
 
 #include <cstdint>
+#include <cstddef>
 #include <string>
 #include <SpeedwireByteEncoding.hpp>
 #include <SpeedwireTagHeader.hpp>
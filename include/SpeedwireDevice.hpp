@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <string>
 #include <AddressConversion.hpp>
+#include <IpAddress.hpp>
 #include <LocalHost.hpp>
 
 namespace libspeedwire {
@@ -104,8 +105,8 @@ namespace libspeedwire {
         SpeedwireAddress deviceAddress;         //!< Speedwire device address, i.e. susy ID and serial number
         std::string      deviceClass;           //!< Device class of the speedwire device, i.e. emeter or inverter.
         std::string      deviceModel;           //!< Device model of the speedwire device, i.e. emeter or inverter.
-        std::string      deviceIpAddress;       //!< IP address of the device, either on the local subnet or somewhere else.
-        std::string      interfaceIpAddress;    //!< IP address of the local interface through which the device is reachable.
+        IpAddress        deviceIpAddress;       //!< IP address of the device, either on the local subnet or somewhere else.
+        IpAddress        interfaceIpAddress;    //!< IP address of the local interface through which the device is reachable.
 
         /** Default constructor.
          *  Just initialize all member variables to a defined state; set susyId and serialNumber to 0. */
@@ -115,7 +116,7 @@ namespace libspeedwire {
         std::string toString(void) const {
             char buffer[256] = { 0 };
             snprintf(buffer, sizeof(buffer), "SusyID %3u  Serial %10u  Class %-16s  Model %-14s  IP %s  IF %s",
-                deviceAddress.susyID, deviceAddress.serialNumber, deviceClass.c_str(), deviceModel.c_str(), deviceIpAddress.c_str(), interfaceIpAddress.c_str());
+                deviceAddress.susyID, deviceAddress.serialNumber, deviceClass.c_str(), deviceModel.c_str(), deviceIpAddress.toString().c_str(), interfaceIpAddress.toString().c_str());
             return std::string(buffer);
         }
 
@@ -123,14 +124,14 @@ namespace libspeedwire {
         bool operator==(const SpeedwireDevice& rhs) const { return (deviceAddress == rhs.deviceAddress && deviceIpAddress == rhs.deviceIpAddress); }
 
         /** Check if this instance is just pre-registered with a given IP, i.e the device ip address is given. */
-        bool hasIPAddressOnly(void) const { return (deviceIpAddress.length() > 0 && deviceAddress.isComplete() == false); }
+        bool hasIPAddressOnly(void) const { return (deviceIpAddress.isValid() && deviceAddress.isComplete() == false); }
 
         /** Check if this instance is just pre-registered with a given serial number, i.e the device serial number is given. */
-        bool hasSerialNumberOnly(void) const { return (deviceIpAddress.length() == 0 && deviceAddress.susyID == 0 && deviceAddress.serialNumber != 0); }
+        bool hasSerialNumberOnly(void) const { return (deviceIpAddress.isValid() == false && deviceAddress.susyID == 0 && deviceAddress.serialNumber != 0); }
 
         /** Check if this instance is fully registered, i.e all device information is given. */
         bool isComplete(void) const {
-            return (deviceAddress.isComplete() && deviceClass.length() > 0 && deviceModel.length() > 0 && deviceIpAddress.length() > 0 && interfaceIpAddress.length() > 0);
+            return (deviceAddress.isComplete() && deviceClass.length() > 0 && deviceModel.length() > 0 && deviceIpAddress.isValid() && interfaceIpAddress.isValid());
         }
     };
 
@@ -2,6 +2,7 @@
 #define __LIBSPEEDWIRE_SPEEDWIREDISCOVERY_HPP__
 
 #include <cstdint>
+#include <string>
 #include <vector>
 #include <LocalHost.hpp>
 #include <SpeedwireSocket.hpp>
@@ -9,6 +10,9 @@
 
 namespace libspeedwire {
 
+    // forward declarations
+    class SpeedwireCommand;
+
     /**
      *  Class implementing a discovery mechanism for speedwire devices.
      *  Discovery is performed against all potential devices on all local subnets that are connected to the different
@@ -17,6 +21,14 @@ namespace libspeedwire {
      *  - multicast speedwire discovery requests to all interfaces
      *  - unicast speedwire discovery requests to pre-registered hosts
      *  - unicast speedwire discovery requests to all hosts on the network (only if the network prefix is < /16)
+     *
+     *  For a fast startup, fully registered devices can be saved to a device cache file and loaded from it on the next
+     *  start. Loaded devices are usable immediately; they can be verified with one unicast device type query per device.
+     *  Like SpeedwireQueryEngine, the verification does not create threads: the queries are sent through the given
+     *  SpeedwireCommand instance and pollDeviceVerification() collects the replies on the caller's thread. As verification
+     *  and foreground replies are routed by the same response demultiplexer, other queries can be sent through the same
+     *  instance meanwhile. Devices that do not reply are reverted to required devices, and discoverDevices() then only
+     *  scans the networks if devices are missing.
      */
     class SpeedwireDiscovery {
 
@@ -25,14 +37,28 @@ namespace libspeedwire {
 
         std::vector<SpeedwireDevice> speedwireDevices;
 
-        bool sendNextDiscoveryPacket(size_t& broadcast_counter, size_t& prereg_counter, size_t& subnet_counter, size_t& socket_counter);
+        //! Struct holding a device probed by the device verification.
+        typedef struct VerificationProbe {
+            SpeedwireDevice device;                                     //!< The device as registered.
+            SpeedwireDevice reply;                                      //!< The device with class and model as replied; both are empty without reply.
+            int             token;                                      //!< Command token of the device type query in flight, or -1.
+        } VerificationProbe;
+
+        bool cacheLoaded;                                               //!< Devices have been loaded from a device cache file.
+        SpeedwireCommand* verificationCommand;                          //!< Command instance of the pending verification, or nullptr.
+        std::vector<VerificationProbe> verificationProbes;              //!< Devices probed by the pending verification.
+        uint64_t verificationDeadline;                                  //!< Deadline of the pending verification as local tick count in ms.
+        int verificationCount;                                          //!< Number of devices verified by the last verification.
+
+        bool sendNextDiscoveryPacket(size_t& broadcast_counter, size_t& prereg_counter, size_t& subnet_counter, size_t& socket_counter, const size_t max_requests);
         bool recvDiscoveryPackets(const SpeedwireSocket& socket);
         bool sendMulticastDiscoveryRequestToSockets(void);
         bool sendMulticastDiscoveryRequestToDevices(void);
         bool sendUnicastDiscoveryRequestToDevices(void);
-        bool sendUnicastDiscoveryRequestToSockets(size_t& subnet_counter, size_t& socket_counter);
+        bool sendUnicastDiscoveryRequestToSockets(size_t& subnet_counter, size_t& socket_counter, const size_t max_requests);
         int pollSockets(const std::vector<SpeedwireSocket>& sockets, int timeout);
         bool completeDeviceInformation(void);
+        void applyDeviceVerification(void);
 
     public:
 
@@ -53,6 +79,13 @@ namespace libspeedwire {
         unsigned long getNumberOfDevices(void) const;
 
         int discoverDevices(const bool full_scan = false);
+
+        bool saveDeviceCache(const std::string& path) const;
+        int  loadDeviceCache(const std::string& path);
+        bool startDeviceVerification(SpeedwireCommand& command, const int timeout_in_ms = 1000);
+        bool pollDeviceVerification(const int timeout_in_ms);
+        int  finishDeviceVerification(void);
+        bool isDeviceVerificationPending(void) const;
     };
 
 }   // namespace libspeedwire
@@ -0,0 +1,139 @@
+#ifndef __LIBSPEEDWIRE_SPEEDWIREHISTORYREADER_HPP__
+#define __LIBSPEEDWIRE_SPEEDWIREHISTORYREADER_HPP__
+
+#include <cstdint>
+#include <string>
+#include <deque>
+#include <map>
+#include <vector>
+#include <SpeedwireCommand.hpp>
+#include <SpeedwireData.hpp>
+#include <SpeedwireDevice.hpp>
+#include <SpeedwireInverterProtocol.hpp>
+
+namespace libspeedwire {
+
+    class ArchiveProducer;
+
+    /**
+     *  Interface to be implemented by the consumer of yield and event history records.
+     */
+    class SpeedwireHistoryConsumer {
+    public:
+        /** Virtual destructor. */
+        virtual ~SpeedwireHistoryConsumer(void) {}
+
+        /**
+         * Consume a yield record.
+         * @param device The originating inverter device.
+         * @param command The query command, i.e. YIELD_BY_MINUTE_QUERY or YIELD_BY_DAY_QUERY.
+         * @param epoch_time The record time in seconds since unix epoch start.
+         * @param yield_value The total energy yield in Wh at the record time.
+         */
+        virtual void consumeYield(const SpeedwireDevice& device, const Command command, const uint32_t epoch_time, const uint64_t yield_value) = 0;
+
+        /**
+         * Consume an event record.
+         * @param device The originating inverter device.
+         * @param event The event.
+         */
+        virtual void consumeEvent(const SpeedwireDevice& /*device*/, const SpeedwireRawDataEvent::EventValue& /*event*/) {}
+    };
+
+
+    /**
+     *  Class SpeedwireHistoryArchiveSink passes yield records to an ArchiveProducer as total inverter energy values.
+     *  Event records are ignored.
+     */
+    class SpeedwireHistoryArchiveSink : public SpeedwireHistoryConsumer {
+    protected:
+        ArchiveProducer& archive;   //!< Reference to the archive receiving the yield values.
+
+    public:
+        SpeedwireHistoryArchiveSink(ArchiveProducer& archive);
+        virtual ~SpeedwireHistoryArchiveSink(void);
+
+        virtual void consumeYield(const SpeedwireDevice& device, const Command command, const uint32_t epoch_time, const uint64_t yield_value);
+    };
+
+
+    /**
+     *  Class SpeedwireHistoryCursor keeps the download progress per device and history command, such that an interrupted
+     *  download can be resumed. The cursor is the first epoch time that has not yet been downloaded completely.
+     */
+    class SpeedwireHistoryCursor {
+    protected:
+        std::map<uint64_t, uint32_t> cursors;   //!< Cursor times by device serial number and command.
+
+    public:
+        uint32_t get(const SpeedwireDevice& device, const Command command) const;
+        void     set(const SpeedwireDevice& device, const Command command, const uint32_t epoch_time);
+
+        bool save(const std::string& path) const;
+        bool load(const std::string& path);
+    };
+
+
+    /**
+     *  Class SpeedwireHistoryReader downloads yield and event history from an inverter and streams the decoded records
+     *  into a SpeedwireHistoryConsumer.
+     *
+     *  The requested time range is split into chunks and up to max_in_flight chunk queries are kept in flight. Replies
+     *  span several fragments; each fragment is decoded as soon as it has been received, without collecting the records
+     *  of a chunk. Fragment counters count down to 0; as fragments may arrive out of order, the number of fragments of a
+     *  chunk is taken from the highest counter seen. A chunk is complete once fragment 0 and all fragments up to the
+     *  highest counter have been received; duplicate fragments are skipped. Chunks still incomplete at their deadline
+     *  are queried again; the fragments received so far are remembered, such that their records are not delivered twice. A lost leading fragment cannot be detected if all fragments with lower counters arrive, as
+     *  the replies do not announce the number of fragments otherwise. The cursor is advanced across the leading completed chunks,
+     *  hence records of chunks following the cursor may be delivered again after a resumed download.
+     */
+    class SpeedwireHistoryReader {
+    protected:
+
+        //! Struct holding the state of a chunk query.
+        typedef struct Chunk {
+            uint32_t firstTime;                     //!< First epoch time of the chunk.
+            uint32_t lastTime;                      //!< Last epoch time of the chunk.
+            SpeedwireCommandTokenIndex token;       //!< Command token while in flight, or -1.
+            uint64_t key;                           //!< Reply key of the command token.
+            uint64_t deadline;                      //!< Deadline as local tick count in ms.
+            unsigned retries;                       //!< Number of retries.
+            unsigned fragmentsExpected;             //!< Number of fragments, i.e. the highest fragment counter seen + 1.
+            unsigned fragmentsReceived;             //!< Number of distinct fragments received.
+            std::vector<bool> fragmentsSeen;        //!< Received flag per fragment counter.
+            bool     complete;                      //!< All fragments have been received.
+        } Chunk;
+
+        SpeedwireCommand& command;                  //!< Command instance providing sockets, tokens and demultiplexer.
+        unsigned maxInFlight;                       //!< Maximum number of chunk queries in flight.
+        unsigned maxRetries;                        //!< Maximum number of retries per chunk.
+        uint64_t numRecords;                        //!< Number of records delivered.
+        uint64_t numFragments;                      //!< Number of fragments received.
+        uint64_t numRetries;                        //!< Number of chunk retries.
+
+        bool send(const SpeedwireDevice& peer, const Command cmd, Chunk& chunk, const int timeout_in_ms);
+        void release(Chunk& chunk);
+        static bool addFragment(Chunk& chunk, const uint16_t counter);
+
+    public:
+        SpeedwireHistoryReader(SpeedwireCommand& command, const unsigned max_in_flight = 2, const unsigned max_retries = 2);
+
+        int64_t download(const SpeedwireDevice& peer, const Command cmd, const uint32_t from_time, const uint32_t to_time,
+                         SpeedwireHistoryConsumer& consumer, SpeedwireHistoryCursor* cursor = nullptr, const int timeout_in_ms = 2000);
+
+        /** Get the number of records delivered. */
+        uint64_t getRecordCount(void) const { return numRecords; }
+
+        /** Get the number of reply fragments received. */
+        uint64_t getFragmentCount(void) const { return numFragments; }
+
+        /** Get the number of chunk retries. */
+        uint64_t getRetryCount(void) const { return numRetries; }
+
+        static uint32_t getChunkDuration(const Command cmd);
+        static size_t   decode(const SpeedwireDevice& device, const SpeedwireInverterProtocol& fragment, SpeedwireHistoryConsumer& consumer);
+    };
+
+}   // namespace libspeedwire
+
+#endif
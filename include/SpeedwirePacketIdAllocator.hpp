@@ -0,0 +1,64 @@
+#ifndef __LIBSPEEDWIRE_SPEEDWIREPACKETIDALLOCATOR_HPP__
+#define __LIBSPEEDWIRE_SPEEDWIREPACKETIDALLOCATOR_HPP__
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace libspeedwire {
+
+    /**
+     *  Class SpeedwirePacketIdAllocator hands out packet ids for inverter requests.
+     *
+     *  Replies are matched to requests by (susyid, serialnumber, packetid), hence packet ids only need to be unique
+     *  among the requests in flight to the same device. Each device has its own id space of 15 bits; ids in flight are
+     *  marked in a bitmap and are skipped until they are released, such that in-flight requests never collide, even if
+     *  the id space wraps around under heavy pipelining. A new login session advances the id space by half its size,
+     *  such that late replies from the previous session are unlikely to match new requests.
+     *
+     *  Device id spaces are distributed across a fixed number of shards, each protected by its own mutex. All methods
+     *  are thread-safe; threads polling different devices rarely contend for the same mutex.
+     */
+    class SpeedwirePacketIdAllocator {
+    protected:
+        static const size_t   num_shards = 16;              //!< Number of shards; a power of 2.
+        static const uint32_t num_ids = 0x8000;             //!< Number of packet ids per device.
+
+        //! Struct holding the packet id space of a device.
+        typedef struct Space {
+            uint16_t next;                      //!< Next packet id to try, without the 0x8000 flag.
+            uint32_t session;                   //!< Session number, incremented with each new session.
+            uint32_t numInFlight;               //!< Number of packet ids in flight.
+            std::vector<uint64_t> inFlight;     //!< Bitmap of packet ids in flight.
+        } Space;
+
+        //! Struct holding a shard of device id spaces.
+        typedef struct Shard {
+            std::mutex mutex;                               //!< Mutex protecting the id spaces of this shard.
+            std::unordered_map<uint64_t, Space> spaces;     //!< Id spaces by (susyid, serialnumber).
+        } Shard;
+
+        Shard    shards[num_shards];        //!< Shards of device id spaces.
+        uint16_t seed;                      //!< First packet id of new id spaces.
+
+        static uint64_t getDeviceKey(const uint16_t susyid, const uint32_t serialnumber) { return ((uint64_t)susyid << 32) | serialnumber; }
+        Shard& getShard(const uint64_t device_key);
+        Space& getSpace(Shard& shard, const uint64_t device_key);
+
+    public:
+        SpeedwirePacketIdAllocator(void);
+
+        uint16_t allocate(const uint16_t susyid, const uint32_t serialnumber);
+        void     release(const uint16_t susyid, const uint32_t serialnumber, const uint16_t packetid);
+        uint32_t beginSession(const uint16_t susyid, const uint32_t serialnumber);
+        void     beginSession(void);
+
+        uint32_t getSession(const uint16_t susyid, const uint32_t serialnumber);
+        uint32_t getInFlightCount(const uint16_t susyid, const uint32_t serialnumber);
+        bool     isInFlight(const uint16_t susyid, const uint32_t serialnumber, const uint16_t packetid);
+    };
+
+}   // namespace libspeedwire
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef __LIBSPEEDWIRE_SPEEDWIREPOLLINGSCHEDULER_HPP__
+#define __LIBSPEEDWIRE_SPEEDWIREPOLLINGSCHEDULER_HPP__
+
+#include <cstdint>
+#include <vector>
+#include <map>
+#include <SpeedwireCommand.hpp>
+#include <SpeedwireData.hpp>
+#include <SpeedwireDevice.hpp>
+#include <SpeedwireQueryPlanner.hpp>
+#include <Consumer.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Struct describing a query that is due to be sent to a device.
+     */
+    typedef struct SpeedwireScheduledQuery {
+        SpeedwireDevice     device;     //!< The device to be queried.
+        SpeedwireQueryRange range;      //!< The command and register range to be queried.
+
+        SpeedwireScheduledQuery(const SpeedwireDevice& dev, const SpeedwireQueryRange& rng) : device(dev), range(rng) {}
+    } SpeedwireScheduledQuery;
+
+
+    /**
+     *  Class SpeedwirePollingScheduler polls each SpeedwireData item of each device at its own interval.
+     *
+     *  Each item has a minimum and a maximum polling interval. The interval is doubled whenever a reply shows an unchanged
+     *  value, up to the maximum interval, and reset to the minimum interval whenever the value changed; i.e. stable values
+     *  are polled less often while changing values are polled at full rate. Items that are due at the same time are
+     *  coalesced into the fewest query requests by a SpeedwireQueryPlanner. Replies update every item they contain,
+     *  including items that were not yet due.
+     *
+     *  The number of requests sent to a single device is limited by a token bucket. If the budget is exhausted, due queries
+     *  are deferred and the most overdue queries, relative to their interval, are sent first once budget is available.
+     */
+    class SpeedwirePollingScheduler {
+    protected:
+
+        //! Struct holding the polling state of a single item.
+        typedef struct Entry {
+            SpeedwireData data;             //!< The item; measurement values are added to it.
+            uint32_t      minInterval;      //!< Minimum polling interval in ms.
+            uint32_t      maxInterval;      //!< Maximum polling interval in ms.
+            uint32_t      interval;         //!< Current polling interval in ms.
+            uint64_t      nextPoll;         //!< Next poll time as local tick count in ms.
+            uint8_t       lastData[44];     //!< Raw payload of the last reply.
+            size_t        lastDataSize;     //!< Raw payload size of the last reply, 0 if there was no reply yet.
+            uint64_t      numUpdates;       //!< Number of replies.
+            uint64_t      numChanges;       //!< Number of replies with a changed value.
+        } Entry;
+
+        //! Struct holding the polling state of a single device.
+        typedef struct DeviceState {
+            SpeedwireDevice    device;      //!< The device.
+            std::vector<Entry> entries;     //!< Polled items.
+            double             budget;      //!< Available number of requests.
+            uint64_t           budgetTime;  //!< Time of the last budget refill as local tick count in ms.
+        } DeviceState;
+
+        SpeedwireCommand&     command;              //!< Command instance used to send queries.
+        SpeedwireQueryPlanner planner;              //!< Planner coalescing due items into queries.
+        double                requestsPerSecond;    //!< Sustained number of requests per second and device.
+        double                maxBurst;             //!< Maximum number of requests per device sent back to back.
+        uint64_t              numRequests;          //!< Number of requests sent.
+        uint64_t              numDeferred;          //!< Number of queries deferred due to an exhausted budget.
+        std::map<uint32_t, DeviceState> devices;    //!< Polling state per device serial number.
+
+    public:
+        SpeedwirePollingScheduler(SpeedwireCommand& command, const double requests_per_second = 2.0, const unsigned max_burst = 4);
+
+        void add(const SpeedwireDevice& device, const SpeedwireData& data, const uint32_t min_interval_in_ms, const uint32_t max_interval_in_ms);
+        void add(const SpeedwireDevice& device, const SpeedwireData& data);
+        void remove(const SpeedwireDevice& device);
+
+        std::vector<SpeedwireScheduledQuery> getDueQueries(const uint64_t now);
+        size_t update(const SpeedwireDevice& device, const SpeedwireRawData& raw_data, const uint64_t now, SpeedwireConsumer* consumer = nullptr);
+        void   failed(const SpeedwireScheduledQuery& query, const uint64_t now);
+        int    poll(SpeedwireConsumer* consumer = nullptr, const int timeout_in_ms = 1000);
+
+        uint64_t getNextPollTime(void) const;
+        uint32_t getInterval(const SpeedwireDevice& device, const SpeedwireData& data) const;
+
+        /** Get the number of requests sent or handed out by getDueQueries(). */
+        uint64_t getRequestCount(void) const { return numRequests; }
+
+        /** Get the number of due queries that have been deferred due to an exhausted request budget. */
+        uint64_t getDeferredCount(void) const { return numDeferred; }
+
+        static void getDefaultIntervals(const SpeedwireData& data, uint32_t& min_interval_in_ms, uint32_t& max_interval_in_ms);
+    };
+
+}   // namespace libspeedwire
+
+#endif
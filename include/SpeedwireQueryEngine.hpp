@@ -0,0 +1,165 @@
+#ifndef __LIBSPEEDWIRE_SPEEDWIREQUERYENGINE_HPP__
+#define __LIBSPEEDWIRE_SPEEDWIREQUERYENGINE_HPP__
+
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+#include <SpeedwireCommand.hpp>
+
+namespace libspeedwire {
+
+    class SpeedwireSessionManager;
+
+    /**
+     *  Enumeration describing the outcome of an asynchronous query.
+     */
+    enum class SpeedwireQueryStatus {
+        OK,                 //!< A valid reply without error code has been received.
+        ERROR_CODE,         //!< A reply with a non-zero error code has been received.
+        NOT_AUTHENTICATED,  //!< A reply with error code 0x0017 has been received; a new login is required.
+        TIMEOUT,            //!< No reply has been received before the deadline.
+        SEND_FAILED         //!< The request could not be sent.
+    };
+
+
+    /**
+     *  Struct holding the outcome of an asynchronous query; the packet is only valid for the duration of the callback.
+     */
+    typedef struct SpeedwireQueryResult {
+        uint32_t             requestId;     //!< Request id as returned by SpeedwireQueryEngine::submit().
+        SpeedwireQueryStatus status;        //!< Query outcome.
+        SpeedwireAddress     peer;          //!< Address of the queried device.
+        Command              command;       //!< Query command.
+        uint32_t             firstRegister; //!< First register of the query.
+        uint32_t             lastRegister;  //!< Last register of the query.
+        uint16_t             errorCode;     //!< Error code of the reply, or 0.
+        uint32_t             roundTripTime; //!< Time from sending the request to receiving the reply in ms.
+        const uint8_t*       packet;        //!< Reply packet, or nullptr if no reply has been received.
+        size_t               packetSize;    //!< Size of the reply packet in bytes.
+    } SpeedwireQueryResult;
+
+
+    /**
+     *  Struct holding the outcome of an asynchronous query together with a copy of the reply packet; used with futures.
+     */
+    typedef struct SpeedwireQueryResponse {
+        SpeedwireQueryStatus status;        //!< Query outcome.
+        uint16_t             errorCode;     //!< Error code of the reply, or 0.
+        std::vector<uint8_t> packet;        //!< Copy of the reply packet; empty if no reply has been received.
+    } SpeedwireQueryResponse;
+
+
+    /**
+     *  Interface to be implemented by any consumer of asynchronous query results.
+     */
+    class SpeedwireQueryCallback {
+    public:
+        /** Virtual destructor. */
+        virtual ~SpeedwireQueryCallback(void) {}
+
+        /**
+         * Callback to deliver the outcome of a query; new queries may be submitted from within the callback.
+         * @param result The query result.
+         */
+        virtual void onQueryComplete(const SpeedwireQueryResult& result) = 0;
+    };
+
+
+    /**
+     *  Class SpeedwireQueryEngine pipelines inverter queries across many devices. Submitted queries are queued per device
+     *  and sent as soon as the configured number of in-flight requests per device and overall permits. Replies are matched
+     *  to their requests by the response demultiplexer of the given SpeedwireCommand instance and delivered through a
+     *  callback or a future. Each request has a deadline, counted from submission; deadlines are kept in a min-heap.
+     *
+     *  The engine does not create threads; poll() must be called repeatedly to send queued requests, receive replies and
+     *  expire deadlines. Futures are only fulfilled from within poll(). The engine itself is not
+     *  synchronized; submit() and poll() must be called from the same thread. Several engines, each polled on its own
+     *  thread, may share one SpeedwireCommand instance; replies are routed to the engine that sent the request.
+     *
+     *  If a session manager is attached, requests to devices that are not authenticated are held back until the session
+     *  manager has logged in. A request answered with error code 0x0017 invalidates the session of its device and is
+     *  queued again once, such that it is sent again after the transparent re-login; its deadline is then counted anew
+     *  from the time it is queued again. Requests to other devices are not affected.
+     */
+    class SpeedwireQueryEngine {
+    protected:
+
+        //! Struct holding a submitted request.
+        typedef struct Request {
+            uint32_t                   id;              //!< Request id.
+            SpeedwireDevice            peer;            //!< Queried device.
+            Command                    command;         //!< Query command.
+            uint32_t                   firstRegister;   //!< First register.
+            uint32_t                   lastRegister;    //!< Last register.
+            uint32_t                   timeout;         //!< Timeout in ms.
+            uint64_t                   deadline;        //!< Deadline as local tick count in ms.
+            uint64_t                   sendTime;        //!< Send time as local tick count in ms, or 0 if still queued.
+            SpeedwireCommandTokenIndex token;           //!< Command token while in flight, or -1.
+            bool                       requeued;        //!< The request has been queued again after error code 0x0017.
+            SpeedwireQueryCallback*    callback;        //!< Callback, or nullptr.
+            std::shared_ptr<std::promise<SpeedwireQueryResponse> > promise;    //!< Promise, or nullptr.
+        } Request;
+
+        //! Struct holding the per-device queue.
+        typedef struct DeviceQueue {
+            std::deque<uint32_t> queued;                //!< Ids of requests waiting to be sent.
+            unsigned             inFlight;              //!< Number of requests in flight.
+            DeviceQueue(void) : inFlight(0) {}
+        } DeviceQueue;
+
+        typedef std::pair<uint64_t, uint32_t> Deadline; //!< Deadline and request id.
+
+        SpeedwireCommand&   command;                    //!< Command instance providing sockets and token repository.
+        unsigned            maxInFlightPerDevice;       //!< Maximum number of requests in flight per device.
+        unsigned            maxInFlight;                //!< Maximum number of requests in flight overall.
+        unsigned            inFlight;                   //!< Number of requests in flight overall.
+        uint32_t            nextId;                     //!< Next request id.
+        uint32_t            lastDevice;                 //!< Serial number of the device served last, for round-robin sending.
+        SpeedwireSessionManager* sessions;              //!< Session manager, or nullptr.
+
+        std::unordered_map<uint32_t, Request> requests;             //!< All pending requests by id.
+        std::map<uint32_t, DeviceQueue> devices;                    //!< Per-device queues by serial number.
+        std::unordered_map<SpeedwireCommandTokenIndex, uint32_t> tokens;    //!< Request ids of in-flight requests by token.
+        std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline> > deadlines;   //!< Request deadlines.
+        std::vector<std::pair<SpeedwireCommandTokenIndex, uint32_t> > inFlightTokens;  //!< Reused copy of the token map.
+        std::vector<SpeedwireQueryRequest> batch;                   //!< Reused batch of requests to be sent.
+        std::vector<uint32_t> batchIds;                             //!< Request ids of the batch.
+
+        uint32_t submitRequest(const SpeedwireDevice& peer, const Command cmd, const uint32_t first_register, const uint32_t last_register, const int timeout_in_ms,
+                               SpeedwireQueryCallback* callback, const std::shared_ptr<std::promise<SpeedwireQueryResponse> >& promise);
+        int  sendQueued(void);
+        int  receive(const int timeout_in_ms);
+        int  expire(void);
+        void requeue(const uint32_t id);
+        void complete(const uint32_t id, const SpeedwireQueryStatus status, const uint16_t error_code, const uint8_t* packet, const size_t packet_size);
+
+    public:
+        SpeedwireQueryEngine(SpeedwireCommand& command, const unsigned max_in_flight_per_device = 2, const unsigned max_in_flight = 32);
+        ~SpeedwireQueryEngine(void);
+
+        uint32_t submit(const SpeedwireDevice& peer, const Command command, const uint32_t first_register, const uint32_t last_register,
+                        SpeedwireQueryCallback& callback, const int timeout_in_ms = 1000);
+        std::future<SpeedwireQueryResponse> submit(const SpeedwireDevice& peer, const Command command, const uint32_t first_register, const uint32_t last_register,
+                                                   const int timeout_in_ms = 1000);
+
+        int  poll(const int timeout_in_ms);
+        int  run(const int timeout_in_ms);
+
+        /** Attach a session manager handling logins and re-logins after error code 0x0017, or nullptr to detach it. */
+        void setSessionManager(SpeedwireSessionManager* session_manager) { sessions = session_manager; }
+
+        /** Get the number of requests that have been submitted but not yet completed. */
+        size_t getPendingCount(void) const { return requests.size(); }
+
+        /** Get the number of requests currently in flight. */
+        unsigned getInFlightCount(void) const { return inFlight; }
+    };
+
+}   // namespace libspeedwire
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef __LIBSPEEDWIRE_SPEEDWIREQUERYPLANNER_HPP__
+#define __LIBSPEEDWIRE_SPEEDWIREQUERYPLANNER_HPP__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <SpeedwireCommand.hpp>
+#include <SpeedwireData.hpp>
+#include <SpeedwireDevice.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Struct describing a single query request of a query plan.
+     */
+    typedef struct SpeedwireQueryRange {
+        Command  command;           //!< Query command.
+        uint32_t firstRegister;     //!< First register id of the query, including connector byte 0x00.
+        uint32_t lastRegister;      //!< Last register id of the query, including connector byte 0xff.
+        size_t   numItems;          //!< Number of requested SpeedwireData items covered by this query.
+        size_t   estimatedSize;     //!< Estimated size of the response payload in bytes.
+
+        SpeedwireQueryRange(const Command cmd, const uint32_t first_register, const uint32_t last_register, const size_t num_items, const size_t estimated_size) :
+            command(cmd), firstRegister(first_register), lastRegister(last_register), numItems(num_items), estimatedSize(estimated_size) {}
+    } SpeedwireQueryRange;
+
+    //! A query plan is the ordered list of query requests needed to obtain a set of SpeedwireData items.
+    typedef std::vector<SpeedwireQueryRange> SpeedwireQueryPlan;
+
+
+    /**
+     *  Class SpeedwireQueryPlanner turns a set of requested SpeedwireData items into the fewest query requests.
+     *
+     *  Items are grouped by command and their registers are sorted; adjacent, overlapping and nearby register ranges
+     *  of the same command are merged into a single request as long as the register gap stays within a configurable limit and
+     *  the estimated response payload does not exceed the maximum response size known for the command. Registers inside
+     *  a gap are assumed to be answered by the device as well and are included in the size estimate. Timeline items,
+     *  i.e. yield and event data, are not register based and are not planned.
+     *
+     *  Plans depend on the requested items and the configured limits only. They are cached by item signature, such
+     *  that devices polling the same set of items share a plan and devices polling different sets do not evict each
+     *  other's plans. The cache is bounded; it is cleared once it holds max_cache_size plans.
+     */
+    class SpeedwireQueryPlanner {
+    protected:
+
+        size_t   defaultMaxResponseSize;                //!< Maximum response payload size for commands without a known limit.
+        uint32_t maxRegisterGap;                        //!< Maximum number of unrequested registers between two merged registers.
+        std::map<Command, size_t> maxResponseSizes;     //!< Known maximum response payload sizes per command.
+        std::map<std::vector<uint64_t>, SpeedwireQueryPlan> cache;     //!< Cached plans by sorted command and key of each planned item.
+
+        static std::vector<uint64_t> getSignature(const SpeedwireDataMap& items);
+
+    public:
+        static const size_t max_cache_size = 64;        //!< Maximum number of cached plans.
+
+        SpeedwireQueryPlanner(const size_t default_max_response_size = 1024, const uint32_t max_register_gap = 16);
+
+        void   setMaxResponseSize(const Command command, const size_t max_response_size);
+        size_t getMaxResponseSize(const Command command) const;
+
+        const SpeedwireQueryPlan& getPlan(const SpeedwireDataMap& items);
+        SpeedwireQueryPlan createPlan(const SpeedwireDataMap& items) const;
+
+        /** Remove all cached plans. */
+        void clear(void) { cache.clear(); }
+
+        /** Get the number of cached plans. */
+        size_t getCacheSize(void) const { return cache.size(); }
+
+        static size_t getRecordSize(const SpeedwireDataType type);
+    };
+
+}   // namespace libspeedwire
+
+#endif
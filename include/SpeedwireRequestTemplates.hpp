@@ -0,0 +1,88 @@
+#ifndef __LIBSPEEDWIRE_SPEEDWIREREQUESTTEMPLATES_HPP__
+#define __LIBSPEEDWIRE_SPEEDWIREREQUESTTEMPLATES_HPP__
+
+#include <cstdint>
+#include <vector>
+#include <map>
+#include <array>
+#include <mutex>
+#include <SpeedwireDevice.hpp>
+
+namespace libspeedwire {
+
+    // forward declarations
+    enum class Command : uint32_t;
+
+    /**
+     *  Class SpeedwireRequestTemplates keeps fully assembled request packets, keyed by destination and source address,
+     *  command and register range. The packets are stored back to back in a single contiguous arena.
+     *
+     *  Assembling a request then reduces to copying its template and patching the fields that change from request to
+     *  request, i.e. the packet id and, for login requests, the inverter time. Templates are created on first use; if the
+     *  arena would exceed its maximum size, all templates are dropped and the arena is refilled. All methods are
+     *  synchronized, so a single instance can be shared by threads assembling requests concurrently.
+     */
+    class SpeedwireRequestTemplates {
+    public:
+        static constexpr size_t query_request_size = 24 + 8 + 8 + 6 + 4 + 4 + 4;                //!< Size of a query request packet in bytes
+        static constexpr size_t login_request_size = 24 + 8 + 8 + 6 + 4 + 4 + 4 + 4 + 12 + 4;  //!< Size of a login request packet in bytes
+
+    protected:
+        static constexpr size_t inverter_offset = 20;                           //!< Offset of the inverter protocol data behind the data2 control byte
+        static constexpr size_t packet_id_offset = inverter_offset + 20;        //!< Offset of the packet id field
+        static constexpr size_t login_time_offset = inverter_offset + 34;       //!< Offset of the inverter time in login requests
+        static constexpr size_t login_password_offset = inverter_offset + 42;   //!< Offset of the encoded password in login requests
+
+        //! Struct holding the template key.
+        typedef struct Key {
+            uint32_t dstSerialNumber;   //!< Destination serial number.
+            uint32_t srcSerialNumber;   //!< Source serial number.
+            uint16_t dstSusyID;         //!< Destination susy id.
+            uint16_t srcSusyID;         //!< Source susy id.
+            uint32_t command;           //!< Command.
+            uint32_t firstRegister;     //!< First register.
+            uint32_t lastRegister;      //!< Last register.
+
+            /** Compare two keys. */
+            bool operator<(const Key& rhs) const {
+                if (dstSerialNumber != rhs.dstSerialNumber) return dstSerialNumber < rhs.dstSerialNumber;
+                if (command         != rhs.command)         return command         < rhs.command;
+                if (firstRegister   != rhs.firstRegister)   return firstRegister   < rhs.firstRegister;
+                if (lastRegister    != rhs.lastRegister)    return lastRegister    < rhs.lastRegister;
+                if (dstSusyID       != rhs.dstSusyID)       return dstSusyID       < rhs.dstSusyID;
+                if (srcSerialNumber != rhs.srcSerialNumber) return srcSerialNumber < rhs.srcSerialNumber;
+                return srcSusyID < rhs.srcSusyID;
+            }
+        } Key;
+
+        std::vector<uint8_t> arena;             //!< Contiguous storage of all templates.
+        std::map<Key, size_t> offsets;          //!< Offset of each template in the arena.
+        size_t maxArenaSize;                    //!< Maximum arena size in bytes.
+        mutable std::mutex mutex;               //!< Mutex guarding the arena and the offsets.
+
+        static Key getKey(const SpeedwireAddress& dst, const SpeedwireAddress& src, const Command command, const uint32_t first_register, const uint32_t last_register);
+        size_t allocate(const size_t size);
+        void   assemble(const size_t offset, const size_t size, const SpeedwireAddress& dst, const SpeedwireAddress& src, const uint16_t control,
+                        const Command command, const uint32_t first_register, const uint32_t last_register);
+
+    public:
+        SpeedwireRequestTemplates(const size_t max_arena_size = 64 * 1024);
+
+        size_t getQueryRequest(const SpeedwireAddress& dst, const SpeedwireAddress& src, const Command command, const uint32_t first_register, const uint32_t last_register,
+                               const uint16_t packet_id, void* buffer, const size_t buffer_size);
+        size_t getLoginRequest(const SpeedwireAddress& dst, const SpeedwireAddress& src, const uint32_t user, const uint32_t timeout, const std::array<uint8_t, 12>& password,
+                               const uint16_t packet_id, const uint32_t inverter_time, void* buffer, const size_t buffer_size);
+
+        /** Drop all templates. */
+        void clear(void) { std::lock_guard<std::mutex> lock(mutex); arena.clear(); offsets.clear(); }
+
+        /** Get the number of templates. */
+        size_t size(void) const { std::lock_guard<std::mutex> lock(mutex); return offsets.size(); }
+
+        /** Get the number of arena bytes in use. */
+        size_t getArenaSize(void) const { std::lock_guard<std::mutex> lock(mutex); return arena.size(); }
+    };
+
+}   // namespace libspeedwire
+
+#endif
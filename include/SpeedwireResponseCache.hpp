@@ -0,0 +1,100 @@
+#ifndef __LIBSPEEDWIRE_SPEEDWIRERESPONSECACHE_HPP__
+#define __LIBSPEEDWIRE_SPEEDWIRERESPONSECACHE_HPP__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <SpeedwireDevice.hpp>
+
+namespace libspeedwire {
+
+    // forward declarations
+    enum class Command : uint32_t;
+    class SpeedwireRawData;
+
+    /**
+     *  Class SpeedwireResponseCache keeps reply packets of slow-changing inverter registers, like device name, device
+     *  type, software version and nominal power, keyed by device serial number, command and register range.
+     *
+     *  A reply is cached if a time-to-live rule covers its command and register range; the time-to-live is taken from the
+     *  first matching rule. By default, device queries and the nominal power register are cached for one hour. Status
+     *  replies can be passed to observe(); a change of the operation or update status of a device invalidates all cached
+     *  replies of the device, e.g. since a firmware update changes the software version. Expiry times are unix epoch times,
+     *  such that the cache can be saved to and loaded from a file across restarts.
+     */
+    class SpeedwireResponseCache {
+    protected:
+
+        //! Struct holding the cache key.
+        typedef struct Key {
+            uint32_t serialNumber;      //!< Device serial number.
+            uint32_t command;           //!< Query command.
+            uint32_t firstRegister;     //!< First register of the query.
+            uint32_t lastRegister;      //!< Last register of the query.
+
+            /** Compare two keys. */
+            bool operator<(const Key& rhs) const {
+                if (serialNumber  != rhs.serialNumber)  return serialNumber  < rhs.serialNumber;
+                if (command       != rhs.command)       return command       < rhs.command;
+                if (firstRegister != rhs.firstRegister) return firstRegister < rhs.firstRegister;
+                return lastRegister < rhs.lastRegister;
+            }
+        } Key;
+
+        //! Struct holding a cached reply packet.
+        typedef struct Entry {
+            std::vector<uint8_t> packet;    //!< Reply packet.
+            uint64_t             expiry;    //!< Expiry time in ms since unix epoch start.
+        } Entry;
+
+        //! Struct holding a time-to-live rule.
+        typedef struct Rule {
+            uint32_t command;               //!< Query command.
+            uint32_t firstRegister;         //!< First register covered by the rule.
+            uint32_t lastRegister;          //!< Last register covered by the rule.
+            uint32_t timeToLive;            //!< Time-to-live in ms; 0 disables caching.
+        } Rule;
+
+        std::map<Key, Entry> entries;                       //!< Cached reply packets.
+        std::vector<Rule> rules;                            //!< Time-to-live rules, in order of precedence.
+        std::map<uint64_t, std::vector<uint8_t> > status;   //!< Last observed status data per device serial number and register key.
+        uint64_t numHits;                                   //!< Number of queries served from the cache.
+        uint64_t numMisses;                                 //!< Number of queries not served from the cache.
+
+        static Key getKey(const SpeedwireDevice& device, const Command command, const uint32_t first_register, const uint32_t last_register);
+
+    public:
+        SpeedwireResponseCache(void);
+
+        void     addRule(const Command command, const uint32_t first_register, const uint32_t last_register, const uint32_t time_to_live_in_ms);
+        uint32_t getTimeToLive(const Command command, const uint32_t first_register, const uint32_t last_register) const;
+
+        bool    put(const SpeedwireDevice& device, const Command command, const uint32_t first_register, const uint32_t last_register,
+                    const void* packet, const size_t packet_size, const uint64_t now_in_ms);
+        int32_t get(const SpeedwireDevice& device, const Command command, const uint32_t first_register, const uint32_t last_register,
+                    void* udp_buffer, const size_t udp_buffer_size, const uint64_t now_in_ms);
+
+        bool observe(const SpeedwireDevice& device, const SpeedwireRawData& raw_data);
+        void invalidate(const SpeedwireDevice& device);
+        void invalidate(const SpeedwireDevice& device, const Command command, const uint32_t first_register, const uint32_t last_register);
+
+        /** Remove all cached replies. */
+        void clear(void) { entries.clear(); }
+
+        /** Get the number of cached replies, including expired replies that have not yet been removed. */
+        size_t size(void) const { return entries.size(); }
+
+        /** Get the number of queries served from the cache. */
+        uint64_t getHitCount(void) const { return numHits; }
+
+        /** Get the number of queries not served from the cache. */
+        uint64_t getMissCount(void) const { return numMisses; }
+
+        bool save(const std::string& path) const;
+        bool load(const std::string& path, const uint64_t now_in_ms);
+    };
+
+}   // namespace libspeedwire
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef __LIBSPEEDWIRE_SPEEDWIRERESPONSEDEMULTIPLEXER_HPP__
+#define __LIBSPEEDWIRE_SPEEDWIRERESPONSEDEMULTIPLEXER_HPP__
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <vector>
+#include <SpeedwireSocket.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Struct holding a received reply packet together with its source address.
+     */
+    typedef struct SpeedwireReply {
+        std::vector<uint8_t> packet;        //!< Reply packet.
+        struct sockaddr_in6  src;           //!< Source address; large enough for ipv4 and ipv6 addresses.
+        uint64_t             time;          //!< Local tick count in ms when the packet was received.
+    } SpeedwireReply;
+
+
+    /**
+     *  Class SpeedwireResponseDemultiplexer receives all packets arriving on the unicast command sockets and routes
+     *  inverter replies to the pending request they belong to. Requests are identified by the key of their command
+     *  token, i.e. (susyid, serialnumber, packetid), see SpeedwireCommandTokenRepository::getKey(). Each packet is read
+     *  and parsed once; replies for expected keys are kept in a mailbox until they are collected, all other replies
+     *  are put into a bounded late-reply queue. Hence concurrent queries on the same socket no longer discard each
+     *  other's replies. Requests sent to the broadcast address, e.g. broadcast logins, cannot know the susyid and serial
+     *  number of the replying devices; their key is a wildcard matching replies of any device by packet id alone.
+     *
+     *  All methods are thread-safe. While one thread polls the sockets, other threads waiting for a reply sleep until
+     *  the polling thread has routed a packet.
+     */
+    class SpeedwireResponseDemultiplexer {
+    protected:
+        const std::vector<SpeedwireSocket>& sockets;                //!< Unicast command sockets.
+        std::unordered_map<uint64_t, std::deque<SpeedwireReply> > mailbox;  //!< Routed replies by expected key.
+        std::deque<SpeedwireReply> lateReplies;                     //!< Replies that no request has been waiting for.
+        size_t   maxLateReplies;                                    //!< Capacity of the late-reply queue.
+        bool     polling;                                           //!< A thread is currently polling the sockets.
+        std::vector<struct pollfd> pollfds;                         //!< Reused poll descriptors.
+        mutable std::mutex mutex;                                   //!< Mutex protecting all members.
+        std::condition_variable condition;                          //!< Signalled whenever packets have been routed.
+
+        uint64_t receivedCount;                                     //!< Number of packets received.
+        uint64_t routedCount;                                       //!< Number of replies routed to an expected key.
+        uint64_t lateCount;                                         //!< Number of replies put into the late-reply queue.
+        uint64_t lateDroppedCount;                                  //!< Number of late replies dropped due to a full queue.
+        uint64_t ignoredCount;                                      //!< Number of packets that are not inverter replies.
+
+        void route(SpeedwireReply& reply);
+
+    public:
+        SpeedwireResponseDemultiplexer(const std::vector<SpeedwireSocket>& sockets, const size_t max_late_replies = 64);
+        ~SpeedwireResponseDemultiplexer(void);
+
+        void expect(const uint64_t key);
+        void cancel(const uint64_t key);
+
+        int  receive(const int timeout_in_ms);
+        bool takeReply(const uint64_t key, SpeedwireReply& reply);
+        bool waitForReply(const uint64_t key, SpeedwireReply& reply, const int timeout_in_ms);
+        bool takeLateReply(SpeedwireReply& reply);
+
+        static uint64_t getReplyKey(const uint8_t* packet, const size_t packet_size);
+
+        /** Get the wildcard key of the given key, i.e. the key of a broadcast request with the same packet id. */
+        static uint64_t getBroadcastKey(const uint64_t key) { return key | 0xffffffffffff0000ull; }
+
+        uint64_t getReceivedCount(void) const;
+        uint64_t getRoutedCount(void) const;
+        uint64_t getLateCount(void) const;
+        uint64_t getLateDroppedCount(void) const;
+        uint64_t getIgnoredCount(void) const;
+    };
+
+}   // namespace libspeedwire
+
+#endif
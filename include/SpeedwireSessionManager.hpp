@@ -0,0 +1,76 @@
+#ifndef __LIBSPEEDWIRE_SPEEDWIRESESSIONMANAGER_HPP__
+#define __LIBSPEEDWIRE_SPEEDWIRESESSIONMANAGER_HPP__
+
+#include <cstdint>
+#include <map>
+#include <SpeedwireAuthentication.hpp>
+#include <SpeedwireDevice.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Class SpeedwireSessionManager keeps login sessions with a set of inverter devices.
+     *
+     *  Login requests to all devices due for a login are sent at once; replies are collected through the response
+     *  demultiplexer, such that one slow or unreachable device does not delay the others. The age of each session is
+     *  tracked and sessions are renewed proactively once they reach the configured refresh age; devices stay
+     *  authenticated while the renewal is in flight. A device reporting error code 0x0017 is invalidated and logged in
+     *  again with the next call to poll(). Failed logins are retried after the configured retry interval.
+     *
+     *  Like SpeedwireQueryEngine, the session manager does not create threads; poll() must be called repeatedly. If it
+     *  is attached to a query engine, the engine calls poll() itself and holds back the requests of devices that are
+     *  not authenticated.
+     */
+    class SpeedwireSessionManager {
+    protected:
+
+        //! Struct holding the login session state of a device.
+        typedef struct Session {
+            SpeedwireDevice            device;          //!< The device.
+            bool                       authenticated;   //!< The device accepted the last login.
+            SpeedwireCommandTokenIndex token;           //!< Command token of the login request in flight, or -1.
+            uint64_t                   deadline;        //!< Deadline of the login request in flight as local tick count in ms.
+            uint64_t                   loginTime;       //!< Time of the last successful login as local tick count in ms.
+            uint64_t                   retryTime;       //!< Earliest time of the next login attempt as local tick count in ms.
+        } Session;
+
+        SpeedwireAuthentication& authentication;        //!< Authentication instance sending login requests.
+        Credentials              credentials;           //!< Login credentials.
+        uint32_t                 refreshAge;            //!< Session age in ms after which a session is renewed.
+        uint32_t                 loginTimeout;          //!< Timeout of a login request in ms.
+        uint32_t                 retryInterval;         //!< Time in ms between failed login attempts.
+        std::map<uint32_t, Session> sessions;           //!< Sessions by device serial number.
+        uint64_t                 numLogins;             //!< Number of successful logins.
+        uint64_t                 numFailures;           //!< Number of failed logins.
+
+        bool sendLogin(Session& session, const uint64_t now);
+        void finishLogin(Session& session, const bool success, const uint64_t now);
+
+    public:
+        SpeedwireSessionManager(SpeedwireAuthentication& authentication, const Credentials& credentials, const uint32_t refresh_age_in_ms = 600000,
+                                const uint32_t login_timeout_in_ms = 1000, const uint32_t retry_interval_in_ms = 10000);
+        ~SpeedwireSessionManager(void);
+
+        void add(const SpeedwireDevice& device);
+        void remove(const SpeedwireDevice& device);
+
+        int  login(const int timeout_in_ms);
+        int  poll(const int timeout_in_ms);
+        void invalidate(const SpeedwireDevice& device);
+
+        bool     isManaged(const SpeedwireDevice& device) const;
+        bool     isAuthenticated(const SpeedwireDevice& device) const;
+        bool     needsLogin(const SpeedwireDevice& device) const;
+        uint64_t getSessionAge(const SpeedwireDevice& device, const uint64_t now) const;
+        size_t   getPendingCount(void) const;
+
+        /** Get the number of successful logins. */
+        uint64_t getLoginCount(void) const { return numLogins; }
+
+        /** Get the number of failed logins. */
+        uint64_t getFailureCount(void) const { return numFailures; }
+    };
+
+}   // namespace libspeedwire
+
+#endif
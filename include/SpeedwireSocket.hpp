@@ -11,7 +11,9 @@
 #endif
 
 #include <string>
+#include <vector>
 #include <LocalHost.hpp>
+#include <IpAddress.hpp>
 
 namespace libspeedwire {
 
@@ -38,6 +40,18 @@ namespace libspeedwire {
 
     public:
 
+        /**
+         *  Struct describing a datagram to be sent by sendmmsg().
+         */
+        typedef struct Datagram {
+            const void*             buffer;     //!< Pointer to the datagram payload.
+            unsigned long           size;       //!< Size of the datagram payload in bytes.
+            struct sockaddr_storage dest;       //!< Pre-resolved ipv4 or ipv6 destination address.
+            int                     nbytes;     //!< Returns the number of bytes sent, or -1 on failure.
+
+            Datagram(const void* const buff, const unsigned long buff_size, const struct sockaddr& dest_address);
+        } Datagram;
+
         static const uint16_t speedwire_port_9522 = 9522;
         static const struct sockaddr_in  speedwire_multicast_address_239_12_255_254;
         static const struct sockaddr_in  speedwire_multicast_address_239_12_255_255;
@@ -73,8 +87,12 @@ namespace libspeedwire {
         int sendto(const void* const buff, const unsigned long size, const struct sockaddr_in& dest) const;
         int sendto(const void* const buff, const unsigned long size, const struct sockaddr_in6& dest) const;
         int sendto(const void* const buff, const unsigned long size, const std::string& dest) const;
+        int sendto(const void* const buff, const unsigned long size, const IpAddress& dest) const;
         int sendto(const void* const buff, const unsigned long size, const struct sockaddr_in& dest, const struct in_addr& local_interface_address) const;
         int sendto(const void* const buff, const unsigned long size, const struct sockaddr_in6& dest, const struct in6_addr& local_interface_address) const;
+
+        // send a batch of datagrams to the socket
+        int sendmmsg(std::vector<Datagram>& datagrams) const;
     };
 
 }   // namespace libspeedwire
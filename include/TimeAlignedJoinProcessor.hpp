@@ -0,0 +1,110 @@
+#ifndef __LIBSPEEDWIRE_TIMEALIGNEDJOINPROCESSOR_HPP__
+#define __LIBSPEEDWIRE_TIMEALIGNEDJOINPROCESSOR_HPP__
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <vector>
+#include <Consumer.hpp>
+#include <ObisData.hpp>
+#include <SpeedwireData.hpp>
+#include <Measurement.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Class holding a single time-aligned row of the TimeAlignedJoinProcessor.
+     */
+    class JoinedRow {
+    public:
+        uint32_t            time;       //!< Grid timestamp of the row in emeter time, i.e. milliseconds.
+        std::vector<double> values;     //!< Interpolated values, one for each column.
+        std::vector<bool>   valid;      //!< Validity flags, one for each column; false if the column has no data close enough to the grid time.
+
+        JoinedRow(void) : time(0) {}
+
+        /** Return true if all columns of the row are valid. */
+        bool isComplete(void) const {
+            for (size_t i = 0; i < valid.size(); ++i) {
+                if (valid[i] == false) return false;
+            }
+            return true;
+        }
+    };
+
+
+    /**
+     *  Interface to be implemented by any consumer of rows produced by class TimeAlignedJoinProcessor.
+     */
+    class JoinedRowConsumer {
+    public:
+        /** Virtual destructor. */
+        virtual ~JoinedRowConsumer(void) {}
+
+        /**
+         * Callback to consume a time-aligned row.
+         * @param row The row; column i corresponds to the i-th column added to the TimeAlignedJoinProcessor.
+         */
+        virtual void consume(const JoinedRow& row) = 0;
+    };
+
+
+    /**
+     *  Class TimeAlignedJoinProcessor resamples selected measurements of several emeter and inverter devices onto a
+     *  common time grid and emits time-aligned rows, such that derived values can be calculated from coherent snapshots.
+     *
+     *  Inverter timestamps are converted into emeter time. Each grid point is emitted once the newest received timestamp
+     *  is at least the configured latency beyond it; column values are interpolated from the two time-wise closest
+     *  values. The cost per emitted row is O(columns * log(history)), and the number of rows per packet is bounded.
+     */
+    class TimeAlignedJoinProcessor : public ObisConsumer, SpeedwireConsumer {
+
+    protected:
+
+        //! Class holding the definition and recent history of a single column.
+        class JoinColumn {
+        public:
+            uint32_t    serialNumber;   //!< Serial number of the device.
+            uint32_t    key;            //!< Measurement key, i.e. ObisType::toKey() or SpeedwireRawData::toKey().
+            Measurement measurement;    //!< Measurement type, wire and recent history in emeter time.
+            JoinColumn(const uint32_t serial, const uint32_t k, const Measurement& m) : serialNumber(serial), key(k), measurement(m.measurementType, m.wire) {}
+        };
+
+        uint32_t gridStepInMs;                      //!< Time grid step in milliseconds.
+        uint32_t latencyInMs;                       //!< Time to wait for late data before a grid point is emitted.
+        uint32_t maxAgeInMs;                        //!< Maximum time distance between a grid point and the closest column value.
+        size_t   historySize;                       //!< Number of values kept per column.
+        size_t   maxRowsPerPacket;                  //!< Maximum number of rows emitted per data packet; older grid points are skipped.
+        std::deque<JoinColumn> columns;             //!< Columns; a deque keeps element addresses stable while columns are added.
+        std::map<uint64_t, size_t> columnIndex;     //!< Map from device serial number and measurement key to column index.
+        uint32_t newestTime;                        //!< Newest timestamp received for any column.
+        uint32_t nextGridTime;                      //!< Next grid timestamp to emit.
+        bool     gridIsValid;                       //!< The grid timestamps have been initialized.
+        JoinedRow row;                              //!< Preallocated output row.
+        std::vector<JoinedRowConsumer*> consumerTable;  //!< Table of registered JoinedRowConsumer
+
+        void process(const uint32_t serial_number, const uint32_t key, const Measurement& measurement, const bool is_inverter_time);
+        void emitRows(void);
+
+    public:
+
+        TimeAlignedJoinProcessor(const uint32_t grid_step_in_ms, const uint32_t latency_in_ms, const uint32_t max_age_in_ms, const size_t history_size = 16, const size_t max_rows_per_packet = 4);
+        ~TimeAlignedJoinProcessor(void);
+
+        size_t addColumn(const uint32_t serial_number, const ObisData& element);
+        size_t addColumn(const uint32_t serial_number, const SpeedwireData& element);
+        size_t getNumberOfColumns(void) const { return columns.size(); }
+        const Measurement& getColumnMeasurement(const size_t index) const { return columns[index].measurement; }
+        uint32_t getColumnSerialNumber(const size_t index) const { return columns[index].serialNumber; }
+
+        void addConsumer(JoinedRowConsumer& consumer);
+
+        virtual void consume(const SpeedwireDevice& device, ObisData& element);
+        virtual void consume(const SpeedwireDevice& device, SpeedwireData& element);
+        virtual void endOfObisData(const SpeedwireDevice& device, const uint32_t time);
+        virtual void endOfSpeedwireData(const SpeedwireDevice& device, const uint32_t time);
+    };
+
+}   // namespace libspeedwire
+
+#endif
@@ -0,0 +1,305 @@
+#ifndef __LIBSPEEDWIRE_WINDOWAGGREGATE_HPP__
+#define __LIBSPEEDWIRE_WINDOWAGGREGATE_HPP__
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <SpeedwireTime.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Class PercentileSketch implements a fixed-bin histogram over a configurable value range.
+     *  Values outside the range are clamped to the first or last bin. Adding and removing a value is O(1),
+     *  querying a percentile is O(number of bins). A default constructed sketch is disabled and ignores all values.
+     */
+    class PercentileSketch {
+    protected:
+        double lowerBound;              //!< Lower bound of the value range.
+        double upperBound;              //!< Upper bound of the value range.
+        double binWidth;                //!< Width of a single bin.
+        std::vector<uint32_t> bins;     //!< Histogram bins.
+        uint32_t total;                 //!< Total number of values in all bins.
+
+        size_t getBinIndex(const double value) const {
+            if (value <= lowerBound) return 0;
+            size_t index = (size_t)((value - lowerBound) / binWidth);
+            return (index < bins.size() ? index : bins.size() - 1);
+        }
+
+    public:
+
+        /** Default constructor; the sketch is disabled. */
+        PercentileSketch(void) : lowerBound(0.0), upperBound(0.0), binWidth(0.0), total(0) {}
+
+        /**
+         *  Constructor.
+         *  @param lower Lower bound of the value range.
+         *  @param upper Upper bound of the value range.
+         *  @param num_bins Number of histogram bins; the sketch is disabled if num_bins is 0 or the range is empty.
+         */
+        PercentileSketch(const double lower, const double upper, const size_t num_bins) :
+            lowerBound(lower), upperBound(upper), binWidth(0.0), total(0) {
+            if (num_bins > 0 && upper > lower) {
+                bins.resize(num_bins, 0);
+                binWidth = (upper - lower) / (double)num_bins;
+            }
+        }
+
+        /** Return true if the sketch is enabled. */
+        bool isEnabled(void) const { return bins.size() > 0; }
+
+        /** Get the number of values in the sketch. */
+        uint32_t getCount(void) const { return total; }
+
+        /** Add the given value to the sketch. */
+        void add(const double value) {
+            if (isEnabled()) { ++bins[getBinIndex(value)]; ++total; }
+        }
+
+        /** Remove the given value from the sketch; the value must have been added before. */
+        void remove(const double value) {
+            if (isEnabled()) {
+                uint32_t& bin = bins[getBinIndex(value)];
+                if (bin > 0) { --bin; --total; }
+            }
+        }
+
+        /** Remove all values from the sketch, while keeping its configuration. */
+        void clear(void) {
+            for (size_t i = 0; i < bins.size(); ++i) bins[i] = 0;
+            total = 0;
+        }
+
+        /**
+         *  Merge the given sketch into this sketch. If this sketch is disabled, it becomes a copy of the given sketch.
+         *  Sketches with a different bin configuration are not merged.
+         *  @param other The sketch to merge.
+         */
+        void merge(const PercentileSketch& other) {
+            if (!other.isEnabled()) return;
+            if (!isEnabled()) { *this = other; return; }
+            if (other.bins.size() != bins.size() || other.lowerBound != lowerBound || other.upperBound != upperBound) return;
+            for (size_t i = 0; i < bins.size(); ++i) bins[i] += other.bins[i];
+            total += other.total;
+        }
+
+        /**
+         *  Get an estimate of the given percentile; the estimate is linearly interpolated within the bin.
+         *  @param percentile The percentile in the range 0 .. 100.
+         *  @return The estimated value, or 0.0 if the sketch is disabled or empty.
+         */
+        double getPercentile(const double percentile) const {
+            if (total == 0) return 0.0;
+            double rank = (percentile < 0.0 ? 0.0 : (percentile > 100.0 ? 100.0 : percentile)) * 0.01 * (double)total;
+            uint32_t cumulative = 0;
+            for (size_t i = 0; i < bins.size(); ++i) {
+                if (bins[i] > 0 && (double)(cumulative + bins[i]) >= rank) {
+                    double fraction = (rank - (double)cumulative) / (double)bins[i];
+                    return lowerBound + binWidth * ((double)i + fraction);
+                }
+                cumulative += bins[i];
+            }
+            return upperBound;
+        }
+    };
+
+
+    /**
+     *  Class WindowAggregate holds mergeable summary statistics of the measurement values inside a time window.
+     *  The time-weighted mean assumes sample-and-hold behaviour, i.e. each value is valid until the next value arrives.
+     */
+    class WindowAggregate {
+    public:
+        uint32_t count;             //!< Number of values.
+        double   sum;               //!< Sum of all values.
+        double   min;               //!< Minimum value.
+        double   max;               //!< Maximum value.
+        double   first;             //!< Oldest value.
+        double   last;              //!< Most recent value.
+        uint32_t firstTime;         //!< Timestamp of the oldest value.
+        uint32_t lastTime;          //!< Timestamp of the most recent value.
+        double   weightedSum;       //!< Sum of value * holding duration.
+        double   weightedDuration;  //!< Sum of holding durations.
+        PercentileSketch sketch;    //!< Optional percentile sketch; disabled by default.
+
+        /** Default constructor; the aggregate is empty and the percentile sketch is disabled. */
+        WindowAggregate(void) { clear(); }
+
+        /** Constructor; the aggregate is empty and uses a copy of the given sketch configuration. */
+        WindowAggregate(const PercentileSketch& sketch_config) : sketch(sketch_config) { clear(); }
+
+        /** Remove all values from the aggregate, while keeping the sketch configuration. */
+        void clear(void) {
+            count = 0; sum = 0.0; min = 0.0; max = 0.0; first = 0.0; last = 0.0;
+            firstTime = 0; lastTime = 0; weightedSum = 0.0; weightedDuration = 0.0;
+            sketch.clear();
+        }
+
+        /** Return true if the aggregate does not hold any value. */
+        bool isEmpty(void) const { return count == 0; }
+
+        /**
+         *  Add a value to the aggregate; values are expected in chronological order.
+         *  @param value The measurement value.
+         *  @param time The measurement timestamp.
+         */
+        void add(const double value, const uint32_t time) {
+            if (count == 0) {
+                min = max = first = value;
+                firstTime = time;
+            }
+            else {
+                int32_t dt = SpeedwireTime::calculateTimeDifference(time, lastTime);
+                if (dt > 0) {
+                    weightedSum += last * (double)dt;
+                    weightedDuration += (double)dt;
+                }
+                if (value < min) min = value;
+                if (value > max) max = value;
+            }
+            ++count;
+            sum += value;
+            last = value;
+            lastTime = time;
+            sketch.add(value);
+        }
+
+        /**
+         *  Merge the given aggregate, covering a later time window, into this aggregate.
+         *  The gap between the last value of this aggregate and the first value of the given aggregate is bridged
+         *  by holding the last value of this aggregate.
+         *  @param later The aggregate to merge.
+         */
+        void merge(const WindowAggregate& later) {
+            if (later.count == 0) return;
+            if (count == 0) { *this = later; return; }
+            int32_t dt = SpeedwireTime::calculateTimeDifference(later.firstTime, lastTime);
+            if (dt > 0) {
+                weightedSum += last * (double)dt;
+                weightedDuration += (double)dt;
+            }
+            count += later.count;
+            sum += later.sum;
+            if (later.min < min) min = later.min;
+            if (later.max > max) max = later.max;
+            last = later.last;
+            lastTime = later.lastTime;
+            weightedSum += later.weightedSum;
+            weightedDuration += later.weightedDuration;
+            sketch.merge(later.sketch);
+        }
+
+        /** Get the arithmetic mean of all values. */
+        double getMean(void) const { return (count > 0 ? sum / (double)count : 0.0); }
+
+        /** Get the time-weighted mean of all values; if the aggregate spans no time, the arithmetic mean is returned. */
+        double getTimeWeightedMean(void) const { return (weightedDuration > 0.0 ? weightedSum / weightedDuration : getMean()); }
+
+        /** Get the given percentile from the sketch; returns 0.0 if the sketch is disabled. */
+        double getPercentile(const double percentile) const { return sketch.getPercentile(percentile); }
+    };
+
+
+    /**
+     *  Class SlidingWindow maintains a WindowAggregate over all values received within the most recent time interval.
+     *  Adding and evicting values is amortized O(1): sums are updated incrementally and min/max are tracked by monotonic deques.
+     */
+    class SlidingWindow {
+    protected:
+        struct Sample {
+            double   value;
+            uint32_t time;
+            uint64_t sequence;
+            Sample(const double v, const uint32_t t, const uint64_t s) : value(v), time(t), sequence(s) {}
+        };
+
+        uint32_t length;                //!< Window length in timestamp units.
+        std::deque<Sample> samples;     //!< All samples inside the window, oldest first.
+        std::deque<Sample> minQueue;    //!< Monotonically increasing candidate minimums.
+        std::deque<Sample> maxQueue;    //!< Monotonically decreasing candidate maximums.
+        uint64_t sequence;              //!< Sequence number of the next sample.
+        WindowAggregate aggregate;      //!< Incrementally maintained sums; min/max are taken from the deques.
+
+    public:
+
+        /**
+         *  Constructor.
+         *  @param window_length Window length in timestamp units.
+         *  @param sketch_config Percentile sketch configuration; pass a default constructed sketch to disable it.
+         */
+        SlidingWindow(const uint32_t window_length, const PercentileSketch& sketch_config = PercentileSketch()) :
+            length(window_length), sequence(0), aggregate(sketch_config) {}
+
+        /** Get the window length. */
+        uint32_t getLength(void) const { return length; }
+
+        /** Get the number of values inside the window. */
+        size_t size(void) const { return samples.size(); }
+
+        /**
+         *  Add a value to the window and evict all values that fall out of the window.
+         *  @param value The measurement value.
+         *  @param time The measurement timestamp; values are expected in chronological order.
+         */
+        void add(const double value, const uint32_t time) {
+            Sample sample(value, time, sequence++);
+            samples.push_back(sample);
+            while (!minQueue.empty() && minQueue.back().value >= value) minQueue.pop_back();
+            minQueue.push_back(sample);
+            while (!maxQueue.empty() && maxQueue.back().value <= value) maxQueue.pop_back();
+            maxQueue.push_back(sample);
+            aggregate.add(value, time);
+            evict(time);
+        }
+
+        /**
+         *  Evict all values older than the window length with respect to the given time; the window is empty if no value
+         *  is left inside the window.
+         *  @param time The reference timestamp.
+         */
+        void evict(const uint32_t time) {
+            while (samples.size() > 0 && SpeedwireTime::calculateTimeDifference(time, samples.front().time) >= (int32_t)length) {
+                if (samples.size() == 1) {
+                    clear();
+                    break;
+                }
+                const Sample oldest = samples.front();
+                samples.pop_front();
+                const Sample& next = samples.front();
+                int32_t dt = SpeedwireTime::calculateTimeDifference(next.time, oldest.time);
+                if (dt > 0) {
+                    aggregate.weightedSum -= oldest.value * (double)dt;
+                    aggregate.weightedDuration -= (double)dt;
+                }
+                aggregate.count--;
+                aggregate.sum -= oldest.value;
+                aggregate.sketch.remove(oldest.value);
+                if (minQueue.front().sequence == oldest.sequence) minQueue.pop_front();
+                if (maxQueue.front().sequence == oldest.sequence) maxQueue.pop_front();
+            }
+        }
+
+        /** Remove all values from the window. */
+        void clear(void) {
+            samples.clear();
+            minQueue.clear();
+            maxQueue.clear();
+            aggregate.clear();
+        }
+
+        /** Get the aggregate over all values inside the window. */
+        const WindowAggregate& getAggregate(void) {
+            if (samples.size() > 0) {
+                aggregate.min = minQueue.front().value;
+                aggregate.max = maxQueue.front().value;
+                aggregate.first = samples.front().value;
+                aggregate.firstTime = samples.front().time;
+            }
+            return aggregate;
+        }
+    };
+
+}   // namespace libspeedwire
+
+#endif
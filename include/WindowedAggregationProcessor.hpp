@@ -0,0 +1,98 @@
+#ifndef __LIBSPEEDWIRE_WINDOWEDAGGREGATIONPROCESSOR_HPP__
+#define __LIBSPEEDWIRE_WINDOWEDAGGREGATIONPROCESSOR_HPP__
+
+#include <cstdint>
+#include <map>
+#include <vector>
+#include <Consumer.hpp>
+#include <ObisData.hpp>
+#include <SpeedwireData.hpp>
+#include <Measurement.hpp>
+#include <WindowAggregate.hpp>
+
+namespace libspeedwire {
+
+    /**
+     *  Enumeration describing the windowing strategy of the WindowedAggregationProcessor.
+     */
+    enum class WindowType {
+        TUMBLING,   //!< Fixed-size, non-overlapping windows aligned to multiples of the window length.
+        SLIDING,    //!< Window covering the most recent window length; an aggregate is emitted with each value.
+        HOPPING     //!< Fixed-size, overlapping windows; an aggregate is emitted each hop length.
+    };
+
+
+    /**
+     *  Interface to be implemented by any consumer of window aggregates produced by class WindowedAggregationProcessor.
+     */
+    class WindowAggregateConsumer {
+    public:
+        /** Virtual destructor. */
+        virtual ~WindowAggregateConsumer(void) {}
+
+        /**
+         * Callback to consume the aggregate of a completed window.
+         * @param device The originating device.
+         * @param measurement The measurement the aggregate belongs to; it provides the measurement type and wire.
+         * @param aggregate The window aggregate.
+         * @param window_start The start timestamp of the window, in the time domain of the measurement.
+         * @param window_end The end timestamp of the window, in the time domain of the measurement.
+         */
+        virtual void consume(const SpeedwireDevice& device, const Measurement& measurement, const WindowAggregate& aggregate, const uint32_t window_start, const uint32_t window_end) = 0;
+
+        /**
+         * Callback to notify that all windows completed by the given data packet have been emitted.
+         * @param device The originating device.
+         * @param timestamp The timestamp associated with the just finished data packet.
+         */
+        virtual void endOfWindowAggregates(const SpeedwireDevice& /*device*/, const uint32_t /*timestamp*/) {}
+    };
+
+
+    /**
+     *  Class WindowedAggregationProcessor implements tumbling, sliding and hopping window aggregation of obis elements
+     *  received from emeter packets and inverter reply packets. For each device and measurement it maintains
+     *  mean, min, max, last, count, time-weighted mean and optionally a percentile sketch with O(1) state updates per value.
+     */
+    class WindowedAggregationProcessor : public ObisConsumer, SpeedwireConsumer {
+
+    protected:
+
+        //! Struct holding the window state of a single measurement of a given speedwire device.
+        typedef struct WindowState {
+            WindowAggregate tumbling;       //!< Running aggregate for tumbling windows.
+            SlidingWindow   sliding;        //!< Sliding window for sliding and hopping windows.
+            uint32_t        windowStart;    //!< Start timestamp of the current tumbling window or hop.
+            bool            windowStartIsValid; //!< The window start timestamp has been initialized.
+            WindowState(const uint32_t length, const PercentileSketch& sketch) : tumbling(sketch), sliding(length, sketch), windowStart(0), windowStartIsValid(false) {}
+        } WindowState;
+
+        WindowType    windowType;                               //!< Windowing strategy.
+        unsigned long windowLengthInMs;                         //!< Window length in milliseconds.
+        unsigned long hopLengthInMs;                            //!< Hop length in milliseconds; only used for hopping windows.
+        PercentileSketch sketchConfig;                          //!< Percentile sketch configuration for new window states.
+        std::map<uint64_t, WindowState> states;                 //!< Window states for all known devices and measurements.
+        std::map<uint32_t, bool> emitted;                       //!< Devices for which a window was emitted during the current packet.
+        std::vector<WindowAggregateConsumer*> consumerTable;    //!< Table of registered WindowAggregateConsumer
+
+        void process(const SpeedwireDevice& device, const uint32_t key, const unsigned long time_scale, const Measurement& measurement);
+        void emit(const SpeedwireDevice& device, const Measurement& measurement, const WindowAggregate& aggregate, const uint32_t window_start, const uint32_t window_end);
+        void endOfData(const SpeedwireDevice& device, const uint32_t time);
+
+    public:
+
+        WindowedAggregationProcessor(const WindowType window_type, const unsigned long window_length_in_ms, const unsigned long hop_length_in_ms = 0);
+        ~WindowedAggregationProcessor(void);
+
+        void setPercentileSketch(const double lower, const double upper, const size_t num_bins);
+        void addConsumer(WindowAggregateConsumer& consumer);
+
+        virtual void consume(const SpeedwireDevice& device, ObisData& element);
+        virtual void consume(const SpeedwireDevice& device, SpeedwireData& element);
+        virtual void endOfObisData(const SpeedwireDevice& device, const uint32_t time);
+        virtual void endOfSpeedwireData(const SpeedwireDevice& device, const uint32_t time);
+    };
+
+}   // namespace libspeedwire
+
+#endif
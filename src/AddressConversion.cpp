@@ -201,15 +201,18 @@ bool AddressConversion::resideOnSameSubnet(const struct in6_addr& host1, const s
  *  Check if both given ipv4 or ipv6 hosts are residing on the same subnet as defined by its prefix_length.
  */
 bool AddressConversion::resideOnSameSubnet(const std::string& host1, const std::string& host2, const uint32_t prefix_length) {
-    if (isIpv4(host1) && isIpv4(host2)) {
-        struct in_addr inaddr1 = AddressConversion::toInAddress(host1);
-        struct in_addr inaddr2 = AddressConversion::toInAddress(host2);
-        return resideOnSameSubnet(inaddr1, inaddr2, prefix_length);
+    return resideOnSameSubnet(IpAddress(host1), IpAddress(host2), prefix_length);
+}
+
+/**
+ *  Check if the given binary ipv4 or ipv6 addresses reside on the same subnet
+ */
+bool AddressConversion::resideOnSameSubnet(const IpAddress& host1, const IpAddress& host2, const uint32_t prefix_length) {
+    if (host1.isIpv4() && host2.isIpv4()) {
+        return resideOnSameSubnet(host1.getInAddress(), host2.getInAddress(), prefix_length);
     }
-    if (isIpv6(host1) && isIpv6(host2)) {
-        struct in6_addr inaddr1 = AddressConversion::toIn6Address(host1);
-        struct in6_addr inaddr2 = AddressConversion::toIn6Address(host2);
-        return resideOnSameSubnet(inaddr1, inaddr2, prefix_length);
+    if (host1.isIpv6() && host2.isIpv6()) {
+        return resideOnSameSubnet(host1.getIn6Address(), host2.getIn6Address(), prefix_length);
     }
     return false;
 }
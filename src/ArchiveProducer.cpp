@@ -0,0 +1,372 @@
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <ArchiveProducer.hpp>
+#include <LocalHost.hpp>
+#include <SpeedwireTime.hpp>
+#include <Logger.hpp>
+using namespace libspeedwire;
+
+static Logger logger("ArchiveProducer");
+
+static const char   archive_magic[8] = { 'S', 'W', 'A', 'R', 'C', 'H', 'V', '1' };
+static const size_t archive_header_size = 4096;
+static const uint64_t max_name_attempts = 1024;
+
+
+/**
+ * Constructor of the ArchiveProducer instance. The first segment file is created with the first value.
+ * @param _directory Directory receiving the segment files; it must exist.
+ * @param file_prefix Segment file name prefix; file names are <prefix>-<start time in ms>.swa.
+ * @param segment_duration_in_ms Segment duration in ms; segment boundaries are aligned to multiples of it.
+ * @param segment_capacity Maximum number of entries per segment.
+ * @param sync_on_flush If true, entries are written to the storage device on each flush.
+ */
+ArchiveProducer::ArchiveProducer(const std::string& _directory, const std::string& file_prefix, const uint64_t segment_duration_in_ms,
+                                 const size_t segment_capacity, const bool sync_on_flush) :
+    directory(_directory),
+    filePrefix(file_prefix),
+    segmentDuration(segment_duration_in_ms > 0 ? segment_duration_in_ms : 1),
+    segmentCapacity(segment_capacity > 0 ? segment_capacity : 1),
+    syncOnFlush(sync_on_flush),
+    header(nullptr),
+    times(nullptr),
+    values(nullptr),
+    devices(nullptr),
+    measurements(nullptr),
+    uncommitted(0),
+    currentTime(0),
+    droppedCount(0) {}
+
+
+/**
+ * Destructor; all uncommitted entries are committed and the current segment is closed.
+ */
+ArchiveProducer::~ArchiveProducer(void) {
+    closeSegment();
+}
+
+
+/**
+ * Get the size of a segment file with the given capacity.
+ * @param capacity Number of entries per column.
+ * @return The file size in bytes.
+ */
+size_t ArchiveProducer::getSegmentSize(const size_t capacity) {
+    return archive_header_size + capacity * (sizeof(uint64_t) + sizeof(double) + sizeof(uint32_t) + sizeof(uint32_t));
+}
+
+
+/**
+ * Get the measurement id of the given measurement type and wire, as stored in the measurement id column.
+ * @param type The measurement type.
+ * @param wire The wire.
+ * @return The measurement id; it is composed of quantity, type, direction and wire.
+ */
+uint32_t ArchiveProducer::getMeasurementId(const MeasurementType& type, const Wire wire) {
+    return ((uint32_t)type.quantity << 24) | ((uint32_t)type.type << 16) | ((uint32_t)type.direction << 8) | (uint32_t)wire;
+}
+
+
+/**
+ * Create and map a new segment file containing the given time.
+ * @param time Time of the first entry in ms since unix epoch.
+ * @return true on success, false otherwise.
+ */
+bool ArchiveProducer::openSegment(const uint64_t time) {
+    const uint64_t start_time = time - (time % segmentDuration);
+    std::string path;
+    for (uint64_t name_time = time; ; ++name_time) {
+        char name[64];
+        snprintf(name, sizeof(name), "-%llu.swa", (unsigned long long)name_time);
+        path = directory;
+        if (path.length() > 0 && path[path.length() - 1] != '/' && path[path.length() - 1] != '\\') {
+            path.push_back('/');
+        }
+        path.append(filePrefix).append(name);
+        // segments filled within the same millisecond get successive names; existing files are never overwritten
+        FILE* fp = fopen(path.c_str(), "rb");
+        if (fp == NULL) break;
+        fclose(fp);
+        if (name_time - time >= max_name_attempts) {
+            logger.print(LogLevel::LOG_ERROR, "no free segment file name for time %llu", (unsigned long long)time);
+            return false;
+        }
+    }
+
+    if (file.create(path, getSegmentSize(segmentCapacity)) == false) {
+        return false;
+    }
+    uint8_t* const base = file.data();
+    header = (ArchiveSegmentHeader*)base;
+    memset(header, 0, sizeof(ArchiveSegmentHeader));
+    header->headerSize = (uint32_t)archive_header_size;
+    header->capacity = segmentCapacity;
+    header->startTime = start_time;
+    header->endTime = start_time + segmentDuration;
+    header->timesOffset = archive_header_size;
+    header->valuesOffset = header->timesOffset + segmentCapacity * sizeof(uint64_t);
+    header->devicesOffset = header->valuesOffset + segmentCapacity * sizeof(double);
+    header->measurementsOffset = header->devicesOffset + segmentCapacity * sizeof(uint32_t);
+    times = (uint64_t*)(base + header->timesOffset);
+    values = (double*)(base + header->valuesOffset);
+    devices = (uint32_t*)(base + header->devicesOffset);
+    measurements = (uint32_t*)(base + header->measurementsOffset);
+    uncommitted = 0;
+    // the magic is written last, such that readers never see a partially initialized header
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic, archive_magic, sizeof(archive_magic));
+    return true;
+}
+
+
+/**
+ * Commit all entries and unmap the current segment file. A segment that is not full is replaced by a copy truncated
+ * to its committed entries.
+ */
+void ArchiveProducer::closeSegment(void) {
+    if (header != nullptr) {
+        flush();
+        file.sync(0, file.size(), syncOnFlush);
+        const std::string path = file.getPath();
+        const std::string temp_path = path + ".tmp";
+        const bool compacted = (header->count < header->capacity && writeCompacted(temp_path));
+        file.close();
+        if (compacted) {
+#ifdef _WIN32
+            remove(path.c_str());
+#endif
+            if (rename(temp_path.c_str(), path.c_str()) != 0) {
+                logger.print(LogLevel::LOG_WARNING, "cannot truncate segment file %s", path.c_str());
+                remove(temp_path.c_str());
+            }
+        }
+        header = nullptr;
+        times = nullptr;
+        values = nullptr;
+        devices = nullptr;
+        measurements = nullptr;
+    }
+}
+
+
+/**
+ * Write a copy of the current segment holding only its committed entries, i.e. with a capacity equal to its count, and
+ * wait until it is on the storage device. The copy replaces the preallocated segment file by a rename, such that
+ * readers still mapping the preallocated file are not affected and a crash leaves one of both files intact.
+ * @param path The path of the copy.
+ * @return true on success, false otherwise.
+ */
+bool ArchiveProducer::writeCompacted(const std::string& path) {
+    const size_t count = (size_t)header->count;
+    MappedFile copy;
+    if (copy.create(path, getSegmentSize(count)) == false) {
+        return false;
+    }
+    uint8_t* const base = copy.data();
+    ArchiveSegmentHeader* const h = (ArchiveSegmentHeader*)base;
+    memcpy(h, header, sizeof(ArchiveSegmentHeader));
+    h->capacity = count;
+    h->timesOffset = archive_header_size;
+    h->valuesOffset = h->timesOffset + count * sizeof(uint64_t);
+    h->devicesOffset = h->valuesOffset + count * sizeof(double);
+    h->measurementsOffset = h->devicesOffset + count * sizeof(uint32_t);
+    memcpy(base + h->timesOffset, times, count * sizeof(uint64_t));
+    memcpy(base + h->valuesOffset, values, count * sizeof(double));
+    memcpy(base + h->devicesOffset, devices, count * sizeof(uint32_t));
+    memcpy(base + h->measurementsOffset, measurements, count * sizeof(uint32_t));
+    if (copy.sync(0, copy.size(), true) == false) {
+        copy.close();
+        remove(path.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ * Expand the given truncated timestamp to a 64-bit unix epoch time in ms; a timestamp of 0 is replaced by the current time.
+ */
+uint64_t ArchiveProducer::expandTime(const uint32_t time_in_ms) {
+    if (currentTime == 0) {
+        currentTime = LocalHost::getUnixEpochTimeInMs();
+    }
+    return (time_in_ms != 0 ? SpeedwireTime::expandTimeTo64(time_in_ms, currentTime) : currentTime);
+}
+
+
+/**
+ * Append a single entry to the current segment, starting a new segment if necessary. Segments are only rotated forward
+ * in time; late values older than the current segment are accepted into it and its start time is lowered accordingly,
+ * such that out-of-order values do not create a new segment each.
+ */
+void ArchiveProducer::append(const uint32_t serial, const uint32_t measurement_id, const double value, const uint64_t time) {
+    if (header != nullptr && (time >= header->endTime || header->count + uncommitted >= header->capacity)) {
+        closeSegment();
+    }
+    if (header == nullptr && openSegment(time) == false) {
+        ++droppedCount;
+        return;
+    }
+    if (time < header->startTime) {
+        header->startTime = time;
+    }
+    const size_t index = (size_t)header->count + uncommitted;
+    times[index] = time;
+    values[index] = value;
+    devices[index] = serial;
+    measurements[index] = measurement_id;
+    ++uncommitted;
+}
+
+
+/**
+ * Commit all entries written since the previous flush by updating the committed count in the segment header.
+ */
+void ArchiveProducer::flush(void) {
+    if (header != nullptr && uncommitted > 0) {
+        const size_t first = (size_t)header->count;
+        if (syncOnFlush) {
+            file.sync((size_t)header->timesOffset + first * sizeof(uint64_t), uncommitted * sizeof(uint64_t), true);
+            file.sync((size_t)header->valuesOffset + first * sizeof(double), uncommitted * sizeof(double), true);
+            file.sync((size_t)header->devicesOffset + first * sizeof(uint32_t), uncommitted * sizeof(uint32_t), true);
+            file.sync((size_t)header->measurementsOffset + first * sizeof(uint32_t), uncommitted * sizeof(uint32_t), true);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        header->count = first + uncommitted;
+        uncommitted = 0;
+        if (syncOnFlush) {
+            file.sync(0, sizeof(ArchiveSegmentHeader), true);
+        }
+    }
+    currentTime = 0;
+}
+
+
+/**
+ * Append the given value to the archive; it becomes visible to readers on the next flush.
+ * @param device The device generating the data
+ * @param type The measurement type of the given data
+ * @param wire The Wire enumeration value
+ * @param value The data value itself
+ * @param time_in_ms The measurement timestamp as lower 32 bits of ms since unix epoch start
+ */
+void ArchiveProducer::produce(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value, const uint32_t time_in_ms) {
+    append(device.deviceAddress.serialNumber, getMeasurementId(type, wire), value, expandTime(time_in_ms));
+}
+
+
+/**
+ * Archive the given value with a full 64-bit timestamp, e.g. for backfilling historic data older than the range
+ * of truncated 32-bit timestamps.
+ * @param device The device generating the data
+ * @param type The measurement type of the given data
+ * @param wire The Wire enumeration value
+ * @param value The data value itself
+ * @param time_in_ms The measurement timestamp in ms since unix epoch start
+ */
+void ArchiveProducer::produceAt(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value, const uint64_t time_in_ms) {
+    append(device.deviceAddress.serialNumber, getMeasurementId(type, wire), value, time_in_ms);
+}
+
+
+/**
+ * Append all records of the given batch to the archive and commit them.
+ * @param batch The record batch.
+ */
+void ArchiveProducer::produce(const RecordBatch& batch) {
+    for (size_t i = 0; i < batch.size(); ++i) {
+        const size_t m = batch.measurementIndex[i];
+        append(batch.deviceTable[batch.deviceIndex[i]].deviceAddress.serialNumber, getMeasurementId(batch.typeTable[m], batch.wireTable[m]), batch.values[i], expandTime(batch.times[i]));
+    }
+    flush();
+}
+
+
+/**
+ * Constructor of the ArchiveReader instance.
+ */
+ArchiveReader::ArchiveReader(void) : header(nullptr) {}
+
+
+/**
+ * Destructor.
+ */
+ArchiveReader::~ArchiveReader(void) {
+    close();
+}
+
+
+/**
+ * Map the given segment file and validate its header.
+ * @param path The segment file path.
+ * @return true on success, false if the file cannot be mapped or is not a valid segment.
+ */
+bool ArchiveReader::open(const std::string& path) {
+    close();
+    if (file.open(path) == false) {
+        return false;
+    }
+    const ArchiveSegmentHeader* h = (const ArchiveSegmentHeader*)file.data();
+    if (file.size() < sizeof(ArchiveSegmentHeader) || memcmp(h->magic, archive_magic, sizeof(archive_magic)) != 0 ||
+        h->measurementsOffset + h->capacity * sizeof(uint32_t) > file.size() ||
+        h->timesOffset + h->capacity * sizeof(uint64_t) > h->valuesOffset ||
+        h->valuesOffset + h->capacity * sizeof(double) > h->devicesOffset ||
+        h->devicesOffset + h->capacity * sizeof(uint32_t) > h->measurementsOffset) {
+        logger.print(LogLevel::LOG_ERROR, "invalid archive segment %s", path.c_str());
+        file.close();
+        return false;
+    }
+    header = h;
+    return true;
+}
+
+
+/**
+ * Unmap the segment file.
+ */
+void ArchiveReader::close(void) {
+    header = nullptr;
+    file.close();
+}
+
+
+/**
+ * Get a span covering all entries committed so far.
+ * @return The span; its length is 0 if no segment is open.
+ */
+ArchiveSpan ArchiveReader::getSpan(void) const {
+    ArchiveSpan span = { nullptr, nullptr, nullptr, nullptr, 0 };
+    if (header != nullptr) {
+        const uint8_t* const base = file.data();
+        const uint64_t count = header->count;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        span.times = (const uint64_t*)(base + header->timesOffset);
+        span.values = (const double*)(base + header->valuesOffset);
+        span.devices = (const uint32_t*)(base + header->devicesOffset);
+        span.measurements = (const uint32_t*)(base + header->measurementsOffset);
+        span.length = (size_t)(count < header->capacity ? count : header->capacity);
+    }
+    return span;
+}
+
+
+/**
+ * Append all committed entries of the given device and measurement to the given measurement values; timestamps are
+ * truncated to 32 bits as used throughout MeasurementValues.
+ * @param serial The device serial number.
+ * @param measurement_id The measurement id, see ArchiveProducer::getMeasurementId().
+ * @param values The measurement values; older entries are replaced if its capacity is exceeded.
+ * @return The number of entries appended.
+ */
+size_t ArchiveReader::getMeasurementValues(const uint32_t serial, const uint32_t measurement_id, MeasurementValues& values) const {
+    const ArchiveSpan span = getSpan();
+    size_t n = 0;
+    for (size_t i = 0; i < span.length; ++i) {
+        if (span.devices[i] == serial && span.measurements[i] == measurement_id) {
+            values.addMeasurement(span.values[i], (uint32_t)span.times[i]);
+            ++n;
+        }
+    }
+    return n;
+}
@@ -0,0 +1,409 @@
+#include <string.h>
+#include <ArrowFileWriter.hpp>
+#include <LocalHost.hpp>
+#include <SpeedwireTime.hpp>
+#include <Logger.hpp>
+using namespace libspeedwire;
+
+static Logger logger("ArrowFileWriter");
+
+// arrow format constants, see Schema.fbs, Message.fbs and File.fbs of the arrow format specification
+static const uint8_t  arrow_magic[8] = { 'A', 'R', 'R', 'O', 'W', '1', 0, 0 };
+static const uint32_t arrow_continuation = 0xffffffff;
+static const uint64_t arrow_metadata_v5 = 4;
+static const uint8_t  arrow_header_schema = 1;
+static const uint8_t  arrow_header_record_batch = 3;
+static const uint8_t  arrow_type_int = 2;
+static const uint8_t  arrow_type_floating_point = 3;
+static const uint8_t  arrow_type_timestamp = 10;
+static const uint64_t arrow_precision_double = 2;
+static const uint64_t arrow_unit_millisecond = 1;
+static const size_t   rows_per_batch = 64 * 1024;
+
+
+/**
+ *  Minimal flatbuffer encoder. Unlike the reference implementation, the buffer is built front to back: tables are
+ *  written with placeholder offsets, which are patched once the referenced objects have been appended behind them.
+ */
+class FlatbufferEncoder {
+public:
+    //! Struct describing a scalar or offset field of a table.
+    typedef struct Field {
+        uint16_t id;        //!< Field id, i.e. index in the vtable.
+        uint8_t  size;      //!< Field size in bytes: 1, 2, 4 or 8; offsets have size 4.
+        uint64_t value;     //!< Field value; ignored for offsets.
+    } Field;
+
+    std::vector<uint8_t>& buffer;
+
+    FlatbufferEncoder(std::vector<uint8_t>& b) : buffer(b) { buffer.clear(); }
+
+    void align(const size_t alignment) {
+        while (buffer.size() % alignment != 0) buffer.push_back(0);
+    }
+
+    void put(const uint64_t value, const size_t size) {
+        for (size_t i = 0; i < size; ++i) buffer.push_back((uint8_t)(value >> (8 * i)));
+    }
+
+    void set(const size_t pos, const uint64_t value, const size_t size) {
+        for (size_t i = 0; i < size; ++i) buffer[pos + i] = (uint8_t)(value >> (8 * i));
+    }
+
+    // let the offset at the given position refer to the given target position; the target must be behind the offset
+    void patch(const size_t pos, const size_t target) {
+        set(pos, (uint32_t)(target - pos), 4);
+    }
+
+    // write the root offset placeholder; it must be patched with the position of the root table
+    size_t root(void) {
+        const size_t pos = buffer.size();
+        put(0, 4);
+        return pos;
+    }
+
+    // write a vtable and table; positions[i] receives the buffer position of fields[i]
+    size_t table(const Field* fields, const size_t num_fields, size_t* positions) {
+        size_t num_ids = 0;
+        for (size_t i = 0; i < num_fields; ++i) {
+            if (fields[i].id + 1u > num_ids) num_ids = fields[i].id + 1u;
+        }
+        align(2);
+        const size_t vtable = buffer.size();
+        put(4 + 2 * num_ids, 2);
+        put(0, 2);
+        for (size_t i = 0; i < num_ids; ++i) put(0, 2);
+
+        align(8);
+        const size_t table = buffer.size();
+        put(table - vtable, 4);
+        // place larger fields first to minimize padding
+        for (size_t size = 8; size > 0; size /= 2) {
+            for (size_t i = 0; i < num_fields; ++i) {
+                if (fields[i].size == size) {
+                    align(size);
+                    positions[i] = buffer.size();
+                    set(vtable + 4 + 2 * fields[i].id, buffer.size() - table, 2);
+                    put(fields[i].value, size);
+                }
+            }
+        }
+        set(vtable + 2, buffer.size() - table, 2);
+        return table;
+    }
+
+    // write the length of a vector whose elements have the given alignment; return the vector position
+    size_t vector(const size_t length, const size_t element_alignment) {
+        align(4);
+        while ((buffer.size() + 4) % element_alignment != 0) buffer.push_back(0);
+        const size_t pos = buffer.size();
+        put(length, 4);
+        return pos;
+    }
+
+    size_t string(const std::string& str) {
+        const size_t pos = vector(str.length(), 4);
+        buffer.insert(buffer.end(), str.begin(), str.end());
+        buffer.push_back(0);
+        return pos;
+    }
+
+    // write a type table for the given column type; return the type table position and the union type
+    size_t type(const ArrowType t, uint8_t& union_type) {
+        size_t pos[2];
+        switch (t) {
+        case ArrowType::TIMESTAMP_MS: {
+            const Field fields[] = { { 0, 2, arrow_unit_millisecond } };
+            union_type = arrow_type_timestamp;
+            return table(fields, 1, pos);
+        }
+        case ArrowType::UINT32: {
+            const Field fields[] = { { 0, 4, 32 }, { 1, 1, 0 } };
+            union_type = arrow_type_int;
+            return table(fields, 2, pos);
+        }
+        default: {
+            const Field fields[] = { { 0, 2, arrow_precision_double } };
+            union_type = arrow_type_floating_point;
+            return table(fields, 1, pos);
+        }
+        }
+    }
+
+    size_t schema(const std::vector<ArrowColumn>& columns) {
+        const Field schema_fields[] = { { 0, 2, 0 }, { 1, 4, 0 } };     // endianness little, fields
+        size_t schema_pos[2];
+        const size_t schema_table = table(schema_fields, 2, schema_pos);
+        const size_t vec = vector(columns.size(), 4);
+        patch(schema_pos[1], vec);
+        for (size_t i = 0; i < columns.size(); ++i) put(0, 4);
+
+        for (size_t i = 0; i < columns.size(); ++i) {
+            uint8_t union_type = 0;
+            // name, nullable, type_type, type, children
+            const Field field_fields[] = { { 0, 4, 0 }, { 1, 1, 0 }, { 2, 1, 0 }, { 3, 4, 0 }, { 5, 4, 0 } };
+            size_t field_pos[5];
+            const size_t field_table = table(field_fields, 5, field_pos);
+            patch(vec + 4 + 4 * i, field_table);
+            patch(field_pos[0], string(columns[i].name));
+            patch(field_pos[3], type(columns[i].type, union_type));
+            set(field_pos[2], union_type, 1);
+            patch(field_pos[4], vector(0, 4));
+        }
+        return schema_table;
+    }
+};
+
+
+/**
+ * Constructor of the ArrowFileWriter instance.
+ * @param _schema The column definitions.
+ */
+ArrowFileWriter::ArrowFileWriter(const std::vector<ArrowColumn>& _schema) :
+    schema(_schema),
+    file(nullptr),
+    position(0) {}
+
+
+/**
+ * Destructor; an open file is completed and closed.
+ */
+ArrowFileWriter::~ArrowFileWriter(void) {
+    close();
+}
+
+
+/**
+ * Get the size in bytes of a single value of the given type.
+ */
+size_t ArrowFileWriter::getTypeSize(const ArrowType type) {
+    return (type == ArrowType::UINT32 ? 4 : 8);
+}
+
+
+/**
+ * Write the given data and padding to the next multiple of 8 bytes.
+ */
+bool ArrowFileWriter::write(const void* data, const size_t length) {
+    static const uint8_t padding[8] = { 0 };
+    const size_t padding_length = (8 - length % 8) % 8;
+    if ((length > 0 && fwrite(data, 1, length, file) != length) ||
+        (padding_length > 0 && fwrite(padding, 1, padding_length, file) != padding_length)) {
+        logger.print(LogLevel::LOG_ERROR, "cannot write arrow file");
+        return false;
+    }
+    position += length + padding_length;
+    return true;
+}
+
+
+/**
+ * Write the flatbuffer in the metadata buffer as an encapsulated message; the message body must follow.
+ */
+bool ArrowFileWriter::writeMessage(const uint64_t body_length) {
+    const uint32_t padded_length = (uint32_t)((metadata.size() + 7) & ~(size_t)7);
+    Block block = { position, 8 + padded_length, body_length };
+    const uint32_t prefix[2] = { arrow_continuation, padded_length };
+    if (write(prefix, sizeof(prefix)) == false || write(metadata.data(), metadata.size()) == false) {
+        return false;
+    }
+    if (body_length > 0) {
+        batches.push_back(block);
+    }
+    return true;
+}
+
+
+/**
+ * Create the given file and write the file header and schema.
+ * @param path The file path; an existing file is replaced.
+ * @return true on success, false otherwise.
+ */
+bool ArrowFileWriter::open(const std::string& path) {
+    close();
+    file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        logger.print(LogLevel::LOG_ERROR, "cannot create arrow file %s", path.c_str());
+        return false;
+    }
+    position = 0;
+    batches.clear();
+
+    FlatbufferEncoder encoder(metadata);
+    const size_t root = encoder.root();
+    // version, header_type, header, bodyLength
+    const FlatbufferEncoder::Field message_fields[] = { { 0, 2, arrow_metadata_v5 }, { 1, 1, arrow_header_schema }, { 2, 4, 0 }, { 3, 8, 0 } };
+    size_t message_pos[4];
+    encoder.patch(root, encoder.table(message_fields, 4, message_pos));
+    encoder.patch(message_pos[2], encoder.schema(schema));
+
+    if (write(arrow_magic, sizeof(arrow_magic)) == false || writeMessage(0) == false) {
+        fclose(file);
+        file = nullptr;
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ * Write a record batch; column data is written as is, without any conversion.
+ * @param columns Array of pointers to the column data, one per column of the schema. Each column must hold length
+ *                contiguous values of the column type; timestamps are int64 or uint64 values.
+ * @param length The number of rows.
+ * @return true on success, false otherwise.
+ */
+bool ArrowFileWriter::writeBatch(const void* const columns[], const size_t length) {
+    if (file == nullptr) {
+        return false;
+    }
+    FlatbufferEncoder encoder(metadata);
+    const size_t root = encoder.root();
+
+    uint64_t body_length = 0;
+    for (size_t i = 0; i < schema.size(); ++i) {
+        body_length += (length * getTypeSize(schema[i].type) + 7) & ~(uint64_t)7;
+    }
+    const FlatbufferEncoder::Field message_fields[] = { { 0, 2, arrow_metadata_v5 }, { 1, 1, arrow_header_record_batch }, { 2, 4, 0 }, { 3, 8, body_length } };
+    size_t message_pos[4];
+    encoder.patch(root, encoder.table(message_fields, 4, message_pos));
+
+    // length, nodes, buffers
+    const FlatbufferEncoder::Field batch_fields[] = { { 0, 8, length }, { 1, 4, 0 }, { 2, 4, 0 } };
+    size_t batch_pos[3];
+    encoder.patch(message_pos[2], encoder.table(batch_fields, 3, batch_pos));
+
+    // one field node per column: length, null count
+    encoder.patch(batch_pos[1], encoder.vector(schema.size(), 8));
+    for (size_t i = 0; i < schema.size(); ++i) {
+        encoder.put(length, 8);
+        encoder.put(0, 8);
+    }
+    // two buffers per column: an empty validity bitmap and the values
+    encoder.patch(batch_pos[2], encoder.vector(2 * schema.size(), 8));
+    uint64_t offset = 0;
+    for (size_t i = 0; i < schema.size(); ++i) {
+        const uint64_t size = length * getTypeSize(schema[i].type);
+        encoder.put(offset, 8);
+        encoder.put(0, 8);
+        encoder.put(offset, 8);
+        encoder.put(size, 8);
+        offset += (size + 7) & ~(uint64_t)7;
+    }
+
+    if (writeMessage(body_length) == false) {
+        return false;
+    }
+    for (size_t i = 0; i < schema.size(); ++i) {
+        if (write(columns[i], length * getTypeSize(schema[i].type)) == false) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+ * Write the end-of-stream marker and the file footer and close the file.
+ * @return true on success, false otherwise.
+ */
+bool ArrowFileWriter::close(void) {
+    if (file == nullptr) {
+        return false;
+    }
+    FlatbufferEncoder encoder(metadata);
+    const size_t root = encoder.root();
+    // version, schema, recordBatches
+    const FlatbufferEncoder::Field footer_fields[] = { { 0, 2, arrow_metadata_v5 }, { 1, 4, 0 }, { 3, 4, 0 } };
+    size_t footer_pos[3];
+    encoder.patch(root, encoder.table(footer_fields, 3, footer_pos));
+    encoder.patch(footer_pos[2], encoder.vector(batches.size(), 8));
+    for (size_t i = 0; i < batches.size(); ++i) {
+        encoder.put(batches[i].offset, 8);
+        encoder.put(batches[i].metadataLength, 4);
+        encoder.put(0, 4);
+        encoder.put(batches[i].bodyLength, 8);
+    }
+    encoder.patch(footer_pos[1], encoder.schema(schema));
+
+    const uint32_t eos[2] = { arrow_continuation, 0 };
+    const uint32_t footer_length = (uint32_t)metadata.size();
+    bool result = (fwrite(eos, sizeof(eos), 1, file) == 1 &&
+                   fwrite(metadata.data(), 1, metadata.size(), file) == metadata.size() &&
+                   fwrite(&footer_length, sizeof(footer_length), 1, file) == 1 &&
+                   fwrite(arrow_magic, 6, 1, file) == 1);
+    result = (fclose(file) == 0 && result);
+    if (result == false) {
+        logger.print(LogLevel::LOG_ERROR, "cannot write arrow file footer");
+    }
+    file = nullptr;
+    return result;
+}
+
+
+/**
+ * Export the content of the given measurement values, from oldest to newest, into an arrow file with columns time and value.
+ * Truncated 32-bit timestamps are expanded to 64-bit unix epoch milliseconds relative to the current time.
+ * @param path The file path.
+ * @param values The measurement values.
+ * @param time_scale Number of milliseconds per timestamp unit; 1 for emeter data, 1000 for inverter data.
+ * @return true on success, false otherwise.
+ */
+bool ArrowFileWriter::exportMeasurementValues(const std::string& path, const MeasurementValues& values, const unsigned long time_scale) {
+    std::vector<ArrowColumn> columns;
+    columns.push_back(ArrowColumn("time", ArrowType::TIMESTAMP_MS));
+    columns.push_back(ArrowColumn("value", ArrowType::DOUBLE));
+    ArrowFileWriter writer(columns);
+    if (writer.open(path) == false) {
+        return false;
+    }
+    // ring buffer elements interleave value and time, hence they are split into column chunks
+    const size_t n = values.getNumberOfElements();
+    const size_t chunk = (n < rows_per_batch ? n : rows_per_batch);
+    const uint64_t reference_time = LocalHost::getUnixEpochTimeInMs() / (time_scale > 0 ? time_scale : 1);
+    std::vector<uint64_t> times(chunk);
+    std::vector<double> doubles(chunk);
+    for (size_t start = 0; start < n; start += chunk) {
+        const size_t length = (n - start < chunk ? n - start : chunk);
+        for (size_t i = 0; i < length; ++i) {
+            const TimestampDoublePair& pair = values.at(start + i);
+            times[i] = SpeedwireTime::expandTimeTo64(pair.time, reference_time) * time_scale;
+            doubles[i] = pair.value;
+        }
+        const void* const data[] = { times.data(), doubles.data() };
+        if (writer.writeBatch(data, length) == false) {
+            writer.close();
+            return false;
+        }
+    }
+    return writer.close();
+}
+
+
+/**
+ * Export the given archive span into an arrow file with columns time, value, serial and measurement. The span columns
+ * are written directly from the mapped archive segment.
+ * @param path The file path.
+ * @param span The archive span, see ArchiveReader::getSpan().
+ * @return true on success, false otherwise.
+ */
+bool ArrowFileWriter::exportArchiveSpan(const std::string& path, const ArchiveSpan& span) {
+    std::vector<ArrowColumn> columns;
+    columns.push_back(ArrowColumn("time", ArrowType::TIMESTAMP_MS));
+    columns.push_back(ArrowColumn("value", ArrowType::DOUBLE));
+    columns.push_back(ArrowColumn("serial", ArrowType::UINT32));
+    columns.push_back(ArrowColumn("measurement", ArrowType::UINT32));
+    ArrowFileWriter writer(columns);
+    if (writer.open(path) == false) {
+        return false;
+    }
+    for (size_t start = 0; start < span.length; start += rows_per_batch) {
+        const size_t length = (span.length - start < rows_per_batch ? span.length - start : rows_per_batch);
+        const void* const data[] = { span.times + start, span.values + start, span.devices + start, span.measurements + start };
+        if (writer.writeBatch(data, length) == false) {
+            writer.close();
+            return false;
+        }
+    }
+    return writer.close();
+}
@@ -0,0 +1,263 @@
+#include <AsyncProducer.hpp>
+#include <LocalHost.hpp>
+#include <chrono>
+using namespace libspeedwire;
+
+
+/**
+ * Constructor of the AsyncProducer instance; the worker thread is started immediately.
+ * @param _producer Reference to the wrapped producer; it is only called from the worker thread.
+ * @param capacity Queue capacity; it is rounded up to the next power of 2.
+ * @param policy Behaviour if the queue is full.
+ * @param batch_size Number of values after which the wrapped producer is flushed.
+ * @param max_delay_in_ms Maximum time a value is held before the wrapped producer is flushed.
+ */
+AsyncProducer::AsyncProducer(Producer& _producer, const size_t capacity, const OverflowPolicy policy, const size_t batch_size, const unsigned long max_delay_in_ms) :
+    producer(_producer),
+    overflowPolicy(policy),
+    batchSize(batch_size > 0 ? batch_size : 1),
+    maxDelayInMs(max_delay_in_ms),
+    enqueuePos(0),
+    dequeuePos(0),
+    enqueuedCount(0),
+    droppedCount(0),
+    producedCount(0),
+    maxQueueDepth(0),
+    flushRequested(false),
+    running(true),
+    numBlocked(0),
+    numProducing(0) {
+    size_t size = 2;
+    while (size < capacity) size <<= 1;
+    mask = size - 1;
+    cells.reset(new Cell[size]);
+    for (size_t i = 0; i < size; ++i) {
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    worker = std::thread(&AsyncProducer::run, this);
+}
+
+
+/**
+ * Destructor; all queued values are passed to the wrapped producer before the worker thread terminates.
+ */
+AsyncProducer::~AsyncProducer(void) {
+    stop();
+}
+
+
+/**
+ * Stop the worker thread after all queued values have been passed to the wrapped producer. Producing threads waiting
+ * for room in the queue return and drop their values.
+ */
+void AsyncProducer::stop(void) {
+    if (running.exchange(false) == true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+        }
+        condition.notify_one();
+        space.notify_all();
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+
+/**
+ * Try to enqueue a value; this is safe to be called from several threads concurrently.
+ * @return true if the value has been enqueued, false if the queue is full.
+ */
+bool AsyncProducer::tryEnqueue(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value, const uint32_t time) {
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    Cell* cell;
+    for (;;) {
+        cell = &cells[pos & mask];
+        const size_t seq = cell->sequence.load(std::memory_order_acquire);
+        const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            return false;
+        }
+        else {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    // assignment reuses the string capacity of the preallocated record
+    Record& record = cell->record;
+    record.device = device;
+    record.type = type;
+    record.wire = wire;
+    record.value = value;
+    record.time = time;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+
+/**
+ * Dequeue the oldest value. This is called by the worker thread to pass the value to the wrapped producer
+ * and by producing threads to discard the value if the overflow policy is DROP_OLDEST.
+ * @param discard If true, the value is discarded instead of passed to the wrapped producer.
+ * @return true if a value has been dequeued, false if the queue is empty.
+ */
+bool AsyncProducer::dequeue(const bool discard) {
+    size_t pos = dequeuePos.load(std::memory_order_relaxed);
+    Cell* cell;
+    for (;;) {
+        cell = &cells[pos & mask];
+        const size_t seq = cell->sequence.load(std::memory_order_acquire);
+        const intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            return false;
+        }
+        else {
+            pos = dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+    if (discard == true) {
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+    // copy the value out, such that the cell is free while the wrapped producer is busy
+    current = cell->record;
+    cell->sequence.store(pos + mask + 1, std::memory_order_release);
+    producer.produce(current.device, current.type, current.wire, current.value, current.time);
+    producedCount.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+
+/**
+ * Wait until the worker thread made room in the queue; this is used by the BLOCK overflow policy.
+ * @return true if there may be room in the queue, false if the worker thread has been stopped.
+ */
+bool AsyncProducer::waitForSpace(void) {
+    std::unique_lock<std::mutex> lock(mutex);
+    numBlocked.fetch_add(1);
+    condition.notify_one();
+    // the timeout guards against a value dequeued between the failed enqueue attempt and taking the lock
+    space.wait_for(lock, std::chrono::milliseconds(10), [this] { return running.load() == false || getQueueDepth() <= mask; });
+    numBlocked.fetch_sub(1);
+    return running.load();
+}
+
+
+/**
+ * Enqueue the given value for the worker thread; the behaviour on a full queue depends on the overflow policy.
+ * After stop(), the value is dropped.
+ * @param device The device generating the data
+ * @param type The measurement type of the given data
+ * @param wire The Wire enumeration value
+ * @param value The data value itself
+ * @param time_in_ms The measurement timestamp
+ */
+void AsyncProducer::produce(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value, const uint32_t time_in_ms) {
+    // announce this thread before checking running; the stopping worker waits for it before its final drain
+    numProducing.fetch_add(1);
+    if (running.load() == false) {
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+        numProducing.fetch_sub(1);
+        return;
+    }
+    while (tryEnqueue(device, type, wire, value, time_in_ms) == false) {
+        if (overflowPolicy == OverflowPolicy::DROP_NEWEST) {
+            droppedCount.fetch_add(1, std::memory_order_relaxed);
+            numProducing.fetch_sub(1);
+            return;
+        }
+        if (overflowPolicy == OverflowPolicy::DROP_OLDEST) {
+            if (dequeue(true) == true) {
+                droppedCount.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        else if (waitForSpace() == false) {
+            droppedCount.fetch_add(1, std::memory_order_relaxed);
+            numProducing.fetch_sub(1);
+            return;
+        }
+    }
+    enqueuedCount.fetch_add(1, std::memory_order_relaxed);
+    numProducing.fetch_sub(1);
+
+    const size_t depth = getQueueDepth();
+    size_t max_depth = maxQueueDepth.load(std::memory_order_relaxed);
+    while (depth > max_depth && maxQueueDepth.compare_exchange_weak(max_depth, depth, std::memory_order_relaxed));
+    if (depth >= batchSize) {
+        condition.notify_one();
+    }
+}
+
+
+/**
+ * Request the worker thread to flush the wrapped producer once all currently queued values have been passed to it.
+ */
+void AsyncProducer::flush(void) {
+    flushRequested.store(true);
+    condition.notify_one();
+}
+
+
+/**
+ * Get the current number of queued values.
+ */
+size_t AsyncProducer::getQueueDepth(void) const {
+    const size_t enqueue_pos = enqueuePos.load(std::memory_order_relaxed);
+    const size_t dequeue_pos = dequeuePos.load(std::memory_order_relaxed);
+    return (enqueue_pos >= dequeue_pos ? enqueue_pos - dequeue_pos : 0);
+}
+
+
+/**
+ * Worker thread main loop.
+ */
+void AsyncProducer::run(void) {
+    size_t unflushed = 0;
+    uint64_t oldest_unflushed_time = 0;
+
+    for (;;) {
+        const bool keep_running = running.load();
+        if (keep_running == false) {
+            // wait for threads that passed the running check in produce(), such that their values are drained below
+            while (numProducing.load() > 0) {
+                std::this_thread::yield();
+            }
+        }
+
+        // pass queued values to the wrapped producer, flushing after each full batch
+        while (dequeue(false) == true) {
+            if (numBlocked.load() > 0) {
+                // taking the mutex ensures a blocked thread is either waiting or sees the room made
+                std::lock_guard<std::mutex> lock(mutex);
+                space.notify_all();
+            }
+            if (unflushed++ == 0) {
+                oldest_unflushed_time = LocalHost::getTickCountInMs();
+            }
+            if (unflushed >= batchSize) {
+                producer.flush();
+                unflushed = 0;
+            }
+        }
+        if (unflushed > 0 && (flushRequested.exchange(false) == true || keep_running == false ||
+                              LocalHost::getTickCountInMs() - oldest_unflushed_time >= maxDelayInMs)) {
+            producer.flush();
+            unflushed = 0;
+        }
+        if (keep_running == false) {
+            break;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait_for(lock, std::chrono::milliseconds(unflushed > 0 && maxDelayInMs < 10 ? maxDelayInMs + 1 : 10));
+    }
+}
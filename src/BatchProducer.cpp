@@ -0,0 +1,66 @@
+#include <BatchProducer.hpp>
+using namespace libspeedwire;
+
+
+/**
+ * Constructor of the BatchingProducer instance.
+ * @param batch_producer Reference to the batch producer receiving the batches.
+ */
+BatchingProducer::BatchingProducer(BatchProducer& batch_producer) :
+    batchProducer(batch_producer) {}
+
+
+/**
+ * Destructor.
+ */
+BatchingProducer::~BatchingProducer(void) {}
+
+
+/**
+ * Pass all values collected since the previous flush to the batch producer.
+ */
+void BatchingProducer::flush(void) {
+    if (batch.size() > 0) {
+        batchProducer.produce(batch);
+        batch.clear();
+    }
+}
+
+
+/**
+ * Append the given value to the current record batch.
+ * @param device The device generating the data
+ * @param type The measurement type of the given data
+ * @param wire The Wire enumeration value
+ * @param value The data value itself
+ * @param time_in_ms The measurement timestamp
+ */
+void BatchingProducer::produce(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value, const uint32_t time_in_ms) {
+    batch.add(device, type, wire, value, time_in_ms);
+}
+
+
+/**
+ * Constructor of the ProducerBatchAdapter instance.
+ * @param _producer Reference to the wrapped producer.
+ */
+ProducerBatchAdapter::ProducerBatchAdapter(Producer& _producer) :
+    producer(_producer) {}
+
+
+/**
+ * Destructor.
+ */
+ProducerBatchAdapter::~ProducerBatchAdapter(void) {}
+
+
+/**
+ * Produce each record of the given batch individually and flush the wrapped producer once.
+ * @param batch The record batch.
+ */
+void ProducerBatchAdapter::produce(const RecordBatch& batch) {
+    for (size_t i = 0; i < batch.size(); ++i) {
+        producer.produce(batch.getDevice(i), batch.getMeasurementType(i), batch.getWire(i), batch.values[i], batch.times[i]);
+    }
+    producer.flush();
+}
@@ -30,6 +30,8 @@ CalculatedValueProcessor::CalculatedValueProcessor(ObisDataMap& obis_map, Speedw
     obis_data_map(obis_map),
     speedwire_data_map(speedwire_map),
     producer(_producer) {
+    expressions.bindInputs(obis_data_map);
+    expressions.bindInputs(speedwire_data_map);
 }
 
 
@@ -39,6 +41,27 @@ CalculatedValueProcessor::CalculatedValueProcessor(ObisDataMap& obis_map, Speedw
 CalculatedValueProcessor::~CalculatedValueProcessor(void) { }
 
 
+/**
+ * Evaluate the formulas of the given engine and produce all recomputed outputs.
+ * @param engine The expression engine.
+ * @param device The device used for outputs without an explicitly bound output device.
+ * @param timestamp The timestamp used for outputs without a valid input timestamp.
+ */
+void CalculatedValueProcessor::produceExpressions(ExpressionEngine& engine, const SpeedwireDevice& device, const uint32_t timestamp) {
+    if (engine.getNumberOfFormulas() == 0 || engine.evaluate() == 0) {
+        return;
+    }
+    for (size_t i = 0; i < engine.getNumberOfFormulas(); ++i) {
+        const size_t slot = engine.getOutputSlot(i);
+        if (engine.isChanged(slot)) {
+            const SpeedwireDevice& output_device = (engine.hasOutputDevice(slot) ? engine.getOutputDevice(slot) : device);
+            const uint32_t time = (engine.getTime(slot) != 0 ? engine.getTime(slot) : timestamp);
+            producer.produce(output_device, engine.getOutputType(slot), engine.getOutputWire(slot), engine.getValue(slot), time);
+        }
+    }
+}
+
+
 /**
  * Callback to produce the given obis data to the next stage in the processing pipeline.
  * @param device The originating inverter device.
@@ -174,6 +197,7 @@ void CalculatedValueProcessor::endOfObisData(const SpeedwireDevice& device, cons
 #endif
     }
 
+    produceExpressions(expressions, device, timestamp);
     producer.flush();
 }
 
@@ -299,5 +323,6 @@ void CalculatedValueProcessor::endOfSpeedwireData(const SpeedwireDevice& device,
             }
         }
     }
+    produceExpressions(expressions, device, timestamp);
     producer.flush();
 }
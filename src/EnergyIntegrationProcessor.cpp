@@ -0,0 +1,236 @@
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <stdio.h>
+#include <EnergyIntegrationProcessor.hpp>
+#include <SpeedwireTime.hpp>
+#include <Logger.hpp>
+using namespace libspeedwire;
+
+static Logger logger("EnergyIntegrationProcessor");
+
+
+// Flush the given file from the stdio and operating system buffers to the storage device
+static bool syncFile(FILE* file) {
+    if (fflush(file) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return (_commit(_fileno(file)) == 0);
+#else
+    return (fsync(fileno(file)) == 0);
+#endif
+}
+
+
+// Flush the directory holding the given file path to the storage device, such that a rename survives a power loss
+static void syncDirectory(const std::string& path) {
+#ifndef _WIN32
+    const size_t slash = path.find_last_of('/');
+    const std::string directory = (slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash)));
+    const int fd = open(directory.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+#endif
+}
+
+
+/**
+ * Constructor of an integration state.
+ */
+EnergyIntegrationProcessor::IntegrationState::IntegrationState(void) :
+    serialNumber(0), energy(0.0), lastValue(0.0), lastTime(0), lastIsValid(false), changed(false), typeIsValid(false),
+    type(Direction::NO_DIRECTION, Type::ACTIVE, Quantity::ENERGY, "Wh", 1), wire(Wire::NO_WIRE) {}
+
+
+/**
+ * Constructor of the EnergyIntegrationProcessor instance.
+ * @param _producer Reference to producer to receive the energy counters.
+ * @param max_gap_in_ms Maximum interval between two power values to be integrated; longer intervals are treated as data gaps.
+ */
+EnergyIntegrationProcessor::EnergyIntegrationProcessor(Producer& _producer, const unsigned long max_gap_in_ms) :
+    producer(_producer),
+    maxGapInMs(max_gap_in_ms) {}
+
+
+/**
+ * Destructor.
+ */
+EnergyIntegrationProcessor::~EnergyIntegrationProcessor(void) {}
+
+
+/**
+ * Internal implementation of the trapezoidal integration of the newest power value of the given measurement.
+ * @param device The originating device.
+ * @param key The measurement key, unique for the given device.
+ * @param time_scale Number of milliseconds per timestamp unit; 1 for emeter data, 1000 for inverter data.
+ * @param measurement The measurement holding the new value.
+ */
+void EnergyIntegrationProcessor::process(const SpeedwireDevice& device, const uint32_t key, const unsigned long time_scale, const Measurement& measurement) {
+    const MeasurementType& mtype = measurement.measurementType;
+    if (mtype.quantity != Quantity::POWER || mtype.type == Type::NOMINAL || measurement.measurementValues.getNumberOfElements() == 0) {
+        return;
+    }
+    IntegrationState& state = states[((uint64_t)device.deviceAddress.serialNumber << 32) | key];
+    if (state.typeIsValid == false) {
+        state.serialNumber = device.deviceAddress.serialNumber;
+        state.type = MeasurementType(mtype.direction, mtype.type, Quantity::ENERGY, mtype.unit + "h", 1);
+        state.wire = measurement.wire;
+        state.typeIsValid = true;
+    }
+
+    const TimestampDoublePair& newest = measurement.measurementValues.getNewestElement();
+    const uint32_t time_in_ms = (uint32_t)(newest.time * time_scale);     // truncated to 32 bits like emeter timestamps
+    if (state.lastIsValid == true) {
+        const int32_t dt_in_ms = SpeedwireTime::calculateTimeDifference(time_in_ms, state.lastTime);
+        if (dt_in_ms <= 0) {
+            return;     // duplicate or out-of-order value
+        }
+        if ((unsigned long)dt_in_ms <= maxGapInMs) {
+            state.energy += 0.5 * (state.lastValue + newest.value) * (double)dt_in_ms / 3600000.0;
+            state.changed = true;
+        }
+    }
+    state.lastValue = newest.value;
+    state.lastTime = time_in_ms;
+    state.lastIsValid = true;
+}
+
+
+/**
+ * Produce the energy counters of the given device that changed since they were produced last.
+ * @param device The device.
+ */
+void EnergyIntegrationProcessor::produceEnergies(const SpeedwireDevice& device) {
+    const uint64_t first = ((uint64_t)device.deviceAddress.serialNumber << 32);
+    bool produced = false;
+    for (std::map<uint64_t, IntegrationState>::iterator it = states.lower_bound(first); it != states.end() && (it->first >> 32) == device.deviceAddress.serialNumber; ++it) {
+        IntegrationState& state = it->second;
+        if (state.changed == true && state.typeIsValid == true) {
+            producer.produce(device, state.type, state.wire, state.energy, state.lastTime);
+            state.changed = false;
+            produced = true;
+        }
+    }
+    if (produced == true) {
+        producer.flush();
+    }
+}
+
+
+/**
+ * Get the accumulated energy of the given device and power measurement.
+ * @param serial_number The serial number of the device.
+ * @param key The measurement key, i.e. ObisType::toKey() or SpeedwireRawData::toKey().
+ * @return The accumulated energy, e.g. in Wh, or 0 if there is no such accumulator.
+ */
+double EnergyIntegrationProcessor::getEnergy(const uint32_t serial_number, const uint32_t key) const {
+    std::map<uint64_t, IntegrationState>::const_iterator it = states.find(((uint64_t)serial_number << 32) | key);
+    return (it != states.end() ? it->second.energy : 0.0);
+}
+
+
+/**
+ * Save the accumulated energies to the given file. The file is first written under a temporary name, flushed to the
+ * storage device and then renamed, such that a crash or power loss during the write does not destroy the previous checkpoint.
+ * @param path The checkpoint file path.
+ * @return true on success, false otherwise.
+ */
+bool EnergyIntegrationProcessor::saveCheckpoint(const std::string& path) const {
+    const std::string temp_path = path + ".tmp";
+    FILE* file = fopen(temp_path.c_str(), "w");
+    if (file == NULL) {
+        logger.print(LogLevel::LOG_ERROR, "cannot open checkpoint file %s", temp_path.c_str());
+        return false;
+    }
+    bool ok = true;
+    for (std::map<uint64_t, IntegrationState>::const_iterator it = states.begin(); it != states.end(); ++it) {
+        ok &= (fprintf(file, "%08x %08x %.17g\n", (unsigned)(it->first >> 32), (unsigned)(it->first & 0xffffffff), it->second.energy) > 0);
+    }
+    ok &= syncFile(file);
+    ok &= (fclose(file) == 0);
+#ifdef _WIN32
+    remove(path.c_str());
+#endif
+    if (ok == false || rename(temp_path.c_str(), path.c_str()) != 0) {
+        logger.print(LogLevel::LOG_ERROR, "cannot write checkpoint file %s", path.c_str());
+        remove(temp_path.c_str());
+        return false;
+    }
+    syncDirectory(path);
+    return true;
+}
+
+
+/**
+ * Restore the accumulated energies from the given file. Restored accumulators continue from the checkpointed energy;
+ * the interval between the checkpoint and the first new power value is not integrated.
+ * @param path The checkpoint file path.
+ * @return true on success, false otherwise.
+ */
+bool EnergyIntegrationProcessor::restoreCheckpoint(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == NULL) {
+        logger.print(LogLevel::LOG_WARNING, "cannot open checkpoint file %s", path.c_str());
+        return false;
+    }
+    unsigned serial_number, key;
+    double energy;
+    while (fscanf(file, "%x %x %lg", &serial_number, &key, &energy) == 3) {
+        IntegrationState& state = states[((uint64_t)serial_number << 32) | key];
+        state.serialNumber = serial_number;
+        state.energy = energy;
+        state.lastIsValid = false;
+    }
+    bool ok = (feof(file) != 0);
+    fclose(file);
+    if (ok == false) {
+        logger.print(LogLevel::LOG_ERROR, "invalid checkpoint file %s", path.c_str());
+    }
+    return ok;
+}
+
+
+/**
+ * Callback to consume the given obis data element.
+ * @param device The originating emeter device.
+ * @param element A reference to an ObisData instance, holding output data of the ObisFilter.
+ */
+void EnergyIntegrationProcessor::consume(const SpeedwireDevice& device, ObisData& element) {
+    process(device, element.toKey(), 1, element);
+}
+
+
+/**
+ * Callback to consume the given inverter reply data element.
+ * @param device The originating inverter device.
+ * @param element A reference to a SpeedwireData instance.
+ */
+void EnergyIntegrationProcessor::consume(const SpeedwireDevice& device, SpeedwireData& element) {
+    process(device, element.toKey(), 1000, element);
+}
+
+
+/**
+ * Callback to notify that the last obis data in the emeter packet has been processed.
+ * @param device The originating emeter device.
+ * @param time The timestamp associated with the just finished emeter packet.
+ */
+void EnergyIntegrationProcessor::endOfObisData(const SpeedwireDevice& device, const uint32_t /*time*/) {
+    produceEnergies(device);
+}
+
+
+/**
+ * Callback to notify that the last data in the inverter packet has been processed.
+ * @param device The originating inverter device.
+ * @param time The timestamp associated with the just finished inverter packet.
+ */
+void EnergyIntegrationProcessor::endOfSpeedwireData(const SpeedwireDevice& device, const uint32_t /*time*/) {
+    produceEnergies(device);
+}
@@ -0,0 +1,516 @@
+#include <ExpressionEngine.hpp>
+#include <Logger.hpp>
+#include <LocalHost.hpp>
+#include <SpeedwireTime.hpp>
+#include <cctype>
+#include <cstdlib>
+#include <cmath>
+using namespace libspeedwire;
+
+static Logger logger("ExpressionEngine");
+
+
+namespace {
+
+    /**
+     *  Recursive descent parser translating a single expression into postfix stack machine instructions.
+     *  Variable references are emitted as LOAD or MEAN instructions with their names collected in a parallel vector.
+     */
+    class ExpressionParser {
+    protected:
+        const std::string& text;
+        size_t pos;
+
+        void skipSpaces(void) {
+            while (pos < text.length() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r')) ++pos;
+        }
+
+        bool accept(const char c) {
+            skipSpaces();
+            if (pos < text.length() && text[pos] == c) { ++pos; return true; }
+            return false;
+        }
+
+        void emit(const ExpressionEngine::OpCode op, const double constant = 0.0, const std::string& name = std::string()) {
+            ExpressionEngine::Instruction instruction;
+            instruction.op = op;
+            instruction.slot = 0;
+            instruction.constant = constant;
+            instructions.push_back(instruction);
+            names.push_back(name);
+        }
+
+        bool parseExpression(void) {
+            if (!parseTerm()) return false;
+            for (;;) {
+                if (accept('+'))      { if (!parseTerm()) return false; emit(ExpressionEngine::OpCode::ADD); }
+                else if (accept('-')) { if (!parseTerm()) return false; emit(ExpressionEngine::OpCode::SUB); }
+                else return true;
+            }
+        }
+
+        bool parseTerm(void) {
+            if (!parseUnary()) return false;
+            for (;;) {
+                if (accept('*'))      { if (!parseUnary()) return false; emit(ExpressionEngine::OpCode::MUL); }
+                else if (accept('/')) { if (!parseUnary()) return false; emit(ExpressionEngine::OpCode::DIV); }
+                else return true;
+            }
+        }
+
+        bool parseUnary(void) {
+            if (accept('-')) {
+                if (!parseUnary()) return false;
+                emit(ExpressionEngine::OpCode::NEG);
+                return true;
+            }
+            return parsePrimary();
+        }
+
+        bool parsePrimary(void) {
+            skipSpaces();
+            if (accept('(')) {
+                return (parseExpression() && accept(')'));
+            }
+            if (pos < text.length() && (isdigit((unsigned char)text[pos]) || text[pos] == '.')) {
+                const char* start = text.c_str() + pos;
+                char* end = NULL;
+                double value = strtod(start, &end);
+                if (end == start) return false;
+                pos += (size_t)(end - start);
+                emit(ExpressionEngine::OpCode::CONSTANT, value);
+                return true;
+            }
+            std::string name;
+            if (!parseName(name)) return false;
+            if (accept('(')) {
+                if (name == "abs") {
+                    if (!parseExpression() || !accept(')')) return false;
+                    emit(ExpressionEngine::OpCode::ABS);
+                    return true;
+                }
+                if (name == "mean") {
+                    std::string variable;
+                    if (!parseName(variable) || !accept(')')) return false;
+                    emit(ExpressionEngine::OpCode::MEAN, 0.0, variable);
+                    return true;
+                }
+                if (name == "min" || name == "max") {
+                    if (!parseExpression() || !accept(',') || !parseExpression() || !accept(')')) return false;
+                    emit(name == "min" ? ExpressionEngine::OpCode::MIN : ExpressionEngine::OpCode::MAX);
+                    return true;
+                }
+                error = "unknown function " + name;
+                return false;
+            }
+            emit(ExpressionEngine::OpCode::LOAD, 0.0, name);
+            return true;
+        }
+
+    public:
+        std::vector<ExpressionEngine::Instruction> instructions;   //!< Postfix instructions.
+        std::vector<std::string> names;                             //!< Variable names of LOAD and MEAN instructions.
+        std::string error;                                          //!< Error description.
+
+        ExpressionParser(const std::string& t) : text(t), pos(0) {}
+
+        bool parseName(std::string& name) {
+            skipSpaces();
+            size_t start = pos;
+            while (pos < text.length() && (isalnum((unsigned char)text[pos]) || text[pos] == '_')) ++pos;
+            if (pos == start || isdigit((unsigned char)text[start])) {
+                pos = start;
+                return false;
+            }
+            name = text.substr(start, pos - start);
+            return true;
+        }
+
+        bool parseFormula(std::string& output) {
+            if (!parseName(output) || !accept('=')) {
+                error = "expected <name> = <expression>";
+                return false;
+            }
+            if (!parseExpression()) {
+                if (error.length() == 0) error = "syntax error at position " + std::to_string(pos);
+                return false;
+            }
+            skipSpaces();
+            if (pos != text.length()) {
+                error = "unexpected character at position " + std::to_string(pos);
+                return false;
+            }
+            return true;
+        }
+    };
+
+}   // namespace
+
+
+/**
+ * Constructor of a slot.
+ * @param n The variable name.
+ */
+ExpressionEngine::Slot::Slot(const std::string& n) :
+    name(n), input(NULL), formula(-1), value(0.0), time(0), inputTime(0), inSeconds(false), valid(false), changed(false), used(false), hasDevice(false),
+    type(Direction::NO_DIRECTION, Type::NO_TYPE, Quantity::NO_QUANTITY, "", 1), wire(Wire::NO_WIRE) {}
+
+
+/**
+ * Constructor of the ExpressionEngine instance.
+ */
+ExpressionEngine::ExpressionEngine(void) {}
+
+
+/**
+ * Destructor.
+ */
+ExpressionEngine::~ExpressionEngine(void) {}
+
+
+/**
+ * Get the slot index for the given variable name; create a new slot if there is none.
+ * @param name The variable name.
+ * @return The slot index.
+ */
+uint32_t ExpressionEngine::getOrCreateSlot(const std::string& name) {
+    std::map<std::string, uint32_t>::const_iterator it = slotIndex.find(name);
+    if (it != slotIndex.end()) {
+        return it->second;
+    }
+    slots.push_back(Slot(name));
+    slotIndex[name] = (uint32_t)(slots.size() - 1);
+    return (uint32_t)(slots.size() - 1);
+}
+
+
+/**
+ * Find the slot index for the given variable name.
+ * @param name The variable name.
+ * @return The slot index, or -1 if there is no such variable.
+ */
+int ExpressionEngine::findSlot(const std::string& name) const {
+    std::map<std::string, uint32_t>::const_iterator it = slotIndex.find(name);
+    return (it != slotIndex.end() ? (int)it->second : -1);
+}
+
+
+/**
+ * Bind the given variable name to a measurement. The measurement must outlive the engine; elements of
+ * ObisDataMap and SpeedwireDataMap instances are suitable, as map elements do not move in memory.
+ * If a formula assigns to this name, the measurement type and wire are used when producing the output.
+ * @param name The variable name.
+ * @param measurement The measurement providing the newest value.
+ * @param is_inverter_time True if the measurement holds inverter timestamps in seconds, false for emeter timestamps in ms.
+ */
+void ExpressionEngine::bindInput(const std::string& name, const Measurement& measurement, const bool is_inverter_time) {
+    Slot& slot = slots[getOrCreateSlot(name)];
+    slot.input = &measurement;
+    slot.inSeconds = is_inverter_time;
+    slot.type = measurement.measurementType;
+    slot.wire = measurement.wire;
+}
+
+
+/**
+ * Bind all elements of the given obis data map by their description, e.g. "positive_active_power_l1".
+ * Names that are already bound are left unchanged.
+ * @param map The obis data map.
+ */
+void ExpressionEngine::bindInputs(const ObisDataMap& map) {
+    for (ObisDataMap::const_iterator it = map.begin(); it != map.end(); ++it) {
+        if (findSlot(it->second.description) < 0) {
+            bindInput(it->second.description, it->second);
+        }
+    }
+}
+
+
+/**
+ * Bind all elements of the given speedwire data map by their description, e.g. "power_mpp1"; their timestamps are
+ * inverter timestamps. Names that are already bound are left unchanged.
+ * @param map The speedwire data map.
+ */
+void ExpressionEngine::bindInputs(const SpeedwireDataMap& map) {
+    for (SpeedwireDataMap::const_iterator it = map.begin(); it != map.end(); ++it) {
+        if (findSlot(it->second.description) < 0) {
+            bindInput(it->second.description, it->second, true);
+        }
+    }
+}
+
+
+/**
+ * Define the measurement type and wire used when producing the given output variable; the output is produced for the
+ * device passed to the caller of evaluate().
+ * @param name The variable name.
+ * @param type The measurement type of the output.
+ * @param wire The wire of the output.
+ */
+void ExpressionEngine::bindOutput(const std::string& name, const MeasurementType& type, const Wire wire) {
+    Slot& slot = slots[getOrCreateSlot(name)];
+    slot.type = type;
+    slot.wire = wire;
+}
+
+
+/**
+ * Define the device, measurement type and wire used when producing the given output variable.
+ * @param name The variable name.
+ * @param device The device to produce the output for.
+ * @param type The measurement type of the output.
+ * @param wire The wire of the output.
+ */
+void ExpressionEngine::bindOutput(const std::string& name, const SpeedwireDevice& device, const MeasurementType& type, const Wire wire) {
+    Slot& slot = slots[getOrCreateSlot(name)];
+    slot.hasDevice = true;
+    slot.device = device;
+    slot.type = type;
+    slot.wire = wire;
+}
+
+
+/**
+ * Compile the given formulas and add them to the engine.
+ * @param text One or more formulas, separated by newlines or semicolons.
+ * @return true on success; false on syntax errors, duplicate outputs or cyclic dependencies, in which case no formula is added.
+ */
+bool ExpressionEngine::compile(const std::string& text) {
+    const size_t num_slots = slots.size();
+    const size_t num_instructions = instructions.size();
+    const size_t num_formulas = formulas.size();
+    std::vector<bool> used(num_slots);
+    for (size_t i = 0; i < num_slots; ++i) {
+        used[i] = slots[i].used;
+    }
+    size_t line_start = 0;
+
+    while (line_start <= text.length()) {
+        size_t line_end = text.find_first_of(";\n", line_start);
+        if (line_end == std::string::npos) line_end = text.length();
+        std::string line = text.substr(line_start, line_end - line_start);
+        line_start = line_end + 1;
+
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+        ExpressionParser parser(line);
+        std::string output;
+        bool ok = parser.parseFormula(output);
+        if (ok && findSlot(output) >= 0 && slots[findSlot(output)].formula >= 0) {
+            parser.error = "duplicate definition of " + output;
+            ok = false;
+        }
+        if (ok == false) {
+            logger.print(LogLevel::LOG_ERROR, "%s: %s", parser.error.c_str(), line.c_str());
+            rollback(num_slots, num_instructions, num_formulas, used);
+            return false;
+        }
+
+        // resolve variable names into slot indexes and append the instructions
+        Formula formula;
+        formula.begin = instructions.size();
+        for (size_t i = 0; i < parser.instructions.size(); ++i) {
+            Instruction instruction = parser.instructions[i];
+            if (instruction.op == OpCode::LOAD || instruction.op == OpCode::MEAN) {
+                instruction.slot = getOrCreateSlot(parser.names[i]);
+                slots[instruction.slot].used = true;
+                formula.inputs.push_back(instruction.slot);
+            }
+            instructions.push_back(instruction);
+        }
+        formula.end = instructions.size();
+        formula.output = getOrCreateSlot(output);
+        slots[formula.output].formula = (int)formulas.size();
+        formulas.push_back(formula);
+    }
+
+    if (sortFormulas() == false) {
+        logger.print(LogLevel::LOG_ERROR, "cyclic formula dependencies");
+        rollback(num_slots, num_instructions, num_formulas, used);
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ * Undo a failed compilation: remove the added formulas and instructions, the slots created for them and restore
+ * the used flags of the previously existing slots.
+ * @param num_slots The number of slots before compilation.
+ * @param num_instructions The number of instructions before compilation.
+ * @param num_formulas The number of formulas before compilation.
+ * @param used The used flags of the slots before compilation.
+ */
+void ExpressionEngine::rollback(const size_t num_slots, const size_t num_instructions, const size_t num_formulas, const std::vector<bool>& used) {
+    for (size_t i = num_slots; i < slots.size(); ++i) {
+        slotIndex.erase(slots[i].name);
+    }
+    slots.erase(slots.begin() + num_slots, slots.end());
+    for (size_t i = 0; i < num_slots; ++i) {
+        slots[i].used = used[i];
+    }
+    instructions.resize(num_instructions);
+    formulas.resize(num_formulas);
+    sortFormulas();
+}
+
+
+/**
+ * Sort formulas into dependency order and update the list of used input slots.
+ * @return false if the formulas contain cyclic dependencies.
+ */
+bool ExpressionEngine::sortFormulas(void) {
+    for (size_t i = 0; i < slots.size(); ++i) {
+        slots[i].formula = -1;
+    }
+    for (size_t i = 0; i < formulas.size(); ++i) {
+        slots[formulas[i].output].formula = (int)i;
+    }
+
+    // topological sort (Kahn's algorithm) on formula indexes
+    std::vector<size_t> pending(formulas.size(), 0);
+    std::vector<std::vector<size_t> > dependents(formulas.size());
+    for (size_t i = 0; i < formulas.size(); ++i) {
+        for (size_t j = 0; j < formulas[i].inputs.size(); ++j) {
+            int producer = slots[formulas[i].inputs[j]].formula;
+            if (producer >= 0) {
+                dependents[producer].push_back(i);
+                ++pending[i];
+            }
+        }
+    }
+    std::vector<size_t> order;
+    for (size_t i = 0; i < formulas.size(); ++i) {
+        if (pending[i] == 0) order.push_back(i);
+    }
+    for (size_t k = 0; k < order.size(); ++k) {
+        for (size_t j = 0; j < dependents[order[k]].size(); ++j) {
+            if (--pending[dependents[order[k]][j]] == 0) order.push_back(dependents[order[k]][j]);
+        }
+    }
+    if (order.size() != formulas.size()) {
+        return false;
+    }
+    std::vector<Formula> sorted;
+    sorted.reserve(formulas.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        sorted.push_back(formulas[order[i]]);
+        slots[sorted.back().output].formula = (int)i;
+    }
+    formulas.swap(sorted);
+
+    // collect used input slots and the required stack size
+    usedInputs.clear();
+    for (size_t i = 0; i < slots.size(); ++i) {
+        if (slots[i].used == true && slots[i].formula < 0) {
+            usedInputs.push_back((uint32_t)i);
+        }
+    }
+    stack.reserve(instructions.size() + 1);
+    return true;
+}
+
+
+/**
+ * Remove all formulas and bindings.
+ */
+void ExpressionEngine::clear(void) {
+    slots.clear();
+    slotIndex.clear();
+    instructions.clear();
+    formulas.clear();
+    usedInputs.clear();
+}
+
+
+/**
+ * Execute the instructions of the given formula.
+ * @param formula The formula.
+ * @return The result.
+ */
+double ExpressionEngine::execute(const Formula& formula) {
+    stack.clear();
+    for (size_t i = formula.begin; i < formula.end; ++i) {
+        const Instruction& instruction = instructions[i];
+        double b;
+        switch (instruction.op) {
+        case OpCode::LOAD:     stack.push_back(slots[instruction.slot].value); break;
+        case OpCode::CONSTANT: stack.push_back(instruction.constant); break;
+        case OpCode::NEG:      stack.back() = -stack.back(); break;
+        case OpCode::ABS:      stack.back() = fabs(stack.back()); break;
+        case OpCode::ADD:      b = stack.back(); stack.pop_back(); stack.back() += b; break;
+        case OpCode::SUB:      b = stack.back(); stack.pop_back(); stack.back() -= b; break;
+        case OpCode::MUL:      b = stack.back(); stack.pop_back(); stack.back() *= b; break;
+        case OpCode::DIV:      b = stack.back(); stack.pop_back(); stack.back() = (b != 0.0 ? stack.back() / b : 0.0); break;
+        case OpCode::MIN:      b = stack.back(); stack.pop_back(); if (b < stack.back()) stack.back() = b; break;
+        case OpCode::MAX:      b = stack.back(); stack.pop_back(); if (b > stack.back()) stack.back() = b; break;
+        case OpCode::MEAN: {
+            const Slot& slot = slots[instruction.slot];
+            if (slot.formula < 0 && slot.input != NULL && slot.input->measurementValues.getNumberOfElements() > 0) {
+                stack.push_back(slot.input->measurementValues.estimateMean());
+            }
+            else {
+                stack.push_back(slot.value);
+            }
+            break;
+        }
+        }
+    }
+    return (stack.size() > 0 ? stack.back() : 0.0);
+}
+
+
+/**
+ * Evaluate all formulas with at least one changed input. An input has changed if the newest value of its bound
+ * measurement has a different timestamp or value than during the previous evaluation. Formulas with unbound or empty
+ * inputs are skipped. Each output is stamped with the newest timestamp of its inputs, in emeter time.
+ * @return The number of recomputed formulas; use isChanged() to find the recomputed output slots.
+ */
+size_t ExpressionEngine::evaluate(void) {
+    uint64_t now = 0;
+    for (size_t i = 0; i < usedInputs.size(); ++i) {
+        Slot& slot = slots[usedInputs[i]];
+        slot.changed = false;
+        if (slot.input != NULL && slot.input->measurementValues.getNumberOfElements() > 0) {
+            const TimestampDoublePair& newest = slot.input->measurementValues.getNewestElement();
+            if (slot.valid == false || newest.time != slot.inputTime || newest.value != slot.value) {
+                slot.value = newest.value;
+                slot.inputTime = newest.time;
+                if (slot.inSeconds == true) {
+                    if (now == 0) now = LocalHost::getUnixEpochTimeInMs();
+                    slot.time = SpeedwireTime::convertInverterToEmeterTime(newest.time, now);
+                }
+                else {
+                    slot.time = newest.time;
+                }
+                slot.valid = true;
+                slot.changed = true;
+            }
+        }
+    }
+
+    size_t recomputed = 0;
+    for (size_t i = 0; i < formulas.size(); ++i) {
+        const Formula& formula = formulas[i];
+        Slot& output = slots[formula.output];
+        bool any_changed = false, all_valid = true;
+        uint32_t time = 0;
+        for (size_t j = 0; j < formula.inputs.size(); ++j) {
+            const Slot& input = slots[formula.inputs[j]];
+            any_changed |= input.changed;
+            all_valid &= input.valid;
+            if (SpeedwireTime::calculateTimeDifference(input.time, time) > 0 || j == 0) time = input.time;
+        }
+        output.changed = false;
+        if (all_valid == true && (any_changed == true || (output.valid == false && formula.inputs.size() == 0))) {
+            output.value = execute(formula);
+            output.time = time;
+            output.valid = true;
+            output.changed = true;
+            ++recomputed;
+        }
+    }
+    return recomputed;
+}
@@ -0,0 +1,172 @@
+#define _WINSOCK_DEPRECATED_NO_WARNINGS
+#include <cstring>
+
+#ifdef _WIN32
+#include <Winsock2.h>
+#include <Ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+#include <IpAddress.hpp>
+#include <AddressConversion.hpp>
+using namespace libspeedwire;
+
+
+/**
+ *  Construct an invalid address.
+ */
+IpAddress::IpAddress(void) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sa.sa_family = AF_UNSPEC;
+}
+
+/**
+ *  Construct an address from the given string in ipv4 dot notation or ipv6 colon notation.
+ *  Empty or invalid strings result in an invalid address.
+ */
+IpAddress::IpAddress(const std::string& ip_address) : IpAddress(ip_address.c_str()) {}
+
+/**
+ *  Construct an address from the given string in ipv4 dot notation or ipv6 colon notation.
+ *  Empty or invalid strings result in an invalid address.
+ */
+IpAddress::IpAddress(const char* const ip_address) : IpAddress() {
+    if (ip_address == NULL || ip_address[0] == '\0') {
+        return;
+    }
+    if (strchr(ip_address, ':') == NULL) {
+        if (inet_pton(AF_INET, ip_address, &addr.v4.sin_addr) == 1) {
+            addr.v4.sin_family = AF_INET;
+#ifdef __APPLE__
+            addr.v4.sin_len = sizeof(struct sockaddr_in);
+#endif
+        }
+    }
+    else if (inet_pton(AF_INET6, ip_address, &addr.v6.sin6_addr) == 1) {
+        addr.v6.sin6_family = AF_INET6;
+#ifdef __APPLE__
+        addr.v6.sin6_len = sizeof(struct sockaddr_in6);
+#endif
+    }
+}
+
+/**
+ *  Construct an address from the given ipv4 address.
+ */
+IpAddress::IpAddress(const struct in_addr& address) : IpAddress() {
+    addr.v4.sin_family = AF_INET;
+    addr.v4.sin_addr = address;
+#ifdef __APPLE__
+    addr.v4.sin_len = sizeof(struct sockaddr_in);
+#endif
+}
+
+/**
+ *  Construct an address from the given ipv6 address.
+ */
+IpAddress::IpAddress(const struct in6_addr& address) : IpAddress() {
+    addr.v6.sin6_family = AF_INET6;
+    addr.v6.sin6_addr = address;
+#ifdef __APPLE__
+    addr.v6.sin6_len = sizeof(struct sockaddr_in6);
+#endif
+}
+
+/**
+ *  Construct an address from the ip address of the given socket address; the port is not retained.
+ */
+IpAddress::IpAddress(const struct sockaddr& address) : IpAddress() {
+    if (address.sa_family == AF_INET) {
+        *this = IpAddress(AddressConversion::toSockAddrIn(address).sin_addr);
+    }
+    else if (address.sa_family == AF_INET6) {
+        *this = IpAddress(AddressConversion::toSockAddrIn6(address).sin6_addr);
+    }
+}
+
+
+/**
+ *  Check if this is the ipv4 or ipv6 any address, i.e. 0.0.0.0 or ::
+ */
+bool IpAddress::isAny(void) const {
+    if (isIpv4()) {
+        return (addr.v4.sin_addr.s_addr == 0);
+    }
+    if (isIpv6()) {
+        static const struct in6_addr any = {};
+        return (memcmp(&addr.v6.sin6_addr, &any, sizeof(any)) == 0);
+    }
+    return false;
+}
+
+
+/**
+ *  Convert the address to a string in ipv4 dot notation or ipv6 colon notation; invalid addresses result in an empty string.
+ */
+std::string IpAddress::toString(void) const {
+    if (isIpv4()) {
+        return AddressConversion::toString(addr.v4.sin_addr);
+    }
+    if (isIpv6()) {
+        return AddressConversion::toString(addr.v6.sin6_addr);
+    }
+    return std::string();
+}
+
+
+/**
+ *  Calculate a hash value from the binary address.
+ */
+size_t IpAddress::hash(void) const {
+    // fnv-1a hash across the address bytes
+    const uint8_t* bytes = NULL;
+    size_t length = 0;
+    if (isIpv4()) {
+        bytes = (const uint8_t*)&addr.v4.sin_addr;
+        length = sizeof(addr.v4.sin_addr);
+    }
+    else if (isIpv6()) {
+        bytes = (const uint8_t*)&addr.v6.sin6_addr;
+        length = sizeof(addr.v6.sin6_addr);
+    }
+    uint64_t hash = 0xcbf29ce484222325ull ^ (uint64_t)addr.sa.sa_family;
+    for (size_t i = 0; i < length; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return (size_t)hash;
+}
+
+
+/**
+ *  Compare two addresses; all invalid addresses are equal.
+ */
+bool IpAddress::operator==(const IpAddress& rhs) const {
+    if (addr.sa.sa_family != rhs.addr.sa.sa_family) {
+        return false;
+    }
+    if (isIpv4()) {
+        return (addr.v4.sin_addr.s_addr == rhs.addr.v4.sin_addr.s_addr);
+    }
+    if (isIpv6()) {
+        return (memcmp(&addr.v6.sin6_addr, &rhs.addr.v6.sin6_addr, sizeof(addr.v6.sin6_addr)) == 0);
+    }
+    return true;
+}
+
+
+/**
+ *  Order two addresses; invalid addresses come first, followed by ipv4 and ipv6 addresses in network byte order.
+ */
+bool IpAddress::operator<(const IpAddress& rhs) const {
+    if (addr.sa.sa_family != rhs.addr.sa.sa_family) {
+        return (isValid() == false || (isIpv4() && rhs.isIpv6()));
+    }
+    if (isIpv4()) {
+        return (memcmp(&addr.v4.sin_addr, &rhs.addr.v4.sin_addr, sizeof(addr.v4.sin_addr)) < 0);
+    }
+    if (isIpv6()) {
+        return (memcmp(&addr.v6.sin6_addr, &rhs.addr.v6.sin6_addr, sizeof(addr.v6.sin6_addr)) < 0);
+    }
+    return false;
+}
@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <string.h>
+#include <cmath>
+#include <cstdlib>
+#include <LineProtocolProducer.hpp>
+#include <LocalHost.hpp>
+#include <SpeedwireTime.hpp>
+using namespace libspeedwire;
+
+// two-digit lookup table for integer formatting
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const double powers_of_ten[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+
+
+/**
+ * Constructor of the LineProtocolEncoder instance.
+ * @param measurement_name The line protocol measurement name.
+ * @param initial_capacity The initial buffer capacity in bytes.
+ */
+LineProtocolEncoder::LineProtocolEncoder(const std::string& measurement_name, const size_t initial_capacity) :
+    buffer(initial_capacity > 256 ? initial_capacity : 256),
+    length(0) {
+    appendEscaped(measurementName, measurement_name, true);
+}
+
+
+/**
+ * Append the given string with line protocol escaping applied.
+ * @param out The output string.
+ * @param in The input string.
+ * @param is_measurement True to apply measurement name escaping, false to apply tag and field key escaping.
+ */
+void LineProtocolEncoder::appendEscaped(std::string& out, const std::string& in, const bool is_measurement) {
+    for (size_t i = 0; i < in.length(); ++i) {
+        const char c = in[i];
+        if (c == ',' || c == ' ' || (c == '=' && is_measurement == false)) {
+            out.push_back('\\');
+        }
+        out.push_back(c);
+    }
+}
+
+
+/**
+ * Format the given unsigned integer.
+ * @param out Output character array with room for at least 20 characters.
+ * @param value The value.
+ * @return The number of characters written.
+ */
+size_t LineProtocolEncoder::formatUnsigned(char* out, uint64_t value) {
+    char temp[24];
+    char* p = temp + sizeof(temp);
+    while (value >= 100) {
+        const unsigned index = (unsigned)(value % 100) * 2;
+        value /= 100;
+        *--p = digit_pairs[index + 1];
+        *--p = digit_pairs[index];
+    }
+    if (value >= 10) {
+        const unsigned index = (unsigned)value * 2;
+        *--p = digit_pairs[index + 1];
+        *--p = digit_pairs[index];
+    }
+    else {
+        *--p = (char)('0' + value);
+    }
+    const size_t n = (size_t)(temp + sizeof(temp) - p);
+    memcpy(out, p, n);
+    return n;
+}
+
+
+/**
+ * Format the given double value with the shortest decimal representation that is exact at the resolution of the given
+ * divisor, i.e. 1 decimal for a divisor of 10; values that are not exact at that resolution are formatted with the
+ * first of 15, 16 or 17 significant digits that round-trips.
+ * @param out Output character array with room for at least 32 characters.
+ * @param value The value.
+ * @param divisor The measurement divisor.
+ * @return The number of characters written; 0 if the value is not finite, as line protocol cannot represent it.
+ */
+size_t LineProtocolEncoder::formatDouble(char* out, const double value, const unsigned long divisor) {
+    unsigned decimals = 0;
+    for (unsigned long d = divisor; d >= 10 && decimals < 9; d /= 10) ++decimals;
+
+    // fast path: the value is an exact multiple of the resolution and fits into 53 bits
+    const double scaled = value * powers_of_ten[decimals];
+    if (std::isfinite(scaled) && fabs(scaled) < 9007199254740992.0) {
+        const double rounded = floor(scaled + 0.5);
+        if (rounded / powers_of_ten[decimals] == value) {
+            size_t n = 0;
+            uint64_t integer = (uint64_t)(rounded < 0 ? -rounded : rounded);
+            if (rounded < 0) out[n++] = '-';
+            // strip trailing zeros of the fraction
+            while (decimals > 0 && integer % 10 == 0) { integer /= 10; --decimals; }
+            char digits[24];
+            size_t num_digits = formatUnsigned(digits, integer);
+            if (decimals == 0) {
+                memcpy(out + n, digits, num_digits);
+                return n + num_digits;
+            }
+            if (num_digits <= decimals) {
+                out[n++] = '0';
+                out[n++] = '.';
+                for (size_t i = num_digits; i < decimals; ++i) out[n++] = '0';
+                memcpy(out + n, digits, num_digits);
+                return n + num_digits;
+            }
+            memcpy(out + n, digits, num_digits - decimals);
+            n += num_digits - decimals;
+            out[n++] = '.';
+            memcpy(out + n, digits + num_digits - decimals, decimals);
+            return n + decimals;
+        }
+    }
+    if (std::isfinite(value) == false) {
+        return 0;
+    }
+    // try 15 and 16 significant digits first, as they are sufficient for most values to round-trip
+    int n = snprintf(out, 32, "%.15g", value);
+    if (n > 0 && strtod(out, NULL) == value) {
+        return (size_t)n;
+    }
+    n = snprintf(out, 32, "%.16g", value);
+    if (n > 0 && strtod(out, NULL) == value) {
+        return (size_t)n;
+    }
+    n = snprintf(out, 32, "%.17g", value);
+    return (n > 0 ? (size_t)n : 0);
+}
+
+
+/**
+ * Get the precomputed line prefix for the given device and measurement; it is created on first use.
+ */
+const std::string& LineProtocolEncoder::getPrefix(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire) {
+    const uint64_t key = ((uint64_t)device.deviceAddress.serialNumber << 32) | ((uint64_t)type.quantity << 24) |
+                         ((uint64_t)type.type << 16) | ((uint64_t)type.direction << 8) | (uint64_t)wire;
+    // the key does not cover the susy id and device class; a cached prefix is only valid if they are unchanged
+    Prefix& entry = prefixes[key];
+    if (entry.line.length() > 0 && entry.susyID == device.deviceAddress.susyID && entry.deviceClass == device.deviceClass) {
+        return entry.line;
+    }
+    char number[24];
+    std::string prefix(measurementName);
+    if (device.deviceClass.length() > 0) {
+        prefix.append(",class=");
+        appendEscaped(prefix, device.deviceClass, false);
+    }
+    prefix.append(",serial=");
+    prefix.append(number, formatUnsigned(number, device.deviceAddress.serialNumber));
+    prefix.append(",susyid=");
+    prefix.append(number, formatUnsigned(number, device.deviceAddress.susyID));
+    prefix.push_back(' ');
+    appendEscaped(prefix, type.getFullName(wire), false);
+    prefix.push_back('=');
+    entry.susyID = device.deviceAddress.susyID;
+    entry.deviceClass = device.deviceClass;
+    entry.line = prefix;
+    return entry.line;
+}
+
+
+/**
+ * Encode the given value as a single line and append it to the buffer. Non-finite values are skipped.
+ * @param device The device generating the data
+ * @param type The measurement type of the given data
+ * @param wire The Wire enumeration value
+ * @param value The data value itself
+ * @param time_in_ms The measurement timestamp in ms since unix epoch start; 0 omits the timestamp
+ */
+void LineProtocolEncoder::encode(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value, const uint64_t time_in_ms) {
+    if (std::isfinite(value) == false) {
+        return;     // nan and inf cannot be represented in line protocol; skip the line
+    }
+    const std::string& prefix = getPrefix(device, type, wire);
+    char tail[64];
+    size_t n = formatDouble(tail, value, type.divisor);
+    if (time_in_ms != 0) {
+        tail[n++] = ' ';
+        n += formatUnsigned(tail + n, time_in_ms);
+    }
+    tail[n++] = '\n';
+    if (length + prefix.length() + n > buffer.size()) {
+        buffer.resize(2 * (length + prefix.length() + n));
+    }
+    memcpy(buffer.data() + length, prefix.data(), prefix.length());
+    length += prefix.length();
+    memcpy(buffer.data() + length, tail, n);
+    length += n;
+}
+
+
+/**
+ * Constructor of the LineProtocolProducer instance.
+ * @param _writer Reference to the writer receiving the encoded lines.
+ * @param measurement_name The line protocol measurement name.
+ * @param max_buffer_size Buffer size above which the encoded lines are written without waiting for flush().
+ */
+LineProtocolProducer::LineProtocolProducer(LineProtocolWriter& _writer, const std::string& measurement_name, const size_t max_buffer_size) :
+    writer(_writer),
+    encoder(measurement_name, max_buffer_size + 1024),
+    maxBufferSize(max_buffer_size),
+    currentTime(0) {}
+
+
+/**
+ * Destructor.
+ */
+LineProtocolProducer::~LineProtocolProducer(void) {}
+
+
+/**
+ * Write all lines encoded since the previous flush to the writer.
+ */
+void LineProtocolProducer::flush(void) {
+    if (encoder.size() > 0) {
+        writer.write(encoder.data(), encoder.size());
+        encoder.clear();
+    }
+    currentTime = 0;
+}
+
+
+/**
+ * Encode the given value into line protocol.
+ * @param device The device generating the data
+ * @param type The measurement type of the given data
+ * @param wire The Wire enumeration value
+ * @param value The data value itself
+ * @param time_in_ms The measurement timestamp as lower 32 bits of ms since unix epoch start
+ */
+void LineProtocolProducer::produce(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value, const uint32_t time_in_ms) {
+    if (currentTime == 0) {
+        currentTime = LocalHost::getUnixEpochTimeInMs();
+    }
+    const uint64_t time = (time_in_ms != 0 ? SpeedwireTime::expandTimeTo64(time_in_ms, currentTime) : currentTime);
+    encoder.encode(device, type, wire, value, time);
+    if (encoder.size() >= maxBufferSize) {
+        writer.write(encoder.data(), encoder.size());
+        encoder.clear();
+    }
+}
@@ -0,0 +1,190 @@
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include <errno.h>
+#include <string.h>
+#include <MappedFile.hpp>
+#include <Logger.hpp>
+using namespace libspeedwire;
+
+static Logger logger("MappedFile");
+
+
+/**
+ * Constructor.
+ */
+#ifdef _WIN32
+MappedFile::MappedFile(void) : address(nullptr), length(0), writable(false), file(INVALID_HANDLE_VALUE), mapping(NULL) {}
+#else
+MappedFile::MappedFile(void) : address(nullptr), length(0), writable(false), fd(-1) {}
+#endif
+
+
+/**
+ * Destructor; the file is unmapped and closed.
+ */
+MappedFile::~MappedFile(void) {
+    close();
+}
+
+
+/**
+ * Create a new file of the given size and map it for reading and writing. The file must not exist.
+ * @param file_path The file path.
+ * @param size The file size in bytes; the file is preallocated to this size.
+ * @return true on success, false otherwise.
+ */
+bool MappedFile::create(const std::string& file_path, const size_t size) {
+    close();
+    path = file_path;
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        logger.print(LogLevel::LOG_ERROR, "cannot create file %s (error %lu)", path.c_str(), (unsigned long)GetLastError());
+        return false;
+    }
+    mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, NULL);
+    if (mapping == NULL) {
+        logger.print(LogLevel::LOG_ERROR, "cannot create mapping for file %s (error %lu)", path.c_str(), (unsigned long)GetLastError());
+        close();
+        return false;
+    }
+    address = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+#else
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        logger.print(LogLevel::LOG_ERROR, "cannot create file %s (%s)", path.c_str(), strerror(errno));
+        return false;
+    }
+#if defined(__linux__)
+    const int result = posix_fallocate(fd, 0, (off_t)size);
+#else
+    const int result = (ftruncate(fd, (off_t)size) == 0 ? 0 : errno);
+#endif
+    if (result != 0) {
+        logger.print(LogLevel::LOG_ERROR, "cannot preallocate %lu bytes for file %s (%s)", (unsigned long)size, path.c_str(), strerror(result));
+        close();
+        ::unlink(path.c_str());
+        return false;
+    }
+    void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    address = (ptr != MAP_FAILED ? (uint8_t*)ptr : nullptr);
+#endif
+    if (address == nullptr) {
+        logger.print(LogLevel::LOG_ERROR, "cannot map file %s", path.c_str());
+        close();
+        return false;
+    }
+    length = size;
+    writable = true;
+    return true;
+}
+
+
+/**
+ * Map an existing file read-only.
+ * @param file_path The file path.
+ * @return true on success, false otherwise.
+ */
+bool MappedFile::open(const std::string& file_path) {
+    close();
+    path = file_path;
+    size_t size = 0;
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    LARGE_INTEGER file_size;
+    if (file == INVALID_HANDLE_VALUE || GetFileSizeEx(file, &file_size) == 0) {
+        logger.print(LogLevel::LOG_ERROR, "cannot open file %s", path.c_str());
+        close();
+        return false;
+    }
+    size = (size_t)file_size.QuadPart;
+    if (size > 0) {
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        address = (mapping != NULL ? (uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size) : nullptr);
+    }
+#else
+    struct stat st;
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        logger.print(LogLevel::LOG_ERROR, "cannot open file %s (%s)", path.c_str(), strerror(errno));
+        close();
+        return false;
+    }
+    size = (size_t)st.st_size;
+    if (size > 0) {
+        void* ptr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+        address = (ptr != MAP_FAILED ? (uint8_t*)ptr : nullptr);
+    }
+#endif
+    if (address == nullptr) {
+        logger.print(LogLevel::LOG_ERROR, "cannot map file %s", path.c_str());
+        close();
+        return false;
+    }
+    length = size;
+    writable = false;
+    return true;
+}
+
+
+/**
+ * Write modified pages in the given range back to the file.
+ * @param offset Start offset of the range in bytes.
+ * @param size Size of the range in bytes.
+ * @param blocking If true, wait until the data has been written to the storage device.
+ * @return true on success, false otherwise.
+ */
+bool MappedFile::sync(const size_t offset, const size_t size, const bool blocking) {
+    if (address == nullptr || writable == false || offset >= length) {
+        return false;
+    }
+    const size_t end = (offset + size < length ? offset + size : length);
+#ifdef _WIN32
+    if (FlushViewOfFile(address + offset, end - offset) == 0) {
+        return false;
+    }
+    return (blocking == false || FlushFileBuffers(file) != 0);
+#else
+    // msync requires a page aligned start address
+    const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t start = offset - (offset % page_size);
+    return (msync(address + start, end - start, (blocking ? MS_SYNC : MS_ASYNC)) == 0);
+#endif
+}
+
+
+/**
+ * Unmap and close the file.
+ */
+void MappedFile::close(void) {
+#ifdef _WIN32
+    if (address != nullptr) {
+        UnmapViewOfFile(address);
+    }
+    if (mapping != NULL) {
+        CloseHandle(mapping);
+        mapping = NULL;
+    }
+    if (file != INVALID_HANDLE_VALUE) {
+        CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (address != nullptr) {
+        munmap(address, length);
+    }
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+#endif
+    address = nullptr;
+    length = 0;
+    writable = false;
+}
@@ -0,0 +1,191 @@
+#include <RollupProcessor.hpp>
+#include <SpeedwireTime.hpp>
+using namespace libspeedwire;
+
+
+/**
+ * Default constructor of the RollupProcessor instance.
+ * Rollups are kept for 1 s (1 hour history), 1 min (1 day history), 15 min (1 week history) and 1 h (31 days history).
+ */
+RollupProcessor::RollupProcessor(void) {
+    resolutionsInMs.push_back(1000);    capacities.push_back(3600);
+    resolutionsInMs.push_back(60000);   capacities.push_back(1440);
+    resolutionsInMs.push_back(900000);  capacities.push_back(672);
+    resolutionsInMs.push_back(3600000); capacities.push_back(744);
+}
+
+
+/**
+ * Constructor of the RollupProcessor instance.
+ * @param resolutions_in_ms Bucket lengths in milliseconds, from finest to coarsest; each should be a multiple of the previous one.
+ * @param bucket_capacities Maximum number of closed buckets kept for each resolution.
+ */
+RollupProcessor::RollupProcessor(const std::vector<unsigned long>& resolutions_in_ms, const std::vector<size_t>& bucket_capacities) :
+    resolutionsInMs(resolutions_in_ms),
+    capacities(bucket_capacities) {
+    capacities.resize(resolutionsInMs.size(), 1);
+}
+
+
+/**
+ * Destructor.
+ */
+RollupProcessor::~RollupProcessor(void) {}
+
+
+/**
+ * Find or create the rollup state for the given device and measurement.
+ * @param serial_number The serial number of the device.
+ * @param key The measurement key, unique for the given device.
+ * @param time_scale Number of milliseconds per timestamp unit; 1 for emeter data, 1000 for inverter data.
+ * @param measurement The measurement.
+ * @return Reference to the rollup state.
+ */
+RollupProcessor::RollupState& RollupProcessor::findOrCreateState(const uint32_t serial_number, const uint32_t key, const unsigned long time_scale, const Measurement& measurement) {
+    const uint64_t state_key = ((uint64_t)serial_number << 32) | key;
+    std::map<uint64_t, RollupState>::iterator it = states.find(state_key);
+    if (it != states.end()) {
+        return it->second;
+    }
+    RollupState& state = states[state_key];
+    state.isCounter = (isInstantaneous(measurement.measurementType.quantity) == false);
+
+    // size the levels in place; ring buffers must not be copied once their capacity is set
+    state.levels.resize(resolutionsInMs.size());
+    for (size_t i = 0; i < resolutionsInMs.size(); ++i) {
+        RollupLevel& level = state.levels[i];
+        level.resolution = (uint32_t)(resolutionsInMs[i] / time_scale);
+        if (level.resolution == 0) level.resolution = 1;
+        level.buckets.setMaximumNumberOfElements(capacities[i] > 0 ? capacities[i] : 1);
+    }
+    return state;
+}
+
+
+/**
+ * Internal implementation to add the newest value of the given measurement to the finest rollup level.
+ * @param serial_number The serial number of the device.
+ * @param key The measurement key, unique for the given device.
+ * @param time_scale Number of milliseconds per timestamp unit; 1 for emeter data, 1000 for inverter data.
+ * @param measurement The measurement holding the new value.
+ */
+void RollupProcessor::process(const uint32_t serial_number, const uint32_t key, const unsigned long time_scale, const Measurement& measurement) {
+    if (resolutionsInMs.size() == 0 || measurement.measurementValues.getNumberOfElements() == 0) {
+        return;
+    }
+    RollupState& state = findOrCreateState(serial_number, key, time_scale, measurement);
+    const TimestampDoublePair& newest = measurement.measurementValues.getNewestElement();
+
+    // convert energy counters into deltas; a decreasing counter is treated as a counter reset
+    double value = newest.value;
+    if (state.isCounter == true) {
+        double delta = (state.previousCounterIsValid == true && value >= state.previousCounter ? value - state.previousCounter : 0.0);
+        state.previousCounter = value;
+        state.previousCounterIsValid = true;
+        value = delta;
+    }
+
+    // a raw value is a bucket of zero length
+    RollupBucket sample;
+    sample.startTime = newest.time;
+    sample.isDelta = state.isCounter;
+    sample.aggregate.add(value, newest.time);
+    mergeIntoLevel(state, 0, sample);
+}
+
+
+/**
+ * Merge the given bucket into the open bucket of the given level. If the bucket starts beyond the open bucket,
+ * the open bucket is closed, appended to the level history and merged into the next coarser level.
+ * @param state The rollup state.
+ * @param level_index The index of the level.
+ * @param bucket The bucket to merge.
+ */
+void RollupProcessor::mergeIntoLevel(RollupState& state, const size_t level_index, const RollupBucket& bucket) {
+    if (level_index >= state.levels.size()) {
+        return;
+    }
+    RollupLevel& level = state.levels[level_index];
+
+    if (level.openIsValid == true && SpeedwireTime::calculateTimeDifference(bucket.startTime, level.open.startTime) >= (int32_t)level.resolution) {
+        level.buckets.addNewElement(level.open);
+        level.openIsValid = false;
+        mergeIntoLevel(state, level_index + 1, level.buckets.getNewestElement());
+    }
+    if (level.openIsValid == false) {
+        level.open.startTime = bucket.startTime - (bucket.startTime % level.resolution);
+        level.open.isDelta = bucket.isDelta;
+        level.open.aggregate.clear();
+        level.openIsValid = true;
+    }
+    level.open.aggregate.merge(bucket.aggregate);
+}
+
+
+/**
+ * Get the rollup history of the given device and measurement at the given resolution.
+ * @param serial_number The serial number of the device.
+ * @param key The measurement key, i.e. ObisType::toKey() or SpeedwireRawData::toKey().
+ * @param resolution_in_ms The resolution in milliseconds; it must be one of the configured resolutions.
+ * @param buckets Output vector receiving the buckets, oldest first.
+ * @param include_open_bucket If true, the currently open and thus incomplete bucket is appended.
+ * @return The number of buckets appended to the output vector.
+ */
+size_t RollupProcessor::getRollups(const uint32_t serial_number, const uint32_t key, const unsigned long resolution_in_ms, std::vector<RollupBucket>& buckets, const bool include_open_bucket) const {
+    const uint64_t state_key = ((uint64_t)serial_number << 32) | key;
+    std::map<uint64_t, RollupState>::const_iterator it = states.find(state_key);
+    if (it == states.end()) {
+        return 0;
+    }
+    for (size_t i = 0; i < resolutionsInMs.size() && i < it->second.levels.size(); ++i) {
+        if (resolutionsInMs[i] == resolution_in_ms) {
+            const RollupLevel& level = it->second.levels[i];
+            const size_t n = level.buckets.getNumberOfElements();
+            for (size_t j = 0; j < n; ++j) {
+                buckets.push_back(level.buckets.at(j));
+            }
+            if (include_open_bucket == true && level.openIsValid == true) {
+                buckets.push_back(level.open);
+                return n + 1;
+            }
+            return n;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * Get the rollup history of the given emeter device and obis measurement at the given resolution.
+ */
+size_t RollupProcessor::getRollups(const SpeedwireDevice& device, const ObisType& type, const unsigned long resolution_in_ms, std::vector<RollupBucket>& buckets, const bool include_open_bucket) const {
+    return getRollups(device.deviceAddress.serialNumber, type.toKey(), resolution_in_ms, buckets, include_open_bucket);
+}
+
+
+/**
+ * Get the rollup history of the given inverter device and speedwire measurement at the given resolution.
+ */
+size_t RollupProcessor::getRollups(const SpeedwireDevice& device, const SpeedwireRawData& data, const unsigned long resolution_in_ms, std::vector<RollupBucket>& buckets, const bool include_open_bucket) const {
+    return getRollups(device.deviceAddress.serialNumber, data.toKey(), resolution_in_ms, buckets, include_open_bucket);
+}
+
+
+/**
+ * Callback to consume the given obis data element.
+ * @param device The originating emeter device.
+ * @param element A reference to an ObisData instance, holding output data of the ObisFilter.
+ */
+void RollupProcessor::consume(const SpeedwireDevice& device, ObisData& element) {
+    process(device.deviceAddress.serialNumber, element.toKey(), 1, element);
+}
+
+
+/**
+ * Callback to consume the given inverter reply data element.
+ * @param device The originating inverter device.
+ * @param element A reference to a SpeedwireData instance.
+ */
+void RollupProcessor::consume(const SpeedwireDevice& device, SpeedwireData& element) {
+    process(device.deviceAddress.serialNumber, element.toKey(), 1000, element);
+}
@@ -0,0 +1,366 @@
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include <errno.h>
+#include <string.h>
+#include <new>
+#include <SharedValueTable.hpp>
+#include <ArchiveProducer.hpp>
+#include <LocalHost.hpp>
+#include <SpeedwireTime.hpp>
+#include <Logger.hpp>
+using namespace libspeedwire;
+
+static Logger logger("SharedValueTable");
+
+static const char     table_magic[8] = { 'S', 'W', 'L', 'I', 'V', 'E', 'V', '1' };
+static const unsigned max_read_retries = 64;
+
+
+// get the platform specific name of the shared memory object
+static std::string getObjectName(const std::string& name) {
+#ifdef _WIN32
+    return "Local\\" + name;
+#else
+    return (name.length() > 0 && name[0] == '/' ? name : "/" + name);
+#endif
+}
+
+// get the first slot index to probe for the given key
+static size_t getHashIndex(const uint64_t key, const size_t capacity) {
+    uint64_t h = key * 0x9E3779B97F4A7C15ull;
+    return (size_t)(h >> 32) & (capacity - 1);
+}
+
+// reinterpret the bit patterns of double values
+static uint64_t toBits(const double value) { uint64_t bits; memcpy(&bits, &value, sizeof(bits)); return bits; }
+static double fromBits(const uint64_t bits) { double value; memcpy(&value, &bits, sizeof(value)); return value; }
+
+
+/**
+ * Constructor of the SharedValuePublisher instance; the shared memory table is created and initialized.
+ * An existing table of the same name is replaced.
+ * @param _name The shared memory object name.
+ * @param capacity Number of slots; it is rounded up to the next power of 2 and should be well above the number of measurements.
+ * @param remove_on_close If true, the shared memory object is removed in the destructor.
+ */
+SharedValuePublisher::SharedValuePublisher(const std::string& _name, const size_t capacity, const bool remove_on_close) :
+    name(getObjectName(_name)),
+    removeOnClose(remove_on_close),
+    size(0),
+    header(nullptr),
+    slots(nullptr),
+    currentTime(0),
+    droppedCount(0) {
+    size_t num_slots = 2;
+    while (num_slots < capacity) num_slots <<= 1;
+    const size_t table_size = sizeof(SharedValueTableHeader) + num_slots * sizeof(SharedValueSlot);
+    void* address = nullptr;
+
+#ifdef _WIN32
+    mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)table_size >> 32), (DWORD)table_size, name.c_str());
+    if (mapping == NULL) {
+        logger.print(LogLevel::LOG_ERROR, "cannot create shared memory %s (error %lu)", name.c_str(), (unsigned long)GetLastError());
+        return;
+    }
+    address = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, table_size);
+#else
+    shm_unlink(name.c_str());
+    const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        logger.print(LogLevel::LOG_ERROR, "cannot create shared memory %s (%s)", name.c_str(), strerror(errno));
+        return;
+    }
+    if (ftruncate(fd, (off_t)table_size) == 0) {
+        address = mmap(NULL, table_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED) address = nullptr;
+    }
+    ::close(fd);
+#endif
+    if (address == nullptr) {
+        logger.print(LogLevel::LOG_ERROR, "cannot map shared memory %s", name.c_str());
+        return;
+    }
+    size = table_size;
+
+    // the memory is zero-initialized; construct the atomics in place and write the magic last
+    header = new (address) SharedValueTableHeader();
+    header->capacity = (uint32_t)num_slots;
+    header->slotSize = (uint32_t)sizeof(SharedValueSlot);
+    header->usedSlots.store(0);
+    header->updateCount.store(0);
+    slots = new ((uint8_t*)address + sizeof(SharedValueTableHeader)) SharedValueSlot[num_slots]();
+    for (size_t i = 0; i < num_slots; ++i) {
+        slots[i].sequence.store(0, std::memory_order_relaxed);
+        slots[i].key.store(0, std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic, table_magic, sizeof(table_magic));
+}
+
+
+/**
+ * Destructor; the table is unmapped and optionally removed.
+ */
+SharedValuePublisher::~SharedValuePublisher(void) {
+    if (header != nullptr) {
+#ifdef _WIN32
+        UnmapViewOfFile(header);
+#else
+        munmap(header, size);
+        if (removeOnClose) {
+            shm_unlink(name.c_str());
+        }
+#endif
+    }
+#ifdef _WIN32
+    if (mapping != NULL) {
+        CloseHandle(mapping);
+    }
+#endif
+}
+
+
+/**
+ * Write the given value into the slot of the given device and measurement.
+ * @param serial The device serial number.
+ * @param susy_id The device susy id.
+ * @param measurement_id The measurement id, see ArchiveProducer::getMeasurementId().
+ * @param value The value.
+ * @param time The measurement time in ms since unix epoch.
+ * @return true on success, false if the table is full or not open.
+ */
+bool SharedValuePublisher::publish(const uint32_t serial, const uint32_t susy_id, const uint32_t measurement_id, const double value, const uint64_t time) {
+    if (header == nullptr) {
+        return false;
+    }
+    const uint64_t key = ((uint64_t)serial << 32) | measurement_id;
+    const size_t capacity = header->capacity;
+    size_t index = getHashIndex(key, capacity);
+    for (size_t probe = 0; probe < capacity; ++probe, index = (index + 1) & (capacity - 1)) {
+        SharedValueSlot& slot = slots[index];
+        // this is the only writer, hence relaxed loads of its own stores are sufficient
+        const uint32_t seq = slot.sequence.load(std::memory_order_relaxed);
+        if (seq != 0 && slot.key.load(std::memory_order_relaxed) != key) {
+            continue;
+        }
+        slot.sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.key.store(key, std::memory_order_relaxed);
+        slot.susyID.store(susy_id, std::memory_order_relaxed);
+        slot.value.store(toBits(value), std::memory_order_relaxed);
+        slot.time.store(time, std::memory_order_relaxed);
+        slot.sequence.store(seq + 2, std::memory_order_release);
+        if (seq == 0) {
+            header->usedSlots.fetch_add(1, std::memory_order_relaxed);
+        }
+        return true;
+    }
+    ++droppedCount;
+    return false;
+}
+
+
+/**
+ * Increment the update counter of the table, such that readers can detect new data.
+ */
+void SharedValuePublisher::flush(void) {
+    if (header != nullptr) {
+        header->updateCount.fetch_add(1, std::memory_order_release);
+    }
+    currentTime = 0;
+}
+
+
+/**
+ * Publish the given value.
+ * @param device The device generating the data
+ * @param type The measurement type of the given data
+ * @param wire The Wire enumeration value
+ * @param value The data value itself
+ * @param time_in_ms The measurement timestamp as lower 32 bits of ms since unix epoch start
+ */
+void SharedValuePublisher::produce(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value, const uint32_t time_in_ms) {
+    if (currentTime == 0) {
+        currentTime = LocalHost::getUnixEpochTimeInMs();
+    }
+    const uint64_t time = (time_in_ms != 0 ? SpeedwireTime::expandTimeTo64(time_in_ms, currentTime) : currentTime);
+    publish(device.deviceAddress.serialNumber, device.deviceAddress.susyID, ArchiveProducer::getMeasurementId(type, wire), value, time);
+}
+
+
+/**
+ * Constructor of the SharedValueReader instance.
+ */
+#ifdef _WIN32
+SharedValueReader::SharedValueReader(void) : size(0), header(nullptr), slots(nullptr), mapping(NULL) {}
+#else
+SharedValueReader::SharedValueReader(void) : size(0), header(nullptr), slots(nullptr) {}
+#endif
+
+
+/**
+ * Destructor.
+ */
+SharedValueReader::~SharedValueReader(void) {
+    close();
+}
+
+
+/**
+ * Map the shared value table of the given name read-only.
+ * @param name The shared memory object name, as given to the publisher.
+ * @return true on success, false if the table does not exist or is not initialized yet.
+ */
+bool SharedValueReader::open(const std::string& name) {
+    close();
+    const std::string object_name = getObjectName(name);
+    void* address = nullptr;
+    size_t table_size = 0;
+#ifdef _WIN32
+    mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, object_name.c_str());
+    if (mapping == NULL) {
+        return false;
+    }
+    address = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION info;
+    if (address != nullptr && VirtualQuery(address, &info, sizeof(info)) != 0) {
+        table_size = (size_t)info.RegionSize;
+    }
+#else
+    const int fd = shm_open(object_name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        table_size = (size_t)st.st_size;
+        address = mmap(NULL, table_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED) address = nullptr;
+    }
+    ::close(fd);
+#endif
+    if (address == nullptr) {
+        close();
+        return false;
+    }
+    size = table_size;
+    header = (const SharedValueTableHeader*)address;
+    if (size < sizeof(SharedValueTableHeader) || memcmp(header->magic, table_magic, sizeof(table_magic)) != 0 ||
+        header->slotSize != sizeof(SharedValueSlot) || (header->capacity & (header->capacity - 1)) != 0 ||
+        sizeof(SharedValueTableHeader) + (size_t)header->capacity * sizeof(SharedValueSlot) > size) {
+        logger.print(LogLevel::LOG_WARNING, "invalid or uninitialized shared memory %s", object_name.c_str());
+        close();
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    slots = (const SharedValueSlot*)((const uint8_t*)address + sizeof(SharedValueTableHeader));
+    return true;
+}
+
+
+/**
+ * Unmap the shared value table.
+ */
+void SharedValueReader::close(void) {
+#ifdef _WIN32
+    if (header != nullptr) {
+        UnmapViewOfFile(header);
+    }
+    if (mapping != NULL) {
+        CloseHandle(mapping);
+        mapping = NULL;
+    }
+#else
+    if (header != nullptr) {
+        munmap((void*)header, size);
+    }
+#endif
+    header = nullptr;
+    slots = nullptr;
+    size = 0;
+}
+
+
+/**
+ * Read a consistent copy of the given slot.
+ * @param slot The slot.
+ * @param value The copy of the slot content.
+ * @param sequence The sequence number of the copy; it is 0 if the slot has never been used.
+ * @return true on success, false if the slot has been updated concurrently too many times.
+ */
+bool SharedValueReader::readSlot(const SharedValueSlot& slot, SharedValue& value, uint32_t& sequence) const {
+    for (unsigned retry = 0; retry < max_read_retries; ++retry) {
+        const uint32_t seq1 = slot.sequence.load(std::memory_order_acquire);
+        if ((seq1 & 1) != 0) {
+            continue;
+        }
+        const uint64_t key = slot.key.load(std::memory_order_relaxed);
+        value.susyID = slot.susyID.load(std::memory_order_relaxed);
+        value.value = fromBits(slot.value.load(std::memory_order_relaxed));
+        value.time = slot.time.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == seq1) {
+            value.serialNumber = (uint32_t)(key >> 32);
+            value.measurementId = (uint32_t)key;
+            sequence = seq1;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/**
+ * Read the latest value of the given device and measurement.
+ * @param serial The device serial number.
+ * @param measurement_id The measurement id, see ArchiveProducer::getMeasurementId().
+ * @param value The latest value.
+ * @return true on success, false if there is no such value.
+ */
+bool SharedValueReader::read(const uint32_t serial, const uint32_t measurement_id, SharedValue& value) const {
+    if (header == nullptr) {
+        return false;
+    }
+    const uint64_t key = ((uint64_t)serial << 32) | measurement_id;
+    const size_t capacity = header->capacity;
+    size_t index = getHashIndex(key, capacity);
+    for (size_t probe = 0; probe < capacity; ++probe, index = (index + 1) & (capacity - 1)) {
+        uint32_t sequence;
+        if (readSlot(slots[index], value, sequence) == false) {
+            return false;
+        }
+        if (sequence == 0) {
+            return false;
+        }
+        if (value.serialNumber == serial && value.measurementId == measurement_id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/**
+ * Get a copy of all values in the table; each value is consistent in itself.
+ * @param values The vector receiving the values; its previous content is replaced.
+ * @return The number of values.
+ */
+size_t SharedValueReader::snapshot(std::vector<SharedValue>& values) const {
+    values.clear();
+    if (header != nullptr) {
+        for (size_t i = 0; i < header->capacity; ++i) {
+            SharedValue value;
+            uint32_t sequence;
+            if (readSlot(slots[i], value, sequence) == true && sequence != 0) {
+                values.push_back(value);
+            }
+        }
+    }
+    return values.size();
+}
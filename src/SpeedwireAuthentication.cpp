@@ -27,7 +27,7 @@ bool SpeedwireAuthentication::login(const Credentials& credentials, const int ti
         result &= login(entry.first, broadcast_address, local_address, credentials, timeout_in_ms);
     }
     for (const auto& device : devices) {
-        if (!AddressConversion::resideOnSameSubnet(device.deviceIpAddress, device.interfaceIpAddress, 24) && device.interfaceIpAddress.length() > 0) { // FIXME: hard coded prefix
+        if (!AddressConversion::resideOnSameSubnet(device.deviceIpAddress, device.interfaceIpAddress, 24) && device.interfaceIpAddress.isValid()) { // FIXME: hard coded prefix
             result &= login(device.interfaceIpAddress, device.deviceAddress, local_address, credentials, timeout_in_ms);
         }
     }
@@ -58,17 +58,16 @@ bool SpeedwireAuthentication::login(const SpeedwireDevice& dst_peer, const Crede
 /**
  *  synchronous login method - send inverter login command to the given peer, wait for the response and check for error codes
  */
-bool SpeedwireAuthentication::login(const std::string& if_address, const SpeedwireAddress& dst, const SpeedwireAddress& src, const Credentials& credentials, const int timeout_in_ms) {
+bool SpeedwireAuthentication::login(const IpAddress& if_address, const SpeedwireAddress& dst, const SpeedwireAddress& src, const Credentials& credentials, const int timeout_in_ms) {
     logger.print(LogLevel::LOG_INFO_0, "login susyid %u serial %lu => susyid %u serial %lu time 0x%016llx",
         src.susyID, src.serialNumber, dst.susyID, dst.serialNumber, localhost.getUnixEpochTimeInMs());
 
     // determine receive socket
-    SocketIndex socket_index = socket_map[if_address];
+    SocketIndex socket_index = getSocketIndex(if_address);
     if (socket_index < 0) {
         logger.print(LogLevel::LOG_ERROR, "invalid socket_index");
         return false;
     }
-    SpeedwireSocket& socket = sockets[socket_index];
 
     // send login request to peer
     SpeedwireCommandTokenIndex token_index = sendLoginRequest(if_address, dst, src, credentials);
@@ -78,7 +77,7 @@ bool SpeedwireAuthentication::login(const std::string& if_address, const Speedwi
 
     // wait for the response
     unsigned char response_buffer[2048];
-    int32_t nbytes = receiveResponse(token_index, socket, response_buffer, sizeof(response_buffer), timeout_in_ms);
+    int32_t nbytes = receiveResponse(token_index, response_buffer, sizeof(response_buffer), timeout_in_ms);
     if (nbytes <= 0) {
         return false;
     }
@@ -116,6 +115,14 @@ bool SpeedwireAuthentication::login(const std::string& if_address, const Speedwi
         }
     }
     token_repository.remove(token_index);
+
+    // a successful login starts a new session; requests of the new session use a separate packet id range
+    if (dst.isBroadcast()) {
+        packet_ids.beginSession();
+    }
+    else {
+        packet_ids.beginSession(dst.susyID, dst.serialNumber);
+    }
     return true;
 }
 
@@ -131,7 +138,7 @@ bool SpeedwireAuthentication::logoff(void) {
         result &= logoff(entry.first, broadcast_address, local_address);
     }
     for (const auto& device : devices) {
-        if (!AddressConversion::resideOnSameSubnet(device.deviceIpAddress, device.interfaceIpAddress, 24) && device.interfaceIpAddress.length() > 0) { // FIXME: hard coded prefix
+        if (!AddressConversion::resideOnSameSubnet(device.deviceIpAddress, device.interfaceIpAddress, 24) && device.interfaceIpAddress.isValid()) { // FIXME: hard coded prefix
             result &= logoff(device.interfaceIpAddress, device.deviceAddress, local_address);
         }
     }
@@ -162,7 +169,7 @@ bool SpeedwireAuthentication::logoff(const SpeedwireDevice& dst) {
 /**
  *  Logoff - send inverter logoff command to the given peer and return; there is no reply from the inverter for logoff commands
  */
-bool SpeedwireAuthentication::logoff(const std::string& if_address, const SpeedwireAddress& dst, const SpeedwireAddress& src) {
+bool SpeedwireAuthentication::logoff(const IpAddress& if_address, const SpeedwireAddress& dst, const SpeedwireAddress& src) {
     logger.print(LogLevel::LOG_INFO_0, "logoff susyid %u serial %lu => susyid %u serial %lu time 0x%016llx",
         src.susyID, src.serialNumber, dst.susyID, dst.serialNumber, localhost.getUnixEpochTimeInMs());
 
@@ -173,52 +180,33 @@ bool SpeedwireAuthentication::logoff(const std::string& if_address, const Speedw
 /**
  *  Send inverter login command to the given peer
  */
-SpeedwireCommandTokenIndex SpeedwireAuthentication::sendLoginRequest(const std::string& if_address, const SpeedwireAddress& dst, const SpeedwireAddress& src, const Credentials& credentials) {
+SpeedwireCommandTokenIndex SpeedwireAuthentication::sendLoginRequest(const IpAddress& if_address, const SpeedwireAddress& dst, const SpeedwireAddress& src, const Credentials& credentials) {
     // Request  534d4100000402a000000001003a0010 60650ea0 7a01842a71b30001 7d0042be283a0001 000000000280 0c04fdff 07000000 84030000 00d8e85f 00000000 c1c1c1c18888888888888888 00000000   => login command = 0xfffd040c, first = 0x00000007 (user 7, installer a), last = 0x00000384 (hier timeout), time = 0x5fdf9ae8, 0x00000000, pw 12 bytes
     // Response 534d4100000402a000000001002e0010 60650be0 7d0042be283a0001 7a01842a71b30001 000000000280 0d04fdff 07000000 84030000 00d8e85f 00000000 00000000 => login OK
     // Response 534d4100000402a000000001002e0010 60650be0 7d0042be283a0001 7a01842a71b30001 000100000280 0d04fdff 07000000 84030000 fddbe85f 00000000 00000000 => login INVALID PASSWORD
     // command  0xfffd040c => 0x400 set?  0x00c bytecount=12?
     // assemble unicast device login packet
-    unsigned char request_buffer[24 + 8 + 8 + 6 + 4 + 4 + 4 + 4 + 12 + 4];
-    memset(request_buffer, 0, sizeof(request_buffer));
-
-    SpeedwireHeader request_header(request_buffer, sizeof(request_buffer));
-    request_header.setDefaultHeader(1, sizeof(request_buffer) - 20, SpeedwireData2Packet::sma_inverter_protocol_id);   // 4 + 8 + 4 => es fehlen 4 byte an der Lnge, prfen of tagLength erst nach dem control word zhlt
-    //LocalHost::hexdump(request_buffer, sizeof(request_buffer));
-
-    SpeedwireData2Packet data2_packet(request_header);
-    data2_packet.setControl(0xa0);
-
-    const uint16_t packet_id = getIncrementedPacketID();
-
-    SpeedwireInverterProtocol request(request_header);
-    request.setDstSusyID(dst.susyID);
-    request.setDstSerialNumber(dst.serialNumber);
-    request.setDstControl(0x0100);
-    request.setSrcSusyID(src.susyID);
-    request.setSrcSerialNumber(src.serialNumber);
-    request.setSrcControl(0x0100);
-    request.setErrorCode(0);
-    request.setFragmentCounter(0);
-    request.setPacketID(packet_id);
-    request.setCommandID(Command::LOGIN);
-    request.setFirstRegisterID((uint32_t)credentials.getUserName());    // user: 0x7  installer: 0xa
-    request.setLastRegisterID(0x00000384);     // timeout
-    request.setDataUint32(0, SpeedwireTime::getInverterTimeNow());
-    request.setDataUint32(4, 0x00000000);
-    std::array<uint8_t, 12> encoded_password = credentials.getEncodedPassWord();
-    request.setDataUint8Array(8, encoded_password.data(), (unsigned long)encoded_password.size());
+    unsigned char request_buffer[SpeedwireRequestTemplates::login_request_size];
+    const uint16_t packet_id = packet_ids.allocate(dst.susyID, dst.serialNumber);
+    if (packet_id == 0) {
+        logger.print(LogLevel::LOG_ERROR, "too many outstanding requests");
+        return -1;
+    }
+    const std::array<uint8_t, 12> encoded_password = credentials.getEncodedPassWord();
+    request_templates.getLoginRequest(dst, src, (uint32_t)credentials.getUserName(), 0x00000384, encoded_password,   // user: 0x7  installer: 0xa, timeout
+                                      packet_id, SpeedwireTime::getInverterTimeNow(), request_buffer, sizeof(request_buffer));
 
     // identify the socket to be used
-    SocketIndex socket_index = socket_map[if_address];
+    SocketIndex socket_index = getSocketIndex(if_address);
     if (socket_index < 0) {
         logger.print(LogLevel::LOG_ERROR, "invalid socket_index");
+        packet_ids.release(dst.susyID, dst.serialNumber, packet_id);
         return -1;
     }
     SpeedwireSocket& socket = sockets[socket_index];
 
     // identify the destination ip address to be used
-    std::string dst_ip_address = AddressConversion::toString(socket.getSpeedwireMulticastIn4Address().sin_addr);
+    IpAddress dst_ip_address(socket.getSpeedwireMulticastIn4Address().sin_addr);
     if (dst.isBroadcast() == false) {
         for (const auto& device : devices) {
             if (device.deviceAddress == dst) {
@@ -227,16 +215,25 @@ SpeedwireCommandTokenIndex SpeedwireAuthentication::sendLoginRequest(const std::
         }
     }
 
+    // add a query token; this is used to match reply packets to this request packet. The reply is expected before
+    // the request is sent, as another thread polling the sockets may receive it right away
+    SpeedwireCommandTokenIndex index = token_repository.add(dst.susyID, dst.serialNumber, packet_id, dst_ip_address, Command::LOGIN);
+    if (index < 0) {
+        packet_ids.release(dst.susyID, dst.serialNumber, packet_id);
+        return -1;
+    }
+    const uint64_t key = SpeedwireCommandTokenRepository::getKey(dst.susyID, dst.serialNumber, packet_id);
+    demultiplexer.expect(key);
+
     // send login request packet to peer
     int nsent = socket.sendto(request_buffer, sizeof(request_buffer), dst_ip_address);
     if (nsent <= 0) {
         logger.print(LogLevel::LOG_ERROR, "cannot send data to socket");
+        demultiplexer.cancel(key);
+        token_repository.remove(index);     // releases the packet id
         return -1;
     }
 
-    // add a query token; this is used to match reply packets to this request packet
-    SpeedwireCommandTokenIndex index = token_repository.add(dst.susyID, dst.serialNumber, packet_id, dst_ip_address, Command::LOGIN);
-
     return index;
 }
 
@@ -244,7 +241,7 @@ SpeedwireCommandTokenIndex SpeedwireAuthentication::sendLoginRequest(const std::
 /**
  *  Send inverter logoff command to the given peer
  */
-bool SpeedwireAuthentication::sendLogoffRequest(const std::string& if_address, const SpeedwireAddress& dst, const SpeedwireAddress& src) {
+bool SpeedwireAuthentication::sendLogoffRequest(const IpAddress& if_address, const SpeedwireAddress& dst, const SpeedwireAddress& src) {
     // Request 534d4100000402a00000000100220010 606508a0 ffffffffffff0003 7d0052be283a0003 000000000280 0e01fdff ffffffff 00000000   => logoff command = 0xfffd01e0 (fehlt hier last?)
     // Request 534d4100000402a00000000100220010 606508a0 ffffffffffff0003 7d0042be283a0003 000000000180 e001fdff ffffffff 00000000
     // assemble unicast device logoff packet
@@ -282,7 +279,7 @@ bool SpeedwireAuthentication::sendLogoffRequest(const std::string& if_address, c
     SpeedwireSocket& socket = sockets[socket_index];
 
     // identify the destination ip address to be used
-    std::string dst_ip_address = AddressConversion::toString(socket.getSpeedwireMulticastIn4Address().sin_addr);
+    IpAddress dst_ip_address(socket.getSpeedwireMulticastIn4Address().sin_addr);
     if (dst.isBroadcast() == false) {
         for (const auto& device : devices) {
             if (device.deviceAddress == dst) {
@@ -22,22 +22,27 @@
 #include <SpeedwireSocket.hpp>
 #include <SpeedwireSocketFactory.hpp>
 #include <SpeedwireCommand.hpp>
+#include <SpeedwireResponseCache.hpp>
 using namespace libspeedwire;
 
 static Logger logger("SpeedwireCommand");
 
-uint16_t SpeedwireCommand::packet_id = 0x8001;
+std::atomic<uint16_t> SpeedwireCommand::packet_id(0x8001);
 
 
 SpeedwireCommand::SpeedwireCommand(const LocalHost &_localhost, const std::vector<SpeedwireDevice> &_devices) :
     localhost(_localhost),
-    devices(_devices) {
+    devices(_devices),
+    demultiplexer(sockets),
+    response_cache(nullptr) {
+    token_repository.setPacketIdAllocator(&packet_ids);
+
     // loop across all speedwire devices
     for (auto& device : devices) {
         // check if there is already a map entry for the interface ip address
-        if (socket_map.find(device.interfaceIpAddress) == socket_map.end() && device.interfaceIpAddress.length() > 0 && device.interfaceIpAddress != "0.0.0.0") {
+        if (socket_map.find(device.interfaceIpAddress) == socket_map.end() && device.interfaceIpAddress.isValid() && device.interfaceIpAddress.isAny() == false) {
             // create and open a socket for the interface
-            SpeedwireSocket socket = SpeedwireSocketFactory::getInstance(localhost)->getRecvSocket(SpeedwireSocketFactory::SocketType::UNICAST, device.interfaceIpAddress);
+            SpeedwireSocket socket = SpeedwireSocketFactory::getInstance(localhost)->getRecvSocket(SpeedwireSocketFactory::SocketType::UNICAST, device.interfaceIpAddress.toString());
             if (socket.getSocketFd() >= 0) {
                 // add it to the map
                 socket_map[device.interfaceIpAddress] = (SocketIndex)sockets.size();
@@ -59,16 +64,24 @@ SpeedwireCommand::~SpeedwireCommand(void) {
 /**
  *  synchronous query method - send inverter query command to the given peer, wait for the response and check for error codes
  *  this method cannot handle fragmented response packets
+ *  if a response cache is set, fresh cached replies are returned without sending a query
  */
 int32_t SpeedwireCommand::query(const SpeedwireDevice& peer, const Command command, const uint32_t first_register, const uint32_t last_register, void* udp_buffer, const size_t udp_buffer_size, const int timeout_in_ms) {
 
+    // serve the query from the response cache
+    if (response_cache != nullptr) {
+        int32_t nbytes = response_cache->get(peer, command, first_register, last_register, udp_buffer, udp_buffer_size, LocalHost::getUnixEpochTimeInMs());
+        if (nbytes > 0) {
+            return nbytes;
+        }
+    }
+
     // determine receive socket
-    SocketIndex socket_index = socket_map[peer.interfaceIpAddress];
+    SocketIndex socket_index = getSocketIndex(peer.interfaceIpAddress);
     if (socket_index < 0) {
         logger.print(LogLevel::LOG_ERROR, "invalid socket_index");
         return -1;
     }
-    SpeedwireSocket& socket = sockets[socket_index];
 
     // send query request to peer
     SpeedwireCommandTokenIndex token_index = sendQueryRequest(peer, command, first_register, last_register);
@@ -77,7 +90,7 @@ int32_t SpeedwireCommand::query(const SpeedwireDevice& peer, const Command comma
     }
 
     // wait for the response
-    int32_t nbytes = receiveResponse(token_index, socket, udp_buffer, udp_buffer_size, timeout_in_ms);
+    int32_t nbytes = receiveResponse(token_index, udp_buffer, udp_buffer_size, timeout_in_ms);
     if (nbytes <= 0) {
         return -1;
     }
@@ -98,6 +111,16 @@ int32_t SpeedwireCommand::query(const SpeedwireDevice& peer, const Command comma
         return -1;
     }
     token_repository.remove(token_index);
+
+    // update the response cache; status changes may invalidate cached replies
+    if (response_cache != nullptr) {
+        response_cache->put(peer, command, first_register, last_register, udp_buffer, nbytes, LocalHost::getUnixEpochTimeInMs());
+        if (command == Command::STATUS_QUERY) {
+            for (const auto& raw_data : inverter_packet.getRawDataElements()) {
+                response_cache->observe(peer, raw_data);
+            }
+        }
+    }
     return nbytes;
 }
 
@@ -140,54 +163,130 @@ SpeedwireCommandTokenIndex SpeedwireCommand::sendQueryRequest(const SpeedwireDev
     // Request  534d4100000402a00000000100260010 606509a0 7a01842a71b30001 7d0042be283a0001 000000000a80 00028051 00644100 ff644100 00000000 =>  query grid relay status
     // Response 534d4100000402a000000001004e0010 606513a0 7d0042be283a00a1 7a01842a71b30001 000000000a80 01028051 07000000 07000000 01644108 59c5e95f 33000001 37010000 fdffff00 feffff00 00000000 00000000 00000000 00000000 00000000
 
-    // assemble unicast device login packet                                                                                 
-    unsigned char request_buffer[24 + 8 + 8 + 6 + 4 + 4 + 4];
-    memset(request_buffer, 0, sizeof(request_buffer));
-
-    SpeedwireHeader request_header(request_buffer, sizeof(request_buffer));
-    request_header.setDefaultHeader(1, sizeof(request_buffer) - 20, SpeedwireData2Packet::sma_inverter_protocol_id);
-
-    SpeedwireData2Packet data2_packet(request_header);
-    data2_packet.setControl(0xa0);
+    // assemble unicast device query packet from its template
+    unsigned char request_buffer[SpeedwireRequestTemplates::query_request_size];
+    const uint16_t packet_id = packet_ids.allocate(peer.deviceAddress.susyID, peer.deviceAddress.serialNumber);
+    if (packet_id == 0) {
+        logger.print(LogLevel::LOG_ERROR, "too many outstanding requests");
+        return -1;
+    }
+    request_templates.getQueryRequest(peer.deviceAddress, SpeedwireAddress::getLocalAddress(), command, first_register, last_register, packet_id, request_buffer, sizeof(request_buffer));
     //LocalHost::hexdump(request_buffer, sizeof(request_buffer));
-
-    const uint16_t packet_id = getIncrementedPacketID();
-
-    SpeedwireInverterProtocol request(request_header);
-    request.setDstSusyID(peer.deviceAddress.susyID);
-    request.setDstSerialNumber(peer.deviceAddress.serialNumber);
-    request.setDstControl(0x0100);
-    request.setSrcSusyID(SpeedwireAddress::getLocalAddress().susyID);
-    request.setSrcSerialNumber(SpeedwireAddress::getLocalAddress().serialNumber);
-    request.setSrcControl(0x0100);
-    request.setErrorCode(0);
-    request.setFragmentCounter(0);
-    request.setPacketID(packet_id);
-    request.setCommandID(command);
-    request.setFirstRegisterID(first_register);
-    request.setLastRegisterID(last_register);
     //printf("query: command %08lx first 0x%08lx last 0x%08lx\n", command, first_register, last_register);
 
     // send query request packet to peer
-    SocketIndex socket_index = socket_map[peer.interfaceIpAddress];
+    SocketIndex socket_index = getSocketIndex(peer.interfaceIpAddress);
     if (socket_index < 0) {
         logger.print(LogLevel::LOG_ERROR, "invalid socket_index");
+        packet_ids.release(peer.deviceAddress.susyID, peer.deviceAddress.serialNumber, packet_id);
         return -1;
     }
     SpeedwireSocket& socket = sockets[socket_index];
+
+    // add a query token; this is used to match reply packets to this request packet. The reply is expected before
+    // the request is sent, as another thread polling the sockets may receive it right away
+    SpeedwireCommandTokenIndex index = token_repository.add(peer.deviceAddress.susyID, peer.deviceAddress.serialNumber, packet_id, peer.deviceIpAddress, command);
+    if (index < 0) {
+        packet_ids.release(peer.deviceAddress.susyID, peer.deviceAddress.serialNumber, packet_id);
+        return -1;
+    }
+    const uint64_t key = SpeedwireCommandTokenRepository::getKey(peer.deviceAddress.susyID, peer.deviceAddress.serialNumber, packet_id);
+    demultiplexer.expect(key);
+
     int nsent = socket.sendto(request_buffer, sizeof(request_buffer), peer.deviceIpAddress);
     if (nsent <= 0) {
         logger.print(LogLevel::LOG_ERROR, "cannot send data to socket");
+        demultiplexer.cancel(key);
+        token_repository.remove(index);     // releases the packet id
         return -1;
     }
 
-    // add a query token; this is used to match reply packets to this request packet
-    SpeedwireCommandTokenIndex index = token_repository.add(peer.deviceAddress.susyID, peer.deviceAddress.serialNumber, packet_id, peer.deviceIpAddress, command);
-
     return index;
 }
 
 
+/**
+ *  assemble a batch of inverter query commands and send them with one sendmmsg call per socket
+ *  the command token of each request is returned in its token field; it is -1 if the request could not be sent
+ *  @return the number of requests sent
+ */
+int SpeedwireCommand::sendQueryRequests(std::vector<SpeedwireQueryRequest>& requests) {
+    const size_t packet_size = SpeedwireRequestTemplates::query_request_size;
+    std::lock_guard<std::mutex> lock(batch_mutex);
+    batch_buffer.resize(requests.size() * packet_size);
+    int nsent = 0;
+
+    for (auto& request : requests) {
+        request.token = -1;
+    }
+
+    // send the requests socket by socket
+    for (size_t socket_index = 0; socket_index < sockets.size(); ++socket_index) {
+        batch_datagrams.clear();
+        batch_requests.clear();
+
+        for (size_t i = 0; i < requests.size(); ++i) {
+            const SpeedwireDevice& peer = *requests[i].peer;
+            SocketMap::const_iterator socket = socket_map.find(peer.interfaceIpAddress);
+            if (socket == socket_map.end() || socket->second != (SocketIndex)socket_index) {
+                continue;
+            }
+            if (peer.deviceIpAddress.isValid() == false) {
+                logger.print(LogLevel::LOG_ERROR, "invalid peer ip address");
+                continue;
+            }
+            // assemble the request packet from its template
+            uint8_t* const request_buffer = batch_buffer.data() + i * packet_size;
+            const uint16_t packet_id = packet_ids.allocate(peer.deviceAddress.susyID, peer.deviceAddress.serialNumber);
+            if (packet_id == 0) {
+                logger.print(LogLevel::LOG_ERROR, "too many outstanding requests");
+                continue;
+            }
+            request_templates.getQueryRequest(peer.deviceAddress, SpeedwireAddress::getLocalAddress(), requests[i].command, requests[i].firstRegister, requests[i].lastRegister,
+                                              packet_id, request_buffer, packet_size);
+
+            // add a query token and expect the reply before sending, as another thread polling the sockets may receive it right away
+            requests[i].token = token_repository.add(peer.deviceAddress.susyID, peer.deviceAddress.serialNumber, packet_id, peer.deviceIpAddress, requests[i].command);
+            if (requests[i].token < 0) {
+                packet_ids.release(peer.deviceAddress.susyID, peer.deviceAddress.serialNumber, packet_id);
+                continue;
+            }
+            demultiplexer.expect(SpeedwireCommandTokenRepository::getKey(peer.deviceAddress.susyID, peer.deviceAddress.serialNumber, packet_id));
+            batch_datagrams.push_back(SpeedwireSocket::Datagram(request_buffer, (unsigned long)packet_size, peer.deviceIpAddress.getSockAddr()));
+            SpeedwireSocket::Datagram& datagram = batch_datagrams.back();
+            if (datagram.dest.ss_family == AF_INET) {
+                ((struct sockaddr_in&)datagram.dest).sin_port = htons(SpeedwireSocket::speedwire_port_9522);
+            }
+            else {
+                ((struct sockaddr_in6&)datagram.dest).sin6_port = htons(SpeedwireSocket::speedwire_port_9522);
+            }
+            batch_requests.push_back(std::make_pair(i, packet_id));
+        }
+        if (batch_datagrams.size() == 0) {
+            continue;
+        }
+
+        sockets[socket_index].sendmmsg(batch_datagrams);
+
+        // drop the query tokens of all requests that could not be sent
+        for (size_t j = 0; j < batch_datagrams.size(); ++j) {
+            SpeedwireQueryRequest& request = requests[batch_requests[j].first];
+            const uint16_t packet_id = batch_requests[j].second;
+            const SpeedwireDevice& peer = *request.peer;
+            if (batch_datagrams[j].nbytes <= 0) {
+                logger.print(LogLevel::LOG_ERROR, "cannot send data to socket");
+                demultiplexer.cancel(SpeedwireCommandTokenRepository::getKey(peer.deviceAddress.susyID, peer.deviceAddress.serialNumber, packet_id));
+                token_repository.remove(request.token);     // releases the packet id
+                request.token = -1;
+                continue;
+            }
+            ++nsent;
+        }
+    }
+    return nsent;
+}
+
+
 /**
  *  query device type
  */
@@ -201,28 +300,137 @@ SpeedwireDevice SpeedwireCommand::queryDeviceType(const SpeedwireDevice& peer, c
     // Response 534d4100 000402a000000001 009e0010 606527a0 7d0042be283a00a1 7a01842a71b30001 000000000480 01020058 01000000 03000000 011e8210 6f89e95f 534e3a20 33303130 35333831 31360000 00000000 00000000 00000000 00000000 
     //                                                                                                                              011f8208 6f89e95f 411f0001 feffff00 00000000 00000000 00000000 00000000 00000000 00000000  => 1f41 solar inverter
     //                                                                                                                              01208208 6f89e95f 96240000 80240000 81240001 82240000 feffff00 00000000 00000000 00000000 00000000
-    // send unicast query device type request
-    SpeedwireCommandTokenIndex token_index = sendQueryRequest(peer, Command::DEVICE_QUERY, 0x00821E00, 0x008220FF);
-    //SpeedwireCommandTokenIndex token_index = sendQueryRequest(peer, Command::DEVICE_QUERY, 0x00823400, 0x008234FF);  // query software version
+    // serve the query from the response cache
+    unsigned char udp_packet[2048];
+    int32_t nbytes = -1;
+    if (response_cache != nullptr) {
+        nbytes = response_cache->get(peer, Command::DEVICE_QUERY, 0x00821E00, 0x008220FF, udp_packet, sizeof(udp_packet), LocalHost::getUnixEpochTimeInMs());
+    }
 
-    // determine socket
-    SocketIndex socket_index = socket_map[peer.interfaceIpAddress];
-    if (socket_index < 0) {
-        logger.print(LogLevel::LOG_ERROR, "invalid socket_index");
-        return info;
+    if (nbytes <= 0) {
+        // send unicast query device type request
+        SpeedwireCommandTokenIndex token_index = sendQueryRequest(peer, Command::DEVICE_QUERY, 0x00821E00, 0x008220FF);
+        //SpeedwireCommandTokenIndex token_index = sendQueryRequest(peer, Command::DEVICE_QUERY, 0x00823400, 0x008234FF);  // query software version
+
+        // determine socket
+        SocketIndex socket_index = getSocketIndex(peer.interfaceIpAddress);
+        if (socket_index < 0) {
+            logger.print(LogLevel::LOG_ERROR, "invalid socket_index");
+            return info;
+        }
+
+        // wait for response
+        nbytes = receiveResponse(token_index, udp_packet, sizeof(udp_packet), timeout_in_ms);
+
+        if (nbytes == 0) {
+            if (peer.deviceClass != toString(SpeedwireDeviceClass::EMETER)) {
+                printf("timeout in queryDeviceType() for %s via %s\n", peer.deviceIpAddress.toString().c_str(), peer.interfaceIpAddress.toString().c_str());
+            }
+        }
+        else if (nbytes > 0 && response_cache != nullptr) {
+            const SpeedwireHeader speedwire_packet(udp_packet, nbytes);
+            if (speedwire_packet.isValidData2Packet() && SpeedwireInverterProtocol(speedwire_packet).getErrorCode() == 0x0000) {
+                response_cache->put(peer, Command::DEVICE_QUERY, 0x00821E00, 0x008220FF, udp_packet, nbytes, LocalHost::getUnixEpochTimeInMs());
+            }
+        }
     }
-    SpeedwireSocket& socket = sockets[socket_index];
 
-    // wait for response
+    parseDeviceTypeReply(udp_packet, nbytes, info);
+    //printf("%s\n", info.toString().c_str());
+    return info;
+}
+
+
+/**
+ *  query device types of several peers at once; all requests are sent as one batch and the replies are collected
+ *  concurrently, such that the call takes at most one timeout regardless of the number of peers
+ *  @return copies of the given peers, augmented with the device information obtained from their replies
+ */
+std::vector<SpeedwireDevice> SpeedwireCommand::queryDeviceTypes(const std::vector<SpeedwireDevice>& peers, const int timeout_in_ms) {
+    std::vector<SpeedwireDevice> infos(peers);
+    std::vector<SpeedwireQueryRequest> requests;
+    std::vector<size_t> request_peers;
     unsigned char udp_packet[2048];
-    int32_t nbytes = receiveResponse(token_index, socket, udp_packet, sizeof(udp_packet), timeout_in_ms);
 
-    if (nbytes == 0) {
-        if (peer.deviceClass != toString(SpeedwireDeviceClass::EMETER)) {
-            printf("timeout in queryDeviceType() for %s via %s\n", peer.deviceIpAddress.c_str(), socket.getLocalInterfaceAddress().c_str());
+    // serve queries from the response cache
+    for (size_t i = 0; i < peers.size(); ++i) {
+        int32_t nbytes = -1;
+        if (response_cache != nullptr) {
+            nbytes = response_cache->get(peers[i], Command::DEVICE_QUERY, 0x00821E00, 0x008220FF, udp_packet, sizeof(udp_packet), LocalHost::getUnixEpochTimeInMs());
+        }
+        if (nbytes > 0) {
+            parseDeviceTypeReply(udp_packet, nbytes, infos[i]);
+        }
+        else {
+            requests.push_back(SpeedwireQueryRequest(peers[i], Command::DEVICE_QUERY, 0x00821E00, 0x008220FF));
+            request_peers.push_back(i);
+        }
+    }
+
+    // send unicast query device type requests to all remaining peers
+    sendQueryRequests(requests);
+    std::vector<std::pair<size_t, uint64_t> > pending;
+    for (size_t j = 0; j < requests.size(); ++j) {
+        if (requests[j].token >= 0) {
+            const SpeedwireCommandToken& token = token_repository.at(requests[j].token);
+            pending.push_back(std::make_pair(j, SpeedwireCommandTokenRepository::getKey(token.susyid, token.serialnumber, token.packetid)));
+        }
+    }
+
+    // collect replies until all peers replied or the deadline has passed
+    const uint64_t deadline = LocalHost::getTickCountInMs() + (timeout_in_ms > 0 ? timeout_in_ms : 0);
+    SpeedwireReply reply;
+    while (pending.size() > 0) {
+        const uint64_t now = LocalHost::getTickCountInMs();
+        if (now >= deadline || demultiplexer.receive((int)(deadline - now)) < 0) {
+            break;
+        }
+        for (size_t p = 0; p < pending.size(); ) {
+            const SpeedwireQueryRequest& request = requests[pending[p].first];
+            const SpeedwireCommandToken token = token_repository.at(request.token);
+            bool replied = false;
+            while (replied == false && demultiplexer.takeReply(pending[p].second, reply) == true) {
+                SpeedwireHeader speedwire_packet(reply.packet.data(), (unsigned long)reply.packet.size());
+                if (checkReply(speedwire_packet, AddressConversion::toSockAddr(reply.src), token) == false) {
+                    continue;
+                }
+                const int32_t nbytes = (int32_t)reply.packet.size();
+                if (response_cache != nullptr && SpeedwireInverterProtocol(speedwire_packet).getErrorCode() == 0x0000) {
+                    response_cache->put(*request.peer, Command::DEVICE_QUERY, 0x00821E00, 0x008220FF, reply.packet.data(), nbytes, LocalHost::getUnixEpochTimeInMs());
+                }
+                parseDeviceTypeReply(reply.packet.data(), nbytes, infos[request_peers[pending[p].first]]);
+                replied = true;
+            }
+            if (replied) {
+                demultiplexer.cancel(pending[p].second);
+                token_repository.remove(request.token);
+                pending[p] = pending.back();
+                pending.pop_back();
+            }
+            else {
+                ++p;
+            }
         }
     }
-    else if (nbytes > 0) {
+
+    // give up on peers that did not reply
+    for (const auto& entry : pending) {
+        const SpeedwireQueryRequest& request = requests[entry.first];
+        if (request.peer->deviceClass != toString(SpeedwireDeviceClass::EMETER)) {
+            printf("timeout in queryDeviceTypes() for %s via %s\n", request.peer->deviceIpAddress.toString().c_str(), request.peer->interfaceIpAddress.toString().c_str());
+        }
+        demultiplexer.cancel(entry.second);
+        token_repository.remove(request.token);
+    }
+    return infos;
+}
+
+
+/**
+ *  augment the device information with the device class and model found in a device type reply packet
+ */
+void SpeedwireCommand::parseDeviceTypeReply(const void* udp_packet, const int32_t nbytes, SpeedwireDevice& info) {
+    if (nbytes > 0) {
         //LocalHost::hexdump(udp_packet, nbytes);
 
         // parse reply packet
@@ -264,71 +472,42 @@ SpeedwireDevice SpeedwireCommand::queryDeviceType(const SpeedwireDevice& peer, c
             }
         }
     }
-    //printf("%s\n", info.toString().c_str());
-    return info;
 }
 
 
 /**
  *  synchronously receive inverter reply; for asynchronous receiption please use class SpeedwireReceiveDispatcher
+ *  replies are received through the demultiplexer, which polls all unicast command sockets and keeps replies
+ *  belonging to other pending requests for them, instead of discarding them
  */
-int32_t SpeedwireCommand::receiveResponse(const SpeedwireCommandTokenIndex token_index, SpeedwireSocket& socket, void* udp_buffer, const size_t udp_buffer_size, const int timeout_in_ms) {
-
-    // prepare the pollfd structure
-    struct pollfd pollfds;
-    pollfds.fd      = socket.getSocketFd();
-    pollfds.events  = POLLIN;
-    pollfds.revents = 0;
-
-    // enter packet receive wait loop - any udp packets received before the inverter packet or before the timeout kicks in are skipped(!)
-    int  nbytes = -1;
-    bool valid  = false;
-    while (valid == false && nbytes != 0) {
-
-        // wait for a packet on the configured socket
-        int pollresult = poll(&pollfds, 1, timeout_in_ms);
-        if (pollresult == 0) {
-            //perror("poll timeout in SpeedwireCommand");
-            return 0;
-        }
-        if (pollresult < 0) {
-            logger.print(LogLevel::LOG_ERROR, "poll failure");
-            return -1;
+int32_t SpeedwireCommand::receiveResponse(const SpeedwireCommandTokenIndex token_index, void* udp_buffer, const size_t udp_buffer_size, const int timeout_in_ms) {
+    if (token_repository.isValid(token_index) == false) {
+        logger.print(LogLevel::LOG_ERROR, "invalid command token");
+        return -1;
+    }
+    // copy the token, as the repository may be modified while waiting
+    const SpeedwireCommandToken token = token_repository.at(token_index);
+    const uint64_t key = SpeedwireCommandTokenRepository::getKey(token.susyid, token.serialnumber, token.packetid);
+    demultiplexer.expect(key);
+
+    // wait for a valid reply packet - replies failing the validity check are skipped
+    const uint64_t deadline = LocalHost::getTickCountInMs() + (timeout_in_ms > 0 ? timeout_in_ms : 0);
+    int32_t nbytes = 0;
+    SpeedwireReply reply;
+    for (;;) {
+        const uint64_t now = LocalHost::getTickCountInMs();
+        if (now >= deadline || demultiplexer.waitForReply(key, reply, (int)(deadline - now)) == false) {
+            break;
         }
-
-        // determine if the socket received a packet
-        if ((pollfds.revents & POLLIN) != 0) {
-
-            // read packet data
-            struct sockaddr src;
-            if (socket.isIpv4()) {
-                nbytes = socket.recvfrom(udp_buffer, udp_buffer_size, AddressConversion::toSockAddrIn(src));
-            }
-            else if (socket.isIpv6()) {
-                nbytes = socket.recvfrom(udp_buffer, udp_buffer_size, AddressConversion::toSockAddrIn6(src));
-            }
-
-            // check if the reply is a valid sma speedwire data2 packet
-            SpeedwireHeader speedwire_packet(udp_buffer, nbytes);
-            if (speedwire_packet.isValidData2Packet()) {
-                if (!speedwire_packet.isValidData2Packet(true)) {
-                    printf("is valid speedwire packet, but minor deviations from standard detected\n");
-                }
-                SpeedwireData2Packet data2_packet(speedwire_packet);
-
-                // check if the reply is an inverter packet
-                if (data2_packet.isInverterProtocolID()) {
-
-                    // check reply packet for validity
-                    const SpeedwireCommandToken& token = token_repository.at(token_index);
-                    if (checkReply(speedwire_packet, src, token) == true) {
-                        valid = true;
-                        token_repository.remove(token_index);
-                    }
-                }
-            }
+        SpeedwireHeader speedwire_packet(reply.packet.data(), (unsigned long)reply.packet.size());
+        if (checkReply(speedwire_packet, AddressConversion::toSockAddr(reply.src), token) == true) {
+            nbytes = (int32_t)(reply.packet.size() < udp_buffer_size ? reply.packet.size() : udp_buffer_size);
+            memcpy(udp_buffer, reply.packet.data(), nbytes);
+            token_repository.remove(token_index);
+            break;
         }
     }
+    demultiplexer.cancel(key);
     return nbytes;
 }
 
@@ -362,6 +541,16 @@ SpeedwireCommandTokenRepository& SpeedwireCommand::getTokenRepository(void) {
 }
 
 
+/**
+ *  Get the index of the unicast socket for the given interface ip address. The socket map is only written by the
+ *  constructor, hence the lookup does not insert; interfaces unknown at construction time use the first socket.
+ */
+SpeedwireCommand::SocketIndex SpeedwireCommand::getSocketIndex(const IpAddress& interface_ip_address) const {
+    SocketMap::const_iterator it = socket_map.find(interface_ip_address);
+    return (it != socket_map.end() ? it->second : 0);
+}
+
+
 /**
  *  check reply packet for correctness
  */
@@ -436,10 +625,10 @@ bool SpeedwireCommand::checkReply(const SpeedwireHeader& speedwire_reply_packet,
             printf("ipv4 port %u is not 9522\n", (unsigned)ntohs(addr.sin_port));
             return false;
         }
-        struct in_addr token_in_addr = AddressConversion::toInAddress(token.peer_ip_address);
-        if (token_in_addr.s_addr != addr.sin_addr.s_addr &&
-            token_in_addr.s_addr != SpeedwireSocket(localhost).getSpeedwireMulticastIn4Address().sin_addr.s_addr) {
-            printf("ipv4 address %s is not peer ip address %s\n", AddressConversion::toString(addr.sin_addr).c_str(), token.peer_ip_address.c_str());
+        const struct in_addr& token_in_addr = token.peer_ip_address.getInAddress();
+        if (token.peer_ip_address.isIpv4() == false || (token_in_addr.s_addr != addr.sin_addr.s_addr &&
+            token_in_addr.s_addr != SpeedwireSocket::speedwire_multicast_address_239_12_255_254.sin_addr.s_addr)) {
+            printf("ipv4 address %s is not peer ip address %s\n", AddressConversion::toString(addr.sin_addr).c_str(), token.peer_ip_address.toString().c_str());
             return false;
         }
     }
@@ -449,9 +638,8 @@ bool SpeedwireCommand::checkReply(const SpeedwireHeader& speedwire_reply_packet,
             printf("ipv6 port %u is not 9522\n", (unsigned)ntohs(addr.sin6_port));
             return false;
         }
-        struct in6_addr temp = AddressConversion::toIn6Address(token.peer_ip_address);
-        if (memcmp(&addr.sin6_addr, &temp, sizeof(temp)) != 0) {
-            printf("ipv4 address %s is not peer ip address %s\n", AddressConversion::toString(addr.sin6_addr).c_str(), token.peer_ip_address.c_str());
+        if (IpAddress(addr.sin6_addr) != token.peer_ip_address) {
+            printf("ipv6 address %s is not peer ip address %s\n", AddressConversion::toString(addr.sin6_addr).c_str(), token.peer_ip_address.toString().c_str());
             return false;
         }
     }
@@ -462,56 +650,195 @@ bool SpeedwireCommand::checkReply(const SpeedwireHeader& speedwire_reply_packet,
 
 //=====================================================================================
 
-SpeedwireCommandTokenIndex SpeedwireCommandTokenRepository::add(const uint16_t susyid, const uint32_t serialnumber, const uint16_t packetid, const std::string& peer_ip_address, const Command command) {
+const size_t   SpeedwireCommandTokenRepository::max_slots;
+const uint32_t SpeedwireCommandTokenRepository::wheel_granularity;
+const uint32_t SpeedwireCommandTokenRepository::wheel_size;
+const uint32_t SpeedwireCommandTokenRepository::none;
+
+static const SpeedwireCommandToken invalid_token = { 0, 0, 0, "", Command::NONE, 0 };
+
+
+SpeedwireCommandTokenRepository::SpeedwireCommandTokenRepository(void) :
+    needs_login(false),
+    wheel(wheel_size, none),
+    free_list(none),
+    wheel_time((uint32_t)LocalHost::getUnixEpochTimeInMs() & ~(wheel_granularity - 1)),
+    num_tokens(0),
+    packet_ids(nullptr) {}
+
+/**
+ *  add a token and return its handle; return -1 if the repository is full
+ */
+SpeedwireCommandTokenIndex SpeedwireCommandTokenRepository::add(const uint16_t susyid, const uint32_t serialnumber, const uint16_t packetid, const IpAddress& peer_ip_address, const Command command) {
     uint32_t create_time = (uint32_t)LocalHost::getUnixEpochTimeInMs();
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // a token with the same key is replaced, as replies could not be told apart anyway; its packet id is taken over
+    const uint64_t key = getKey(susyid, serialnumber, packetid);
+    std::unordered_map<uint64_t, uint32_t>::iterator it = index_map.find(key);
+    if (it != index_map.end()) {
+        release(it->second, false);
+    }
+
+    // take a slot from the free list or append a new one
+    uint32_t slot_index = free_list;
+    if (slot_index != none) {
+        free_list = slots[slot_index].next;
+    }
+    else if (slots.size() < max_slots) {
+        Slot new_slot;
+        new_slot.generation = 1;
+        new_slot.used = false;
+        slots.push_back(new_slot);
+        slot_index = (uint32_t)slots.size() - 1;
+    }
+    else {
+        logger.print(LogLevel::LOG_ERROR, "too many outstanding command tokens");
+        return -1;
+    }
+    Slot& slot = slots[slot_index];
     SpeedwireCommandToken new_token = { susyid, serialnumber, packetid, peer_ip_address, command, create_time };
-    token.push_back(new_token);
-    return (SpeedwireCommandTokenIndex)token.size()-1;
+    slot.token = new_token;
+    slot.used = true;
+
+    // link the slot into its timer wheel bucket
+    if (num_tokens == 0 || (int32_t)(create_time - wheel_time) < 0) {
+        wheel_time = create_time & ~(wheel_granularity - 1);
+    }
+    uint32_t& head = wheel[(create_time / wheel_granularity) & (wheel_size - 1)];
+    slot.prev = none;
+    slot.next = head;
+    if (head != none) {
+        slots[head].prev = slot_index;
+    }
+    head = slot_index;
+
+    index_map[key] = slot_index;
+    ++num_tokens;
+    return (SpeedwireCommandTokenIndex)(((uint32_t)(slot.generation & 0x7fff) << 16) | slot_index);
+}
+
+/**
+ *  get the slot index of the given handle; return none if the handle is invalid or stale
+ */
+uint32_t SpeedwireCommandTokenRepository::getSlotIndex(const SpeedwireCommandTokenIndex index) const {
+    if (index < 0) {
+        return none;
+    }
+    const uint32_t slot_index = (uint32_t)index & 0xffff;
+    const uint16_t generation = (uint16_t)((uint32_t)index >> 16);
+    if (slot_index >= slots.size() || slots[slot_index].used == false || (slots[slot_index].generation & 0x7fff) != generation) {
+        return none;
+    }
+    return slot_index;
+}
+
+/**
+ *  unlink the given slot from the hash index and the timer wheel and put it on the free list;
+ *  the packet id of the token is released to the packet id allocator, if requested
+ */
+void SpeedwireCommandTokenRepository::release(const uint32_t slot_index, const bool release_packet_id) {
+    Slot& slot = slots[slot_index];
+    const SpeedwireCommandToken& t = slot.token;
+    index_map.erase(getKey(t.susyid, t.serialnumber, t.packetid));
+    if (release_packet_id && packet_ids != nullptr) {
+        packet_ids->release(t.susyid, t.serialnumber, t.packetid);
+    }
+    if (slot.prev != none) {
+        slots[slot.prev].next = slot.next;
+    }
+    else {
+        wheel[(t.create_time / wheel_granularity) & (wheel_size - 1)] = slot.next;
+    }
+    if (slot.next != none) {
+        slots[slot.next].prev = slot.prev;
+    }
+    slot.used = false;
+    slot.generation = ((slot.generation + 1) & 0x7fff);
+    if (slot.generation == 0) slot.generation = 1;
+    slot.next = free_list;
+    free_list = slot_index;
+    --num_tokens;
 }
 
 void SpeedwireCommandTokenRepository::remove(const SpeedwireCommandTokenIndex index) {
-    int i = 0;
-    for (std::vector<SpeedwireCommandToken>::iterator it = token.begin(); it != token.end(); ++it, ++i) {
-        if (i == index) {
-            it = token.erase(it);
-            break;
-        }
+    std::lock_guard<std::mutex> lock(mutex);
+    const uint32_t slot_index = getSlotIndex(index);
+    if (slot_index != none) {
+        release(slot_index);
     }
 }
 
 int SpeedwireCommandTokenRepository::find(const uint16_t susyid, const uint32_t serialnumber, const uint16_t packetid) const {
-    for (int i = 0; i < token.size(); ++i) {
-        const SpeedwireCommandToken& t = token[i];
-        if (t.susyid == susyid && t.serialnumber == serialnumber && t.packetid == (packetid | 0x8000)) {
-            return i;
-        }
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unordered_map<uint64_t, uint32_t>::const_iterator it = index_map.find(getKey(susyid, serialnumber, packetid));
+    if (it != index_map.end()) {
+        const Slot& slot = slots[it->second];
+        return (int)(((uint32_t)(slot.generation & 0x7fff) << 16) | it->second);
     }
     return -1;
 }
 
-const SpeedwireCommandToken& SpeedwireCommandTokenRepository::at(const SpeedwireCommandTokenIndex index) const {
-    return token[index];
+bool SpeedwireCommandTokenRepository::isValid(const SpeedwireCommandTokenIndex index) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return (getSlotIndex(index) != none);
+}
+
+/**
+ *  get a copy of the token of the given handle; an empty token with command NONE is returned for invalid or stale handles
+ */
+SpeedwireCommandToken SpeedwireCommandTokenRepository::at(const SpeedwireCommandTokenIndex index) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    const uint32_t slot_index = getSlotIndex(index);
+    return (slot_index != none ? slots[slot_index].token : invalid_token);
 }
 
 void SpeedwireCommandTokenRepository::clear(void) {
-    token.clear();
+    std::lock_guard<std::mutex> lock(mutex);
+    for (uint32_t i = 0; i < slots.size(); ++i) {
+        if (slots[i].used) {
+            release(i);
+        }
+    }
 }
 
 int SpeedwireCommandTokenRepository::expire(const int timeout_in_ms) {
-    uint32_t now = (uint32_t)LocalHost::getUnixEpochTimeInMs();
+    return expire(timeout_in_ms, (uint32_t)LocalHost::getUnixEpochTimeInMs());
+}
+
+/**
+ *  remove all tokens older than the given timeout; only the timer wheel buckets between the oldest possible
+ *  creation time and the expiry cutoff are visited
+ */
+int SpeedwireCommandTokenRepository::expire(const int timeout_in_ms, const uint32_t now) {
+    const uint32_t cutoff = now - (uint32_t)timeout_in_ms;
+    std::lock_guard<std::mutex> lock(mutex);
     int count = 0;
-    for (std::vector<SpeedwireCommandToken>::iterator it = token.begin(); it != token.end(); /*nop*/) {
-        if ((now - it->create_time) > (uint32_t)timeout_in_ms) {
-            it = token.erase(it);
-            ++count;
+    for (uint32_t steps = 0; num_tokens > 0 && (int32_t)(cutoff - wheel_time) > 0; ++steps) {
+        // after a full revolution, all buckets have been checked
+        if (steps >= wheel_size) {
+            wheel_time = cutoff & ~(wheel_granularity - 1);
+            break;
         }
-        else {
-            ++it;
+        uint32_t slot_index = wheel[(wheel_time / wheel_granularity) & (wheel_size - 1)];
+        while (slot_index != none) {
+            const uint32_t next = slots[slot_index].next;
+            if ((int32_t)(cutoff - slots[slot_index].token.create_time) > 0) {
+                release(slot_index);
+                ++count;
+            }
+            slot_index = next;
+        }
+        // stop at the bucket containing the cutoff, as it may hold younger tokens
+        if ((int32_t)(cutoff - (wheel_time + wheel_granularity)) < 0) {
+            break;
         }
+        wheel_time += wheel_granularity;
     }
     return count;
 }
 
 int SpeedwireCommandTokenRepository::size(void) const {
-    return (int)token.size();
+    std::lock_guard<std::mutex> lock(mutex);
+    return num_tokens;
 }
@@ -36,11 +36,17 @@ using namespace libspeedwire;
  *  Constructor.
  *  @param host A reference to the LocalHost instance of this machine.
  */
-SpeedwireDiscovery::SpeedwireDiscovery(LocalHost& host) : localhost(host) {}
+SpeedwireDiscovery::SpeedwireDiscovery(LocalHost& host) :
+    localhost(host),
+    cacheLoaded(false),
+    verificationCommand(nullptr),
+    verificationDeadline(0),
+    verificationCount(0) {}
 
 
 /**
- *  Destructor - clear the device list.
+ *  Destructor - clear the device list. A pending verification is abandoned; its command instance may already be gone,
+ *  hence its tokens are left to the command instance.
  */
 SpeedwireDiscovery::~SpeedwireDiscovery(void) {
     speedwireDevices.clear();
@@ -209,6 +215,14 @@ unsigned long SpeedwireDiscovery::getNumberOfDevices(void) const {
  */
 int SpeedwireDiscovery::discoverDevices(const bool full_scan) {
 
+    // devices loaded from the device cache need no scan, unless the verification found some of them missing
+    if (verificationCommand != nullptr) {
+        finishDeviceVerification();
+    }
+    if (cacheLoaded && full_scan == false && getNumberOfMissingDevices() == 0 && getNumberOfPreRegisteredIPDevices() == 0) {
+        return getNumberOfFullyRegisteredDevices();
+    }
+
     // get a list of all local ipv4 interface addresses
     const std::vector<std::string>& localIPs = localhost.getLocalIPv4Addresses();
 
@@ -228,15 +242,14 @@ int SpeedwireDiscovery::discoverDevices(const bool full_scan) {
         int num_sends = ((broadcast_counter == 0 || prereg_counter == 0) ? 1 : 10);
         //printf("broadcast_counter %llu prereg_counter %llu subnet_counter %llu  socket_counter %llu\n", broadcast_counter, prereg_counter, subnet_counter, socket_counter);
 
-        // send discovery request packet and update counters
+        // send discovery request packets and update counters; full scan requests are sent in batches of num_sends packets
         if (num_retries > 0) {
-            for (int i = 0; i < num_sends; ++i) {
-                if (sendNextDiscoveryPacket(broadcast_counter, prereg_counter, subnet_counter, socket_counter) == false) {
-                    --num_retries;
-                    broadcast_counter = 0;  // retry multicast discovery of unknown devices
-                    prereg_counter = 0;     // retry unicast discovery of pre-registered devices
-                    break;  // done with sending all discovery packets
-                }
+            if (sendNextDiscoveryPacket(broadcast_counter, prereg_counter, subnet_counter, socket_counter, num_sends) == false) {
+                --num_retries;
+                broadcast_counter = 0;  // retry multicast discovery of unknown devices
+                prereg_counter = 0;     // retry unicast discovery of pre-registered devices
+            }
+            else {
                 startTimeInMillis = localhost.getTickCountInMs();
             }
         }
@@ -309,7 +322,7 @@ int SpeedwireDiscovery::pollSockets(const std::vector<SpeedwireSocket>& sockets,
  *  - unicast speedwire discovery requests to pre-registered devices
  *  - unicast speedwire discovery requests to all hosts on the network (only if the network prefix is < /16)
  */
-bool SpeedwireDiscovery::sendNextDiscoveryPacket(size_t& broadcast_counter, size_t& prereg_counter, size_t& subnet_counter, size_t& socket_counter) {
+bool SpeedwireDiscovery::sendNextDiscoveryPacket(size_t& broadcast_counter, size_t& prereg_counter, size_t& subnet_counter, size_t& socket_counter, const size_t max_requests) {
 
     // sequentially first send multicast speedwire discovery requests
     const std::vector<std::string>& localIPs = localhost.getLocalIPv4Addresses();
@@ -326,7 +339,7 @@ bool SpeedwireDiscovery::sendNextDiscoveryPacket(size_t& broadcast_counter, size
     }
     // followed by a full scan based on unicast speedwire discovery requests
     if (socket_counter < localIPs.size()) {
-        return sendUnicastDiscoveryRequestToSockets(subnet_counter, socket_counter);
+        return sendUnicastDiscoveryRequestToSockets(subnet_counter, socket_counter, max_requests);
     }
     return false;
 }
@@ -355,7 +368,7 @@ bool SpeedwireDiscovery::sendMulticastDiscoveryRequestToDevices(void) {
     const std::vector<std::string>& localIPs = localhost.getLocalIPv4Addresses();
     for (auto& device : speedwireDevices) {
         if (device.hasIPAddressOnly()) {
-            struct in_addr     dev_addr = AddressConversion::toInAddress(device.deviceIpAddress);
+            struct in_addr     dev_addr = device.deviceIpAddress.getInAddress();
             struct sockaddr_in sockaddr = AddressConversion::toSockAddrIn(dev_addr, SpeedwireSocket::speedwire_port_9522);
             for (const auto& local_if_addr : localIPs) {
                 struct in_addr if_addr = AddressConversion::toInAddress(local_if_addr);
@@ -379,7 +392,7 @@ bool SpeedwireDiscovery::sendUnicastDiscoveryRequestToDevices(void) {
     const std::vector<std::string>& localIPs = localhost.getLocalIPv4Addresses();
     for (auto& device : speedwireDevices) {
         if (device.hasIPAddressOnly()) {
-            struct sockaddr_in sockaddr = AddressConversion::toSockAddrIn(device.deviceIpAddress, SpeedwireSocket::speedwire_port_9522);
+            struct sockaddr_in sockaddr = AddressConversion::toSockAddrIn(device.deviceIpAddress.getInAddress(), SpeedwireSocket::speedwire_port_9522);
             for (const auto& local_if_addr : localIPs) {
                 SpeedwireSocket socket = SpeedwireSocketFactory::getInstance(localhost)->getSendSocket(SpeedwireSocketFactory::SocketType::UNICAST, local_if_addr);
                 //fprintf(stdout, "send unicast discovery request to %s (via interface %s)\n", device.deviceIpAddress.c_str(), socket.getLocalInterfaceAddress().c_str());
@@ -401,8 +414,9 @@ bool SpeedwireDiscovery::sendUnicastDiscoveryRequestToDevices(void) {
 
 /**
  *  Send unicast discovery packets to each ip address in the subnet of each socket. This is used for full subnet scans.
+ *  Up to max_requests packets are sent as one batch.
  */
-bool SpeedwireDiscovery::sendUnicastDiscoveryRequestToSockets(size_t& subnet_counter, size_t& socket_counter) {
+bool SpeedwireDiscovery::sendUnicastDiscoveryRequestToSockets(size_t& subnet_counter, size_t& socket_counter, const size_t max_requests) {
     // determine address range of local subnet
     const std::vector<std::string>& localIPs = localhost.getLocalIPv4Addresses();
     const std::string& addr = localIPs[socket_counter];
@@ -417,21 +431,29 @@ bool SpeedwireDiscovery::sendUnicastDiscoveryRequestToSockets(size_t& subnet_cou
         fprintf(stdout, "starting full scan for interface %s for ip addresses 1 ... %lu\n", addr.c_str(), max_subnet_counter);
     }
     if (subnet_counter < max_subnet_counter && socket_counter < localIPs.size()) {
-        // assemble address of the recipient
+        const std::array<uint8_t, 58> unicast_request = SpeedwireDiscoveryProtocol::getUnicastRequest();
         struct in_addr inaddr = AddressConversion::toInAddress(addr);
-        uint32_t saddr = ntohl(inaddr.s_addr);      // ip address of the interface
-        saddr = saddr & (~max_subnet_counter);      // mask subnet addresses, such that the subnet part is 0
-        saddr = saddr + (uint32_t)subnet_counter;   // add subnet address
-        sockaddr_in sockaddr;
-        sockaddr.sin_family = AF_INET;
-        sockaddr.sin_addr.s_addr = htonl(saddr);
-        sockaddr.sin_port = htons(SpeedwireSocket::speedwire_port_9522);
+        std::vector<SpeedwireSocket::Datagram> datagrams;
+        while (subnet_counter < max_subnet_counter && datagrams.size() < (max_requests > 0 ? max_requests : 1)) {
+            // assemble address of the recipient
+            uint32_t saddr = ntohl(inaddr.s_addr);      // ip address of the interface
+            saddr = saddr & (~max_subnet_counter);      // mask subnet addresses, such that the subnet part is 0
+            saddr = saddr + (uint32_t)subnet_counter;   // add subnet address
+            sockaddr_in sockaddr;
+            memset(&sockaddr, 0, sizeof(sockaddr));
+            sockaddr.sin_family = AF_INET;
+            sockaddr.sin_addr.s_addr = htonl(saddr);
+            sockaddr.sin_port = htons(SpeedwireSocket::speedwire_port_9522);
+            datagrams.push_back(SpeedwireSocket::Datagram(unicast_request.data(), (unsigned long)unicast_request.size(), AddressConversion::toSockAddr(sockaddr)));
+            ++subnet_counter;
+        }
         // send to socket
         SpeedwireSocket socket = SpeedwireSocketFactory::getInstance(localhost)->getSendSocket(SpeedwireSocketFactory::SocketType::UNICAST, addr);
-        //fprintf(stdout, "send unicast discovery request to %s (via interface %s)\n", AddressConversion::toString(sockaddr).c_str(), socket.getLocalInterfaceAddress().c_str());
-        const std::array<uint8_t, 58> unicast_request = SpeedwireDiscoveryProtocol::getUnicastRequest();
-        int nbytes = socket.sendto(unicast_request.data(), (unsigned long)unicast_request.size(), sockaddr);
-        ++subnet_counter;
+        //fprintf(stdout, "send %u unicast discovery requests (via interface %s)\n", (unsigned)datagrams.size(), socket.getLocalInterfaceAddress().c_str());
+        int nsent = socket.sendmmsg(datagrams);
+        if (nsent < (int)datagrams.size()) {
+            fprintf(stderr, "sent only %d of %u unicast discovery requests (via interface %s)\n", nsent, (unsigned)datagrams.size(), addr.c_str());
+        }
         return true;
     }
     // proceed with the next local interface
@@ -505,11 +527,11 @@ bool SpeedwireDiscovery::recvDiscoveryPackets(const SpeedwireSocket& socket) {
                 }
                 device.deviceIpAddress = peer_ip_address;
                 device.interfaceIpAddress = localhost.getMatchingLocalIPAddress(peer_ip_address);
-                if (device.interfaceIpAddress == "" && socket.isIpAny() == false) {
+                if (device.interfaceIpAddress.isValid() == false && socket.isIpAny() == false) {
                     device.interfaceIpAddress = socket.getLocalInterfaceAddress();
                 }
                 if (registerDevice(device)) {
-                    printf("found susyid %u serial %lu ip %s\n", device.deviceAddress.susyID, device.deviceAddress.serialNumber, device.deviceIpAddress.c_str());
+                    printf("found susyid %u serial %lu ip %s\n", device.deviceAddress.susyID, device.deviceAddress.serialNumber, device.deviceIpAddress.toString().c_str());
                     result = true;
                 }
             }
@@ -525,7 +547,7 @@ bool SpeedwireDiscovery::recvDiscoveryPackets(const SpeedwireSocket& socket) {
                 device.deviceModel = "Inverter";
                 device.deviceIpAddress = peer_ip_address;
                 device.interfaceIpAddress = localhost.getMatchingLocalIPAddress(peer_ip_address);
-                if (device.interfaceIpAddress.length() == 0 && socket.isIpAny() == false) {
+                if (device.interfaceIpAddress.isValid() == false && socket.isIpAny() == false) {
                     device.interfaceIpAddress = socket.getLocalInterfaceAddress();
                 }
                 // try to get further information about the device by examining the susy id; this is not accurate
@@ -535,7 +557,7 @@ bool SpeedwireDiscovery::recvDiscoveryPackets(const SpeedwireSocket& socket) {
                     device.deviceModel = device_type.name;
                 }
                 if (registerDevice(device)) {
-                    printf("found susyid %u serial %lu ip %s\n", device.deviceAddress.susyID, device.deviceAddress.serialNumber, device.deviceIpAddress.c_str());
+                    printf("found susyid %u serial %lu ip %s\n", device.deviceAddress.susyID, device.deviceAddress.serialNumber, device.deviceIpAddress.toString().c_str());
                     result = true;
                 }
 #if 0
@@ -558,26 +580,38 @@ bool SpeedwireDiscovery::recvDiscoveryPackets(const SpeedwireSocket& socket) {
 
 
 /**
- *  Receive a discovery packet, analyze it and create a device information record.
+ *  Complete the device information records of all incomplete devices by querying their device type. The queries
+ *  to all devices are sent at once through a shared command instance and their replies are collected concurrently.
  */
 bool SpeedwireDiscovery::completeDeviceInformation(void) {
     const uint32_t max_retries = 1;
     uint32_t num_retries = 0;
 
     while (num_retries < max_retries) {
-        // try to get further information about the device by querying device type information from the peer
+        // collect all devices where the ip address and interface address is known
+        std::vector<SpeedwireDevice> incomplete_devices;
         for (auto& device : speedwireDevices) {
-            if (device.interfaceIpAddress.length() == 0 || device.interfaceIpAddress == "0.0.0.0") {
-                device.interfaceIpAddress = localhost.getMatchingLocalIPAddress(device.deviceIpAddress);
+            if (device.interfaceIpAddress.isValid() == false || device.interfaceIpAddress.isAny()) {
+                device.interfaceIpAddress = localhost.getMatchingLocalIPAddress(device.deviceIpAddress.toString());
             }
-            // if the ip address and interface address is known, just query the device
-            if (device.isComplete() == false && device.deviceIpAddress.length() != 0 && device.interfaceIpAddress.length() != 0) {
-                SpeedwireCommand command(localhost, speedwireDevices);
-                SpeedwireDevice updatedDevice = command.queryDeviceType(device);
-                if (updatedDevice.isComplete() == true) {
-                    registerDevice(updatedDevice);
-                    printf("%s\n", updatedDevice.toString().c_str());
-                }
+            if (device.isComplete() == false && device.deviceIpAddress.isValid() && device.interfaceIpAddress.isValid()) {
+                incomplete_devices.push_back(device);
+            }
+        }
+        if (incomplete_devices.size() == 0) {
+            break;
+        }
+
+        // try to get further information about the devices by querying device type information from the peers
+        std::vector<SpeedwireDevice> updated_devices;
+        {
+            SpeedwireCommand command(localhost, speedwireDevices);
+            updated_devices = command.queryDeviceTypes(incomplete_devices);
+        }
+        for (const auto& updated_device : updated_devices) {
+            if (updated_device.isComplete() == true) {
+                registerDevice(updated_device);
+                printf("%s\n", updated_device.toString().c_str());
             }
         }
         ++num_retries;
@@ -588,3 +622,235 @@ bool SpeedwireDiscovery::completeDeviceInformation(void) {
     return true;
 }
 
+
+
+/**
+ *  Save all fully registered devices to the given device cache file. The file is first written under a temporary name
+ *  and then renamed, such that a crash during the write does not destroy the previous file.
+ *  @param path The device cache file path.
+ *  @return true on success, false otherwise.
+ */
+bool SpeedwireDiscovery::saveDeviceCache(const std::string& path) const {
+    const std::string temp_path = path + ".tmp";
+    FILE* file = fopen(temp_path.c_str(), "w");
+    if (file == NULL) {
+        printf("cannot open device cache file %s\n", temp_path.c_str());
+        return false;
+    }
+    bool ok = true;
+    for (const auto& device : speedwireDevices) {
+        if (device.isComplete()) {
+            ok &= (fprintf(file, "%u\t%u\t%s\t%s\t%s\t%s\n", device.deviceAddress.susyID, device.deviceAddress.serialNumber, device.deviceClass.c_str(),
+                           device.deviceModel.c_str(), device.deviceIpAddress.toString().c_str(), device.interfaceIpAddress.toString().c_str()) > 0);
+        }
+    }
+    ok &= (fclose(file) == 0);
+#ifdef _WIN32
+    remove(path.c_str());
+#endif
+    if (ok == false || rename(temp_path.c_str(), path.c_str()) != 0) {
+        printf("cannot write device cache file %s\n", path.c_str());
+        remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ *  Load devices from the given device cache file and register them. The devices can be used right away; they should
+ *  be verified by startDeviceVerification() and pollDeviceVerification(), or by a subsequent call to discoverDevices().
+ *  @param path The device cache file path.
+ *  @return The number of loaded devices, or -1 if the file cannot be read.
+ */
+int SpeedwireDiscovery::loadDeviceCache(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == NULL) {
+        return -1;
+    }
+    int count = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        // split the tab separated fields: susyid, serial number, class, model, device ip address, interface ip address
+        std::vector<std::string> fields;
+        std::string remainder(line);
+        while (remainder.length() > 0 && (remainder.back() == '\n' || remainder.back() == '\r')) {
+            remainder.pop_back();
+        }
+        for (size_t pos = remainder.find('\t'); pos != std::string::npos; pos = remainder.find('\t')) {
+            fields.push_back(remainder.substr(0, pos));
+            remainder = remainder.substr(pos + 1);
+        }
+        fields.push_back(remainder);
+        if (fields.size() != 6) {
+            continue;
+        }
+        SpeedwireDevice device;
+        device.deviceAddress.susyID = (uint16_t)strtoul(fields[0].c_str(), NULL, 10);
+        device.deviceAddress.serialNumber = (uint32_t)strtoul(fields[1].c_str(), NULL, 10);
+        device.deviceClass = fields[2];
+        device.deviceModel = fields[3];
+        device.deviceIpAddress = fields[4];
+        device.interfaceIpAddress = fields[5];
+        if (device.isComplete()) {
+            registerDevice(device);
+            ++count;
+        }
+    }
+    fclose(file);
+    cacheLoaded = true;
+    return count;
+}
+
+
+/**
+ *  Start the verification of all fully registered devices. Each device except emeters, which do not answer inverter
+ *  queries, is probed with a unicast device type query; all queries are sent at once through the given command
+ *  instance. The replies are collected by pollDeviceVerification() or finishDeviceVerification(); the command instance
+ *  must stay alive until then.
+ *  @param command The command instance used to send the queries and to receive the replies.
+ *  @param timeout_in_ms The time to wait for replies.
+ *  @return true if the verification has been started, false if it is already pending or there is nothing to verify.
+ */
+bool SpeedwireDiscovery::startDeviceVerification(SpeedwireCommand& command, const int timeout_in_ms) {
+    if (verificationCommand != nullptr) {
+        return false;
+    }
+    verificationProbes.clear();
+    for (const auto& device : speedwireDevices) {
+        if (device.isComplete() && device.deviceClass != toString(SpeedwireDeviceClass::EMETER)) {
+            VerificationProbe probe;
+            probe.device = device;
+            probe.reply = device;
+            probe.token = -1;
+            // clear class and model of the reply, such that only replying devices are complete again
+            probe.reply.deviceClass.clear();
+            probe.reply.deviceModel.clear();
+            verificationProbes.push_back(probe);
+        }
+    }
+    if (verificationProbes.size() == 0) {
+        return false;
+    }
+    std::vector<SpeedwireQueryRequest> requests;
+    for (const auto& probe : verificationProbes) {
+        requests.push_back(SpeedwireQueryRequest(probe.device, Command::DEVICE_QUERY, 0x00821E00, 0x008220FF));
+    }
+    command.sendQueryRequests(requests);
+    for (size_t i = 0; i < requests.size(); ++i) {
+        verificationProbes[i].token = requests[i].token;
+    }
+    verificationCommand = &command;
+    verificationDeadline = LocalHost::getTickCountInMs() + (timeout_in_ms > 0 ? timeout_in_ms : 0);
+    return true;
+}
+
+
+/**
+ *  Wait up to the given time for replies to the pending verification. Once all probed devices replied or the
+ *  verification timeout has passed, the result is applied, see finishDeviceVerification().
+ *  @param timeout_in_ms Maximum time to wait for replies; the wait ends earlier at the verification deadline.
+ *  @return true if the verification has finished, false if it is still pending.
+ */
+bool SpeedwireDiscovery::pollDeviceVerification(const int timeout_in_ms) {
+    if (verificationCommand == nullptr) {
+        return true;
+    }
+    SpeedwireCommandTokenRepository& token_repository = verificationCommand->getTokenRepository();
+    SpeedwireResponseDemultiplexer& demultiplexer = verificationCommand->getDemultiplexer();
+    uint64_t now = LocalHost::getTickCountInMs();
+    int wait_time = (timeout_in_ms > 0 ? timeout_in_ms : 0);
+    const int until_deadline = (verificationDeadline > now ? (int)(verificationDeadline - now) : 0);
+    if (until_deadline < wait_time) wait_time = until_deadline;
+    if (demultiplexer.receive(wait_time) < 0) {
+        verificationDeadline = 0;
+    }
+
+    // collect device type replies
+    size_t npending = 0;
+    SpeedwireReply reply;
+    for (auto& probe : verificationProbes) {
+        // tokens may have been expired by the owner of the command instance meanwhile
+        if (probe.token >= 0 && token_repository.isValid(probe.token) == false) {
+            probe.token = -1;
+        }
+        if (probe.token < 0) {
+            continue;
+        }
+        const SpeedwireCommandToken token = token_repository.at(probe.token);
+        const uint64_t key = SpeedwireCommandTokenRepository::getKey(token.susyid, token.serialnumber, token.packetid);
+        bool replied = false;
+        while (replied == false && demultiplexer.takeReply(key, reply) == true) {
+            const SpeedwireHeader speedwire_packet(reply.packet.data(), (unsigned long)reply.packet.size());
+            if (verificationCommand->checkReply(speedwire_packet, AddressConversion::toSockAddr(reply.src), token) == false) {
+                continue;
+            }
+            SpeedwireCommand::parseDeviceTypeReply(reply.packet.data(), (int32_t)reply.packet.size(), probe.reply);
+            replied = true;
+        }
+        if (replied) {
+            demultiplexer.cancel(key);
+            token_repository.remove(probe.token);
+            probe.token = -1;
+        }
+        else {
+            ++npending;
+        }
+    }
+    now = LocalHost::getTickCountInMs();
+    if (npending > 0 && now < verificationDeadline) {
+        return false;
+    }
+    applyDeviceVerification();
+    return true;
+}
+
+
+/**
+ *  Wait for the pending verification to finish and apply its result. Devices that replied are updated; devices that
+ *  did not reply are reverted to required devices, such that discoverDevices() searches for them.
+ *  @return The number of verified devices.
+ */
+int SpeedwireDiscovery::finishDeviceVerification(void) {
+    while (pollDeviceVerification(INT32_MAX) == false) {}
+    return verificationCount;
+}
+
+
+/**
+ *  Apply the result of the pending verification and abandon the queries still in flight.
+ */
+void SpeedwireDiscovery::applyDeviceVerification(void) {
+    SpeedwireCommandTokenRepository& token_repository = verificationCommand->getTokenRepository();
+    verificationCount = 0;
+    for (const auto& probe : verificationProbes) {
+        if (probe.token >= 0 && token_repository.isValid(probe.token)) {
+            const SpeedwireCommandToken& token = token_repository.at(probe.token);
+            verificationCommand->getDemultiplexer().cancel(SpeedwireCommandTokenRepository::getKey(token.susyid, token.serialnumber, token.packetid));
+            token_repository.remove(probe.token);
+        }
+        if (probe.reply.isComplete()) {
+            for (auto& device : speedwireDevices) {
+                if (device == probe.device) {
+                    device = probe.reply;
+                }
+            }
+            ++verificationCount;
+        }
+        else {
+            printf("cached device not found: %s\n", probe.device.toString().c_str());
+            unregisterDevice(probe.device);
+            requireDevice(probe.device.deviceAddress.serialNumber);
+        }
+    }
+    verificationProbes.clear();
+    verificationCommand = nullptr;
+}
+
+
+/**
+ *  Check if a verification has been started and its result has not yet been applied.
+ */
+bool SpeedwireDiscovery::isDeviceVerificationPending(void) const {
+    return (verificationCommand != nullptr);
+}
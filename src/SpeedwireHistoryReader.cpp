@@ -0,0 +1,350 @@
+#include <stdio.h>
+#include <algorithm>
+#include <SpeedwireHistoryReader.hpp>
+#include <ArchiveProducer.hpp>
+#include <SpeedwireHeader.hpp>
+#include <AddressConversion.hpp>
+#include <LocalHost.hpp>
+#include <Logger.hpp>
+using namespace libspeedwire;
+
+static Logger logger("SpeedwireHistoryReader");
+
+
+/**
+ * Constructor of the SpeedwireHistoryArchiveSink instance.
+ * @param _archive Reference to the archive receiving the yield values.
+ */
+SpeedwireHistoryArchiveSink::SpeedwireHistoryArchiveSink(ArchiveProducer& _archive) :
+    archive(_archive) {}
+
+
+/**
+ * Destructor.
+ */
+SpeedwireHistoryArchiveSink::~SpeedwireHistoryArchiveSink(void) {}
+
+
+/**
+ * Archive the given yield record as total inverter energy in Wh.
+ * @param device The originating inverter device.
+ * @param epoch_time The record time in seconds since unix epoch start.
+ * @param yield_value The total energy yield in Wh at the record time.
+ */
+void SpeedwireHistoryArchiveSink::consumeYield(const SpeedwireDevice& device, const Command /*command*/, const uint32_t epoch_time, const uint64_t yield_value) {
+    const MeasurementType& type = SpeedwireData::InverterEnergyTotal.measurementType;
+    archive.produceAt(device, type, SpeedwireData::InverterEnergyTotal.wire, (double)yield_value / (double)type.divisor, (uint64_t)epoch_time * 1000);
+}
+
+
+/**
+ * Get the cursor of the given device and command.
+ * @return The first epoch time that has not yet been downloaded completely, or 0 if there is no cursor.
+ */
+uint32_t SpeedwireHistoryCursor::get(const SpeedwireDevice& device, const Command command) const {
+    std::map<uint64_t, uint32_t>::const_iterator it = cursors.find(((uint64_t)device.deviceAddress.serialNumber << 32) | (uint32_t)command);
+    return (it != cursors.end() ? it->second : 0);
+}
+
+
+/**
+ * Set the cursor of the given device and command.
+ * @param device The device.
+ * @param command The history command.
+ * @param epoch_time The first epoch time that has not yet been downloaded completely.
+ */
+void SpeedwireHistoryCursor::set(const SpeedwireDevice& device, const Command command, const uint32_t epoch_time) {
+    cursors[((uint64_t)device.deviceAddress.serialNumber << 32) | (uint32_t)command] = epoch_time;
+}
+
+
+/**
+ * Save all cursors to the given file. The file is first written under a temporary name and then renamed,
+ * such that a crash during the write does not destroy the previous file.
+ * @param path The cursor file path.
+ * @return true on success, false otherwise.
+ */
+bool SpeedwireHistoryCursor::save(const std::string& path) const {
+    const std::string temp_path = path + ".tmp";
+    FILE* file = fopen(temp_path.c_str(), "w");
+    if (file == NULL) {
+        logger.print(LogLevel::LOG_ERROR, "cannot open cursor file %s", temp_path.c_str());
+        return false;
+    }
+    bool ok = true;
+    for (std::map<uint64_t, uint32_t>::const_iterator it = cursors.begin(); it != cursors.end(); ++it) {
+        ok &= (fprintf(file, "%08x %08x %u\n", (unsigned)(it->first >> 32), (unsigned)(it->first & 0xffffffff), (unsigned)it->second) > 0);
+    }
+    ok &= (fclose(file) == 0);
+#ifdef _WIN32
+    remove(path.c_str());
+#endif
+    if (ok == false || rename(temp_path.c_str(), path.c_str()) != 0) {
+        logger.print(LogLevel::LOG_ERROR, "cannot write cursor file %s", path.c_str());
+        remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ * Load cursors from the given file.
+ * @param path The cursor file path.
+ * @return true on success, false otherwise.
+ */
+bool SpeedwireHistoryCursor::load(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == NULL) {
+        logger.print(LogLevel::LOG_WARNING, "cannot open cursor file %s", path.c_str());
+        return false;
+    }
+    unsigned serial_number, command, epoch_time;
+    while (fscanf(file, "%x %x %u", &serial_number, &command, &epoch_time) == 3) {
+        cursors[((uint64_t)serial_number << 32) | command] = epoch_time;
+    }
+    bool ok = (feof(file) != 0);
+    fclose(file);
+    if (ok == false) {
+        logger.print(LogLevel::LOG_ERROR, "invalid cursor file %s", path.c_str());
+    }
+    return ok;
+}
+
+
+/**
+ * Constructor of the SpeedwireHistoryReader instance.
+ * @param _command Reference to the command instance used to send queries and receive replies.
+ * @param max_in_flight Maximum number of chunk queries in flight.
+ * @param max_retries Maximum number of retries of a chunk query that timed out or missed fragments.
+ */
+SpeedwireHistoryReader::SpeedwireHistoryReader(SpeedwireCommand& _command, const unsigned max_in_flight, const unsigned max_retries) :
+    command(_command),
+    maxInFlight(max_in_flight > 0 ? max_in_flight : 1),
+    maxRetries(max_retries),
+    numRecords(0),
+    numFragments(0),
+    numRetries(0) {}
+
+
+/**
+ * Get the time span covered by a single chunk query.
+ * @param cmd The history command.
+ * @return The chunk duration in seconds; one day of 5 minute yields or events, or 64 days of daily yields.
+ */
+uint32_t SpeedwireHistoryReader::getChunkDuration(const Command cmd) {
+    if (cmd == Command::YIELD_BY_DAY_QUERY) {
+        return 64 * 86400;
+    }
+    return 86400;
+}
+
+
+/**
+ * Decode all records of the given reply fragment and pass them to the consumer; records are decoded in place,
+ * one at a time.
+ * @param device The originating inverter device.
+ * @param fragment The reply fragment.
+ * @param consumer The consumer.
+ * @return The number of records passed to the consumer.
+ */
+size_t SpeedwireHistoryReader::decode(const SpeedwireDevice& device, const SpeedwireInverterProtocol& fragment, SpeedwireHistoryConsumer& consumer) {
+    const Command cmd = fragment.getCommandID() & ~Command::REQUEST_TYPE_MASK;     // strip the response type
+    const bool is_event = ((cmd & Command::ID_MASK) == (Command::EVENT_QUERY & Command::ID_MASK));
+    const uint32_t element_length = fragment.getRawDataLength();
+    if (element_length == 0) {
+        return 0;
+    }
+    size_t num_records = 0;
+    const void* element = fragment.getFirstRawDataElement();
+    while (element != NULL) {
+        const SpeedwireRawData raw_data = fragment.getRawTimelineData(element, element_length, (is_event ? SpeedwireDataType::Event : SpeedwireDataType::Yield));
+        if (is_event) {
+            if (raw_data.data_size >= SpeedwireRawDataEvent::value_size) {
+                consumer.consumeEvent(device, SpeedwireRawDataEvent(raw_data).getValue(0));
+                ++num_records;
+            }
+        }
+        else if (raw_data.data_size >= SpeedwireRawDataYield::value_size) {
+            const uint64_t value = SpeedwireRawDataYield(raw_data).getValue(0).yield_value;
+            if (value != 0xffffffffffffffffull) {    // skip NaN values
+                consumer.consumeYield(device, cmd, (uint32_t)raw_data.time, value);
+                ++num_records;
+            }
+        }
+        element = fragment.getNextRawDataElement(element, element_length);
+    }
+    return num_records;
+}
+
+
+/**
+ * Send the query of the given chunk. The fragment state is kept across retries, such that fragments already
+ * received and decoded are skipped when the retried query replies with them again.
+ */
+bool SpeedwireHistoryReader::send(const SpeedwireDevice& peer, const Command cmd, Chunk& chunk, const int timeout_in_ms) {
+    chunk.token = command.sendQueryRequest(peer, cmd, chunk.firstTime, chunk.lastTime);
+    chunk.deadline = LocalHost::getTickCountInMs() + (timeout_in_ms > 0 ? timeout_in_ms : 0);
+    if (chunk.token < 0) {
+        return false;
+    }
+    const SpeedwireCommandToken& token = command.getTokenRepository().at(chunk.token);
+    chunk.key = SpeedwireCommandTokenRepository::getKey(token.susyid, token.serialnumber, token.packetid);
+    return true;
+}
+
+
+/**
+ * Record the receipt of the given fragment of a chunk and update its completion state.
+ * @param chunk The chunk.
+ * @param counter The fragment counter.
+ * @return true if the fragment is new, false if it is a duplicate.
+ */
+bool SpeedwireHistoryReader::addFragment(Chunk& chunk, const uint16_t counter) {
+    if (counter >= chunk.fragmentsSeen.size()) {
+        chunk.fragmentsSeen.resize((size_t)counter + 1, false);
+    }
+    if (chunk.fragmentsSeen[counter]) {
+        return false;
+    }
+    chunk.fragmentsSeen[counter] = true;
+    chunk.fragmentsExpected = std::max(chunk.fragmentsExpected, (unsigned)counter + 1);
+    ++chunk.fragmentsReceived;
+    chunk.complete = (chunk.fragmentsSeen[0] && chunk.fragmentsReceived >= chunk.fragmentsExpected);
+    return true;
+}
+
+
+/**
+ * Release the command token and the demultiplexer mailbox of the given chunk.
+ */
+void SpeedwireHistoryReader::release(Chunk& chunk) {
+    if (chunk.token >= 0) {
+        command.getDemultiplexer().cancel(chunk.key);
+        command.getTokenRepository().remove(chunk.token);
+        chunk.token = -1;
+    }
+}
+
+
+/**
+ * Download the history of the given device and time range and stream the decoded records into the consumer.
+ * @param peer The inverter device.
+ * @param cmd The history command, i.e. YIELD_BY_MINUTE_QUERY, YIELD_BY_DAY_QUERY or EVENT_QUERY.
+ * @param from_time The first epoch time in seconds.
+ * @param to_time The last epoch time in seconds.
+ * @param consumer The consumer receiving the records.
+ * @param cursor If not null, the download starts at the cursor, if it is later than from_time, and the cursor is
+ *        advanced as chunks complete.
+ * @param timeout_in_ms Maximum time between two fragments of a chunk.
+ * @return The number of records delivered, or -1 if a chunk could not be downloaded.
+ */
+int64_t SpeedwireHistoryReader::download(const SpeedwireDevice& peer, const Command cmd, const uint32_t from_time, const uint32_t to_time,
+                                         SpeedwireHistoryConsumer& consumer, SpeedwireHistoryCursor* cursor, const int timeout_in_ms) {
+    SpeedwireResponseDemultiplexer& demultiplexer = command.getDemultiplexer();
+    const uint32_t chunk_duration = getChunkDuration(cmd);
+    uint64_t next_time = std::max(from_time, (cursor != nullptr ? cursor->get(peer, cmd) : 0u));
+    std::deque<Chunk> chunks;
+    int64_t num_records = 0;
+    bool failed = false;
+
+    while (failed == false && (chunks.size() > 0 || next_time <= to_time)) {
+
+        // keep up to max_in_flight chunk queries in flight
+        while (chunks.size() < maxInFlight && next_time <= to_time) {
+            Chunk chunk;
+            chunk.firstTime = (uint32_t)next_time;
+            chunk.lastTime = (uint32_t)std::min((uint64_t)to_time, next_time + chunk_duration - 1);
+            chunk.token = -1;
+            chunk.key = 0;
+            chunk.retries = 0;
+            chunk.fragmentsExpected = 0;
+            chunk.fragmentsReceived = 0;
+            chunk.complete = false;
+            next_time = (uint64_t)chunk.lastTime + 1;
+            if (send(peer, cmd, chunk, timeout_in_ms) == false) {
+                failed = true;
+                break;
+            }
+            chunks.push_back(chunk);
+        }
+        if (failed) {
+            break;
+        }
+
+        // decode all fragments that have been received so far
+        uint64_t earliest_deadline = UINT64_MAX;
+        for (auto& chunk : chunks) {
+            SpeedwireReply reply;
+            while (chunk.complete == false && demultiplexer.takeReply(chunk.key, reply)) {
+                const SpeedwireHeader speedwire_packet(reply.packet.data(), (unsigned long)reply.packet.size());
+                if (command.checkReply(speedwire_packet, AddressConversion::toSockAddr(reply.src), command.getTokenRepository().at(chunk.token)) == false) {
+                    continue;
+                }
+                const SpeedwireInverterProtocol fragment(speedwire_packet);
+                const uint16_t counter = fragment.getFragmentCounter();
+                ++numFragments;
+                chunk.deadline = LocalHost::getTickCountInMs() + (timeout_in_ms > 0 ? timeout_in_ms : 0);
+                if (fragment.getErrorCode() != 0x0000) {
+                    if (fragment.getErrorCode() == 0x0017) {
+                        logger.print(LogLevel::LOG_ERROR, "lost connection - not authenticated (error code 0x0017)");
+                        command.getTokenRepository().needs_login = true;
+                        failed = true;
+                        break;
+                    }
+                    // the device has no records in this time range
+                    chunk.complete = true;
+                    break;
+                }
+                if (addFragment(chunk, counter) == false) {
+                    continue;
+                }
+                const size_t n = decode(peer, fragment, consumer);
+                num_records += n;
+                numRecords += n;
+            }
+            if (chunk.complete) {
+                release(chunk);
+            }
+            else {
+                earliest_deadline = std::min(earliest_deadline, chunk.deadline);
+            }
+        }
+
+        // advance the cursor across the leading completed chunks
+        while (chunks.size() > 0 && chunks.front().complete) {
+            if (cursor != nullptr) {
+                cursor->set(peer, cmd, chunks.front().lastTime + 1);
+            }
+            chunks.pop_front();
+        }
+
+        // retry chunks that timed out or missed fragments
+        const uint64_t now = LocalHost::getTickCountInMs();
+        for (auto& chunk : chunks) {
+            if (failed == false && chunk.complete == false && chunk.deadline <= now) {
+                release(chunk);
+                if (chunk.retries++ >= maxRetries) {
+                    logger.print(LogLevel::LOG_ERROR, "history download timeout for %u..%u", chunk.firstTime, chunk.lastTime);
+                    failed = true;
+                }
+                else {
+                    ++numRetries;
+                    failed = (send(peer, cmd, chunk, timeout_in_ms) == false);
+                }
+            }
+        }
+
+        if (failed == false && chunks.size() > 0 && earliest_deadline > now) {
+            const uint64_t wait = std::min(earliest_deadline - now, (uint64_t)100);
+            if (demultiplexer.receive((int)wait) < 0) {
+                failed = true;
+            }
+        }
+    }
+
+    for (auto& chunk : chunks) {
+        release(chunk);
+    }
+    return (failed ? -1 : num_records);
+}
@@ -0,0 +1,160 @@
+#include <SpeedwirePacketIdAllocator.hpp>
+#include <LocalHost.hpp>
+using namespace libspeedwire;
+
+const size_t   SpeedwirePacketIdAllocator::num_shards;
+const uint32_t SpeedwirePacketIdAllocator::num_ids;
+
+
+/**
+ * Constructor. New id spaces start at a packet id derived from the tick count, such that replies to requests of a
+ * previous process instance are unlikely to match.
+ */
+SpeedwirePacketIdAllocator::SpeedwirePacketIdAllocator(void) :
+    seed((uint16_t)(LocalHost::getTickCountInMs() & (num_ids - 1))) {}
+
+
+/**
+ * Get the shard holding the id space of the given device.
+ */
+SpeedwirePacketIdAllocator::Shard& SpeedwirePacketIdAllocator::getShard(const uint64_t device_key) {
+    const uint64_t hash = (device_key ^ (device_key >> 29)) * 0x9e3779b97f4a7c15ull;
+    return shards[(hash >> 59) & (num_shards - 1)];
+}
+
+
+/**
+ * Get the id space of the given device; it is created if it does not yet exist. The shard mutex must be held.
+ */
+SpeedwirePacketIdAllocator::Space& SpeedwirePacketIdAllocator::getSpace(Shard& shard, const uint64_t device_key) {
+    std::unordered_map<uint64_t, Space>::iterator it = shard.spaces.find(device_key);
+    if (it != shard.spaces.end()) {
+        return it->second;
+    }
+    Space& space = shard.spaces[device_key];
+    space.next = seed;
+    space.session = 0;
+    space.numInFlight = 0;
+    space.inFlight.assign(num_ids / 64, 0);
+    return space;
+}
+
+
+/**
+ * Allocate a packet id for a request to the given device. The packet id is marked as in flight until it is released.
+ * @param susyid The susy id of the device.
+ * @param serialnumber The serial number of the device.
+ * @return The packet id, with the 0x8000 flag set, or 0 if all packet ids of the device are in flight.
+ */
+uint16_t SpeedwirePacketIdAllocator::allocate(const uint16_t susyid, const uint32_t serialnumber) {
+    const uint64_t device_key = getDeviceKey(susyid, serialnumber);
+    Shard& shard = getShard(device_key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Space& space = getSpace(shard, device_key);
+    if (space.numInFlight >= num_ids) {
+        return 0;
+    }
+    // skip packet ids in flight; at least one id is available
+    uint16_t id = space.next;
+    while ((space.inFlight[id >> 6] & ((uint64_t)1 << (id & 63))) != 0) {
+        id = (id + 1) & (num_ids - 1);
+    }
+    space.inFlight[id >> 6] |= ((uint64_t)1 << (id & 63));
+    ++space.numInFlight;
+    space.next = (id + 1) & (num_ids - 1);
+    return (uint16_t)(id | 0x8000);
+}
+
+
+/**
+ * Release a packet id once the request is complete or has expired; the packet id can then be allocated again.
+ * @param susyid The susy id of the device.
+ * @param serialnumber The serial number of the device.
+ * @param packetid The packet id.
+ */
+void SpeedwirePacketIdAllocator::release(const uint16_t susyid, const uint32_t serialnumber, const uint16_t packetid) {
+    const uint64_t device_key = getDeviceKey(susyid, serialnumber);
+    Shard& shard = getShard(device_key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    std::unordered_map<uint64_t, Space>::iterator it = shard.spaces.find(device_key);
+    if (it == shard.spaces.end()) {
+        return;
+    }
+    Space& space = it->second;
+    const uint16_t id = packetid & (num_ids - 1);
+    const uint64_t mask = ((uint64_t)1 << (id & 63));
+    if ((space.inFlight[id >> 6] & mask) != 0) {
+        space.inFlight[id >> 6] &= ~mask;
+        --space.numInFlight;
+    }
+}
+
+
+/**
+ * Begin a new session with the given device, e.g. after a successful login. Packet ids still in flight stay reserved.
+ * @param susyid The susy id of the device.
+ * @param serialnumber The serial number of the device.
+ * @return The new session number.
+ */
+uint32_t SpeedwirePacketIdAllocator::beginSession(const uint16_t susyid, const uint32_t serialnumber) {
+    const uint64_t device_key = getDeviceKey(susyid, serialnumber);
+    Shard& shard = getShard(device_key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Space& space = getSpace(shard, device_key);
+    space.next = (space.next + num_ids / 2) & (num_ids - 1);
+    return ++space.session;
+}
+
+
+/**
+ * Begin a new session with all known devices, e.g. after a broadcast login.
+ */
+void SpeedwirePacketIdAllocator::beginSession(void) {
+    for (size_t i = 0; i < num_shards; ++i) {
+        std::lock_guard<std::mutex> lock(shards[i].mutex);
+        for (auto& entry : shards[i].spaces) {
+            entry.second.next = (entry.second.next + num_ids / 2) & (num_ids - 1);
+            ++entry.second.session;
+        }
+    }
+}
+
+
+/**
+ * Get the current session number of the given device; it is 0 before the first session.
+ */
+uint32_t SpeedwirePacketIdAllocator::getSession(const uint16_t susyid, const uint32_t serialnumber) {
+    const uint64_t device_key = getDeviceKey(susyid, serialnumber);
+    Shard& shard = getShard(device_key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    std::unordered_map<uint64_t, Space>::const_iterator it = shard.spaces.find(device_key);
+    return (it != shard.spaces.end() ? it->second.session : 0);
+}
+
+
+/**
+ * Get the number of packet ids in flight to the given device.
+ */
+uint32_t SpeedwirePacketIdAllocator::getInFlightCount(const uint16_t susyid, const uint32_t serialnumber) {
+    const uint64_t device_key = getDeviceKey(susyid, serialnumber);
+    Shard& shard = getShard(device_key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    std::unordered_map<uint64_t, Space>::const_iterator it = shard.spaces.find(device_key);
+    return (it != shard.spaces.end() ? it->second.numInFlight : 0);
+}
+
+
+/**
+ * Check if the given packet id is in flight to the given device.
+ */
+bool SpeedwirePacketIdAllocator::isInFlight(const uint16_t susyid, const uint32_t serialnumber, const uint16_t packetid) {
+    const uint64_t device_key = getDeviceKey(susyid, serialnumber);
+    Shard& shard = getShard(device_key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    std::unordered_map<uint64_t, Space>::const_iterator it = shard.spaces.find(device_key);
+    if (it == shard.spaces.end()) {
+        return false;
+    }
+    const uint16_t id = packetid & (num_ids - 1);
+    return (it->second.inFlight[id >> 6] & ((uint64_t)1 << (id & 63))) != 0;
+}
@@ -0,0 +1,320 @@
+#include <string.h>
+#include <algorithm>
+#include <SpeedwirePollingScheduler.hpp>
+#include <SpeedwireHeader.hpp>
+#include <SpeedwireData2Packet.hpp>
+#include <SpeedwireInverterProtocol.hpp>
+#include <LocalHost.hpp>
+using namespace libspeedwire;
+
+
+/**
+ * Constructor of the SpeedwirePollingScheduler instance.
+ * @param _command Reference to the command instance used to send queries.
+ * @param requests_per_second Sustained number of requests per second and device.
+ * @param max_burst Maximum number of requests sent back to back to a single device.
+ */
+SpeedwirePollingScheduler::SpeedwirePollingScheduler(SpeedwireCommand& _command, const double requests_per_second, const unsigned max_burst) :
+    command(_command),
+    planner(),
+    requestsPerSecond(requests_per_second),
+    maxBurst(max_burst > 0 ? max_burst : 1),
+    numRequests(0),
+    numDeferred(0) {}
+
+
+/**
+ * Get default polling intervals for the given item. Device information is polled rarely, status items have a low maximum
+ * interval such that status changes are noticed quickly, and measurements are polled at the rate of change.
+ * @param data The item.
+ * @param min_interval_in_ms Returns the minimum polling interval in ms.
+ * @param max_interval_in_ms Returns the maximum polling interval in ms.
+ */
+void SpeedwirePollingScheduler::getDefaultIntervals(const SpeedwireData& data, uint32_t& min_interval_in_ms, uint32_t& max_interval_in_ms) {
+    if (data.command == Command::DEVICE_QUERY || (data.id & 0x00ff0000) == 0x00820000 || data.id == SpeedwireData::InverterNominalPower.id) {
+        min_interval_in_ms = 60000;     // device name, type, software version and nominal power
+        max_interval_in_ms = 3600000;
+    }
+    else if (data.command == Command::STATUS_QUERY) {
+        min_interval_in_ms = 2000;
+        max_interval_in_ms = 10000;
+    }
+    else if (data.command == Command::ENERGY_QUERY) {
+        min_interval_in_ms = 5000;
+        max_interval_in_ms = 60000;
+    }
+    else {
+        min_interval_in_ms = 1000;
+        max_interval_in_ms = 30000;
+    }
+}
+
+
+/**
+ * Add an item to be polled from the given device; if the item is already polled, its intervals are replaced.
+ * The item is due immediately.
+ * @param device The device.
+ * @param data The item.
+ * @param min_interval_in_ms Minimum polling interval in ms.
+ * @param max_interval_in_ms Maximum polling interval in ms.
+ */
+void SpeedwirePollingScheduler::add(const SpeedwireDevice& device, const SpeedwireData& data, const uint32_t min_interval_in_ms, const uint32_t max_interval_in_ms) {
+    DeviceState& state = devices[device.deviceAddress.serialNumber];
+    if (state.entries.size() == 0) {
+        state.budget = maxBurst;
+        state.budgetTime = 0;
+    }
+    state.device = device;
+
+    for (auto& entry : state.entries) {
+        if (entry.data.command == data.command && entry.data.id == data.id && entry.data.conn == data.conn) {
+            entry.minInterval = min_interval_in_ms;
+            entry.maxInterval = std::max(min_interval_in_ms, max_interval_in_ms);
+            entry.interval = min_interval_in_ms;
+            entry.nextPoll = 0;
+            return;
+        }
+    }
+    Entry entry;
+    entry.data = data;
+    entry.minInterval = min_interval_in_ms;
+    entry.maxInterval = std::max(min_interval_in_ms, max_interval_in_ms);
+    entry.interval = min_interval_in_ms;
+    entry.nextPoll = 0;
+    entry.lastDataSize = 0;
+    entry.numUpdates = 0;
+    entry.numChanges = 0;
+    state.entries.push_back(entry);
+}
+
+
+/**
+ * Add an item to be polled from the given device using its default polling intervals.
+ * @param device The device.
+ * @param data The item.
+ */
+void SpeedwirePollingScheduler::add(const SpeedwireDevice& device, const SpeedwireData& data) {
+    uint32_t min_interval = 0, max_interval = 0;
+    getDefaultIntervals(data, min_interval, max_interval);
+    add(device, data, min_interval, max_interval);
+}
+
+
+/**
+ * Remove all items of the given device.
+ * @param device The device.
+ */
+void SpeedwirePollingScheduler::remove(const SpeedwireDevice& device) {
+    devices.erase(device.deviceAddress.serialNumber);
+}
+
+
+/**
+ * Get all queries that are due and within the request budget of their device. Due items are coalesced by the query planner;
+ * the planned queries are ordered by urgency, i.e. by the largest overdue time of their items relative to the item interval.
+ * Items covered by a returned query are rescheduled as if they had been polled successfully.
+ * @param now The current local tick count in ms.
+ * @return The queries to be sent.
+ */
+std::vector<SpeedwireScheduledQuery> SpeedwirePollingScheduler::getDueQueries(const uint64_t now) {
+    std::vector<SpeedwireScheduledQuery> queries;
+
+    for (auto& device : devices) {
+        DeviceState& state = device.second;
+
+        // refill the request budget
+        if (now > state.budgetTime) {
+            state.budget = std::min(maxBurst, state.budget + (double)(now - state.budgetTime) * requestsPerSecond / 1000.0);
+            state.budgetTime = now;
+        }
+
+        SpeedwireDataMap due;
+        for (const auto& entry : state.entries) {
+            if (entry.nextPoll <= now) {
+                due.add(entry.data);
+            }
+        }
+        if (due.size() == 0) {
+            continue;
+        }
+        const SpeedwireQueryPlan plan = planner.createPlan(due);
+
+        // order the planned queries by urgency
+        std::vector<std::pair<double, size_t> > urgencies;
+        for (size_t i = 0; i < plan.size(); ++i) {
+            double urgency = 0.0;
+            for (const auto& entry : state.entries) {
+                if (entry.nextPoll <= now && entry.data.command == plan[i].command &&
+                    entry.data.id >= plan[i].firstRegister && entry.data.id <= plan[i].lastRegister) {
+                    urgency = std::max(urgency, (double)(now - entry.nextPoll) / (double)(entry.interval > 0 ? entry.interval : 1));
+                }
+            }
+            urgencies.push_back(std::pair<double, size_t>(-urgency, i));
+        }
+        std::stable_sort(urgencies.begin(), urgencies.end());
+
+        for (const auto& urgency : urgencies) {
+            const SpeedwireQueryRange& range = plan[urgency.second];
+            if (state.budget < 1.0) {
+                ++numDeferred;
+                continue;
+            }
+            state.budget -= 1.0;
+            ++numRequests;
+            queries.push_back(SpeedwireScheduledQuery(state.device, range));
+            for (auto& entry : state.entries) {
+                if (entry.nextPoll <= now && entry.data.command == range.command &&
+                    entry.data.id >= range.firstRegister && entry.data.id <= range.lastRegister) {
+                    entry.nextPoll = now + entry.interval;
+                }
+            }
+        }
+    }
+    return queries;
+}
+
+
+/**
+ * Update all items matching the given reply data element and adapt their polling intervals.
+ * @param device The device the reply has been received from.
+ * @param raw_data The reply data element.
+ * @param now The current local tick count in ms.
+ * @param consumer If not null, updated items are passed to this consumer.
+ * @return The number of updated items.
+ */
+size_t SpeedwirePollingScheduler::update(const SpeedwireDevice& device, const SpeedwireRawData& raw_data, const uint64_t now, SpeedwireConsumer* consumer) {
+    std::map<uint32_t, DeviceState>::iterator it = devices.find(device.deviceAddress.serialNumber);
+    if (it == devices.end()) {
+        return 0;
+    }
+    // reply command ids carry the response type in their lowest byte
+    const Command reply_command = raw_data.command & ~Command::REQUEST_TYPE_MASK;
+    size_t num_updated = 0;
+
+    for (auto& entry : it->second.entries) {
+        if ((entry.data.command & ~Command::REQUEST_TYPE_MASK) != reply_command || entry.data.id != raw_data.id || entry.data.conn != raw_data.conn) {
+            continue;
+        }
+        const size_t data_size = std::min(raw_data.data_size, sizeof(entry.lastData));
+        if (entry.lastDataSize > 0) {
+            const bool changed = (data_size != entry.lastDataSize || memcmp(entry.lastData, raw_data.data, data_size) != 0);
+            if (changed) {
+                entry.interval = entry.minInterval;
+                ++entry.numChanges;
+            }
+            else {
+                entry.interval = (entry.interval <= entry.maxInterval / 2 ? 2 * entry.interval : entry.maxInterval);
+            }
+        }
+        memcpy(entry.lastData, raw_data.data, data_size);
+        entry.lastDataSize = data_size;
+        entry.nextPoll = now + entry.interval;
+        ++entry.numUpdates;
+        ++num_updated;
+
+        if (consumer != nullptr) {
+            SpeedwireRawData raw(raw_data);
+            raw.command = entry.data.command;
+            raw.type = entry.data.type;
+            if (entry.data.consume(raw)) {
+                consumer->consume(it->second.device, entry.data);
+            }
+        }
+    }
+    return num_updated;
+}
+
+
+/**
+ * Notify the scheduler that the given query failed; the covered items are retried after their minimum interval.
+ * @param query The failed query.
+ * @param now The current local tick count in ms.
+ */
+void SpeedwirePollingScheduler::failed(const SpeedwireScheduledQuery& query, const uint64_t now) {
+    std::map<uint32_t, DeviceState>::iterator it = devices.find(query.device.deviceAddress.serialNumber);
+    if (it == devices.end()) {
+        return;
+    }
+    for (auto& entry : it->second.entries) {
+        if (entry.data.command == query.range.command && entry.data.id >= query.range.firstRegister && entry.data.id <= query.range.lastRegister) {
+            entry.nextPoll = std::min(entry.nextPoll, now + entry.minInterval);
+        }
+    }
+}
+
+
+/**
+ * Send all due queries, wait for their replies and update the polled items. This is a synchronous call; queries are
+ * sent one after the other.
+ * @param consumer If not null, updated items are passed to this consumer.
+ * @param timeout_in_ms Timeout for each query.
+ * @return The number of successful queries.
+ */
+int SpeedwirePollingScheduler::poll(SpeedwireConsumer* consumer, const int timeout_in_ms) {
+    const std::vector<SpeedwireScheduledQuery> queries = getDueQueries(LocalHost::getTickCountInMs());
+    int num_successful = 0;
+
+    for (const auto& query : queries) {
+        unsigned char udp_packet[2048];
+        const int32_t nbytes = command.query(query.device, query.range.command, query.range.firstRegister, query.range.lastRegister, udp_packet, sizeof(udp_packet), timeout_in_ms);
+        const uint64_t now = LocalHost::getTickCountInMs();
+        if (nbytes <= 0) {
+            failed(query, now);
+            continue;
+        }
+        SpeedwireHeader speedwire_packet(udp_packet, nbytes);
+        if (speedwire_packet.isValidData2Packet()) {
+            SpeedwireData2Packet data2_packet(speedwire_packet);
+            if (data2_packet.isInverterProtocolID()) {
+                SpeedwireInverterProtocol inverter_packet(data2_packet);
+                std::vector<SpeedwireRawData> raw_data_vector = inverter_packet.getRawDataElements();
+                uint32_t time = 0;
+                for (const auto& raw_data : raw_data_vector) {
+                    update(query.device, raw_data, now, consumer);
+                    time = (uint32_t)raw_data.time;
+                }
+                if (consumer != nullptr && raw_data_vector.size() > 0) {
+                    consumer->endOfSpeedwireData(query.device, time);
+                }
+                ++num_successful;
+                continue;
+            }
+        }
+        failed(query, now);
+    }
+    return num_successful;
+}
+
+
+/**
+ * Get the earliest time an item is due.
+ * @return The earliest next poll time as local tick count in ms, or UINT64_MAX if no item is polled.
+ */
+uint64_t SpeedwirePollingScheduler::getNextPollTime(void) const {
+    uint64_t next_poll = UINT64_MAX;
+    for (const auto& device : devices) {
+        for (const auto& entry : device.second.entries) {
+            next_poll = std::min(next_poll, entry.nextPoll);
+        }
+    }
+    return next_poll;
+}
+
+
+/**
+ * Get the current polling interval of the given item.
+ * @param device The device.
+ * @param data The item.
+ * @return The polling interval in ms, or 0 if the item is not polled.
+ */
+uint32_t SpeedwirePollingScheduler::getInterval(const SpeedwireDevice& device, const SpeedwireData& data) const {
+    std::map<uint32_t, DeviceState>::const_iterator it = devices.find(device.deviceAddress.serialNumber);
+    if (it != devices.end()) {
+        for (const auto& entry : it->second.entries) {
+            if (entry.data.command == data.command && entry.data.id == data.id && entry.data.conn == data.conn) {
+                return entry.interval;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,378 @@
+#include <AddressConversion.hpp>
+#include <Logger.hpp>
+#include <SpeedwireInverterProtocol.hpp>
+#include <SpeedwireQueryEngine.hpp>
+#include <SpeedwireSessionManager.hpp>
+using namespace libspeedwire;
+
+static Logger logger("SpeedwireQueryEngine");
+
+
+/**
+ * Constructor.
+ * @param _command Reference to the command instance providing the unicast sockets and the token repository.
+ * @param max_in_flight_per_device Maximum number of requests in flight per device.
+ * @param max_in_flight Maximum number of requests in flight overall.
+ */
+SpeedwireQueryEngine::SpeedwireQueryEngine(SpeedwireCommand& _command, const unsigned max_in_flight_per_device, const unsigned max_in_flight) :
+    command(_command),
+    maxInFlightPerDevice(max_in_flight_per_device > 0 ? max_in_flight_per_device : 1),
+    maxInFlight(max_in_flight > 0 ? max_in_flight : 1),
+    inFlight(0),
+    nextId(1),
+    lastDevice(0),
+    sessions(nullptr) {}
+
+
+/**
+ * Destructor. Tokens of requests still in flight are removed from the token repository.
+ */
+SpeedwireQueryEngine::~SpeedwireQueryEngine(void) {
+    for (auto& entry : tokens) {
+        command.getTokenRepository().remove(entry.first);
+    }
+}
+
+
+/**
+ * Submit a query; the callback is called from within poll() once the query completes.
+ * @param peer The device to query.
+ * @param cmd The query command.
+ * @param first_register The first register.
+ * @param last_register The last register.
+ * @param callback The callback receiving the query result.
+ * @param timeout_in_ms The timeout counted from submission.
+ * @return The request id.
+ */
+uint32_t SpeedwireQueryEngine::submit(const SpeedwireDevice& peer, const Command cmd, const uint32_t first_register, const uint32_t last_register,
+                                      SpeedwireQueryCallback& callback, const int timeout_in_ms) {
+    return submitRequest(peer, cmd, first_register, last_register, timeout_in_ms, &callback, std::shared_ptr<std::promise<SpeedwireQueryResponse> >());
+}
+
+
+/**
+ * Submit a query; the returned future is fulfilled from within poll() once the query completes.
+ * @param peer The device to query.
+ * @param cmd The query command.
+ * @param first_register The first register.
+ * @param last_register The last register.
+ * @param timeout_in_ms The timeout counted from submission.
+ * @return The future.
+ */
+std::future<SpeedwireQueryResponse> SpeedwireQueryEngine::submit(const SpeedwireDevice& peer, const Command cmd, const uint32_t first_register, const uint32_t last_register,
+                                                                 const int timeout_in_ms) {
+    std::shared_ptr<std::promise<SpeedwireQueryResponse> > promise(new std::promise<SpeedwireQueryResponse>());
+    std::future<SpeedwireQueryResponse> future = promise->get_future();
+    submitRequest(peer, cmd, first_register, last_register, timeout_in_ms, nullptr, promise);
+    return future;
+}
+
+
+/**
+ * Queue a new request and register its deadline.
+ */
+uint32_t SpeedwireQueryEngine::submitRequest(const SpeedwireDevice& peer, const Command cmd, const uint32_t first_register, const uint32_t last_register, const int timeout_in_ms,
+                                             SpeedwireQueryCallback* callback, const std::shared_ptr<std::promise<SpeedwireQueryResponse> >& promise) {
+    const uint32_t id = nextId++;
+    if (nextId == 0) nextId = 1;
+
+    Request& request = requests[id];
+    request.id = id;
+    request.peer = peer;
+    request.command = cmd;
+    request.firstRegister = first_register;
+    request.lastRegister = last_register;
+    request.timeout = (timeout_in_ms > 0 ? timeout_in_ms : 0);
+    request.deadline = LocalHost::getTickCountInMs() + request.timeout;
+    request.sendTime = 0;
+    request.token = -1;
+    request.requeued = false;
+    request.callback = callback;
+    request.promise = promise;
+
+    devices[peer.deviceAddress.serialNumber].queued.push_back(id);
+    deadlines.push(Deadline(request.deadline, id));
+    return id;
+}
+
+
+/**
+ * Send queued requests as far as the in-flight limits permit; devices are served round-robin. All selected requests are
+ * sent as one batch.
+ * @return The number of requests sent.
+ */
+int SpeedwireQueryEngine::sendQueued(void) {
+    batch.clear();
+    batchIds.clear();
+
+    // select queued requests; in-flight slots are reserved until the batch has been sent
+    bool progress = true;
+    while (progress && inFlight < maxInFlight) {
+        progress = false;
+
+        // start with the device following the one served last
+        std::map<uint32_t, DeviceQueue>::iterator it = devices.upper_bound(lastDevice);
+        for (size_t i = 0; i < devices.size() && inFlight < maxInFlight; ++i, ++it) {
+            if (it == devices.end()) {
+                it = devices.begin();
+            }
+            DeviceQueue& queue = it->second;
+            if (queue.queued.empty() || queue.inFlight >= maxInFlightPerDevice) {
+                continue;
+            }
+            // hold back requests to devices waiting for a login
+            if (sessions != nullptr && sessions->needsLogin(requests[queue.queued.front()].peer)) {
+                continue;
+            }
+            const uint32_t id = queue.queued.front();
+            queue.queued.pop_front();
+            lastDevice = it->first;
+            progress = true;
+
+            const Request& request = requests[id];
+            batch.push_back(SpeedwireQueryRequest(request.peer, request.command, request.firstRegister, request.lastRegister));
+            batchIds.push_back(id);
+            ++queue.inFlight;
+            ++inFlight;
+        }
+    }
+    if (batch.size() == 0) {
+        return 0;
+    }
+
+    command.sendQueryRequests(batch);
+
+    const uint64_t now = LocalHost::getTickCountInMs();
+    int nsent = 0;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        std::unordered_map<uint32_t, Request>::iterator it = requests.find(batchIds[i]);
+        if (it == requests.end()) {
+            continue;
+        }
+        Request& request = it->second;
+        if (batch[i].token < 0) {
+            // release the reserved slot; completion callbacks may modify the device map
+            std::map<uint32_t, DeviceQueue>::iterator device = devices.find(request.peer.deviceAddress.serialNumber);
+            if (device != devices.end()) {
+                --device->second.inFlight;
+            }
+            --inFlight;
+            complete(batchIds[i], SpeedwireQueryStatus::SEND_FAILED, 0, nullptr, 0);
+            continue;
+        }
+        request.token = batch[i].token;
+        request.sendTime = now;
+        tokens[batch[i].token] = batchIds[i];
+        ++nsent;
+    }
+    return nsent;
+}
+
+
+/**
+ * Put the given in-flight request back to the front of its device queue, such that it is sent again. The deadline is
+ * extended by the request timeout, such that the request is not expired while its device is logged in again.
+ */
+void SpeedwireQueryEngine::requeue(const uint32_t id) {
+    std::unordered_map<uint32_t, Request>::iterator it = requests.find(id);
+    if (it == requests.end() || it->second.token < 0) {
+        return;
+    }
+    Request& request = it->second;
+    const SpeedwireCommandToken& token = command.getTokenRepository().at(request.token);
+    command.getDemultiplexer().cancel(SpeedwireCommandTokenRepository::getKey(token.susyid, token.serialnumber, token.packetid));
+    command.getTokenRepository().remove(request.token);
+    tokens.erase(request.token);
+    request.token = -1;
+    request.sendTime = 0;
+    request.requeued = true;
+    request.deadline = LocalHost::getTickCountInMs() + request.timeout;
+    deadlines.push(Deadline(request.deadline, id));
+    --inFlight;
+    DeviceQueue& queue = devices[request.peer.deviceAddress.serialNumber];
+    if (queue.inFlight > 0) {
+        --queue.inFlight;
+    }
+    queue.queued.push_front(id);
+}
+
+
+/**
+ * Complete the given request and notify its callback or fulfill its promise.
+ */
+void SpeedwireQueryEngine::complete(const uint32_t id, const SpeedwireQueryStatus status, const uint16_t error_code, const uint8_t* packet, const size_t packet_size) {
+    std::unordered_map<uint32_t, Request>::iterator it = requests.find(id);
+    if (it == requests.end()) {
+        return;
+    }
+    // move the request out of all data structures before calling back, such that callbacks can submit new requests
+    Request request = it->second;
+    requests.erase(it);
+    std::map<uint32_t, DeviceQueue>::iterator device = devices.find(request.peer.deviceAddress.serialNumber);
+    if (request.token >= 0) {
+        const SpeedwireCommandToken& token = command.getTokenRepository().at(request.token);
+        command.getDemultiplexer().cancel(SpeedwireCommandTokenRepository::getKey(token.susyid, token.serialnumber, token.packetid));
+        command.getTokenRepository().remove(request.token);
+        tokens.erase(request.token);
+        --inFlight;
+        if (device != devices.end()) {
+            --device->second.inFlight;
+        }
+    }
+    else if (device != devices.end()) {
+        std::deque<uint32_t>& queued = device->second.queued;
+        for (std::deque<uint32_t>::iterator q = queued.begin(); q != queued.end(); ++q) {
+            if (*q == id) { queued.erase(q); break; }
+        }
+    }
+    if (device != devices.end() && device->second.inFlight == 0 && device->second.queued.empty()) {
+        devices.erase(device);
+    }
+
+    if (request.callback != nullptr) {
+        SpeedwireQueryResult result;
+        result.requestId = id;
+        result.status = status;
+        result.peer = request.peer.deviceAddress;
+        result.command = request.command;
+        result.firstRegister = request.firstRegister;
+        result.lastRegister = request.lastRegister;
+        result.errorCode = error_code;
+        result.roundTripTime = (request.sendTime != 0 && packet != nullptr ? (uint32_t)(LocalHost::getTickCountInMs() - request.sendTime) : 0);
+        result.packet = packet;
+        result.packetSize = packet_size;
+        request.callback->onQueryComplete(result);
+    }
+    if (request.promise) {
+        SpeedwireQueryResponse response;
+        response.status = status;
+        response.errorCode = error_code;
+        if (packet != nullptr) {
+            response.packet.assign(packet, packet + packet_size);
+        }
+        request.promise->set_value(response);
+    }
+}
+
+
+/**
+ * Receive replies through the response demultiplexer and complete the matching requests.
+ * @param timeout_in_ms Poll timeout in ms.
+ * @return The number of completed requests.
+ */
+int SpeedwireQueryEngine::receive(const int timeout_in_ms) {
+    SpeedwireResponseDemultiplexer& demultiplexer = command.getDemultiplexer();
+    if (demultiplexer.receive(timeout_in_ms) < 0) {
+        return -1;
+    }
+
+    // completions modify the token map, hence collect the in-flight requests first
+    inFlightTokens.clear();
+    for (auto& entry : tokens) {
+        inFlightTokens.push_back(entry);
+    }
+    int ncompleted = 0;
+    SpeedwireReply reply;
+    for (auto& entry : inFlightTokens) {
+        const SpeedwireCommandToken& token = command.getTokenRepository().at(entry.first);
+        const uint64_t key = SpeedwireCommandTokenRepository::getKey(token.susyid, token.serialnumber, token.packetid);
+        while (requests.find(entry.second) != requests.end() && demultiplexer.takeReply(key, reply) == true) {
+            const SpeedwireHeader speedwire_packet(reply.packet.data(), (unsigned long)reply.packet.size());
+            if (command.checkReply(speedwire_packet, AddressConversion::toSockAddr(reply.src), token) == false) {
+                continue;
+            }
+            const SpeedwireData2Packet data2_packet(speedwire_packet);
+            const SpeedwireInverterProtocol inverter_packet(data2_packet);
+            const uint16_t error_code = inverter_packet.getErrorCode();
+            SpeedwireQueryStatus status = SpeedwireQueryStatus::OK;
+            if (error_code == 0x0017) {
+                logger.print(LogLevel::LOG_ERROR, "lost connection - not authenticated (error code 0x0017)");
+                command.getTokenRepository().needs_login = true;
+                status = SpeedwireQueryStatus::NOT_AUTHENTICATED;
+
+                // re-login transparently and send the request again
+                const Request& request = requests[entry.second];
+                if (sessions != nullptr && sessions->isManaged(request.peer) && request.requeued == false) {
+                    sessions->invalidate(request.peer);
+                    requeue(entry.second);
+                    break;
+                }
+            }
+            else if (error_code != 0x0000) {
+                status = SpeedwireQueryStatus::ERROR_CODE;
+            }
+            complete(entry.second, status, error_code, reply.packet.data(), reply.packet.size());
+            ++ncompleted;
+        }
+    }
+    return ncompleted;
+}
+
+
+/**
+ * Complete all requests whose deadline has passed.
+ * @return The number of expired requests.
+ */
+int SpeedwireQueryEngine::expire(void) {
+    const uint64_t now = LocalHost::getTickCountInMs();
+    int nexpired = 0;
+    while (deadlines.empty() == false && deadlines.top().first <= now) {
+        const uint32_t id = deadlines.top().second;
+        deadlines.pop();
+        // completed and requeued requests leave stale heap entries behind; they are skipped here
+        std::unordered_map<uint32_t, Request>::const_iterator it = requests.find(id);
+        if (it != requests.end() && it->second.deadline <= now) {
+            complete(id, SpeedwireQueryStatus::TIMEOUT, 0, nullptr, 0);
+            ++nexpired;
+        }
+    }
+    return nexpired;
+}
+
+
+/**
+ * Send queued requests, wait up to the given time for replies, and expire overdue requests.
+ * @param timeout_in_ms Maximum time to wait for replies; the wait ends earlier at the next deadline.
+ * @return The number of completed requests, or -1 on poll failure.
+ */
+int SpeedwireQueryEngine::poll(const int timeout_in_ms) {
+    if (sessions != nullptr) {
+        sessions->poll(0);
+    }
+    sendQueued();
+
+    int wait_time = timeout_in_ms;
+    while (deadlines.empty() == false && requests.find(deadlines.top().second) == requests.end()) {
+        deadlines.pop();
+    }
+    if (deadlines.empty() == false) {
+        const uint64_t now = LocalHost::getTickCountInMs();
+        const uint64_t next = deadlines.top().first;
+        const int until_deadline = (next > now ? (int)(next - now) : 0);
+        if (until_deadline < wait_time) wait_time = until_deadline;
+    }
+    const int nreceived = receive(wait_time);
+    const int nexpired = expire();
+
+    sendQueued();
+    return (nreceived < 0 ? -1 : nreceived + nexpired);
+}
+
+
+/**
+ * Call poll() until all submitted requests have completed or the given time has elapsed.
+ * @param timeout_in_ms Maximum run time in ms.
+ * @return The number of completed requests.
+ */
+int SpeedwireQueryEngine::run(const int timeout_in_ms) {
+    const uint64_t end = LocalHost::getTickCountInMs() + (timeout_in_ms > 0 ? timeout_in_ms : 0);
+    int ncompleted = 0;
+    while (requests.empty() == false) {
+        const uint64_t now = LocalHost::getTickCountInMs();
+        if (now >= end) break;
+        const int n = poll((int)(end - now));
+        if (n < 0) break;
+        ncompleted += n;
+    }
+    return ncompleted;
+}
@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <SpeedwireQueryPlanner.hpp>
+using namespace libspeedwire;
+
+const size_t SpeedwireQueryPlanner::max_cache_size;
+
+
+/**
+ * Constructor of the SpeedwireQueryPlanner instance.
+ * @param default_max_response_size Maximum response payload size in bytes for commands without a known limit.
+ * @param max_register_gap Maximum number of unrequested registers between two registers merged into the same request.
+ */
+SpeedwireQueryPlanner::SpeedwireQueryPlanner(const size_t default_max_response_size, const uint32_t max_register_gap) :
+    defaultMaxResponseSize(default_max_response_size),
+    maxRegisterGap(max_register_gap) {}
+
+
+/**
+ * Set the known maximum response payload size for the given command; cached plans are discarded.
+ * @param command The query command.
+ * @param max_response_size The maximum response payload size in bytes.
+ */
+void SpeedwireQueryPlanner::setMaxResponseSize(const Command command, const size_t max_response_size) {
+    maxResponseSizes[command] = max_response_size;
+    cache.clear();
+}
+
+
+/**
+ * Get the maximum response payload size for the given command.
+ * @param command The query command.
+ * @return The known maximum response payload size, or the default if it is not known.
+ */
+size_t SpeedwireQueryPlanner::getMaxResponseSize(const Command command) const {
+    std::map<Command, size_t>::const_iterator it = maxResponseSizes.find(command);
+    return (it != maxResponseSizes.end() ? it->second : defaultMaxResponseSize);
+}
+
+
+/**
+ * Get the size of a single response record of the given data type, i.e. register id, timestamp and data words.
+ * @param type The data type.
+ * @return The record size in bytes, or 0 for timeline data types.
+ */
+size_t SpeedwireQueryPlanner::getRecordSize(const SpeedwireDataType type) {
+    switch (type & SpeedwireDataType::TypeMask) {
+    case SpeedwireDataType::Unsigned32:
+    case SpeedwireDataType::Signed32:
+    case SpeedwireDataType::Float:
+        return 4 + 4 + 5 * 4;   // value, min, max and two further words
+    case SpeedwireDataType::Status32:
+    case SpeedwireDataType::String32:
+        return 4 + 4 + 32;      // eight status words or 32 characters
+    default:
+        return 0;
+    }
+}
+
+
+/**
+ * Get the sorted signature of the given items; two item sets with the same signature result in the same plan.
+ */
+std::vector<uint64_t> SpeedwireQueryPlanner::getSignature(const SpeedwireDataMap& items) {
+    std::vector<uint64_t> signature;
+    signature.reserve(items.size());
+    for (const auto& item : items) {
+        signature.push_back(((uint64_t)item.second.command << 32) | (uint64_t)item.second.toKey());
+    }
+    std::sort(signature.begin(), signature.end());
+    return signature;
+}
+
+
+/**
+ * Get the query plan for the given items. The plan is taken from the cache if a plan for the same items exists,
+ * otherwise it is created and cached.
+ * @param items The requested items.
+ * @return A reference to the cached plan; it is valid until the cache is cleared, i.e. by clear(), setMaxResponseSize()
+ *         or a call to getPlan() creating a new plan while the cache is full.
+ */
+const SpeedwireQueryPlan& SpeedwireQueryPlanner::getPlan(const SpeedwireDataMap& items) {
+    const std::vector<uint64_t> signature = getSignature(items);
+    std::map<std::vector<uint64_t>, SpeedwireQueryPlan>::const_iterator it = cache.find(signature);
+    if (it != cache.end()) {
+        return it->second;
+    }
+    if (cache.size() >= max_cache_size) {
+        cache.clear();
+    }
+    return cache[signature] = createPlan(items);
+}
+
+
+/**
+ * Create the query plan for the given items.
+ * For each command, registers are visited in ascending order and the current request is extended as long as the
+ * register gap and the estimated response size permit; both limits grow monotonically with the request range,
+ * therefore this greedy approach yields the minimum number of requests.
+ * @param items The requested items.
+ * @return The query plan, ordered by command and register id.
+ */
+SpeedwireQueryPlan SpeedwireQueryPlanner::createPlan(const SpeedwireDataMap& items) const {
+
+    // collect the requested registers per command; each register holds one record per requested connector
+    typedef struct Register {
+        size_t numRecords;
+        size_t numItems;
+        size_t recordSize;
+        Register(void) : numRecords(0), numItems(0), recordSize(0) {}
+    } Register;
+    std::map<Command, std::map<uint32_t, Register> > registers;
+    for (const auto& item : items) {
+        const SpeedwireData& data = item.second;
+        const size_t record_size = getRecordSize(data.type);
+        if (record_size == 0) {
+            continue;
+        }
+        Register& reg = registers[data.command][data.id & 0x00ffff00];
+        reg.numRecords += 1;
+        reg.numItems   += 1;
+        reg.recordSize  = std::max(reg.recordSize, record_size);
+    }
+
+    SpeedwireQueryPlan plan;
+    for (const auto& command : registers) {
+        const size_t max_response_size = getMaxResponseSize(command.first);
+        bool     open = false;
+        uint32_t first = 0, last = 0;
+        size_t   num_records = 0, num_items = 0, record_size = 0;
+
+        for (const auto& entry : command.second) {
+            const uint32_t id = entry.first;
+            const Register& reg = entry.second;
+            if (open) {
+                // unrequested registers in the gap are answered with (at least) one record each
+                const uint32_t gap = (id - last) / 0x100 - 1;
+                const size_t merged_records = num_records + gap + reg.numRecords;
+                const size_t merged_size = merged_records * std::max(record_size, reg.recordSize);
+                if (gap <= maxRegisterGap && merged_size <= max_response_size) {
+                    last = id;
+                    num_records = merged_records;
+                    num_items  += reg.numItems;
+                    record_size = std::max(record_size, reg.recordSize);
+                    continue;
+                }
+                plan.push_back(SpeedwireQueryRange(command.first, first, last | 0xff, num_items, num_records * record_size));
+            }
+            open = true;
+            first = last = id;
+            num_records = reg.numRecords;
+            num_items   = reg.numItems;
+            record_size = reg.recordSize;
+        }
+        if (open) {
+            plan.push_back(SpeedwireQueryRange(command.first, first, last | 0xff, num_items, num_records * record_size));
+        }
+    }
+    return plan;
+}
@@ -0,0 +1,158 @@
+#include <string.h>
+#include <SpeedwireRequestTemplates.hpp>
+#include <SpeedwireByteEncoding.hpp>
+#include <SpeedwireHeader.hpp>
+#include <SpeedwireData2Packet.hpp>
+#include <SpeedwireInverterProtocol.hpp>
+using namespace libspeedwire;
+
+constexpr size_t SpeedwireRequestTemplates::query_request_size;
+constexpr size_t SpeedwireRequestTemplates::login_request_size;
+
+
+/**
+ * Constructor of the SpeedwireRequestTemplates instance.
+ * @param max_arena_size The maximum arena size in bytes; when it is reached, all templates are dropped.
+ */
+SpeedwireRequestTemplates::SpeedwireRequestTemplates(const size_t max_arena_size) :
+    maxArenaSize(max_arena_size) {
+    arena.reserve(max_arena_size);
+}
+
+
+/**
+ * Get the template key for the given request.
+ */
+SpeedwireRequestTemplates::Key SpeedwireRequestTemplates::getKey(const SpeedwireAddress& dst, const SpeedwireAddress& src, const Command command, const uint32_t first_register, const uint32_t last_register) {
+    Key key;
+    key.dstSerialNumber = dst.serialNumber;
+    key.srcSerialNumber = src.serialNumber;
+    key.dstSusyID = dst.susyID;
+    key.srcSusyID = src.susyID;
+    key.command = (uint32_t)command;
+    key.firstRegister = first_register;
+    key.lastRegister = last_register;
+    return key;
+}
+
+
+/**
+ * Allocate space for a template at the end of the arena; the arena is emptied first if it would exceed its maximum size.
+ * @param size The template size in bytes.
+ * @return The offset of the template in the arena.
+ */
+size_t SpeedwireRequestTemplates::allocate(const size_t size) {
+    if (arena.size() + size > maxArenaSize) {
+        arena.clear();
+        offsets.clear();
+    }
+    const size_t offset = arena.size();
+    arena.resize(offset + size, 0);
+    return offset;
+}
+
+
+/**
+ * Assemble the header fields of an inverter request packet in the arena.
+ */
+void SpeedwireRequestTemplates::assemble(const size_t offset, const size_t size, const SpeedwireAddress& dst, const SpeedwireAddress& src, const uint16_t control,
+                                         const Command command, const uint32_t first_register, const uint32_t last_register) {
+    uint8_t* const buffer = arena.data() + offset;
+    memset(buffer, 0, size);
+
+    SpeedwireHeader request_header(buffer, (unsigned long)size);
+    request_header.setDefaultHeader(1, (uint16_t)(size - 20), SpeedwireData2Packet::sma_inverter_protocol_id);
+
+    SpeedwireData2Packet data2_packet(request_header);
+    data2_packet.setControl(0xa0);
+
+    SpeedwireInverterProtocol request(request_header);
+    request.setDstSusyID(dst.susyID);
+    request.setDstSerialNumber(dst.serialNumber);
+    request.setDstControl(control);
+    request.setSrcSusyID(src.susyID);
+    request.setSrcSerialNumber(src.serialNumber);
+    request.setSrcControl(control);
+    request.setErrorCode(0);
+    request.setFragmentCounter(0);
+    request.setPacketID(0);
+    request.setCommandID(command);
+    request.setFirstRegisterID(first_register);
+    request.setLastRegisterID(last_register);
+}
+
+
+/**
+ * Copy the query request packet for the given query into the given buffer; the template is created on first use.
+ * @param dst The destination address.
+ * @param src The source address.
+ * @param command The query command.
+ * @param first_register The first register of the query.
+ * @param last_register The last register of the query.
+ * @param packet_id The packet id to be patched into the request.
+ * @param buffer The buffer receiving the request packet.
+ * @param buffer_size The buffer size in bytes.
+ * @return The request packet size in bytes, or 0 if the buffer is too small.
+ */
+size_t SpeedwireRequestTemplates::getQueryRequest(const SpeedwireAddress& dst, const SpeedwireAddress& src, const Command command, const uint32_t first_register, const uint32_t last_register,
+                                                  const uint16_t packet_id, void* buffer, const size_t buffer_size) {
+    if (buffer_size < query_request_size) {
+        return 0;
+    }
+    const Key key = getKey(dst, src, command, first_register, last_register);
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<Key, size_t>::const_iterator it = offsets.find(key);
+    size_t offset;
+    if (it != offsets.end()) {
+        offset = it->second;
+    }
+    else {
+        offset = allocate(query_request_size);
+        assemble(offset, query_request_size, dst, src, 0x0100, command, first_register, last_register);
+        offsets[key] = offset;
+    }
+    uint8_t* const request = (uint8_t*)buffer;
+    memcpy(request, arena.data() + offset, query_request_size);
+    SpeedwireByteEncoding::setUint16LittleEndian(request + packet_id_offset, packet_id);
+    return query_request_size;
+}
+
+
+/**
+ * Copy the login request packet for the given user into the given buffer; the template is created on first use and
+ * updated if the password changed.
+ * @param dst The destination address.
+ * @param src The source address.
+ * @param user The user name, i.e. 0x7 for user and 0xa for installer.
+ * @param timeout The login timeout.
+ * @param password The encoded password.
+ * @param packet_id The packet id to be patched into the request.
+ * @param inverter_time The inverter time to be patched into the request.
+ * @param buffer The buffer receiving the request packet.
+ * @param buffer_size The buffer size in bytes.
+ * @return The request packet size in bytes, or 0 if the buffer is too small.
+ */
+size_t SpeedwireRequestTemplates::getLoginRequest(const SpeedwireAddress& dst, const SpeedwireAddress& src, const uint32_t user, const uint32_t timeout, const std::array<uint8_t, 12>& password,
+                                                  const uint16_t packet_id, const uint32_t inverter_time, void* buffer, const size_t buffer_size) {
+    if (buffer_size < login_request_size) {
+        return 0;
+    }
+    const Key key = getKey(dst, src, Command::LOGIN, user, timeout);
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<Key, size_t>::const_iterator it = offsets.find(key);
+    size_t offset;
+    if (it != offsets.end()) {
+        offset = it->second;
+    }
+    else {
+        offset = allocate(login_request_size);
+        assemble(offset, login_request_size, dst, src, 0x0100, Command::LOGIN, user, timeout);
+        offsets[key] = offset;
+    }
+    memcpy(arena.data() + offset + login_password_offset, password.data(), password.size());
+    uint8_t* const request = (uint8_t*)buffer;
+    memcpy(request, arena.data() + offset, login_request_size);
+    SpeedwireByteEncoding::setUint16LittleEndian(request + packet_id_offset, packet_id);
+    SpeedwireByteEncoding::setUint32LittleEndian(request + login_time_offset, inverter_time);
+    return login_request_size;
+}
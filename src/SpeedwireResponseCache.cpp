@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <string.h>
+#include <SpeedwireResponseCache.hpp>
+#include <SpeedwireCommand.hpp>
+#include <SpeedwireData.hpp>
+#include <Logger.hpp>
+using namespace libspeedwire;
+
+static Logger logger("SpeedwireResponseCache");
+
+
+/**
+ * Constructor of the SpeedwireResponseCache instance. Device queries and the nominal power register are cached for one hour.
+ */
+SpeedwireResponseCache::SpeedwireResponseCache(void) :
+    numHits(0),
+    numMisses(0) {
+    addRule(Command::DEVICE_QUERY, 0x00000000, 0x00ffffff, 3600000);
+    addRule(SpeedwireData::InverterNominalPower.command, SpeedwireData::InverterNominalPower.id, SpeedwireData::InverterNominalPower.id | 0xff, 3600000);
+}
+
+
+/**
+ * Get the cache key for the given query.
+ */
+SpeedwireResponseCache::Key SpeedwireResponseCache::getKey(const SpeedwireDevice& device, const Command command, const uint32_t first_register, const uint32_t last_register) {
+    Key key;
+    key.serialNumber = device.deviceAddress.serialNumber;
+    key.command = (uint32_t)command;
+    key.firstRegister = first_register;
+    key.lastRegister = last_register;
+    return key;
+}
+
+
+/**
+ * Add a time-to-live rule; rules added first take precedence.
+ * @param command The query command.
+ * @param first_register The first register covered by the rule.
+ * @param last_register The last register covered by the rule.
+ * @param time_to_live_in_ms The time-to-live of replies to queries within the register range; 0 disables caching.
+ */
+void SpeedwireResponseCache::addRule(const Command command, const uint32_t first_register, const uint32_t last_register, const uint32_t time_to_live_in_ms) {
+    Rule rule;
+    rule.command = (uint32_t)command;
+    rule.firstRegister = first_register;
+    rule.lastRegister = last_register;
+    rule.timeToLive = time_to_live_in_ms;
+    rules.push_back(rule);
+}
+
+
+/**
+ * Get the time-to-live for replies to the given query.
+ * @return The time-to-live of the first rule covering the entire register range, or 0 if the reply is not to be cached.
+ */
+uint32_t SpeedwireResponseCache::getTimeToLive(const Command command, const uint32_t first_register, const uint32_t last_register) const {
+    for (const auto& rule : rules) {
+        if (rule.command == (uint32_t)command && rule.firstRegister <= first_register && last_register <= rule.lastRegister) {
+            return rule.timeToLive;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * Insert the reply packet of a successful query, if the query is covered by a time-to-live rule.
+ * @param device The queried device.
+ * @param command The query command.
+ * @param first_register The first register of the query.
+ * @param last_register The last register of the query.
+ * @param packet The reply packet.
+ * @param packet_size The reply packet size in bytes.
+ * @param now_in_ms The current time in ms since unix epoch start.
+ * @return true if the reply has been cached, false otherwise.
+ */
+bool SpeedwireResponseCache::put(const SpeedwireDevice& device, const Command command, const uint32_t first_register, const uint32_t last_register,
+                                 const void* packet, const size_t packet_size, const uint64_t now_in_ms) {
+    const uint32_t time_to_live = getTimeToLive(command, first_register, last_register);
+    if (time_to_live == 0 || packet == NULL || packet_size == 0) {
+        return false;
+    }
+    Entry& entry = entries[getKey(device, command, first_register, last_register)];
+    entry.packet.assign((const uint8_t*)packet, (const uint8_t*)packet + packet_size);
+    entry.expiry = now_in_ms + time_to_live;
+    return true;
+}
+
+
+/**
+ * Copy the cached reply packet of the given query into the given buffer, if it has not yet expired.
+ * @param device The queried device.
+ * @param command The query command.
+ * @param first_register The first register of the query.
+ * @param last_register The last register of the query.
+ * @param udp_buffer The buffer receiving the reply packet.
+ * @param udp_buffer_size The buffer size in bytes.
+ * @param now_in_ms The current time in ms since unix epoch start.
+ * @return The number of bytes copied, or -1 if there is no fresh reply in the cache.
+ */
+int32_t SpeedwireResponseCache::get(const SpeedwireDevice& device, const Command command, const uint32_t first_register, const uint32_t last_register,
+                                    void* udp_buffer, const size_t udp_buffer_size, const uint64_t now_in_ms) {
+    std::map<Key, Entry>::iterator it = entries.find(getKey(device, command, first_register, last_register));
+    if (it == entries.end()) {
+        ++numMisses;
+        return -1;
+    }
+    if (it->second.expiry <= now_in_ms) {
+        entries.erase(it);
+        ++numMisses;
+        return -1;
+    }
+    if (it->second.packet.size() > udp_buffer_size) {
+        ++numMisses;
+        return -1;
+    }
+    memcpy(udp_buffer, it->second.packet.data(), it->second.packet.size());
+    ++numHits;
+    return (int32_t)it->second.packet.size();
+}
+
+
+/**
+ * Observe a status reply data element. If the operation status or the update status of the device changed since the
+ * previous observation, all cached replies of the device are invalidated.
+ * @param device The device the status has been received from.
+ * @param raw_data The status reply data element.
+ * @return true if the cached replies of the device have been invalidated, false otherwise.
+ */
+bool SpeedwireResponseCache::observe(const SpeedwireDevice& device, const SpeedwireRawData& raw_data) {
+    if (raw_data.id != SpeedwireData::InverterOperationStatus.id && raw_data.id != SpeedwireData::InverterUpdateStatus.id) {
+        return false;
+    }
+    const uint64_t key = ((uint64_t)device.deviceAddress.serialNumber << 32) | raw_data.toKey();
+    const size_t data_size = (raw_data.data_size < sizeof(raw_data.data) ? raw_data.data_size : sizeof(raw_data.data));
+    std::vector<uint8_t>& previous = status[key];
+    const bool changed = (previous.size() > 0 && (previous.size() != data_size || memcmp(previous.data(), raw_data.data, data_size) != 0));
+    previous.assign(raw_data.data, raw_data.data + data_size);
+    if (changed) {
+        invalidate(device);
+    }
+    return changed;
+}
+
+
+/**
+ * Remove all cached replies of the given device.
+ * @param device The device.
+ */
+void SpeedwireResponseCache::invalidate(const SpeedwireDevice& device) {
+    Key first = getKey(device, Command::NONE, 0, 0);
+    std::map<Key, Entry>::iterator it = entries.lower_bound(first);
+    while (it != entries.end() && it->first.serialNumber == device.deviceAddress.serialNumber) {
+        it = entries.erase(it);
+    }
+}
+
+
+/**
+ * Remove the cached reply of the given query.
+ * @param device The queried device.
+ * @param command The query command.
+ * @param first_register The first register of the query.
+ * @param last_register The last register of the query.
+ */
+void SpeedwireResponseCache::invalidate(const SpeedwireDevice& device, const Command command, const uint32_t first_register, const uint32_t last_register) {
+    entries.erase(getKey(device, command, first_register, last_register));
+}
+
+
+/**
+ * Save all cached replies to the given file. The file is first written under a temporary name and then renamed,
+ * such that a crash during the write does not destroy the previous file.
+ * @param path The cache file path.
+ * @return true on success, false otherwise.
+ */
+bool SpeedwireResponseCache::save(const std::string& path) const {
+    const std::string temp_path = path + ".tmp";
+    FILE* file = fopen(temp_path.c_str(), "w");
+    if (file == NULL) {
+        logger.print(LogLevel::LOG_ERROR, "cannot open cache file %s", temp_path.c_str());
+        return false;
+    }
+    bool ok = true;
+    for (std::map<Key, Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it) {
+        ok &= (fprintf(file, "%08x %08x %08x %08x %llu ", it->first.serialNumber, it->first.command, it->first.firstRegister, it->first.lastRegister,
+                       (unsigned long long)it->second.expiry) > 0);
+        for (size_t i = 0; i < it->second.packet.size(); ++i) {
+            ok &= (fprintf(file, "%02x", it->second.packet[i]) > 0);
+        }
+        ok &= (fputc('\n', file) != EOF);
+    }
+    ok &= (fclose(file) == 0);
+#ifdef _WIN32
+    remove(path.c_str());
+#endif
+    if (ok == false || rename(temp_path.c_str(), path.c_str()) != 0) {
+        logger.print(LogLevel::LOG_ERROR, "cannot write cache file %s", path.c_str());
+        remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+/**
+ * Load cached replies from the given file; expired replies are skipped.
+ * @param path The cache file path.
+ * @param now_in_ms The current time in ms since unix epoch start.
+ * @return true on success, false otherwise.
+ */
+bool SpeedwireResponseCache::load(const std::string& path, const uint64_t now_in_ms) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == NULL) {
+        logger.print(LogLevel::LOG_WARNING, "cannot open cache file %s", path.c_str());
+        return false;
+    }
+    Key key;
+    unsigned long long expiry;
+    char hex[4096 + 1];
+    while (fscanf(file, "%x %x %x %x %llu %4096s", &key.serialNumber, &key.command, &key.firstRegister, &key.lastRegister, &expiry, hex) == 6) {
+        const size_t length = strlen(hex) / 2;
+        if (expiry <= now_in_ms || length == 0) {
+            continue;
+        }
+        Entry& entry = entries[key];
+        entry.expiry = expiry;
+        entry.packet.resize(length);
+        for (size_t i = 0; i < length; ++i) {
+            unsigned byte = 0;
+            sscanf(hex + 2 * i, "%2x", &byte);
+            entry.packet[i] = (uint8_t)byte;
+        }
+    }
+    bool ok = (feof(file) != 0);
+    fclose(file);
+    if (ok == false) {
+        logger.print(LogLevel::LOG_ERROR, "invalid cache file %s", path.c_str());
+    }
+    return ok;
+}
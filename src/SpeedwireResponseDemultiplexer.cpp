@@ -0,0 +1,275 @@
+#ifdef _WIN32
+#include <Winsock2.h>
+#include <Ws2tcpip.h>
+#define poll(a, b, c)  WSAPoll((a), (b), (c))
+#else
+#include <poll.h>
+#endif
+
+#include <chrono>
+#include <string.h>
+#include <utility>
+#include <AddressConversion.hpp>
+#include <Logger.hpp>
+#include <SpeedwireHeader.hpp>
+#include <SpeedwireInverterProtocol.hpp>
+#include <SpeedwireCommand.hpp>
+#include <SpeedwireResponseDemultiplexer.hpp>
+using namespace libspeedwire;
+
+static Logger logger("SpeedwireResponseDemultiplexer");
+
+static const int max_receive_rounds = 16;
+
+
+/**
+ * Constructor.
+ * @param _sockets Reference to the unicast command sockets; the vector must outlive this instance.
+ * @param max_late_replies Capacity of the late-reply queue; the oldest late reply is dropped if it is exceeded.
+ */
+SpeedwireResponseDemultiplexer::SpeedwireResponseDemultiplexer(const std::vector<SpeedwireSocket>& _sockets, const size_t max_late_replies) :
+    sockets(_sockets),
+    maxLateReplies(max_late_replies),
+    polling(false),
+    receivedCount(0),
+    routedCount(0),
+    lateCount(0),
+    lateDroppedCount(0),
+    ignoredCount(0) {}
+
+
+/**
+ * Destructor.
+ */
+SpeedwireResponseDemultiplexer::~SpeedwireResponseDemultiplexer(void) {}
+
+
+/**
+ * Get the routing key of the given reply packet.
+ * @param packet The packet.
+ * @param packet_size The packet size in bytes.
+ * @return The key (susyid, serialnumber, packetid) of the source device, or 0 if the packet is not an inverter reply.
+ */
+uint64_t SpeedwireResponseDemultiplexer::getReplyKey(const uint8_t* packet, const size_t packet_size) {
+    const SpeedwireHeader speedwire_packet(packet, (unsigned long)packet_size);
+    if (speedwire_packet.isValidData2Packet()) {
+        const SpeedwireData2Packet data2_packet(speedwire_packet);
+        if (data2_packet.isInverterProtocolID() && data2_packet.getTagLength() >= (8 + 8 + 6) && data2_packet.getTagLength() + (size_t)20 <= packet_size) {
+            const SpeedwireInverterProtocol inverter_packet(data2_packet);
+            return SpeedwireCommandTokenRepository::getKey(inverter_packet.getSrcSusyID(), inverter_packet.getSrcSerialNumber(), inverter_packet.getPacketID());
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * Announce that replies with the given key are expected; they are kept until collected or cancelled.
+ * @param key The command token key.
+ */
+void SpeedwireResponseDemultiplexer::expect(const uint64_t key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    mailbox[key];
+}
+
+
+/**
+ * Stop expecting replies with the given key and discard any uncollected replies.
+ * @param key The command token key.
+ */
+void SpeedwireResponseDemultiplexer::cancel(const uint64_t key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    mailbox.erase(key);
+}
+
+
+/**
+ * Route a received packet to its mailbox, to the mailbox of a broadcast request with the same packet id, or to the
+ * late-reply queue; the mutex must be held.
+ */
+void SpeedwireResponseDemultiplexer::route(SpeedwireReply& reply) {
+    ++receivedCount;
+    const uint64_t key = getReplyKey(reply.packet.data(), reply.packet.size());
+    if (key == 0) {
+        ++ignoredCount;
+        return;
+    }
+    std::unordered_map<uint64_t, std::deque<SpeedwireReply> >::iterator it = mailbox.find(key);
+    if (it == mailbox.end()) {
+        it = mailbox.find(getBroadcastKey(key));
+    }
+    if (it != mailbox.end()) {
+        it->second.push_back(std::move(reply));
+        ++routedCount;
+        return;
+    }
+    if (lateReplies.size() >= maxLateReplies) {
+        lateReplies.pop_front();
+        ++lateDroppedCount;
+    }
+    if (maxLateReplies > 0) {
+        lateReplies.push_back(std::move(reply));
+        ++lateCount;
+    }
+}
+
+
+/**
+ * Poll all unicast command sockets, receive all pending packets and route them. If another thread is already polling,
+ * wait until it has routed its packets instead.
+ * @param timeout_in_ms Poll timeout in ms.
+ * @return The number of received packets, or -1 on poll failure.
+ */
+int SpeedwireResponseDemultiplexer::receive(const int timeout_in_ms) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (polling) {
+        condition.wait_for(lock, std::chrono::milliseconds(timeout_in_ms > 0 ? timeout_in_ms : 0));
+        return 0;
+    }
+    polling = true;
+    lock.unlock();
+
+    std::vector<SpeedwireReply> replies;
+    int result = 0;
+    if (pollfds.size() < sockets.size()) {
+        pollfds.resize(sockets.size());
+    }
+    for (int round = 0; round < max_receive_rounds && sockets.size() > 0; ++round) {
+        for (size_t i = 0; i < sockets.size(); ++i) {
+            pollfds[i].fd = sockets[i].getSocketFd();
+            pollfds[i].events = POLLIN;
+            pollfds[i].revents = 0;
+        }
+        // block only in the first round; subsequent rounds drain packets that arrived meanwhile
+        const int pollresult = ::poll(&pollfds[0], (unsigned)sockets.size(), (round == 0 ? timeout_in_ms : 0));
+        if (pollresult < 0) {
+            logger.print(LogLevel::LOG_ERROR, "poll failure");
+            result = -1;
+            break;
+        }
+        if (pollresult == 0) {
+            break;
+        }
+        for (size_t i = 0; i < sockets.size(); ++i) {
+            if ((pollfds[i].revents & POLLIN) == 0) {
+                continue;
+            }
+            const SpeedwireSocket& socket = sockets[i];
+            replies.push_back(SpeedwireReply());
+            SpeedwireReply& reply = replies.back();
+            reply.packet.resize(2048);
+            memset(&reply.src, 0, sizeof(reply.src));
+            int nbytes = -1;
+            if (socket.isIpv4()) {
+                nbytes = socket.recvfrom(reply.packet.data(), reply.packet.size(), (struct sockaddr_in&)reply.src);
+            }
+            else if (socket.isIpv6()) {
+                nbytes = socket.recvfrom(reply.packet.data(), reply.packet.size(), reply.src);
+            }
+            if (nbytes > 0) {
+                reply.packet.resize((size_t)nbytes);
+                reply.time = LocalHost::getTickCountInMs();
+            }
+            else {
+                replies.pop_back();
+            }
+        }
+    }
+
+    lock.lock();
+    for (size_t i = 0; i < replies.size(); ++i) {
+        route(replies[i]);
+    }
+    polling = false;
+    condition.notify_all();
+    return (result < 0 ? result : (int)replies.size());
+}
+
+
+/**
+ * Collect the oldest reply routed to the given key, without polling the sockets.
+ * @param key The command token key.
+ * @param reply The reply.
+ * @return true if a reply has been collected, false otherwise.
+ */
+bool SpeedwireResponseDemultiplexer::takeReply(const uint64_t key, SpeedwireReply& reply) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unordered_map<uint64_t, std::deque<SpeedwireReply> >::iterator it = mailbox.find(key);
+    if (it == mailbox.end() || it->second.empty()) {
+        return false;
+    }
+    reply = std::move(it->second.front());
+    it->second.pop_front();
+    return true;
+}
+
+
+/**
+ * Wait until a reply has been routed to the given key; the key must have been announced by expect().
+ * @param key The command token key.
+ * @param reply The reply.
+ * @param timeout_in_ms Maximum wait time in ms.
+ * @return true if a reply has been collected, false on timeout.
+ */
+bool SpeedwireResponseDemultiplexer::waitForReply(const uint64_t key, SpeedwireReply& reply, const int timeout_in_ms) {
+    const uint64_t deadline = LocalHost::getTickCountInMs() + (timeout_in_ms > 0 ? timeout_in_ms : 0);
+    for (;;) {
+        if (takeReply(key, reply) == true) {
+            return true;
+        }
+        const uint64_t now = LocalHost::getTickCountInMs();
+        if (now >= deadline) {
+            return false;
+        }
+        if (receive((int)(deadline - now)) < 0) {
+            return false;
+        }
+    }
+}
+
+
+/**
+ * Collect the oldest late reply, i.e. a reply that no request has been waiting for.
+ * @param reply The reply.
+ * @return true if a reply has been collected, false if the late-reply queue is empty.
+ */
+bool SpeedwireResponseDemultiplexer::takeLateReply(SpeedwireReply& reply) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (lateReplies.empty()) {
+        return false;
+    }
+    reply = std::move(lateReplies.front());
+    lateReplies.pop_front();
+    return true;
+}
+
+
+/** Get the number of packets received. */
+uint64_t SpeedwireResponseDemultiplexer::getReceivedCount(void) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return receivedCount;
+}
+
+/** Get the number of replies routed to an expected key. */
+uint64_t SpeedwireResponseDemultiplexer::getRoutedCount(void) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return routedCount;
+}
+
+/** Get the number of replies put into the late-reply queue. */
+uint64_t SpeedwireResponseDemultiplexer::getLateCount(void) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lateCount;
+}
+
+/** Get the number of late replies dropped due to a full late-reply queue. */
+uint64_t SpeedwireResponseDemultiplexer::getLateDroppedCount(void) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lateDroppedCount;
+}
+
+/** Get the number of received packets that are not inverter replies. */
+uint64_t SpeedwireResponseDemultiplexer::getIgnoredCount(void) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return ignoredCount;
+}
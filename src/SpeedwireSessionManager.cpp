@@ -0,0 +1,294 @@
+#include <LocalHost.hpp>
+#include <AddressConversion.hpp>
+#include <Logger.hpp>
+#include <SpeedwireInverterProtocol.hpp>
+#include <SpeedwireSessionManager.hpp>
+using namespace libspeedwire;
+
+static Logger logger("SpeedwireSessionManager");
+
+
+/**
+ * Constructor.
+ * @param _authentication Reference to the authentication instance used to send login requests.
+ * @param _credentials The login credentials.
+ * @param refresh_age_in_ms Session age after which the session is renewed; it should be well below the session timeout of the devices.
+ * @param login_timeout_in_ms Timeout of a login request.
+ * @param retry_interval_in_ms Time between failed login attempts.
+ */
+SpeedwireSessionManager::SpeedwireSessionManager(SpeedwireAuthentication& _authentication, const Credentials& _credentials, const uint32_t refresh_age_in_ms,
+                                                 const uint32_t login_timeout_in_ms, const uint32_t retry_interval_in_ms) :
+    authentication(_authentication),
+    credentials(_credentials),
+    refreshAge(refresh_age_in_ms),
+    loginTimeout(login_timeout_in_ms),
+    retryInterval(retry_interval_in_ms),
+    numLogins(0),
+    numFailures(0) {}
+
+
+/**
+ * Destructor. Tokens of login requests still in flight are removed from the token repository.
+ */
+SpeedwireSessionManager::~SpeedwireSessionManager(void) {
+    for (auto& entry : sessions) {
+        if (entry.second.token >= 0) {
+            authentication.getTokenRepository().remove(entry.second.token);
+        }
+    }
+}
+
+
+/**
+ * Add a device; it is logged in with the next call to poll() or login().
+ * @param device The device.
+ */
+void SpeedwireSessionManager::add(const SpeedwireDevice& device) {
+    std::map<uint32_t, Session>::iterator it = sessions.find(device.deviceAddress.serialNumber);
+    if (it != sessions.end()) {
+        it->second.device = device;
+        return;
+    }
+    Session& session = sessions[device.deviceAddress.serialNumber];
+    session.device = device;
+    session.authenticated = false;
+    session.token = -1;
+    session.deadline = 0;
+    session.loginTime = 0;
+    session.retryTime = 0;
+}
+
+
+/**
+ * Remove a device; a login request in flight is abandoned.
+ * @param device The device.
+ */
+void SpeedwireSessionManager::remove(const SpeedwireDevice& device) {
+    std::map<uint32_t, Session>::iterator it = sessions.find(device.deviceAddress.serialNumber);
+    if (it != sessions.end()) {
+        if (it->second.token >= 0) {
+            finishLogin(it->second, false, LocalHost::getTickCountInMs());
+        }
+        sessions.erase(it);
+    }
+}
+
+
+/**
+ * Send a login request to the device of the given session.
+ * @return true if the login request has been sent, false otherwise.
+ */
+bool SpeedwireSessionManager::sendLogin(Session& session, const uint64_t now) {
+    const SpeedwireDevice& device = session.device;
+    const SpeedwireCommand::SocketMap& socket_map = authentication.getSocketMap();
+    SpeedwireCommand::SocketMap::const_iterator socket = socket_map.find(device.interfaceIpAddress);
+    if (socket == socket_map.end() || socket->second < 0 || device.deviceIpAddress.isValid() == false) {
+        logger.print(LogLevel::LOG_ERROR, "no socket for device %s", device.toString().c_str());
+        finishLogin(session, false, now);
+        return false;
+    }
+    session.token = authentication.sendLoginRequest(device.interfaceIpAddress, device.deviceAddress, SpeedwireAddress::getLocalAddress(), credentials);
+    if (session.token < 0) {
+        finishLogin(session, false, now);
+        return false;
+    }
+    session.deadline = now + loginTimeout;
+    return true;
+}
+
+
+/**
+ * Finish the login of the given session. A failed login leaves the authentication state unchanged, such that a failed
+ * renewal of a session does not hold back requests while the previous session is still valid.
+ */
+void SpeedwireSessionManager::finishLogin(Session& session, const bool success, const uint64_t now) {
+    if (session.token >= 0) {
+        const SpeedwireCommandToken& token = authentication.getTokenRepository().at(session.token);
+        authentication.getDemultiplexer().cancel(SpeedwireCommandTokenRepository::getKey(token.susyid, token.serialnumber, token.packetid));
+        authentication.getTokenRepository().remove(session.token);
+        session.token = -1;
+    }
+    if (success) {
+        session.authenticated = true;
+        session.loginTime = now;
+        session.retryTime = 0;
+        authentication.getPacketIdAllocator().beginSession(session.device.deviceAddress.susyID, session.device.deviceAddress.serialNumber);
+        ++numLogins;
+    }
+    else {
+        session.retryTime = now + retryInterval;
+        ++numFailures;
+    }
+}
+
+
+/**
+ * Send login requests to all devices that are not authenticated or whose session is due for renewal, wait up to the given
+ * time for login replies, and expire overdue login requests.
+ * @param timeout_in_ms Maximum time to wait for login replies; the wait ends earlier at the next login deadline.
+ * @return The number of finished login attempts, or -1 on poll failure.
+ */
+int SpeedwireSessionManager::poll(const int timeout_in_ms) {
+    uint64_t now = LocalHost::getTickCountInMs();
+
+    // send all due login requests at once
+    uint64_t next_deadline = UINT64_MAX;
+    for (auto& entry : sessions) {
+        Session& session = entry.second;
+        if (session.token < 0 && now >= session.retryTime && (session.authenticated == false || now - session.loginTime >= refreshAge)) {
+            sendLogin(session, now);
+        }
+        if (session.token >= 0 && session.deadline < next_deadline) {
+            next_deadline = session.deadline;
+        }
+    }
+    if (next_deadline == UINT64_MAX) {
+        return 0;
+    }
+
+    int wait_time = (timeout_in_ms > 0 ? timeout_in_ms : 0);
+    const int until_deadline = (next_deadline > now ? (int)(next_deadline - now) : 0);
+    if (until_deadline < wait_time) wait_time = until_deadline;
+    SpeedwireResponseDemultiplexer& demultiplexer = authentication.getDemultiplexer();
+    if (demultiplexer.receive(wait_time) < 0) {
+        return -1;
+    }
+
+    // collect login replies
+    now = LocalHost::getTickCountInMs();
+    int nfinished = 0;
+    SpeedwireReply reply;
+    for (auto& entry : sessions) {
+        Session& session = entry.second;
+        if (session.token < 0) {
+            continue;
+        }
+        const SpeedwireCommandToken& token = authentication.getTokenRepository().at(session.token);
+        const uint64_t key = SpeedwireCommandTokenRepository::getKey(token.susyid, token.serialnumber, token.packetid);
+        while (session.token >= 0 && demultiplexer.takeReply(key, reply) == true) {
+            const SpeedwireHeader speedwire_packet(reply.packet.data(), (unsigned long)reply.packet.size());
+            if (authentication.checkReply(speedwire_packet, AddressConversion::toSockAddr(reply.src), token) == false) {
+                continue;
+            }
+            const SpeedwireData2Packet data2_packet(speedwire_packet);
+            const SpeedwireInverterProtocol inverter_packet(data2_packet);
+            const uint16_t error_code = inverter_packet.getErrorCode();
+            if (error_code == 0x0100) {
+                logger.print(LogLevel::LOG_ERROR, "invalid password - not authenticated %s", session.device.toString().c_str());
+            }
+            else if (error_code != 0x0000) {
+                logger.print(LogLevel::LOG_ERROR, "login failure - not authenticated %s (error code 0x%04x)", session.device.toString().c_str(), error_code);
+            }
+            if (error_code != 0x0000) {
+                session.authenticated = false;
+            }
+            finishLogin(session, error_code == 0x0000, now);
+            ++nfinished;
+        }
+        if (session.token >= 0 && now >= session.deadline) {
+            logger.print(LogLevel::LOG_WARNING, "login timeout %s", session.device.toString().c_str());
+            finishLogin(session, false, now);
+            ++nfinished;
+        }
+    }
+    return nfinished;
+}
+
+
+/**
+ * Log in to all devices that are not authenticated, ignoring their retry intervals, and wait until all login attempts
+ * have finished or the given time has elapsed. Login requests to all devices are in flight concurrently.
+ * @param timeout_in_ms Maximum time to wait in ms.
+ * @return The number of authenticated devices.
+ */
+int SpeedwireSessionManager::login(const int timeout_in_ms) {
+    for (auto& entry : sessions) {
+        if (entry.second.authenticated == false) {
+            entry.second.retryTime = 0;
+        }
+    }
+    const uint64_t end = LocalHost::getTickCountInMs() + (timeout_in_ms > 0 ? timeout_in_ms : 0);
+    do {
+        const uint64_t now = LocalHost::getTickCountInMs();
+        if (poll(now < end ? (int)(end - now) : 0) < 0) {
+            break;
+        }
+    } while (getPendingCount() > 0 && LocalHost::getTickCountInMs() < end);
+
+    int nauthenticated = 0;
+    for (const auto& entry : sessions) {
+        if (entry.second.authenticated) {
+            ++nauthenticated;
+        }
+    }
+    return nauthenticated;
+}
+
+
+/**
+ * Invalidate the session of the given device, e.g. after it replied with error code 0x0017; the device is logged in
+ * again with the next call to poll().
+ * @param device The device.
+ */
+void SpeedwireSessionManager::invalidate(const SpeedwireDevice& device) {
+    std::map<uint32_t, Session>::iterator it = sessions.find(device.deviceAddress.serialNumber);
+    if (it != sessions.end()) {
+        it->second.authenticated = false;
+        it->second.retryTime = 0;
+    }
+}
+
+
+/**
+ * Check if the given device is managed by this session manager.
+ */
+bool SpeedwireSessionManager::isManaged(const SpeedwireDevice& device) const {
+    return (sessions.find(device.deviceAddress.serialNumber) != sessions.end());
+}
+
+
+/**
+ * Check if the given device accepted the last login and has not been invalidated since.
+ */
+bool SpeedwireSessionManager::isAuthenticated(const SpeedwireDevice& device) const {
+    std::map<uint32_t, Session>::const_iterator it = sessions.find(device.deviceAddress.serialNumber);
+    return (it != sessions.end() && it->second.authenticated);
+}
+
+
+/**
+ * Check if requests to the given device must wait for a login, i.e. if the device is managed but not authenticated.
+ */
+bool SpeedwireSessionManager::needsLogin(const SpeedwireDevice& device) const {
+    std::map<uint32_t, Session>::const_iterator it = sessions.find(device.deviceAddress.serialNumber);
+    return (it != sessions.end() && it->second.authenticated == false);
+}
+
+
+/**
+ * Get the age of the session with the given device.
+ * @param device The device.
+ * @param now The current local tick count in ms.
+ * @return The time since the last successful login in ms, or UINT64_MAX if the device is not authenticated.
+ */
+uint64_t SpeedwireSessionManager::getSessionAge(const SpeedwireDevice& device, const uint64_t now) const {
+    std::map<uint32_t, Session>::const_iterator it = sessions.find(device.deviceAddress.serialNumber);
+    if (it == sessions.end() || it->second.authenticated == false) {
+        return UINT64_MAX;
+    }
+    return (now > it->second.loginTime ? now - it->second.loginTime : 0);
+}
+
+
+/**
+ * Get the number of login requests in flight.
+ */
+size_t SpeedwireSessionManager::getPendingCount(void) const {
+    size_t npending = 0;
+    for (const auto& entry : sessions) {
+        if (entry.second.token >= 0) {
+            ++npending;
+        }
+    }
+    return npending;
+}
@@ -502,14 +502,22 @@ int SpeedwireSocket::send(const void* const buff, const unsigned long size) cons
  *  Send udp multicast packet to the given address provided as string
  */
 int SpeedwireSocket::sendto(const void* const buff, const unsigned long size, const std::string& dest) const {
-    if (dest.find(':') == std::string::npos) {
-        struct sockaddr_in addr = speedwire_multicast_address_239_12_255_254;  // use as template
-        addr.sin_addr = AddressConversion::toInAddress(dest);
+    return sendto(buff, size, IpAddress(dest));
+}
+
+
+/**
+ *  Send udp multicast packet to the given binary ipv4 or ipv6 address
+ */
+int SpeedwireSocket::sendto(const void* const buff, const unsigned long size, const IpAddress& dest) const {
+    if (dest.isIpv4()) {
+        struct sockaddr_in addr = dest.getSockAddrIn();
+        addr.sin_port = htons(speedwire_port_9522);
         return sendto(buff, size, addr);
     }
-    else {
-        struct sockaddr_in6 addr = speedwire_multicast_address_v6;  // use as template
-        addr.sin6_addr = AddressConversion::toIn6Address(dest);
+    else if (dest.isIpv6()) {
+        struct sockaddr_in6 addr = dest.getSockAddrIn6();
+        addr.sin6_port = htons(speedwire_port_9522);
         return sendto(buff, size, addr);
     }
     return -1;
@@ -621,3 +629,80 @@ int SpeedwireSocket::sendto(const void* const buff, const unsigned long size, co
     return nbytes;
 }
 
+
+/**
+ *  Construct a datagram from the given payload and destination address.
+ */
+SpeedwireSocket::Datagram::Datagram(const void* const buff, const unsigned long buff_size, const struct sockaddr& dest_address) :
+    buffer(buff),
+    size(buff_size),
+    nbytes(-1) {
+    memset(&dest, 0, sizeof(dest));
+    if (dest_address.sa_family == AF_INET) {
+        memcpy(&dest, &dest_address, sizeof(struct sockaddr_in));
+    }
+    else if (dest_address.sa_family == AF_INET6) {
+        memcpy(&dest, &dest_address, sizeof(struct sockaddr_in6));
+    }
+}
+
+
+/**
+ *  Send a batch of udp packets to their pre-resolved destination addresses. On linux, unicast batches are sent by a
+ *  single sendmmsg() system call; otherwise, and if any destination is a multicast address requiring a per-packet
+ *  interface selection, the packets are sent one by one. A failure to send one packet does not stop the batch.
+ *  The number of bytes sent is returned in the nbytes field of each datagram.
+ *  @return the number of datagrams sent
+ */
+int SpeedwireSocket::sendmmsg(std::vector<Datagram>& datagrams) const {
+    int nsent = 0;
+#ifdef __linux__
+    bool unicast = true;
+    for (const auto& datagram : datagrams) {
+        const struct sockaddr& dest = (const struct sockaddr&)datagram.dest;
+        if ((dest.sa_family == AF_INET  && (ntohl(AddressConversion::toSockAddrIn(dest).sin_addr.s_addr) >> 28) == 0xe) ||
+            (dest.sa_family == AF_INET6 && AddressConversion::toSockAddrIn6(dest).sin6_addr.s6_addr[0] == 255) ||
+            (dest.sa_family != AF_INET  && dest.sa_family != AF_INET6)) {
+            unicast = false;
+            break;
+        }
+    }
+    if (unicast) {
+        std::vector<struct mmsghdr> messages(datagrams.size());
+        std::vector<struct iovec> iovecs(datagrams.size());
+        for (size_t i = 0; i < datagrams.size(); ++i) {
+            Datagram& datagram = datagrams[i];
+            datagram.nbytes = -1;
+            iovecs[i].iov_base = (void*)datagram.buffer;
+            iovecs[i].iov_len = datagram.size;
+            memset(&messages[i], 0, sizeof(messages[i]));
+            messages[i].msg_hdr.msg_name = &datagram.dest;
+            messages[i].msg_hdr.msg_namelen = (datagram.dest.ss_family == AF_INET ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6));
+            messages[i].msg_hdr.msg_iov = &iovecs[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+        size_t i = 0;
+        while (i < datagrams.size()) {
+            int nmessages = ::sendmmsg(socket_fd, &messages[i], (unsigned int)(datagrams.size() - i), 0);
+            if (nmessages <= 0) {
+                // skip the datagram that could not be sent and continue with the remaining ones
+                perror("sendmmsg failure");
+                ++i;
+                continue;
+            }
+            for (int j = 0; j < nmessages; ++j, ++i) {
+                datagrams[i].nbytes = (int)messages[i].msg_len;
+                ++nsent;
+            }
+        }
+        return nsent;
+    }
+#endif
+    for (auto& datagram : datagrams) {
+        datagram.nbytes = sendto(datagram.buffer, datagram.size, (const struct sockaddr&)datagram.dest);
+        if (datagram.nbytes >= 0) {
+            ++nsent;
+        }
+    }
+    return nsent;
+}
@@ -0,0 +1,181 @@
+#include <TimeAlignedJoinProcessor.hpp>
+#include <SpeedwireTime.hpp>
+using namespace libspeedwire;
+
+
+/**
+ * Constructor of the TimeAlignedJoinProcessor instance.
+ * @param grid_step_in_ms The time grid step in milliseconds.
+ * @param latency_in_ms The time to wait for late data before a grid point is emitted; this should cover the inverter polling interval.
+ * @param max_age_in_ms The maximum time distance between a grid point and the closest column value; otherwise the column value is invalid.
+ * @param history_size The number of values kept per column for interpolation.
+ * @param max_rows_per_packet The maximum number of rows emitted per data packet; if the backlog is larger, older grid points are skipped.
+ */
+TimeAlignedJoinProcessor::TimeAlignedJoinProcessor(const uint32_t grid_step_in_ms, const uint32_t latency_in_ms, const uint32_t max_age_in_ms, const size_t history_size, const size_t max_rows_per_packet) :
+    gridStepInMs(grid_step_in_ms > 0 ? grid_step_in_ms : 1000),
+    latencyInMs(latency_in_ms),
+    maxAgeInMs(max_age_in_ms),
+    historySize(history_size > 1 ? history_size : 2),
+    maxRowsPerPacket(max_rows_per_packet > 0 ? max_rows_per_packet : 1),
+    newestTime(0),
+    nextGridTime(0),
+    gridIsValid(false) {}
+
+
+/**
+ * Destructor.
+ */
+TimeAlignedJoinProcessor::~TimeAlignedJoinProcessor(void) {}
+
+
+/**
+ * Add an emeter measurement column.
+ * @param serial_number The serial number of the emeter device.
+ * @param element The obis data definition of the measurement.
+ * @return The column index.
+ */
+size_t TimeAlignedJoinProcessor::addColumn(const uint32_t serial_number, const ObisData& element) {
+    const uint64_t map_key = ((uint64_t)serial_number << 32) | element.toKey();
+    columns.push_back(JoinColumn(serial_number, element.toKey(), element));
+    columns.back().measurement.measurementValues.setMaximumNumberOfElements(historySize);
+    columnIndex[map_key] = columns.size() - 1;
+    row.values.resize(columns.size(), 0.0);
+    row.valid.resize(columns.size(), false);
+    return columns.size() - 1;
+}
+
+
+/**
+ * Add an inverter measurement column.
+ * @param serial_number The serial number of the inverter device.
+ * @param element The speedwire data definition of the measurement.
+ * @return The column index.
+ */
+size_t TimeAlignedJoinProcessor::addColumn(const uint32_t serial_number, const SpeedwireData& element) {
+    const uint64_t map_key = ((uint64_t)serial_number << 32) | element.toKey();
+    columns.push_back(JoinColumn(serial_number, element.toKey(), element));
+    columns.back().measurement.measurementValues.setMaximumNumberOfElements(historySize);
+    columnIndex[map_key] = columns.size() - 1;
+    row.values.resize(columns.size(), 0.0);
+    row.valid.resize(columns.size(), false);
+    return columns.size() - 1;
+}
+
+
+/**
+ * Add a consumer to receive the rows of the TimeAlignedJoinProcessor.
+ * @param consumer Reference to the JoinedRowConsumer.
+ */
+void TimeAlignedJoinProcessor::addConsumer(JoinedRowConsumer& consumer) {
+    consumerTable.push_back(&consumer);
+}
+
+
+/**
+ * Internal implementation to append the newest value of the given measurement to its column, if it is a selected column.
+ * @param serial_number The serial number of the device.
+ * @param key The measurement key.
+ * @param measurement The measurement holding the new value.
+ * @param is_inverter_time True if the measurement timestamp is an inverter timestamp in seconds.
+ */
+void TimeAlignedJoinProcessor::process(const uint32_t serial_number, const uint32_t key, const Measurement& measurement, const bool is_inverter_time) {
+    std::map<uint64_t, size_t>::const_iterator it = columnIndex.find(((uint64_t)serial_number << 32) | key);
+    if (it == columnIndex.end() || measurement.measurementValues.getNumberOfElements() == 0) {
+        return;
+    }
+    const TimestampDoublePair& newest = measurement.measurementValues.getNewestElement();
+    const uint32_t time = (is_inverter_time ? SpeedwireTime::convertInverterToEmeterTime(newest.time) : newest.time);
+
+    // ignore duplicates and out-of-order values; interpolation requires chronological order
+    MeasurementValues& values = columns[it->second].measurement.measurementValues;
+    if (values.getNumberOfElements() > 0 && SpeedwireTime::calculateTimeDifference(time, values.getNewestElement().time) <= 0) {
+        return;
+    }
+    values.addMeasurement(newest.value, time);
+
+    if (gridIsValid == false) {
+        newestTime = time;
+        nextGridTime = time - (time % gridStepInMs);
+        gridIsValid = true;
+    }
+    else if (SpeedwireTime::calculateTimeDifference(time, newestTime) > 0) {
+        newestTime = time;
+    }
+}
+
+
+/**
+ * Emit all grid points that are at least the latency older than the newest received timestamp.
+ */
+void TimeAlignedJoinProcessor::emitRows(void) {
+    if (gridIsValid == false) {
+        return;
+    }
+    const uint32_t watermark = newestTime - latencyInMs;
+
+    // skip grid points that cannot be emitted within the per-packet budget
+    int32_t backlog = SpeedwireTime::calculateTimeDifference(watermark, nextGridTime);
+    if (backlog >= (int32_t)(gridStepInMs * maxRowsPerPacket)) {
+        nextGridTime += ((uint32_t)backlog / gridStepInMs - (uint32_t)maxRowsPerPacket + 1) * gridStepInMs;
+    }
+
+    while (SpeedwireTime::calculateTimeDifference(watermark, nextGridTime) >= 0) {
+        row.time = nextGridTime;
+        for (size_t i = 0; i < columns.size(); ++i) {
+            const MeasurementValues& values = columns[i].measurement.measurementValues;
+            const size_t index = values.findClosestIndex(nextGridTime);
+            if (index != (size_t)-1 && SpeedwireTime::calculateAbsTimeDifference(nextGridTime, values.at(index).time) <= maxAgeInMs) {
+                row.values[i] = values.interpolateClosestValues(nextGridTime);
+                row.valid[i] = true;
+            }
+            else {
+                row.values[i] = 0.0;
+                row.valid[i] = false;
+            }
+        }
+        for (size_t i = 0; i < consumerTable.size(); ++i) {
+            consumerTable[i]->consume(row);
+        }
+        nextGridTime += gridStepInMs;
+    }
+}
+
+
+/**
+ * Callback to consume the given obis data element.
+ * @param device The originating emeter device.
+ * @param element A reference to an ObisData instance, holding output data of the ObisFilter.
+ */
+void TimeAlignedJoinProcessor::consume(const SpeedwireDevice& device, ObisData& element) {
+    process(device.deviceAddress.serialNumber, element.toKey(), element, false);
+}
+
+
+/**
+ * Callback to consume the given inverter reply data element.
+ * @param device The originating inverter device.
+ * @param element A reference to a SpeedwireData instance.
+ */
+void TimeAlignedJoinProcessor::consume(const SpeedwireDevice& device, SpeedwireData& element) {
+    process(device.deviceAddress.serialNumber, element.toKey(), element, true);
+}
+
+
+/**
+ * Callback to notify that the last obis data in the emeter packet has been processed.
+ * @param device The originating emeter device.
+ * @param time The timestamp associated with the just finished emeter packet.
+ */
+void TimeAlignedJoinProcessor::endOfObisData(const SpeedwireDevice& /*device*/, const uint32_t /*time*/) {
+    emitRows();
+}
+
+
+/**
+ * Callback to notify that the last data in the inverter packet has been processed.
+ * @param device The originating inverter device.
+ * @param time The timestamp associated with the just finished inverter packet.
+ */
+void TimeAlignedJoinProcessor::endOfSpeedwireData(const SpeedwireDevice& /*device*/, const uint32_t /*time*/) {
+    emitRows();
+}
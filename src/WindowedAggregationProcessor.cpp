@@ -0,0 +1,179 @@
+#include <WindowedAggregationProcessor.hpp>
+#include <SpeedwireTime.hpp>
+using namespace libspeedwire;
+
+
+/**
+ * Constructor of the WindowedAggregationProcessor instance.
+ * Window and hop lengths are given in milliseconds; for inverter data with timestamps in seconds they are scaled accordingly.
+ * @param window_type The windowing strategy.
+ * @param window_length_in_ms The window length in milliseconds.
+ * @param hop_length_in_ms The hop length in milliseconds; only used for hopping windows, for tumbling windows it is the window length.
+ */
+WindowedAggregationProcessor::WindowedAggregationProcessor(const WindowType window_type, const unsigned long window_length_in_ms, const unsigned long hop_length_in_ms) :
+    windowType(window_type),
+    windowLengthInMs(window_length_in_ms),
+    hopLengthInMs(window_type == WindowType::HOPPING && hop_length_in_ms > 0 ? hop_length_in_ms : window_length_in_ms) {}
+
+
+/**
+ * Destructor.
+ */
+WindowedAggregationProcessor::~WindowedAggregationProcessor(void) {}
+
+
+/**
+ * Enable a percentile sketch for all measurements; this must be called before the first value is consumed.
+ * @param lower Lower bound of the value range.
+ * @param upper Upper bound of the value range.
+ * @param num_bins Number of histogram bins; 0 disables the sketch.
+ */
+void WindowedAggregationProcessor::setPercentileSketch(const double lower, const double upper, const size_t num_bins) {
+    sketchConfig = PercentileSketch(lower, upper, num_bins);
+}
+
+
+/**
+ * Add a consumer to receive the window aggregates of the WindowedAggregationProcessor.
+ * @param consumer Reference to the WindowAggregateConsumer.
+ */
+void WindowedAggregationProcessor::addConsumer(WindowAggregateConsumer& consumer) {
+    consumerTable.push_back(&consumer);
+}
+
+
+/**
+ * Internal implementation of the window aggregation of emeter obis values or inverter values.
+ * @param device The originating device.
+ * @param key The measurement key, unique for the given device.
+ * @param time_scale Number of milliseconds per timestamp unit; 1 for emeter data, 1000 for inverter data.
+ * @param measurement The measurement holding the new value.
+ */
+void WindowedAggregationProcessor::process(const SpeedwireDevice& device, const uint32_t key, const unsigned long time_scale, const Measurement& measurement) {
+    const uint32_t length = (uint32_t)(windowLengthInMs / time_scale);
+    const uint32_t hop    = (uint32_t)(hopLengthInMs / time_scale);
+    if (length == 0 || measurement.measurementValues.getNumberOfElements() == 0) {
+        return;
+    }
+
+    // find or create the window state of this measurement
+    const uint64_t state_key = ((uint64_t)device.deviceAddress.serialNumber << 32) | key;
+    std::map<uint64_t, WindowState>::iterator it = states.find(state_key);
+    if (it == states.end()) {
+        it = states.insert(std::make_pair(state_key, WindowState(length, sketchConfig))).first;
+    }
+    WindowState& state = it->second;
+
+    const TimestampDoublePair& newest = measurement.measurementValues.getNewestElement();
+    const double   value = newest.value;
+    const uint32_t time  = newest.time;
+
+    switch (windowType) {
+    case WindowType::TUMBLING:
+        // emit the current window once a value beyond its end arrives; windows are aligned to multiples of the length
+        if (state.windowStartIsValid == true && SpeedwireTime::calculateTimeDifference(time, state.windowStart) >= (int32_t)length) {
+            emit(device, measurement, state.tumbling, state.windowStart, state.windowStart + length);
+            state.tumbling.clear();
+            state.windowStartIsValid = false;
+        }
+        if (state.windowStartIsValid == false) {
+            state.windowStart = time - (time % length);
+            state.windowStartIsValid = true;
+        }
+        state.tumbling.add(value, time);
+        break;
+
+    case WindowType::SLIDING:
+        state.sliding.add(value, time);
+        emit(device, measurement, state.sliding.getAggregate(), time - length, time);
+        break;
+
+    case WindowType::HOPPING:
+        // emit the windows ending at all hop boundaries crossed by the value, before adding the value itself;
+        // once the window is empty, the remaining boundaries would only emit empty windows and are skipped
+        while (state.windowStartIsValid == true && hop > 0 && SpeedwireTime::calculateTimeDifference(time, state.windowStart) >= (int32_t)hop) {
+            const uint32_t window_end = state.windowStart + hop;
+            state.sliding.evict(window_end - 1);
+            if (state.sliding.size() == 0) {
+                state.windowStart = time - (time % hop);
+                break;
+            }
+            emit(device, measurement, state.sliding.getAggregate(), window_end - length, window_end);
+            state.windowStart = window_end;
+        }
+        if (state.windowStartIsValid == false) {
+            state.windowStart = (hop > 0 ? time - (time % hop) : time);
+            state.windowStartIsValid = true;
+        }
+        state.sliding.add(value, time);
+        break;
+    }
+}
+
+
+/**
+ * Forward the given window aggregate to all registered consumers.
+ */
+void WindowedAggregationProcessor::emit(const SpeedwireDevice& device, const Measurement& measurement, const WindowAggregate& aggregate, const uint32_t window_start, const uint32_t window_end) {
+    if (aggregate.isEmpty()) {
+        return;
+    }
+    for (size_t i = 0; i < consumerTable.size(); ++i) {
+        consumerTable[i]->consume(device, measurement, aggregate, window_start, window_end);
+    }
+    emitted[device.deviceAddress.serialNumber] = true;
+}
+
+
+/**
+ * Notify consumers about the end of a data packet, if any window of the given device was emitted during the packet.
+ */
+void WindowedAggregationProcessor::endOfData(const SpeedwireDevice& device, const uint32_t time) {
+    std::map<uint32_t, bool>::iterator it = emitted.find(device.deviceAddress.serialNumber);
+    if (it != emitted.end() && it->second == true) {
+        for (size_t i = 0; i < consumerTable.size(); ++i) {
+            consumerTable[i]->endOfWindowAggregates(device, time);
+        }
+        it->second = false;
+    }
+}
+
+
+/**
+ * Callback to consume the given obis data element.
+ * @param device The originating emeter device.
+ * @param element A reference to an ObisData instance, holding output data of the ObisFilter.
+ */
+void WindowedAggregationProcessor::consume(const SpeedwireDevice& device, ObisData& element) {
+    process(device, element.toKey(), 1, element);
+}
+
+
+/**
+ * Callback to consume the given inverter reply data element.
+ * @param device The originating inverter device.
+ * @param element A reference to a SpeedwireData instance.
+ */
+void WindowedAggregationProcessor::consume(const SpeedwireDevice& device, SpeedwireData& element) {
+    process(device, element.toKey(), 1000, element);
+}
+
+
+/**
+ * Callback to notify that the last obis data in the emeter packet has been processed.
+ * @param device The originating emeter device.
+ * @param time The timestamp associated with the just finished emeter packet.
+ */
+void WindowedAggregationProcessor::endOfObisData(const SpeedwireDevice& device, const uint32_t time) {
+    endOfData(device, time);
+}
+
+
+/**
+ * Callback to notify that the last data in the inverter packet has been processed.
+ * @param device The originating inverter device.
+ * @param time The timestamp associated with the just finished inverter packet.
+ */
+void WindowedAggregationProcessor::endOfSpeedwireData(const SpeedwireDevice& device, const uint32_t time) {
+    endOfData(device, time);
+}
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <ArchiveProducer.hpp>
+#include <LocalHost.hpp>
+
+using namespace libspeedwire;
+
+// test that entries become visible on flush and can be read back
+TEST(ArchiveProducerTest, WriteAndRead) {
+    SpeedwireDevice device;
+    device.deviceAddress.susyID = 1;
+    device.deviceAddress.serialNumber = 1234;
+    const MeasurementType type = MeasurementType::InverterPower();
+    const uint32_t id = ArchiveProducer::getMeasurementId(type, Wire::L1);
+    const uint32_t time = (uint32_t)LocalHost::getUnixEpochTimeInMs();
+    std::string first_path, second_path;
+    {
+        ArchiveProducer archive(".", "archive_test", 3600000, 2);
+        archive.produce(device, type, Wire::L1, 10.0, time);
+        archive.produce(device, type, Wire::L2, 20.0, time + 1);
+        first_path = archive.getSegmentPath();
+
+        ArchiveReader reader;
+        ASSERT_TRUE(reader.open(first_path));
+        ASSERT_EQ(reader.getSpan().length, 0);
+        archive.flush();
+        ArchiveSpan span = reader.getSpan();
+        ASSERT_EQ(span.length, 2);
+        ASSERT_EQ((uint32_t)span.times[0], time);
+        ASSERT_EQ(span.values[1], 20.0);
+        ASSERT_EQ(span.devices[1], 1234);
+        ASSERT_EQ(span.measurements[0], id);
+        ASSERT_LE(reader.getStartTime(), span.times[0]);
+        ASSERT_GT(reader.getEndTime(), span.times[1]);
+
+        // the segment is full, the next value starts a new one
+        archive.produce(device, type, Wire::L1, 30.0, time + 2);
+        second_path = archive.getSegmentPath();
+        ASSERT_NE(first_path, second_path);
+    }
+    ArchiveReader reader;
+    ASSERT_TRUE(reader.open(second_path));
+    MeasurementValues values(8);
+    ASSERT_EQ(reader.getMeasurementValues(1234, id, values), 1);
+    ASSERT_EQ(values.getNewestElement().value, 30.0);
+    ASSERT_EQ(values.getNewestElement().time, time + 2);
+    reader.close();
+
+    ASSERT_EQ(remove(first_path.c_str()), 0);
+    ASSERT_EQ(remove(second_path.c_str()), 0);
+}
+
+static long getFileSize(const std::string& path) {
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (fp == NULL) return -1;
+    fseek(fp, 0, SEEK_END);
+    const long size = ftell(fp);
+    fclose(fp);
+    return size;
+}
+
+// test late values are appended to the current segment and segments are truncated to their entries on close
+TEST(ArchiveProducerTest, LateValuesAndTruncation) {
+    SpeedwireDevice device;
+    device.deviceAddress.serialNumber = 1234;
+    const MeasurementType type = MeasurementType::InverterPower();
+    const uint64_t time = 1699999200000ull;     // aligned to the hour
+    std::string path;
+    {
+        ArchiveProducer archive(".", "archive_late", 3600000, 16);
+        archive.produceAt(device, type, Wire::L1, 1.0, time + 1000);
+        path = archive.getSegmentPath();
+        archive.produceAt(device, type, Wire::L1, 2.0, time - 7200000);     // two hours late
+        ASSERT_EQ(archive.getSegmentPath(), path);
+        archive.produceAt(device, type, Wire::L1, 3.0, time + 2000);
+        ASSERT_EQ(archive.getSegmentPath(), path);
+    }
+    ASSERT_EQ(getFileSize(path), (long)ArchiveProducer::getSegmentSize(3));
+    ArchiveReader reader;
+    ASSERT_TRUE(reader.open(path));
+    ASSERT_EQ(reader.getStartTime(), time - 7200000);
+    ASSERT_EQ(reader.getEndTime(), time + 3600000);
+    ArchiveSpan span = reader.getSpan();
+    ASSERT_EQ(span.length, 3);
+    ASSERT_EQ(span.times[1], time - 7200000);
+    ASSERT_EQ(span.values[2], 3.0);
+    reader.close();
+    ASSERT_EQ(remove(path.c_str()), 0);
+}
+
+// test existing segment files are never reused, even if more than 16 segments share the same millisecond
+TEST(ArchiveProducerTest, NameCollisions) {
+    SpeedwireDevice device;
+    device.deviceAddress.serialNumber = 1234;
+    const MeasurementType type = MeasurementType::InverterPower();
+    const uint64_t time = 1700000000000ull;
+    std::vector<std::string> paths;
+    {
+        ArchiveProducer archive(".", "archive_names", 3600000, 1);
+        for (int i = 0; i < 20; ++i) {
+            archive.produceAt(device, type, Wire::L1, (double)i, time);
+            ASSERT_EQ(archive.getDroppedCount(), 0);
+            paths.push_back(archive.getSegmentPath());
+        }
+    }
+    for (size_t i = 0; i < paths.size(); ++i) {
+        ArchiveReader reader;
+        ASSERT_TRUE(reader.open(paths[i]));
+        ASSERT_EQ(reader.getSpan().length, 1);
+        ASSERT_EQ(reader.getSpan().values[0], (double)i);
+        reader.close();
+        ASSERT_EQ(remove(paths[i].c_str()), 0);
+    }
+}
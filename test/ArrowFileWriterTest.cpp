@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <ArrowFileWriter.hpp>
+
+using namespace libspeedwire;
+
+static std::vector<uint8_t> readFile(const char* path) {
+    std::vector<uint8_t> content;
+    FILE* fp = fopen(path, "rb");
+    if (fp != NULL) {
+        uint8_t buffer[4096];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0) content.insert(content.end(), buffer, buffer + n);
+        fclose(fp);
+    }
+    return content;
+}
+
+// test the arrow file framing and the placement of column data
+TEST(ArrowFileWriterTest, ExportArchiveSpan) {
+    uint64_t times[3] = { 1000, 2000, 3000 };
+    double values[3] = { 1.5, 2.5, 3.5 };
+    uint32_t devices[3] = { 1, 2, 3 };
+    uint32_t measurements[3] = { 7, 8, 9 };
+    const ArchiveSpan span = { times, values, devices, measurements, 3 };
+    ASSERT_TRUE(ArrowFileWriter::exportArchiveSpan("arrow_test.arrow", span));
+
+    const std::vector<uint8_t> content = readFile("arrow_test.arrow");
+    ASSERT_GT(content.size(), 64);
+    ASSERT_EQ(memcmp(content.data(), "ARROW1\0\0", 8), 0);
+    ASSERT_EQ(memcmp(content.data() + content.size() - 6, "ARROW1", 6), 0);
+
+    // the footer length precedes the trailing magic; the end-of-stream marker precedes the footer
+    uint32_t footer_length;
+    memcpy(&footer_length, content.data() + content.size() - 10, sizeof(footer_length));
+    ASSERT_LT(footer_length + 18u, content.size());
+    const uint8_t eos[8] = { 0xff, 0xff, 0xff, 0xff, 0, 0, 0, 0 };
+    ASSERT_EQ(memcmp(content.data() + content.size() - 10 - footer_length - 8, eos, 8), 0);
+
+    // column data is written unmodified, each column padded to 8 bytes
+    const uint8_t* body = content.data() + content.size() - 10 - footer_length - 8 - (24 + 24 + 16 + 16);
+    ASSERT_EQ(memcmp(body, times, sizeof(times)), 0);
+    ASSERT_EQ(memcmp(body + 24, values, sizeof(values)), 0);
+    ASSERT_EQ(memcmp(body + 48, devices, sizeof(devices)), 0);
+    ASSERT_EQ(memcmp(body + 64, measurements, sizeof(measurements)), 0);
+
+    ASSERT_EQ(remove("arrow_test.arrow"), 0);
+}
@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+#include <AsyncProducer.hpp>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace libspeedwire;
+
+class RecordingProducer : public Producer {
+public:
+    std::vector<double> values;
+    int flushed = 0;
+    virtual void flush(void) { ++flushed; }
+    virtual void produce(const SpeedwireDevice& /*device*/, const MeasurementType& /*type*/, const Wire /*wire*/, const double value, const uint32_t /*time_in_ms*/) { values.push_back(value); }
+};
+
+// test that all values are delivered in order and flushed in batches
+TEST(AsyncProducerTest, DeliverInOrder) {
+    RecordingProducer recorder;
+    {
+        AsyncProducer async(recorder, 256, OverflowPolicy::BLOCK, 10, 1000);
+        ASSERT_EQ(async.getCapacity(), 256);
+        SpeedwireDevice device;
+        for (int i = 0; i < 1000; ++i) {
+            async.produce(device, MeasurementType::InverterPower(), Wire::L1, (double)i, i);
+        }
+        async.flush();
+        async.stop();
+        ASSERT_EQ(async.getEnqueuedCount(), 1000);
+        ASSERT_EQ(async.getProducedCount(), 1000);
+        ASSERT_EQ(async.getDroppedCount(), 0);
+        ASSERT_EQ(async.getQueueDepth(), 0);
+    }
+    ASSERT_EQ(recorder.values.size(), 1000);
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_EQ(recorder.values[i], (double)i);
+    }
+    ASSERT_GE(recorder.flushed, 100);
+}
+
+// producer blocking in produce() until it is released, such that the queue of the AsyncProducer fills up
+class GatedProducer : public RecordingProducer {
+public:
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool entered = false;
+    bool released = false;
+    virtual void produce(const SpeedwireDevice& /*device*/, const MeasurementType& /*type*/, const Wire /*wire*/, const double value, const uint32_t /*time_in_ms*/) {
+        std::unique_lock<std::mutex> lock(mutex);
+        entered = true;
+        condition.notify_all();
+        condition.wait(lock, [this] { return released; });
+        values.push_back(value);
+    }
+    void waitUntilEntered(void) {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this] { return entered; });
+    }
+    void release(void) {
+        std::lock_guard<std::mutex> lock(mutex);
+        released = true;
+        condition.notify_all();
+    }
+};
+
+// fill a queue of capacity 4 while the worker is blocked in the wrapped producer with value 0
+static void fillQueue(AsyncProducer& async, GatedProducer& gate, const int num_values) {
+    SpeedwireDevice device;
+    async.produce(device, MeasurementType::InverterPower(), Wire::L1, 0.0, 0);
+    gate.waitUntilEntered();
+    for (int i = 1; i < num_values; ++i) {
+        async.produce(device, MeasurementType::InverterPower(), Wire::L1, (double)i, i);
+    }
+}
+
+// test the oldest queued values are dropped and counted if the queue is full
+TEST(AsyncProducerTest, DropOldest) {
+    GatedProducer gate;
+    AsyncProducer async(gate, 4, OverflowPolicy::DROP_OLDEST, 1, 1000);
+    fillQueue(async, gate, 7);
+    ASSERT_EQ(async.getEnqueuedCount(), 7);
+    ASSERT_EQ(async.getDroppedCount(), 2);
+    ASSERT_EQ(async.getMaxQueueDepth(), 4);
+    gate.release();
+    async.stop();
+    ASSERT_EQ(async.getProducedCount(), 5);
+    std::vector<double> expected = { 0, 3, 4, 5, 6 };
+    ASSERT_EQ(gate.values, expected);
+}
+
+// test new values are dropped and counted if the queue is full
+TEST(AsyncProducerTest, DropNewest) {
+    GatedProducer gate;
+    AsyncProducer async(gate, 4, OverflowPolicy::DROP_NEWEST, 1, 1000);
+    fillQueue(async, gate, 7);
+    ASSERT_EQ(async.getEnqueuedCount(), 5);
+    ASSERT_EQ(async.getDroppedCount(), 2);
+    gate.release();
+    async.stop();
+    ASSERT_EQ(async.getProducedCount(), 5);
+    std::vector<double> expected = { 0, 1, 2, 3, 4 };
+    ASSERT_EQ(gate.values, expected);
+}
+
+// test a producing thread waits for room in a full queue and values produced after stop() are dropped
+TEST(AsyncProducerTest, BlockAndStop) {
+    GatedProducer gate;
+    AsyncProducer async(gate, 4, OverflowPolicy::BLOCK, 1, 1000);
+    fillQueue(async, gate, 5);
+    std::atomic<bool> done(false);
+    std::thread thread([&] {
+        SpeedwireDevice device;
+        async.produce(device, MeasurementType::InverterPower(), Wire::L1, 5.0, 5);
+        done = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ASSERT_FALSE(done.load());
+    gate.release();
+    thread.join();
+    ASSERT_TRUE(done.load());
+    async.stop();
+    std::vector<double> expected = { 0, 1, 2, 3, 4, 5 };
+    ASSERT_EQ(gate.values, expected);
+
+    SpeedwireDevice device;
+    async.produce(device, MeasurementType::InverterPower(), Wire::L1, 6.0, 6);
+    ASSERT_EQ(async.getDroppedCount(), 1);
+    ASSERT_EQ(async.getEnqueuedCount(), 6);
+    ASSERT_EQ(gate.values.size(), 6);
+}
+
+// test values produced concurrently with stop() are either passed to the wrapped producer or counted as dropped
+TEST(AsyncProducerTest, ProduceDuringStop) {
+    for (int round = 0; round < 20; ++round) {
+        RecordingProducer recorder;
+        AsyncProducer async(recorder, 1024, OverflowPolicy::BLOCK, 16, 1000);
+        std::atomic<bool> go(false);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.push_back(std::thread([&] {
+                SpeedwireDevice device;
+                while (go.load() == false) {}
+                for (int i = 0; i < 200; ++i) {
+                    async.produce(device, MeasurementType::InverterPower(), Wire::L1, (double)i, i);
+                }
+            }));
+        }
+        go = true;
+        async.stop();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        ASSERT_EQ(async.getEnqueuedCount() + async.getDroppedCount(), 4 * 200);
+        ASSERT_EQ(async.getProducedCount(), async.getEnqueuedCount());
+        ASSERT_EQ(recorder.values.size(), async.getEnqueuedCount());
+    }
+}
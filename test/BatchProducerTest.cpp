@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+#include <BatchProducer.hpp>
+
+using namespace libspeedwire;
+
+class CountingProducer : public Producer {
+public:
+    int produced = 0;
+    int flushed = 0;
+    double sum = 0.0;
+    virtual void flush(void) { ++flushed; }
+    virtual void produce(const SpeedwireDevice& /*device*/, const MeasurementType& /*type*/, const Wire /*wire*/, const double value, const uint32_t /*time_in_ms*/) { ++produced; sum += value; }
+};
+
+// test columnar layout and table deduplication
+TEST(BatchProducerTest, RecordBatch) {
+    SpeedwireDevice dev1, dev2;
+    dev1.deviceAddress.serialNumber = 1;
+    dev2.deviceAddress.serialNumber = 2;
+    dev1.deviceClass = "a device class exceeding the short string buffer";
+    RecordBatch batch;
+    batch.add(dev1, MeasurementType::InverterPower(), Wire::L1, 1.0, 10);
+    batch.add(dev1, MeasurementType::InverterPower(), Wire::L2, 2.0, 10);
+    batch.add(dev2, MeasurementType::InverterPower(), Wire::L1, 3.0, 11);
+    ASSERT_EQ(batch.size(), 3);
+    ASSERT_EQ(batch.getDeviceCount(), 2);
+    ASSERT_EQ(batch.getMeasurementCount(), 2);
+    ASSERT_EQ(batch.getDevice(2).deviceAddress.serialNumber, 2);
+    ASSERT_EQ(batch.getWire(1), Wire::L2);
+    ASSERT_EQ(batch.times[2], 11);
+
+    // measurement types differing in the divisor only are kept apart
+    batch.add(dev1, MeasurementType::InverterPower(), Wire::L1, 4.0, 12);
+    batch.add(dev1, MeasurementType(Direction::NO_DIRECTION, Type::NO_TYPE, Quantity::POWER, "W", 10), Wire::L1, 5.0, 12);
+    ASSERT_EQ(batch.getMeasurementCount(), 3);
+    ASSERT_EQ(batch.getMeasurementType(4).divisor, 10);
+    ASSERT_EQ(batch.measurementIndex[3], 0);
+
+    // clearing releases the table entries for reuse without destroying them
+    batch.clear();
+    ASSERT_EQ(batch.size(), 0);
+    ASSERT_EQ(batch.getDeviceCount(), 0);
+    ASSERT_EQ(batch.getMeasurementCount(), 0);
+    ASSERT_EQ(batch.deviceTable.size(), 2);
+    batch.add(dev2, MeasurementType::InverterPower(), Wire::L3, 6.0, 13);
+    ASSERT_EQ(batch.getDeviceCount(), 1);
+    ASSERT_EQ(batch.getMeasurementCount(), 1);
+    ASSERT_EQ(batch.getDevice(0).deviceAddress.serialNumber, 2);
+    ASSERT_EQ(batch.getWire(0), Wire::L3);
+    ASSERT_GE(batch.deviceTable[0].deviceClass.capacity(), dev1.deviceClass.size());
+}
+
+// test producer to batch producer round trip
+TEST(BatchProducerTest, Adapters) {
+    CountingProducer counter;
+    ProducerBatchAdapter adapter(counter);
+    BatchingProducer batching(adapter);
+    SpeedwireDevice dev;
+    batching.produce(dev, MeasurementType::InverterPower(), Wire::L1, 1.0, 10);
+    batching.produce(dev, MeasurementType::InverterPower(), Wire::L2, 2.0, 10);
+    ASSERT_EQ(counter.produced, 0);
+    batching.flush();
+    ASSERT_EQ(counter.produced, 2);
+    ASSERT_EQ(counter.flushed, 1);
+    ASSERT_EQ(counter.sum, 3.0);
+    batching.flush();
+    ASSERT_EQ(counter.flushed, 1);
+}
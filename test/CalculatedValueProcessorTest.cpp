@@ -0,0 +1,245 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <CalculatedValueProcessor.hpp>
+#include <SpeedwireTime.hpp>
+
+using namespace libspeedwire;
+
+// producer collecting all produced values
+class ValueCollector : public Producer {
+public:
+    struct Value {
+        uint32_t serial;
+        MeasurementType type;
+        Wire wire;
+        double value;
+        uint32_t time;
+        Value(const uint32_t s, const MeasurementType& t, const Wire w, const double v, const uint32_t tm) : serial(s), type(t), wire(w), value(v), time(tm) {}
+    };
+    std::vector<Value> values;
+
+    virtual void flush(void) {}
+    virtual void produce(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value, const uint32_t time_in_ms) {
+        values.push_back(Value(device.deviceAddress.serialNumber, type, wire, value, time_in_ms));
+    }
+    const Value* find(const MeasurementType& type, const Wire wire) const {
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (values[i].type.name == type.name && values[i].wire == wire) return &values[i];
+        }
+        return NULL;
+    }
+    const Value* find(const uint32_t serial, const MeasurementType& type, const Wire wire) const {
+        for (size_t i = 0; i < values.size(); ++i) {
+            if (values[i].serial == serial && values[i].type.name == type.name && values[i].wire == wire) return &values[i];
+        }
+        return NULL;
+    }
+};
+
+// replace all values of the given data map element by a single value
+template<class Map, class Element> static void setValue(Map& map, const Element& element, const double value, const uint32_t time) {
+    MeasurementValues& values = map[element.toKey()].measurementValues;
+    values.clear();
+    values.addMeasurement(value, time);
+}
+
+// get a speedwire data map holding inverter power values
+static void addInverterElements(SpeedwireDataMap& speedwire_map) {
+    speedwire_map.add(SpeedwireData::InverterPowerMPP1);
+    speedwire_map.add(SpeedwireData::InverterPowerMPP2);
+    speedwire_map.add(SpeedwireData::InverterPowerL1);
+    speedwire_map.add(SpeedwireData::InverterPowerL2);
+    speedwire_map.add(SpeedwireData::InverterPowerL3);
+    speedwire_map.add(SpeedwireData::BatteryPowerL1);
+    speedwire_map.add(SpeedwireData::BatteryPowerL2);
+    speedwire_map.add(SpeedwireData::BatteryPowerL3);
+    for (auto& entry : speedwire_map) entry.second.measurementValues.setMaximumNumberOfElements(4);
+}
+
+// test signed power is calculated per value into the signed power element of the obis data map
+TEST(CalculatedValueProcessorTest, SignedPower) {
+    ObisDataMap obis_map;
+    obis_map.add(ObisData::PositiveActivePowerL1);
+    obis_map.add(ObisData::NegativeActivePowerL1);
+    obis_map.add(ObisData::SignedActivePowerL1);
+    obis_map.add(ObisData::PositiveActivePowerL2);
+    obis_map.add(ObisData::NegativeActivePowerL2);
+    for (auto& entry : obis_map) entry.second.measurementValues.setMaximumNumberOfElements(4);
+    SpeedwireDataMap speedwire_map;
+    ValueCollector collector;
+    CalculatedValueProcessor processor(obis_map, speedwire_map, collector);
+
+    SpeedwireDevice emeter;
+    emeter.deviceAddress.serialNumber = 1;
+    obis_map[ObisData::PositiveActivePowerL1.toKey()].measurementValues.addMeasurement(100.0, 1000);
+    obis_map[ObisData::PositiveActivePowerL1.toKey()].measurementValues.addMeasurement(200.0, 2000);
+    obis_map[ObisData::NegativeActivePowerL1.toKey()].measurementValues.addMeasurement(30.0, 1000);
+    obis_map[ObisData::NegativeActivePowerL1.toKey()].measurementValues.addMeasurement(10.0, 2000);
+    setValue(obis_map, ObisData::PositiveActivePowerL2, 100.0, 2000);
+    setValue(obis_map, ObisData::NegativeActivePowerL2, 0.0, 2000);
+    processor.endOfObisData(emeter, 2000);
+
+    const ValueCollector::Value* value = collector.find(ObisData::SignedActivePowerL1.measurementType, Wire::L1);
+    ASSERT_TRUE(value != NULL);
+    ASSERT_EQ(value->serial, 1);
+    ASSERT_DOUBLE_EQ(value->value, 130.0);
+    ASSERT_EQ(value->time, 2000);
+    const MeasurementValues& signed_values = obis_map[ObisData::SignedActivePowerL1.toKey()].measurementValues;
+    ASSERT_EQ(signed_values.getNumberOfElements(), 2);
+    ASSERT_DOUBLE_EQ(signed_values.getNewestElement().value, 190.0);
+
+    // there is no signed power element for L2
+    ASSERT_TRUE(collector.find(ObisData::SignedActivePowerL2.measurementType, Wire::L2) == NULL);
+}
+
+// test dc, ac, loss and efficiency of a pv inverter
+TEST(CalculatedValueProcessorTest, InverterTotals) {
+    ObisDataMap obis_map;
+    SpeedwireDataMap speedwire_map;
+    addInverterElements(speedwire_map);
+    ValueCollector collector;
+    CalculatedValueProcessor processor(obis_map, speedwire_map, collector);
+
+    SpeedwireDevice inverter;
+    inverter.deviceAddress.serialNumber = 2;
+    inverter.deviceClass = "PV-Inverter";
+    const uint32_t time = SpeedwireTime::getInverterTimeNow();
+    setValue(speedwire_map, SpeedwireData::InverterPowerMPP1, 500.0, time);
+    setValue(speedwire_map, SpeedwireData::InverterPowerMPP2, 300.0, time);
+    setValue(speedwire_map, SpeedwireData::InverterPowerL1, 250.0, time);
+    setValue(speedwire_map, SpeedwireData::InverterPowerL2, 250.0, time);
+    setValue(speedwire_map, SpeedwireData::InverterPowerL3, 250.0, time + 1);
+    processor.endOfSpeedwireData(inverter, time);
+
+    const ValueCollector::Value* dc = collector.find(SpeedwireData::InverterPowerDCTotal.measurementType, SpeedwireData::InverterPowerDCTotal.wire);
+    const ValueCollector::Value* ac = collector.find(SpeedwireData::InverterPowerACTotal.measurementType, SpeedwireData::InverterPowerACTotal.wire);
+    const ValueCollector::Value* loss = collector.find(SpeedwireData::InverterPowerLoss.measurementType, SpeedwireData::InverterPowerLoss.wire);
+    const ValueCollector::Value* efficiency = collector.find(SpeedwireData::InverterPowerEfficiency.measurementType, SpeedwireData::InverterPowerEfficiency.wire);
+    ASSERT_TRUE(dc != NULL && ac != NULL && loss != NULL && efficiency != NULL);
+    ASSERT_DOUBLE_EQ(dc->value, 800.0);
+    ASSERT_DOUBLE_EQ(ac->value, 750.0);
+    ASSERT_DOUBLE_EQ(loss->value, 50.0);
+    ASSERT_DOUBLE_EQ(efficiency->value, 93.75);
+    ASSERT_EQ(dc->serial, 2);
+    ASSERT_EQ(dc->time, time);
+    ASSERT_EQ(collector.values.size(), 4);
+
+    // dc values more than 1 second apart are not summed up; without a dc total, there is no loss and efficiency
+    collector.values.clear();
+    setValue(speedwire_map, SpeedwireData::InverterPowerMPP2, 300.0, time + 2);
+    processor.endOfSpeedwireData(inverter, time);
+    ASSERT_TRUE(collector.find(SpeedwireData::InverterPowerDCTotal.measurementType, SpeedwireData::InverterPowerDCTotal.wire) == NULL);
+    ASSERT_TRUE(collector.find(SpeedwireData::InverterPowerACTotal.measurementType, SpeedwireData::InverterPowerACTotal.wire) != NULL);
+    ASSERT_TRUE(collector.find(SpeedwireData::InverterPowerLoss.measurementType, SpeedwireData::InverterPowerLoss.wire) == NULL);
+    ASSERT_TRUE(collector.find(SpeedwireData::InverterPowerEfficiency.measurementType, SpeedwireData::InverterPowerEfficiency.wire) == NULL);
+
+    // ac values more than 1 second apart are not summed up
+    collector.values.clear();
+    setValue(speedwire_map, SpeedwireData::InverterPowerMPP2, 300.0, time);
+    setValue(speedwire_map, SpeedwireData::InverterPowerL3, 250.0, time + 2);
+    processor.endOfSpeedwireData(inverter, time);
+    ASSERT_TRUE(collector.find(SpeedwireData::InverterPowerDCTotal.measurementType, SpeedwireData::InverterPowerDCTotal.wire) != NULL);
+    ASSERT_TRUE(collector.find(SpeedwireData::InverterPowerACTotal.measurementType, SpeedwireData::InverterPowerACTotal.wire) == NULL);
+    ASSERT_TRUE(collector.find(SpeedwireData::InverterPowerLoss.measurementType, SpeedwireData::InverterPowerLoss.wire) == NULL);
+
+    // the efficiency is 0 without dc power
+    collector.values.clear();
+    setValue(speedwire_map, SpeedwireData::InverterPowerMPP1, 0.0, time);
+    setValue(speedwire_map, SpeedwireData::InverterPowerMPP2, 0.0, time);
+    setValue(speedwire_map, SpeedwireData::InverterPowerL3, 250.0, time);
+    processor.endOfSpeedwireData(inverter, time);
+    loss = collector.find(SpeedwireData::InverterPowerLoss.measurementType, SpeedwireData::InverterPowerLoss.wire);
+    efficiency = collector.find(SpeedwireData::InverterPowerEfficiency.measurementType, SpeedwireData::InverterPowerEfficiency.wire);
+    ASSERT_TRUE(loss != NULL && efficiency != NULL);
+    ASSERT_DOUBLE_EQ(loss->value, -750.0);
+    ASSERT_DOUBLE_EQ(efficiency->value, 0.0);
+}
+
+// test a battery inverter yields its ac total only
+TEST(CalculatedValueProcessorTest, BatteryInverter) {
+    ObisDataMap obis_map;
+    SpeedwireDataMap speedwire_map;
+    addInverterElements(speedwire_map);
+    ValueCollector collector;
+    CalculatedValueProcessor processor(obis_map, speedwire_map, collector);
+
+    SpeedwireDevice inverter;
+    inverter.deviceAddress.serialNumber = 3;
+    inverter.deviceClass = "Battery-Inverter";
+    const uint32_t time = SpeedwireTime::getInverterTimeNow();
+    setValue(speedwire_map, SpeedwireData::InverterPowerMPP1, 500.0, time);
+    setValue(speedwire_map, SpeedwireData::InverterPowerMPP2, 300.0, time);
+    setValue(speedwire_map, SpeedwireData::BatteryPowerL1, 100.0, time);
+    setValue(speedwire_map, SpeedwireData::BatteryPowerL2, 200.0, time);
+    setValue(speedwire_map, SpeedwireData::BatteryPowerL3, 300.0, time);
+    processor.endOfSpeedwireData(inverter, time);
+
+    ASSERT_EQ(collector.values.size(), 1);
+    const ValueCollector::Value* ac = collector.find(SpeedwireData::BatteryPowerACTotal.measurementType, SpeedwireData::BatteryPowerACTotal.wire);
+    ASSERT_TRUE(ac != NULL);
+    ASSERT_DOUBLE_EQ(ac->value, 600.0);
+    ASSERT_EQ(ac->time, time);
+}
+
+// test household power and income are derived from recent grid values only
+TEST(CalculatedValueProcessorTest, Household) {
+    ObisDataMap obis_map;
+    obis_map.add(ObisData::PositiveActivePowerTotal);
+    obis_map.add(ObisData::NegativeActivePowerTotal);
+    for (auto& entry : obis_map) entry.second.measurementValues.setMaximumNumberOfElements(4);
+    SpeedwireDataMap speedwire_map;
+    addInverterElements(speedwire_map);
+    ValueCollector collector;
+    CalculatedValueProcessor processor(obis_map, speedwire_map, collector);
+
+    SpeedwireDevice inverter;
+    inverter.deviceAddress.serialNumber = 2;
+    inverter.deviceClass = "PV-Inverter";
+    const uint32_t time = SpeedwireTime::getInverterTimeNow();
+    const uint32_t emeter_time = SpeedwireTime::getEmeterTimeNow();
+    setValue(speedwire_map, SpeedwireData::InverterPowerL1, 250.0, time);
+    setValue(speedwire_map, SpeedwireData::InverterPowerL2, 250.0, time);
+    setValue(speedwire_map, SpeedwireData::InverterPowerL3, 250.0, time);
+    setValue(obis_map, ObisData::PositiveActivePowerTotal, 1000.0, emeter_time);
+    setValue(obis_map, ObisData::NegativeActivePowerTotal, 0.0, emeter_time);
+    processor.endOfSpeedwireData(inverter, time);
+
+    const ValueCollector::Value* household = collector.find(0xcafebabe, SpeedwireData::HouseholdPowerTotal.measurementType, SpeedwireData::HouseholdPowerTotal.wire);
+    const ValueCollector::Value* income = collector.find(0xcafebabe, SpeedwireData::HouseholdIncomeTotal.measurementType, SpeedwireData::HouseholdIncomeTotal.wire);
+    ASSERT_TRUE(household != NULL && income != NULL);
+    ASSERT_DOUBLE_EQ(household->value, 1750.0);
+    ASSERT_EQ(household->time, emeter_time);
+    ASSERT_DOUBLE_EQ(income->value, 750.0 * 0.30 / 1000);
+    ASSERT_EQ(income->time, emeter_time);
+
+    // grid values older than 120 seconds are not used
+    collector.values.clear();
+    setValue(obis_map, ObisData::NegativeActivePowerTotal, 0.0, emeter_time - 200000);
+    processor.endOfSpeedwireData(inverter, time);
+    ASSERT_TRUE(collector.find(SpeedwireData::InverterPowerACTotal.measurementType, SpeedwireData::InverterPowerACTotal.wire) != NULL);
+    ASSERT_TRUE(collector.find(0xcafebabe, SpeedwireData::HouseholdPowerTotal.measurementType, SpeedwireData::HouseholdPowerTotal.wire) == NULL);
+    ASSERT_TRUE(collector.find(0xcafebabe, SpeedwireData::HouseholdIncomeTotal.measurementType, SpeedwireData::HouseholdIncomeTotal.wire) == NULL);
+}
+
+// test site-specific formulas are evaluated in addition to the built-in values
+TEST(CalculatedValueProcessorTest, Expressions) {
+    ObisDataMap obis_map;
+    SpeedwireDataMap speedwire_map;
+    speedwire_map.add(SpeedwireData::InverterPowerMPP1);
+    speedwire_map[SpeedwireData::InverterPowerMPP1.toKey()].measurementValues.setMaximumNumberOfElements(4);
+    ValueCollector collector;
+    CalculatedValueProcessor processor(obis_map, speedwire_map, collector);
+    ExpressionEngine& engine = processor.getExpressionEngine();
+    engine.bindOutput("PdcA", MeasurementType::InverterPower(), Wire::NO_WIRE);
+    ASSERT_TRUE(engine.compile("PdcA = 2 * power_mpp1"));
+
+    SpeedwireDevice inverter;
+    inverter.deviceAddress.serialNumber = 2;
+    const uint32_t time = SpeedwireTime::getInverterTimeNow();
+    setValue(speedwire_map, SpeedwireData::InverterPowerMPP1, 500.0, time);
+    processor.endOfSpeedwireData(inverter, time);
+    const ValueCollector::Value* value = collector.find(MeasurementType::InverterPower(), Wire::NO_WIRE);
+    ASSERT_TRUE(value != NULL);
+    ASSERT_DOUBLE_EQ(value->value, 1000.0);
+    ASSERT_EQ(value->serial, 2);
+}
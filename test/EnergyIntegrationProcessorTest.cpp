@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <vector>
+#include <EnergyIntegrationProcessor.hpp>
+#include "ProcessorTestHelpers.hpp"
+
+using namespace libspeedwire;
+
+// producer collecting all produced energy counters
+class EnergyCollector : public Producer {
+public:
+    std::vector<double> values;
+    std::vector<uint32_t> times;
+    std::vector<MeasurementType> types;
+    int numFlushes;
+
+    EnergyCollector(void) : numFlushes(0) {}
+
+    virtual void flush(void) { ++numFlushes; }
+    virtual void produce(const SpeedwireDevice& /*device*/, const MeasurementType& type, const Wire /*wire*/, const double value, const uint32_t time_in_ms) {
+        values.push_back(value);
+        times.push_back(time_in_ms);
+        types.push_back(type);
+    }
+};
+
+// test trapezoidal integration of emeter and inverter power values
+TEST(EnergyIntegrationProcessorTest, Trapezoid) {
+    SpeedwireDevice device = getDevice();
+    ObisData power(ObisData::PositiveActivePowerTotal);
+    ObisData energy(ObisData::PositiveActiveEnergyTotal);
+    EnergyCollector collector;
+    EnergyIntegrationProcessor processor(collector, 3600000);
+
+    addValue(processor, device, power, 1000.0, 0);
+    ASSERT_EQ(collector.values.size(), 0);                  // nothing integrated yet
+    addValue(processor, device, power, 2000.0, 1800000);    // 30 minutes
+    ASSERT_DOUBLE_EQ(processor.getEnergy(1234, power.toKey()), 750.0);
+    ASSERT_EQ(collector.values.size(), 1);
+    ASSERT_DOUBLE_EQ(collector.values[0], 750.0);
+    ASSERT_EQ(collector.times[0], 1800000);
+    ASSERT_EQ(collector.types[0].quantity, Quantity::ENERGY);
+    ASSERT_EQ(collector.types[0].unit, "Wh");
+    ASSERT_EQ(collector.numFlushes, 1);
+
+    // duplicates and energy values are ignored
+    addValue(processor, device, power, 5000.0, 1800000);
+    addValue(processor, device, energy, 100.0, 1900000);
+    ASSERT_EQ(collector.values.size(), 1);
+    ASSERT_DOUBLE_EQ(processor.getEnergy(1234, energy.toKey()), 0.0);
+
+    // inverter timestamps are in seconds
+    SpeedwireData mpp1(SpeedwireData::InverterPowerMPP1);
+    mpp1.measurementValues.setMaximumNumberOfElements(4);
+    mpp1.measurementValues.addMeasurement(500.0, 100);
+    processor.consume(device, mpp1);
+    mpp1.measurementValues.addMeasurement(500.0, 3700);
+    processor.consume(device, mpp1);
+    processor.endOfSpeedwireData(device, 3700);
+    ASSERT_DOUBLE_EQ(processor.getEnergy(1234, mpp1.toKey()), 500.0);
+    ASSERT_EQ(collector.times.back(), 3700000);
+}
+
+// test emeter and inverter power values of the same device are integrated and produced with timestamps in ms
+TEST(EnergyIntegrationProcessorTest, MixedSources) {
+    SpeedwireDevice device = getDevice();
+    ObisData power(ObisData::PositiveActivePowerTotal);
+    SpeedwireData mpp1(SpeedwireData::InverterPowerMPP1);
+    mpp1.measurementValues.setMaximumNumberOfElements(4);
+    EnergyCollector collector;
+    EnergyIntegrationProcessor processor(collector, 120000);
+
+    // inverter values 60 seconds apart are within the 120 seconds maximum gap
+    const uint32_t epoch_time = 1700000000;
+    mpp1.measurementValues.addMeasurement(600.0, epoch_time);
+    processor.consume(device, mpp1);
+    processor.endOfSpeedwireData(device, epoch_time);
+    mpp1.measurementValues.addMeasurement(600.0, epoch_time + 60);
+    processor.consume(device, mpp1);
+    processor.endOfSpeedwireData(device, epoch_time + 60);
+    ASSERT_DOUBLE_EQ(processor.getEnergy(1234, mpp1.toKey()), 10.0);
+
+    // emeter values are in ms; the inverter accumulator is not produced again, as it did not change
+    addValue(processor, device, power, 1200.0, 1000000);
+    addValue(processor, device, power, 1200.0, 1060000);
+    ASSERT_DOUBLE_EQ(processor.getEnergy(1234, power.toKey()), 20.0);
+
+    ASSERT_EQ(collector.values.size(), 2);
+    ASSERT_DOUBLE_EQ(collector.values[0], 10.0);
+    ASSERT_EQ(collector.times[0], (uint32_t)((uint64_t)(epoch_time + 60) * 1000));
+    ASSERT_DOUBLE_EQ(collector.values[1], 20.0);
+    ASSERT_EQ(collector.times[1], 1060000);
+
+    // an inverter interval exceeding the maximum gap in ms is not integrated
+    mpp1.measurementValues.addMeasurement(600.0, epoch_time + 300);
+    processor.consume(device, mpp1);
+    ASSERT_DOUBLE_EQ(processor.getEnergy(1234, mpp1.toKey()), 10.0);
+}
+
+// test intervals longer than the maximum gap are not integrated
+TEST(EnergyIntegrationProcessorTest, Gap) {
+    SpeedwireDevice device = getDevice();
+    ObisData power(ObisData::PositiveActivePowerTotal);
+    EnergyCollector collector;
+    EnergyIntegrationProcessor processor(collector, 60000);
+
+    addValue(processor, device, power, 1000.0, 0);
+    addValue(processor, device, power, 1000.0, 120000);     // gap
+    ASSERT_DOUBLE_EQ(processor.getEnergy(1234, power.toKey()), 0.0);
+    ASSERT_EQ(collector.values.size(), 0);
+    addValue(processor, device, power, 3000.0, 156000);     // integration continues after the gap
+    ASSERT_DOUBLE_EQ(processor.getEnergy(1234, power.toKey()), 20.0);
+    ASSERT_EQ(collector.values.size(), 1);
+}
+
+// test the accumulated energies survive a checkpoint round-trip
+TEST(EnergyIntegrationProcessorTest, Checkpoint) {
+    const std::string path = "EnergyIntegrationProcessorTest.checkpoint";
+    SpeedwireDevice device = getDevice();
+    ObisData power(ObisData::PositiveActivePowerTotal);
+    ObisData power_l1(ObisData::PositiveActivePowerL1);
+    EnergyCollector collector;
+    {
+        EnergyIntegrationProcessor processor(collector, 3600000);
+        addValue(processor, device, power, 1000.0, 0);
+        addValue(processor, device, power, 1000.0, 360000);
+        addValue(processor, device, power_l1, 1.0 / 3.0, 0);
+        addValue(processor, device, power_l1, 1.0 / 3.0, 3600000);
+        ASSERT_TRUE(processor.saveCheckpoint(path));
+    }
+    FILE* temp = fopen((path + ".tmp").c_str(), "r");
+    ASSERT_TRUE(temp == NULL);
+
+    EnergyIntegrationProcessor restored(collector, 3600000);
+    ASSERT_FALSE(restored.restoreCheckpoint(path + ".missing"));
+    ASSERT_TRUE(restored.restoreCheckpoint(path));
+    ASSERT_DOUBLE_EQ(restored.getEnergy(1234, power.toKey()), 100.0);
+    ASSERT_EQ(restored.getEnergy(1234, power_l1.toKey()), 1.0 / 3.0);      // restored bit-exactly
+
+    // the interval between the checkpoint and the first new value is not integrated
+    addValue(restored, device, power, 1000.0, 7200000);
+    ASSERT_DOUBLE_EQ(restored.getEnergy(1234, power.toKey()), 100.0);
+    addValue(restored, device, power, 1000.0, 7560000);
+    ASSERT_DOUBLE_EQ(restored.getEnergy(1234, power.toKey()), 200.0);
+    ASSERT_EQ(remove(path.c_str()), 0);
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <ExpressionEngine.hpp>
+#include <SpeedwireTime.hpp>
+
+using namespace libspeedwire;
+
+// test compilation and evaluation of a simple difference
+TEST(ExpressionEngineTest, Difference) {
+    Measurement pos(MeasurementType::EmeterPositiveActivePower(), Wire::L1);
+    Measurement neg(MeasurementType::EmeterNegativeActivePower(), Wire::L1);
+    pos.measurementValues.setMaximumNumberOfElements(4);
+    neg.measurementValues.setMaximumNumberOfElements(4);
+
+    ExpressionEngine engine;
+    engine.bindInput("pos", pos);
+    engine.bindInput("neg", neg);
+    ASSERT_TRUE(engine.compile("sig = pos - neg"));
+    const int sig = engine.findSlot("sig");
+    ASSERT_GE(sig, 0);
+
+    // no input values yet
+    ASSERT_EQ(engine.evaluate(), 0);
+    ASSERT_FALSE(engine.isValid(sig));
+
+    pos.measurementValues.addMeasurement(100.0, 1000);
+    neg.measurementValues.addMeasurement(30.0, 1000);
+    ASSERT_EQ(engine.evaluate(), 1);
+    ASSERT_TRUE(engine.isChanged(sig));
+    ASSERT_EQ(engine.getValue(sig), 70.0);
+    ASSERT_EQ(engine.getTime(sig), 1000);
+
+    // unchanged inputs are not recomputed
+    ASSERT_EQ(engine.evaluate(), 0);
+    ASSERT_FALSE(engine.isChanged(sig));
+}
+
+// test operator precedence, functions and chained formulas
+TEST(ExpressionEngineTest, PrecedenceAndDependencies) {
+    Measurement a(MeasurementType::InverterPower(), Wire::MPP1);
+    Measurement b(MeasurementType::InverterPower(), Wire::MPP2);
+    a.measurementValues.setMaximumNumberOfElements(4);
+    b.measurementValues.setMaximumNumberOfElements(4);
+
+    ExpressionEngine engine;
+    engine.bindInput("a", a);
+    engine.bindInput("b", b);
+    // the dependent formula is defined first; evaluation order follows dependencies
+    ASSERT_TRUE(engine.compile("y = max(x, 0) / 2  # comment\nx = -a + b * 3; z = abs(a - b)"));
+    ASSERT_EQ(engine.getNumberOfFormulas(), 3);
+
+    a.measurementValues.addMeasurement(10.0, 5);
+    b.measurementValues.addMeasurement(20.0, 5);
+    ASSERT_EQ(engine.evaluate(), 3);
+    ASSERT_EQ(engine.getValue(engine.findSlot("x")), 50.0);
+    ASSERT_EQ(engine.getValue(engine.findSlot("y")), 25.0);
+    ASSERT_EQ(engine.getValue(engine.findSlot("z")), 10.0);
+}
+
+// test compile errors
+TEST(ExpressionEngineTest, CompileErrors) {
+    ExpressionEngine engine;
+    ASSERT_FALSE(engine.compile("x = (a + "));
+    ASSERT_FALSE(engine.compile("x = foo(a)"));
+    ASSERT_FALSE(engine.compile("= a"));
+    ASSERT_FALSE(engine.compile("p = q\nq = p"));
+    ASSERT_EQ(engine.getNumberOfFormulas(), 0);
+    ASSERT_TRUE(engine.compile("x = 1"));
+    ASSERT_FALSE(engine.compile("x = 2"));
+    ASSERT_EQ(engine.getNumberOfFormulas(), 1);
+}
+
+// test failed compilations leave no orphan slots behind
+TEST(ExpressionEngineTest, CompileRollback) {
+    Measurement a(MeasurementType::InverterPower(), Wire::MPP1);
+    a.measurementValues.setMaximumNumberOfElements(4);
+
+    ExpressionEngine engine;
+    engine.bindInput("a", a);
+    ASSERT_FALSE(engine.compile("x = a + b\ny = (c"));
+    ASSERT_EQ(engine.findSlot("x"), -1);
+    ASSERT_EQ(engine.findSlot("b"), -1);
+    ASSERT_EQ(engine.findSlot("c"), -1);
+    ASSERT_FALSE(engine.compile("p = q + a\nq = p"));
+    ASSERT_EQ(engine.findSlot("p"), -1);
+    ASSERT_EQ(engine.findSlot("q"), -1);
+    ASSERT_GE(engine.findSlot("a"), 0);
+
+    // the bound input is still usable
+    ASSERT_TRUE(engine.compile("x = a * 2"));
+    a.measurementValues.addMeasurement(3.0, 10);
+    ASSERT_EQ(engine.evaluate(), 1);
+    ASSERT_EQ(engine.getValue(engine.findSlot("x")), 6.0);
+}
+
+// test mean() over all values of the bound measurement
+TEST(ExpressionEngineTest, Mean) {
+    Measurement a(MeasurementType::InverterPower(), Wire::MPP1);
+    a.measurementValues.setMaximumNumberOfElements(4);
+
+    ExpressionEngine engine;
+    engine.bindInput("a", a);
+    ASSERT_TRUE(engine.compile("m = mean(a); n = mean(m) + a"));
+    ASSERT_FALSE(engine.compile("x = mean(a + 1)"));
+    a.measurementValues.addMeasurement(1.0, 10);
+    a.measurementValues.addMeasurement(2.0, 20);
+    a.measurementValues.addMeasurement(6.0, 30);
+    ASSERT_EQ(engine.evaluate(), 2);
+    ASSERT_EQ(engine.getValue(engine.findSlot("m")), 3.0);
+    ASSERT_EQ(engine.getValue(engine.findSlot("n")), 9.0);     // mean of an output is its value
+}
+
+// test inverter timestamps in seconds are converted into emeter time
+TEST(ExpressionEngineTest, TimeConversion) {
+    Measurement emeter(MeasurementType::EmeterPositiveActivePower(), Wire::TOTAL);
+    Measurement inverter(MeasurementType::InverterPower(), Wire::TOTAL);
+    emeter.measurementValues.setMaximumNumberOfElements(4);
+    inverter.measurementValues.setMaximumNumberOfElements(4);
+
+    ExpressionEngine engine;
+    engine.bindInput("grid", emeter);
+    engine.bindInput("pv", inverter, true);
+    ASSERT_TRUE(engine.compile("pv_only = pv * 1\nhouse = grid + pv"));
+
+    const uint32_t inverter_time = SpeedwireTime::getInverterTimeNow() - 10;
+    const uint32_t emeter_time = SpeedwireTime::convertInverterToEmeterTime(inverter_time) + 5000;
+    inverter.measurementValues.addMeasurement(1000.0, inverter_time);
+    emeter.measurementValues.addMeasurement(200.0, emeter_time);
+    ASSERT_EQ(engine.evaluate(), 2);
+    ASSERT_EQ(engine.getTime(engine.findSlot("pv_only")), SpeedwireTime::convertInverterToEmeterTime(inverter_time));
+    ASSERT_EQ(engine.getTime(engine.findSlot("house")), emeter_time);
+}
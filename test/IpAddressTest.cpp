@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include <map>
+#include <unordered_map>
+#include <IpAddress.hpp>
+#include <AddressConversion.hpp>
+
+using namespace libspeedwire;
+
+// test parsing and formatting of ipv4 and ipv6 addresses
+TEST(IpAddressTest, Parse) {
+    IpAddress v4("192.168.182.18");
+    ASSERT_TRUE(v4.isValid());
+    ASSERT_TRUE(v4.isIpv4());
+    ASSERT_FALSE(v4.isIpv6());
+    ASSERT_EQ(v4.toString(), "192.168.182.18");
+    ASSERT_EQ(v4.getSockAddr().sa_family, AF_INET);
+    ASSERT_EQ(v4.getSockAddrIn().sin_port, 0);
+
+    IpAddress v6(std::string("fe80::1"));
+    ASSERT_TRUE(v6.isValid());
+    ASSERT_TRUE(v6.isIpv6());
+    ASSERT_EQ(v6.toString(), "fe80::1");
+
+    ASSERT_FALSE(IpAddress().isValid());
+    ASSERT_FALSE(IpAddress("").isValid());
+    ASSERT_FALSE(IpAddress("192.168.182.256").isValid());
+    ASSERT_FALSE(IpAddress("speedwire").isValid());
+    ASSERT_EQ(IpAddress().toString(), "");
+
+    ASSERT_TRUE(IpAddress("0.0.0.0").isAny());
+    ASSERT_TRUE(IpAddress("::").isAny());
+    ASSERT_FALSE(v4.isAny());
+
+    // conversion from and to binary forms
+    IpAddress from_in_addr(v4.getInAddress());
+    ASSERT_EQ(from_in_addr, v4);
+    IpAddress from_sockaddr(v6.getSockAddr());
+    ASSERT_EQ(from_sockaddr, v6);
+}
+
+// test comparison, ordering and hashing
+TEST(IpAddressTest, Compare) {
+    IpAddress a("192.168.182.18");
+    IpAddress b("192.168.182.19");
+    IpAddress c("fe80::1");
+    ASSERT_TRUE(a == IpAddress("192.168.182.18"));
+    ASSERT_TRUE(a != b);
+    ASSERT_TRUE(a != c);
+    ASSERT_TRUE(a < b);
+    ASSERT_FALSE(b < a);
+    ASSERT_FALSE(a < a);
+    ASSERT_TRUE((a < c) != (c < a));
+    ASSERT_EQ(a.hash(), IpAddress("192.168.182.18").hash());
+
+    std::unordered_map<IpAddress, int> unordered;
+    unordered[a] = 1;
+    unordered[b] = 2;
+    unordered[c] = 3;
+    ASSERT_EQ(unordered.size(), 3);
+    ASSERT_EQ(unordered[IpAddress("192.168.182.19")], 2);
+    ASSERT_EQ(unordered[IpAddress("fe80::1")], 3);
+
+    std::map<IpAddress, int> ordered;
+    ordered[c] = 3;
+    ordered[b] = 2;
+    ordered[a] = 1;
+    ASSERT_EQ(ordered.size(), 3);
+    ASSERT_EQ(ordered.begin()->second, 1);
+}
+
+// test subnet checks on binary addresses
+TEST(IpAddressTest, SameSubnet) {
+    ASSERT_TRUE(AddressConversion::resideOnSameSubnet(IpAddress("192.168.182.18"), IpAddress("192.168.182.254"), 24));
+    ASSERT_FALSE(AddressConversion::resideOnSameSubnet(IpAddress("192.168.182.18"), IpAddress("192.168.183.18"), 24));
+    ASSERT_TRUE(AddressConversion::resideOnSameSubnet(IpAddress("fe80::1"), IpAddress("fe80::2"), 64));
+    ASSERT_FALSE(AddressConversion::resideOnSameSubnet(IpAddress("192.168.182.18"), IpAddress("fe80::1"), 24));
+}
@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <LineProtocolProducer.hpp>
+#include <LocalHost.hpp>
+#include <ObisData.hpp>
+
+using namespace libspeedwire;
+
+// writer discarding all data, counting bytes only
+class NullWriter : public LineProtocolWriter {
+public:
+    size_t bytes = 0;
+    virtual void write(const char* /*data*/, const size_t length) { bytes += length; }
+};
+
+// baseline producer building each line with snprintf into a std::string, as typically done by downstream projects
+class SnprintfProducer : public Producer {
+public:
+    NullWriter& writer;
+    std::string lines;
+    SnprintfProducer(NullWriter& w) : writer(w) {}
+    virtual void flush(void) { writer.write(lines.data(), lines.length()); lines.clear(); }
+    virtual void produce(const SpeedwireDevice& device, const MeasurementType& type, const Wire wire, const double value, const uint32_t time_in_ms) {
+        char buffer[256];
+        snprintf(buffer, sizeof(buffer), "speedwire,class=%s,serial=%lu,susyid=%u %s=%lf %llu\n", device.deviceClass.c_str(),
+            (unsigned long)device.deviceAddress.serialNumber, (unsigned)device.deviceAddress.susyID, type.getFullName(wire).c_str(), value,
+            (unsigned long long)time_in_ms);
+        lines.append(std::string(buffer));
+    }
+};
+
+static double run(Producer& producer, const std::vector<ObisData>& elements, const SpeedwireDevice& device, const size_t iterations) {
+    const uint64_t start = LocalHost::getTickCountInMs();
+    for (size_t i = 0; i < iterations; ++i) {
+        for (size_t j = 0; j < elements.size(); ++j) {
+            const double value = (double)((i * 7 + j * 13) % 100000) / (double)elements[j].measurementType.divisor;
+            producer.produce(device, elements[j].measurementType, elements[j].wire, value, (uint32_t)(i * 1000));
+        }
+        producer.flush();
+    }
+    const uint64_t elapsed = LocalHost::getTickCountInMs() - start;
+    return (double)(iterations * elements.size()) * 1000.0 / (double)(elapsed > 0 ? elapsed : 1);
+}
+
+int main(int argc, char** argv) {
+    const size_t iterations = (argc > 1 ? (size_t)atol(argv[1]) : 20000);
+    std::vector<ObisData> elements = ObisData::getAllPredefined();
+    SpeedwireDevice device;
+    device.deviceClass = "Emeter";
+    device.deviceAddress.susyID = 349;
+    device.deviceAddress.serialNumber = 1901234567;
+
+    NullWriter writer1, writer2;
+    SnprintfProducer baseline(writer1);
+    LineProtocolProducer encoder(writer2);
+
+    double baseline_rate = run(baseline, elements, device, iterations);
+    double encoder_rate = run(encoder, elements, device, iterations);
+    printf("snprintf baseline:      %12.0lf points/s (%lu bytes)\n", baseline_rate, (unsigned long)writer1.bytes);
+    printf("LineProtocolProducer:   %12.0lf points/s (%lu bytes)\n", encoder_rate, (unsigned long)writer2.bytes);
+    printf("speedup:                %12.2lf\n", encoder_rate / baseline_rate);
+    return 0;
+}
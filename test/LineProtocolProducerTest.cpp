@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <cmath>
+#include <LineProtocolProducer.hpp>
+
+using namespace libspeedwire;
+
+static std::string formatDouble(const double value, const unsigned long divisor) {
+    char buffer[64];
+    return std::string(buffer, LineProtocolEncoder::formatDouble(buffer, value, divisor));
+}
+
+// test integer formatting
+TEST(LineProtocolProducerTest, FormatUnsigned) {
+    char buffer[32];
+    ASSERT_EQ(std::string(buffer, LineProtocolEncoder::formatUnsigned(buffer, 0)), "0");
+    ASSERT_EQ(std::string(buffer, LineProtocolEncoder::formatUnsigned(buffer, 7)), "7");
+    ASSERT_EQ(std::string(buffer, LineProtocolEncoder::formatUnsigned(buffer, 42)), "42");
+    ASSERT_EQ(std::string(buffer, LineProtocolEncoder::formatUnsigned(buffer, 1901234567)), "1901234567");
+    ASSERT_EQ(std::string(buffer, LineProtocolEncoder::formatUnsigned(buffer, 18446744073709551615ull)), "18446744073709551615");
+}
+
+// test double formatting at the measurement resolution
+TEST(LineProtocolProducerTest, FormatDouble) {
+    ASSERT_EQ(formatDouble(0.0, 10), "0");
+    ASSERT_EQ(formatDouble(123.4, 10), "123.4");
+    ASSERT_EQ(formatDouble(-123.4, 10), "-123.4");
+    ASSERT_EQ(formatDouble(50.0, 1000), "50");
+    ASSERT_EQ(formatDouble(0.05, 1000), "0.05");
+    ASSERT_EQ(formatDouble(230.123, 1000), "230.123");
+    ASSERT_EQ(formatDouble(0.1 + 0.2, 10), "0.30000000000000004");
+    ASSERT_EQ(formatDouble(1.0 / 3.0, 1), "0.3333333333333333");
+    ASSERT_EQ(formatDouble(NAN, 10), "");
+    ASSERT_EQ(formatDouble(INFINITY, 10), "");
+    ASSERT_EQ(formatDouble(2.5, 1), "2.5");
+}
+
+// test complete lines
+TEST(LineProtocolProducerTest, Encode) {
+    LineProtocolEncoder encoder("sma", 16);
+    SpeedwireDevice device;
+    device.deviceClass = "PV Inverter";
+    device.deviceAddress.susyID = 1;
+    device.deviceAddress.serialNumber = 2;
+    encoder.encode(device, MeasurementType::InverterPower(), Wire::L1, 100.0, 1000);
+    encoder.encode(device, MeasurementType::InverterPower(), Wire::L1, 200.0, 0);
+    ASSERT_EQ(std::string(encoder.data(), encoder.size()), "sma,class=PV\\ Inverter,serial=2,susyid=1 power_l1=100 1000\nsma,class=PV\\ Inverter,serial=2,susyid=1 power_l1=200\n");
+    encoder.clear();
+    ASSERT_EQ(encoder.size(), 0);
+
+    // non-finite values are skipped
+    encoder.encode(device, MeasurementType::InverterPower(), Wire::L1, NAN, 1000);
+    ASSERT_EQ(encoder.size(), 0);
+}
+
+// test cached line prefixes follow changes of the device class and susy id
+TEST(LineProtocolProducerTest, PrefixCache) {
+    LineProtocolEncoder encoder("sma", 16);
+    SpeedwireDevice device;
+    device.deviceClass = "Emeter";
+    device.deviceAddress.susyID = 1;
+    device.deviceAddress.serialNumber = 2;
+    encoder.encode(device, MeasurementType::InverterPower(), Wire::L1, 1.0, 0);
+    device.deviceClass = "Inverter";
+    encoder.encode(device, MeasurementType::InverterPower(), Wire::L1, 2.0, 0);
+    device.deviceAddress.susyID = 3;
+    encoder.encode(device, MeasurementType::InverterPower(), Wire::L1, 3.0, 0);
+    ASSERT_EQ(std::string(encoder.data(), encoder.size()), "sma,class=Emeter,serial=2,susyid=1 power_l1=1\nsma,class=Inverter,serial=2,susyid=1 power_l1=2\nsma,class=Inverter,serial=2,susyid=3 power_l1=3\n");
+}
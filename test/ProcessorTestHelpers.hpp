@@ -0,0 +1,30 @@
+#ifndef __LIBSPEEDWIRE_PROCESSORTESTHELPERS_HPP__
+#define __LIBSPEEDWIRE_PROCESSORTESTHELPERS_HPP__
+
+#include <cstdint>
+#include <ObisData.hpp>
+#include <SpeedwireDevice.hpp>
+
+using namespace libspeedwire;
+
+// device used as the origin of test values
+static inline SpeedwireDevice getDevice(const uint32_t serial_number = 1234) {
+    SpeedwireDevice device;
+    device.deviceAddress.susyID = 270;
+    device.deviceAddress.serialNumber = serial_number;
+    return device;
+}
+
+// add the given value to the obis element and pass the element to the processor
+template<class Processor> static void consumeValue(Processor& processor, const SpeedwireDevice& device, ObisData& element, const double value, const uint32_t time) {
+    element.measurementValues.addMeasurement(value, time);
+    processor.consume(device, element);
+}
+
+// pass the given value to the processor as the only value of an emeter packet
+template<class Processor> static void addValue(Processor& processor, const SpeedwireDevice& device, ObisData& element, const double value, const uint32_t time) {
+    consumeValue(processor, device, element, value, time);
+    processor.endOfObisData(device, time);
+}
+
+#endif
@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <RollupProcessor.hpp>
+#include "ProcessorTestHelpers.hpp"
+
+using namespace libspeedwire;
+
+static RollupProcessor getProcessor(void) {
+    std::vector<unsigned long> resolutions;
+    std::vector<size_t> capacities;
+    resolutions.push_back(1000);    capacities.push_back(3);
+    resolutions.push_back(5000);    capacities.push_back(10);
+    return RollupProcessor(resolutions, capacities);
+}
+
+// test closed buckets of the finest level are merged into the next coarser level
+TEST(RollupProcessorTest, Cascade) {
+    SpeedwireDevice device = getDevice();
+    ObisData element(ObisData::PositiveActivePowerTotal);
+    RollupProcessor processor = getProcessor();
+
+    for (uint32_t time = 0; time < 5000; time += 500) {
+        consumeValue(processor, device, element, (double)(time / 1000), time);
+    }
+    std::vector<RollupProcessor::RollupBucket> buckets;
+    ASSERT_EQ(processor.getRollups(device, element, 1000, buckets), 3);     // 4 closed buckets, capacity 3
+    ASSERT_EQ(buckets[0].startTime, 1000);
+    ASSERT_EQ(buckets[2].startTime, 3000);
+    ASSERT_EQ(buckets[2].aggregate.count, 2);
+    ASSERT_DOUBLE_EQ(buckets[2].getValue(), 3.0);
+    ASSERT_FALSE(buckets[2].isDelta);
+
+    buckets.clear();
+    ASSERT_EQ(processor.getRollups(device, element, 5000, buckets), 0);
+    ASSERT_EQ(processor.getRollups(device, element, 5000, buckets, true), 1);
+    ASSERT_EQ(buckets[0].startTime, 0);
+    ASSERT_EQ(buckets[0].aggregate.count, 8);                               // bucket 4000 is still open on the finest level
+
+    // closing the finest bucket 5000 closes the coarse bucket 0
+    consumeValue(processor, device, element, 5.0, 5000);
+    consumeValue(processor, device, element, 6.0, 6000);
+    buckets.clear();
+    ASSERT_EQ(processor.getRollups(device, element, 5000, buckets), 1);
+    ASSERT_EQ(buckets[0].startTime, 0);
+    ASSERT_EQ(buckets[0].aggregate.count, 10);
+    ASSERT_DOUBLE_EQ(buckets[0].aggregate.min, 0.0);
+    ASSERT_DOUBLE_EQ(buckets[0].aggregate.max, 4.0);
+    ASSERT_DOUBLE_EQ(buckets[0].getValue(), 16.0 / 9.0);                    // time-weighted mean over 0 .. 4500
+    buckets.clear();
+    ASSERT_EQ(processor.getRollups(device, element, 5000, buckets, true), 2);
+    ASSERT_EQ(buckets[1].startTime, 5000);
+    ASSERT_EQ(buckets[1].aggregate.count, 1);
+}
+
+// test energy counters are rolled up as deltas and a decreasing counter is treated as a reset
+TEST(RollupProcessorTest, CounterDeltas) {
+    SpeedwireDevice device = getDevice();
+    ObisData element(ObisData::PositiveActiveEnergyTotal);
+    RollupProcessor processor = getProcessor();
+
+    consumeValue(processor, device, element, 100.0, 0);
+    consumeValue(processor, device, element, 110.0, 500);
+    consumeValue(processor, device, element, 130.0, 1000);
+    consumeValue(processor, device, element, 5.0, 1500);       // counter reset
+    consumeValue(processor, device, element, 15.0, 2000);
+
+    std::vector<RollupProcessor::RollupBucket> buckets;
+    ASSERT_EQ(processor.getRollups(device, element, 1000, buckets, true), 3);
+    ASSERT_TRUE(buckets[0].isDelta);
+    ASSERT_DOUBLE_EQ(buckets[0].getValue(), 10.0);          // first value has no previous counter
+    ASSERT_DOUBLE_EQ(buckets[1].getValue(), 20.0);          // the reset contributes no delta
+    ASSERT_DOUBLE_EQ(buckets[2].getValue(), 10.0);
+
+    buckets.clear();
+    ASSERT_EQ(processor.getRollups(device, element, 5000, buckets, true), 1);
+    ASSERT_TRUE(buckets[0].isDelta);
+    ASSERT_DOUBLE_EQ(buckets[0].getValue(), 30.0);          // open bucket 2000 is not yet merged
+}
+
+// test getRollups() lookups and output vector handling
+TEST(RollupProcessorTest, GetRollups) {
+    SpeedwireDevice device = getDevice();
+    SpeedwireDevice other = getDevice();
+    other.deviceAddress.serialNumber = 5678;
+    ObisData element(ObisData::PositiveActivePowerTotal);
+    RollupProcessor processor = getProcessor();
+
+    std::vector<RollupProcessor::RollupBucket> buckets;
+    ASSERT_EQ(processor.getRollups(device, element, 1000, buckets, true), 0);
+
+    consumeValue(processor, device, element, 1.0, 0);
+    consumeValue(processor, device, element, 2.0, 1000);
+    ASSERT_EQ(processor.getRollups(device, element, 1000, buckets), 1);
+    ASSERT_EQ(processor.getRollups(device.deviceAddress.serialNumber, element.toKey(), 1000, buckets), 1);
+    ASSERT_EQ(buckets.size(), 2);                           // buckets are appended
+    ASSERT_EQ(processor.getRollups(device, element, 2000, buckets, true), 0);      // not a configured resolution
+    ASSERT_EQ(processor.getRollups(other, element, 1000, buckets, true), 0);       // unknown device
+    ASSERT_EQ(processor.getRollups(device, ObisData::PositiveActiveEnergyTotal, 1000, buckets, true), 0);
+    ASSERT_EQ(buckets.size(), 2);
+
+    ASSERT_EQ(processor.getResolutions().size(), 2);
+    ASSERT_EQ(processor.getResolutions()[1], 5000);
+}
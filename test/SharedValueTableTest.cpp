@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <SharedValueTable.hpp>
+#include <ArchiveProducer.hpp>
+
+using namespace libspeedwire;
+
+// test publishing and reading values through shared memory
+TEST(SharedValueTableTest, PublishAndRead) {
+    SharedValuePublisher publisher("libspeedwire_test_table", 4);
+    ASSERT_TRUE(publisher.isOpen());
+
+    SharedValueReader reader;
+    ASSERT_TRUE(reader.open("libspeedwire_test_table"));
+    ASSERT_EQ(reader.getUpdateCount(), 0);
+
+    SharedValue value;
+    const uint32_t id = ArchiveProducer::getMeasurementId(MeasurementType::InverterPower(), Wire::L1);
+    ASSERT_FALSE(reader.read(1234, id, value));
+
+    ASSERT_TRUE(publisher.publish(1234, 1, id, 100.0, 5000));
+    ASSERT_TRUE(publisher.publish(1234, 1, id + 1, 200.0, 5000));
+    ASSERT_TRUE(publisher.publish(1234, 1, id, 150.0, 6000));
+    publisher.flush();
+    ASSERT_EQ(reader.getUpdateCount(), 1);
+
+    ASSERT_TRUE(reader.read(1234, id, value));
+    ASSERT_EQ(value.value, 150.0);
+    ASSERT_EQ(value.time, 6000);
+    ASSERT_EQ(value.susyID, 1);
+    ASSERT_TRUE(reader.read(1234, id + 1, value));
+    ASSERT_EQ(value.value, 200.0);
+    ASSERT_FALSE(reader.read(4321, id, value));
+
+    std::vector<SharedValue> values;
+    ASSERT_EQ(reader.snapshot(values), 2);
+
+    // a full table drops new measurements but still updates existing ones
+    ASSERT_TRUE(publisher.publish(1, 1, id, 1.0, 1));
+    ASSERT_TRUE(publisher.publish(2, 1, id, 1.0, 1));
+    ASSERT_FALSE(publisher.publish(3, 1, id, 1.0, 1));
+    ASSERT_TRUE(publisher.publish(1234, 1, id, 175.0, 7000));
+    ASSERT_EQ(publisher.getDroppedCount(), 1);
+    ASSERT_TRUE(reader.read(1234, id, value));
+    ASSERT_EQ(value.value, 175.0);
+}
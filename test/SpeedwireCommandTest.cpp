@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include <set>
+#include <vector>
+#include <LocalHost.hpp>
+#include <SpeedwireCommand.hpp>
+#include <SpeedwireResponseCache.hpp>
+#include "SpeedwireTestReplies.hpp"
+
+using namespace libspeedwire;
+
+static SpeedwireDevice getDevice(const uint32_t serial) {
+    SpeedwireDevice device;
+    device.deviceAddress.susyID = 1;
+    device.deviceAddress.serialNumber = serial;
+    device.deviceIpAddress = IpAddress("127.0.0.2");
+    device.interfaceIpAddress = IpAddress("127.0.0.1");
+    return device;
+}
+
+// test device type queries to several peers are in flight at once and a peer without reply does not hold back the others
+TEST(SpeedwireCommandTest, QueryDeviceTypes) {
+    std::set<uint32_t> answered;
+    answered.insert(100);
+    answered.insert(300);
+    FakeInverter inverter("127.0.0.2", answered);
+    ASSERT_TRUE(inverter.isRunning());
+
+    std::vector<SpeedwireDevice> peers;
+    peers.push_back(getDevice(100));
+    peers.push_back(getDevice(200));
+    peers.push_back(getDevice(300));
+    SpeedwireCommand command(LocalHost::getInstance(), peers);
+
+    // the call returns as soon as all peers replied
+    std::vector<SpeedwireDevice> replying;
+    replying.push_back(peers[0]);
+    replying.push_back(peers[2]);
+    uint64_t start = LocalHost::getTickCountInMs();
+    std::vector<SpeedwireDevice> infos = command.queryDeviceTypes(replying, 1000);
+    ASSERT_LT(LocalHost::getTickCountInMs() - start, 500);
+    ASSERT_EQ(infos.size(), 2);
+    ASSERT_EQ(inverter.getRequestCount(), 2);
+
+    // a peer without reply times out, while the replies of the other peers are still taken
+    SpeedwireResponseCache cache;
+    command.setResponseCache(&cache);
+    start = LocalHost::getTickCountInMs();
+    infos = command.queryDeviceTypes(peers, 300);
+    ASSERT_GE(LocalHost::getTickCountInMs() - start, 300);
+    ASSERT_EQ(inverter.getRequestCount(), 5);
+    ASSERT_EQ(infos.size(), 3);
+    for (size_t i = 0; i < infos.size(); ++i) {
+        ASSERT_TRUE(infos[i] == peers[i]);
+    }
+    ASSERT_EQ(infos[0].deviceClass, "PV-Inverter");
+    ASSERT_EQ(infos[0].deviceModel, "STP-5.0-3AV-40");
+    ASSERT_EQ(infos[1].deviceClass, "");
+    ASSERT_EQ(infos[2].deviceModel, "STP-5.0-3AV-40");
+    uint8_t buffer[2048];
+    const uint64_t now = LocalHost::getUnixEpochTimeInMs();
+    ASSERT_EQ(cache.size(), 2);
+    ASSERT_GT(cache.get(peers[0], Command::DEVICE_QUERY, 0x00821E00, 0x008220FF, buffer, sizeof(buffer), now), 0);
+    ASSERT_EQ(cache.get(peers[1], Command::DEVICE_QUERY, 0x00821E00, 0x008220FF, buffer, sizeof(buffer), now), -1);
+    ASSERT_GT(cache.get(peers[2], Command::DEVICE_QUERY, 0x00821E00, 0x008220FF, buffer, sizeof(buffer), now), 0);
+
+    // the tokens and packet ids of the timed out request are released
+    ASSERT_EQ(command.getTokenRepository().size(), 0);
+    ASSERT_EQ(command.getPacketIdAllocator().getInFlightCount(1, 200), 0);
+
+    // cached peers are not queried again
+    infos = command.queryDeviceTypes(peers, 100);
+    ASSERT_EQ(inverter.getRequestCount(), 6);
+    ASSERT_EQ(infos[2].deviceClass, "PV-Inverter");
+    ASSERT_EQ(command.getTokenRepository().size(), 0);
+}
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+#include <SpeedwireCommand.hpp>
+#include <LocalHost.hpp>
+
+using namespace libspeedwire;
+
+// test add, find and remove with generation tagged handles
+TEST(SpeedwireCommandTokenRepositoryTest, AddFindRemove) {
+    SpeedwireCommandTokenRepository repository;
+    SpeedwireCommandTokenIndex a = repository.add(1, 100, 0x8001, "192.168.1.1", Command::AC_QUERY);
+    SpeedwireCommandTokenIndex b = repository.add(1, 100, 0x8002, "192.168.1.1", Command::DC_QUERY);
+    SpeedwireCommandTokenIndex c = repository.add(2, 200, 0x8001, "192.168.1.2", Command::ENERGY_QUERY);
+    ASSERT_GE(a, 0);
+    ASSERT_GE(b, 0);
+    ASSERT_GE(c, 0);
+    ASSERT_EQ(repository.size(), 3);
+
+    // replies carry the packet id without the 0x8000 flag
+    ASSERT_EQ(repository.find(1, 100, 0x0002), b);
+    ASSERT_EQ(repository.find(2, 200, 0x8001), c);
+    ASSERT_EQ(repository.find(2, 200, 0x8002), -1);
+
+    // removing a token does not affect other handles
+    repository.remove(a);
+    ASSERT_EQ(repository.size(), 2);
+    ASSERT_FALSE(repository.isValid(a));
+    ASSERT_EQ(repository.find(1, 100, 0x8001), -1);
+    ASSERT_TRUE(repository.at(b).command == Command::DC_QUERY);
+    ASSERT_TRUE(repository.at(c).command == Command::ENERGY_QUERY);
+
+    // a reused slot gets a new generation; the stale handle stays invalid
+    SpeedwireCommandTokenIndex d = repository.add(3, 300, 0x8003, "192.168.1.3", Command::LOGIN);
+    ASSERT_NE(d, a);
+    ASSERT_FALSE(repository.isValid(a));
+    ASSERT_TRUE(repository.at(a).command == Command::NONE);
+    repository.remove(a);
+    ASSERT_EQ(repository.size(), 3);
+
+    repository.clear();
+    ASSERT_EQ(repository.size(), 0);
+    ASSERT_FALSE(repository.isValid(b));
+}
+
+// test timer wheel expiry
+TEST(SpeedwireCommandTokenRepositoryTest, Expire) {
+    SpeedwireCommandTokenRepository repository;
+    for (uint16_t i = 0; i < 1000; ++i) {
+        ASSERT_GE(repository.add(1, 100, 0x8000 | i, "192.168.1.1", Command::AC_QUERY), 0);
+    }
+    const uint32_t now = (uint32_t)LocalHost::getUnixEpochTimeInMs();
+    ASSERT_EQ(repository.expire(5000, now), 0);
+    ASSERT_EQ(repository.size(), 1000);
+    ASSERT_EQ(repository.expire(5000, now + 60000), 1000);
+    ASSERT_EQ(repository.size(), 0);
+
+    SpeedwireCommandTokenIndex a = repository.add(1, 100, 0x8001, "192.168.1.1", Command::AC_QUERY);
+    ASSERT_EQ(repository.expire(1000, now + 60000), 1);
+    ASSERT_FALSE(repository.isValid(a));
+}
@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <set>
+#include <string>
+#include <vector>
+#include <LocalHost.hpp>
+#include <SpeedwireCommand.hpp>
+#include <SpeedwireDiscovery.hpp>
+#include "SpeedwireTestReplies.hpp"
+
+using namespace libspeedwire;
+
+// test saving and loading of the device cache file
+TEST(SpeedwireDiscoveryTest, DeviceCache) {
+    const std::string path = "SpeedwireDiscoveryTest.cache";
+    remove(path.c_str());
+
+    SpeedwireDevice inverter;
+    inverter.deviceAddress = SpeedwireAddress(0x7d, 3401);
+    inverter.deviceClass = "PV-Inverter";
+    inverter.deviceModel = "SB 3600TL-21";
+    inverter.deviceIpAddress = IpAddress("127.0.0.2");
+    inverter.interfaceIpAddress = IpAddress("127.0.0.1");
+
+    // a second inverter at an address without a listener
+    SpeedwireDevice silent(inverter);
+    silent.deviceAddress = SpeedwireAddress(0x7d, 3404);
+    silent.deviceIpAddress = IpAddress("127.0.0.3");
+
+    SpeedwireDevice emeter;
+    emeter.deviceAddress = SpeedwireAddress(372, 3402);
+    emeter.deviceClass = "Emeter";
+    emeter.deviceModel = "HM-20";
+    emeter.deviceIpAddress = IpAddress("fe80::1");
+    emeter.interfaceIpAddress = IpAddress("fe80::2");
+
+    {
+        SpeedwireDiscovery discovery(LocalHost::getInstance());
+        ASSERT_EQ(discovery.loadDeviceCache(path), -1);
+        discovery.registerDevice(inverter);
+        discovery.registerDevice(silent);
+        discovery.registerDevice(emeter);
+        discovery.preRegisterDevice("192.168.182.19");
+        discovery.requireDevice(3403);
+        ASSERT_TRUE(discovery.saveDeviceCache(path));
+    }
+
+    // only fully registered devices are cached
+    SpeedwireDiscovery discovery(LocalHost::getInstance());
+    ASSERT_EQ(discovery.loadDeviceCache(path), 3);
+    ASSERT_EQ(discovery.getNumberOfDevices(), 3);
+    ASSERT_EQ(discovery.getNumberOfFullyRegisteredDevices(), 3);
+    const std::vector<SpeedwireDevice>& devices = discovery.getDevices();
+    ASSERT_TRUE(devices[0] == inverter);
+    ASSERT_EQ(devices[0].deviceModel, inverter.deviceModel);
+    ASSERT_TRUE(devices[0].interfaceIpAddress == inverter.interfaceIpAddress);
+    ASSERT_TRUE(devices[2] == emeter);
+    ASSERT_EQ(devices[2].deviceClass, emeter.deviceClass);
+
+    // nothing is missing, hence no scan is performed
+    ASSERT_EQ(discovery.discoverDevices(), 3);
+    ASSERT_FALSE(discovery.isDeviceVerificationPending());
+
+    // the verification runs on this thread; only the first inverter replies and the emeter is not probed
+    std::set<uint32_t> answered;
+    answered.insert(3401);
+    FakeInverter peer("127.0.0.2", answered);
+    ASSERT_TRUE(peer.isRunning());
+    std::vector<SpeedwireDevice> inverters;
+    inverters.push_back(inverter);
+    inverters.push_back(silent);
+    SpeedwireCommand command(LocalHost::getInstance(), inverters);
+    ASSERT_TRUE(discovery.startDeviceVerification(command, 300));
+    ASSERT_TRUE(discovery.isDeviceVerificationPending());
+    ASSERT_FALSE(discovery.startDeviceVerification(command, 300));
+
+    // other queries through the same command instance get their replies meanwhile
+    uint8_t buffer[2048];
+    ASSERT_GT(command.query(inverter, Command::AC_QUERY, 0x00464000, 0x004642FF, buffer, sizeof(buffer), 1000), 0);
+    ASSERT_FALSE(discovery.pollDeviceVerification(0));
+    const uint64_t start = LocalHost::getTickCountInMs();
+    while (discovery.pollDeviceVerification(50) == false) {}
+    ASSERT_LT(LocalHost::getTickCountInMs() - start, 1000);
+    ASSERT_FALSE(discovery.isDeviceVerificationPending());
+    ASSERT_EQ(discovery.finishDeviceVerification(), 1);
+    ASSERT_EQ(peer.getRequestCount(), 2);
+    ASSERT_EQ(command.getTokenRepository().size(), 0);
+
+    // the replying inverter is updated, the silent one is reverted to a required device
+    ASSERT_EQ(discovery.getNumberOfMissingDevices(), 1);
+    ASSERT_EQ(discovery.getNumberOfFullyRegisteredDevices(), 2);
+    ASSERT_TRUE(devices[0] == inverter);
+    ASSERT_EQ(devices[0].deviceModel, "STP-5.0-3AV-40");
+    remove(path.c_str());
+}
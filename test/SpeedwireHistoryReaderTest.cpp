@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <vector>
+#include <SpeedwireHistoryReader.hpp>
+#include <ArchiveProducer.hpp>
+
+using namespace libspeedwire;
+
+// consumer collecting all records
+class TestHistoryConsumer : public SpeedwireHistoryConsumer {
+public:
+    std::vector<std::pair<uint32_t, uint64_t> > yields;
+    std::vector<uint16_t> events;
+    virtual void consumeYield(const SpeedwireDevice& /*device*/, const Command command, const uint32_t epoch_time, const uint64_t yield_value) {
+        ASSERT_TRUE(command == Command::YIELD_BY_MINUTE_QUERY);
+        yields.push_back(std::pair<uint32_t, uint64_t>(epoch_time, yield_value));
+    }
+    virtual void consumeEvent(const SpeedwireDevice& /*device*/, const SpeedwireRawDataEvent::EventValue& event) {
+        events.push_back(event.event_id);
+    }
+};
+
+// assemble a reply fragment with the given records
+static std::vector<uint8_t> getFragment(const Command command, const uint16_t fragment_counter, const size_t record_size, const size_t num_records, const uint32_t first_time) {
+    std::vector<uint8_t> packet(24 + 8 + 8 + 6 + 4 + 4 + 4 + num_records * record_size);
+    SpeedwireHeader header(packet.data(), (unsigned long)packet.size());
+    header.setDefaultHeader(1, (uint16_t)(packet.size() - 20), SpeedwireData2Packet::sma_inverter_protocol_id);
+    SpeedwireInverterProtocol inverter(header);
+    inverter.setFragmentCounter(fragment_counter);
+    inverter.setCommandID(command | Command::QUERY_RESPONSE);
+    inverter.setFirstRegisterID(0);
+    inverter.setLastRegisterID((uint32_t)num_records - 1);
+    for (size_t i = 0; i < num_records; ++i) {
+        inverter.setDataUint32((unsigned long)(i * record_size), first_time + (uint32_t)i * 300);
+        if (command == Command::EVENT_QUERY) {
+            inverter.setDataUint32((unsigned long)(i * record_size + 4 + 8), 0x0100 + (uint32_t)i);    // event id
+        }
+        else {
+            inverter.setDataUint64((unsigned long)(i * record_size + 4), (i == 1 ? 0xffffffffffffffffull : 1000000 + i));
+        }
+    }
+    return packet;
+}
+
+// test incremental decoding of yield and event fragments
+TEST(SpeedwireHistoryReaderTest, Decode) {
+    SpeedwireDevice device;
+    device.deviceAddress = SpeedwireAddress(0x017a, 1901234567);
+    TestHistoryConsumer consumer;
+
+    std::vector<uint8_t> packet = getFragment(Command::YIELD_BY_MINUTE_QUERY, 3, 12, 4, 1700000000);
+    SpeedwireHeader header(packet.data(), (unsigned long)packet.size());
+    SpeedwireInverterProtocol fragment(header);
+    ASSERT_EQ(fragment.getFragmentCounter(), 3);
+    ASSERT_EQ(fragment.getRawDataLength(), 12);
+
+    // the NaN record is skipped
+    ASSERT_EQ(SpeedwireHistoryReader::decode(device, fragment, consumer), 3);
+    ASSERT_EQ(consumer.yields.size(), 3);
+    ASSERT_EQ(consumer.yields[0].first, 1700000000);
+    ASSERT_EQ(consumer.yields[0].second, 1000000);
+    ASSERT_EQ(consumer.yields[1].first, 1700000600);
+    ASSERT_EQ(consumer.yields[2].second, 1000003);
+
+    packet = getFragment(Command::EVENT_QUERY, 0, 4 + 44, 2, 1700000000);
+    SpeedwireHeader event_header(packet.data(), (unsigned long)packet.size());
+    ASSERT_EQ(SpeedwireHistoryReader::decode(device, SpeedwireInverterProtocol(event_header), consumer), 2);
+    ASSERT_EQ(consumer.events.size(), 2);
+    ASSERT_EQ(consumer.events[1], 0x0101);
+
+    ASSERT_EQ(SpeedwireHistoryReader::getChunkDuration(Command::YIELD_BY_MINUTE_QUERY), 86400);
+    ASSERT_EQ(SpeedwireHistoryReader::getChunkDuration(Command::YIELD_BY_DAY_QUERY), 64 * 86400);
+}
+
+// test cursor persistence and the archive sink
+TEST(SpeedwireHistoryReaderTest, CursorAndArchiveSink) {
+    SpeedwireDevice device;
+    device.deviceAddress = SpeedwireAddress(0x017a, 1901234567);
+    const std::string path = "speedwire_history_cursor_test.txt";
+    SpeedwireHistoryCursor cursor;
+    ASSERT_EQ(cursor.get(device, Command::YIELD_BY_MINUTE_QUERY), 0);
+    cursor.set(device, Command::YIELD_BY_MINUTE_QUERY, 1700086400);
+    cursor.set(device, Command::EVENT_QUERY, 1690000000);
+    ASSERT_TRUE(cursor.save(path));
+    SpeedwireHistoryCursor loaded;
+    ASSERT_TRUE(loaded.load(path));
+    ASSERT_EQ(loaded.get(device, Command::YIELD_BY_MINUTE_QUERY), 1700086400);
+    ASSERT_EQ(loaded.get(device, Command::EVENT_QUERY), 1690000000);
+    ASSERT_EQ(loaded.get(device, Command::YIELD_BY_DAY_QUERY), 0);
+    remove(path.c_str());
+
+    // yields older than the range of truncated timestamps are archived with their full timestamp
+    std::string segment_path;
+    {
+        ArchiveProducer archive(".", "history_test", 1000ull * 86400 * 365 * 100, 16);
+        SpeedwireHistoryArchiveSink sink(archive);
+        sink.consumeYield(device, Command::YIELD_BY_DAY_QUERY, 1500000000, 123456);
+        archive.flush();
+        segment_path = archive.getSegmentPath();
+    }
+    ArchiveReader reader;
+    ASSERT_TRUE(reader.open(segment_path));
+    ArchiveSpan span = reader.getSpan();
+    ASSERT_EQ(span.length, 1);
+    ASSERT_EQ(span.times[0], 1500000000000ull);
+    ASSERT_EQ(span.values[0], 123456.0);
+    ASSERT_EQ(span.devices[0], device.deviceAddress.serialNumber);
+    reader.close();
+    remove(segment_path.c_str());
+}
+
+// history reader with access to the fragment bookkeeping of chunks
+class TestHistoryReader : public SpeedwireHistoryReader {
+public:
+    typedef SpeedwireHistoryReader::Chunk Chunk;
+    static bool add(Chunk& chunk, const uint16_t counter) { return addFragment(chunk, counter); }
+};
+
+// test chunk completion with reordered, duplicate and missing fragments
+TEST(SpeedwireHistoryReaderTest, Fragments) {
+    TestHistoryReader::Chunk chunk;
+    chunk.fragmentsExpected = 0;
+    chunk.fragmentsReceived = 0;
+    chunk.complete = false;
+
+    // fragments 2, 1, 0 arrive as 1, 2, 0; the first fragment received does not announce the number of fragments
+    ASSERT_TRUE(TestHistoryReader::add(chunk, 1));
+    ASSERT_FALSE(chunk.complete);
+    ASSERT_TRUE(TestHistoryReader::add(chunk, 2));
+    ASSERT_FALSE(chunk.complete);
+    ASSERT_EQ(chunk.fragmentsExpected, 3);
+    ASSERT_TRUE(TestHistoryReader::add(chunk, 0));
+    ASSERT_TRUE(chunk.complete);
+
+    // fragments 3, 2, 1, 0 with fragment 1 missing and fragment 2 duplicated
+    TestHistoryReader::Chunk lossy;
+    lossy.fragmentsExpected = 0;
+    lossy.fragmentsReceived = 0;
+    lossy.complete = false;
+    ASSERT_TRUE(TestHistoryReader::add(lossy, 3));
+    ASSERT_TRUE(TestHistoryReader::add(lossy, 2));
+    ASSERT_FALSE(TestHistoryReader::add(lossy, 2));
+    ASSERT_TRUE(TestHistoryReader::add(lossy, 0));
+    ASSERT_FALSE(lossy.complete);
+    ASSERT_EQ(lossy.fragmentsReceived, 3);
+    ASSERT_TRUE(TestHistoryReader::add(lossy, 1));
+    ASSERT_TRUE(lossy.complete);
+
+    // a retried query replies with all fragments again; those decoded before the retry are skipped
+    TestHistoryReader::Chunk retried;
+    retried.fragmentsExpected = 0;
+    retried.fragmentsReceived = 0;
+    retried.complete = false;
+    ASSERT_TRUE(TestHistoryReader::add(retried, 2));
+    ASSERT_TRUE(TestHistoryReader::add(retried, 0));
+    ASSERT_FALSE(retried.complete);
+    ASSERT_FALSE(TestHistoryReader::add(retried, 2));
+    ASSERT_TRUE(TestHistoryReader::add(retried, 1));
+    ASSERT_FALSE(TestHistoryReader::add(retried, 0));
+    ASSERT_TRUE(retried.complete);
+    ASSERT_EQ(retried.fragmentsReceived, 3);
+}
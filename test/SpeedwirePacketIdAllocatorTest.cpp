@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+#include <set>
+#include <thread>
+#include <vector>
+#include <SpeedwirePacketIdAllocator.hpp>
+#include <SpeedwireCommand.hpp>
+
+using namespace libspeedwire;
+
+// test that packet ids in flight are never handed out twice, even across wrap-around
+TEST(SpeedwirePacketIdAllocatorTest, InFlight) {
+    SpeedwirePacketIdAllocator allocator;
+    const uint16_t first = allocator.allocate(0x7d, 3401);
+    ASSERT_NE(first, 0);
+    ASSERT_EQ(first & 0x8000, 0x8000);
+    ASSERT_TRUE(allocator.isInFlight(0x7d, 3401, first));
+    ASSERT_FALSE(allocator.isInFlight(0x7d, 3402, first));
+
+    // exhaust the id space of the device
+    std::set<uint16_t> ids;
+    ids.insert(first);
+    for (uint32_t i = 1; i < 0x8000; ++i) {
+        const uint16_t id = allocator.allocate(0x7d, 3401);
+        ASSERT_NE(id, 0);
+        ASSERT_TRUE(ids.insert(id).second);
+    }
+    ASSERT_EQ(allocator.getInFlightCount(0x7d, 3401), 0x8000);
+    ASSERT_EQ(allocator.allocate(0x7d, 3401), 0);
+
+    // other devices have their own id space
+    ASSERT_NE(allocator.allocate(0x7d, 3402), 0);
+
+    // a released id is the only one available
+    allocator.release(0x7d, 3401, first);
+    ASSERT_EQ(allocator.getInFlightCount(0x7d, 3401), 0x7fff);
+    ASSERT_EQ(allocator.allocate(0x7d, 3401), first);
+    ASSERT_EQ(allocator.allocate(0x7d, 3401), 0);
+}
+
+// test that a new session advances the id space
+TEST(SpeedwirePacketIdAllocatorTest, Session) {
+    SpeedwirePacketIdAllocator allocator;
+    const uint16_t id1 = allocator.allocate(0x7d, 3401);
+    allocator.release(0x7d, 3401, id1);
+    ASSERT_EQ(allocator.getSession(0x7d, 3401), 0);
+    ASSERT_EQ(allocator.beginSession(0x7d, 3401), 1);
+    const uint16_t id2 = allocator.allocate(0x7d, 3401);
+    ASSERT_EQ((uint16_t)((id2 - id1 - 1) & 0x7fff), 0x4000);
+
+    allocator.beginSession();
+    ASSERT_EQ(allocator.getSession(0x7d, 3401), 2);
+}
+
+// test concurrent allocation from several threads
+TEST(SpeedwirePacketIdAllocatorTest, Threads) {
+    SpeedwirePacketIdAllocator allocator;
+    const size_t num_threads = 4, num_ids = 2000;
+    std::vector<std::vector<uint16_t> > ids(num_threads);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t) {
+        threads.push_back(std::thread([&allocator, &ids, t]() {
+            for (size_t i = 0; i < num_ids; ++i) {
+                ids[t].push_back(allocator.allocate(0x7d, 3401));
+            }
+        }));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::set<uint16_t> unique;
+    for (const auto& v : ids) {
+        for (uint16_t id : v) {
+            ASSERT_NE(id, 0);
+            ASSERT_TRUE(unique.insert(id).second);
+        }
+    }
+    ASSERT_EQ(allocator.getInFlightCount(0x7d, 3401), num_threads * num_ids);
+
+    uint16_t legacy1 = SpeedwireCommand::getIncrementedPacketID();
+    uint16_t legacy2 = SpeedwireCommand::getIncrementedPacketID();
+    ASSERT_EQ(legacy1 & 0x8000, 0x8000);
+    ASSERT_NE(legacy1, legacy2);
+}
+
+// test that removed and expired command tokens release their packet ids
+TEST(SpeedwirePacketIdAllocatorTest, TokenRelease) {
+    SpeedwirePacketIdAllocator allocator;
+    SpeedwireCommandTokenRepository tokens;
+    tokens.setPacketIdAllocator(&allocator);
+
+    const uint16_t id1 = allocator.allocate(0x7d, 3401);
+    const uint16_t id2 = allocator.allocate(0x7d, 3401);
+    SpeedwireCommandTokenIndex token1 = tokens.add(0x7d, 3401, id1, IpAddress("192.168.182.18"), Command::AC_QUERY);
+    tokens.add(0x7d, 3401, id2, IpAddress("192.168.182.18"), Command::DC_QUERY);
+    ASSERT_EQ(allocator.getInFlightCount(0x7d, 3401), 2);
+
+    tokens.remove(token1);
+    ASSERT_FALSE(allocator.isInFlight(0x7d, 3401, id1));
+    ASSERT_TRUE(allocator.isInFlight(0x7d, 3401, id2));
+
+    tokens.expire(0, tokens.at(tokens.find(0x7d, 3401, id2)).create_time + 1000);
+    ASSERT_EQ(tokens.size(), 0);
+    ASSERT_EQ(allocator.getInFlightCount(0x7d, 3401), 0);
+}
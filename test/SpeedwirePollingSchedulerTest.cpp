@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include <SpeedwirePollingScheduler.hpp>
+#include <LocalHost.hpp>
+
+using namespace libspeedwire;
+
+static SpeedwireRawData getReply(const SpeedwireData& data, const uint32_t value) {
+    uint8_t payload[20] = { 0 };
+    SpeedwireByteEncoding::setUint32LittleEndian(payload, value);
+    return SpeedwireRawData(data.command | Command::QUERY_RESPONSE, data.id, data.conn, data.type, 0, payload, sizeof(payload));
+}
+
+static SpeedwireDevice getDevice(void) {
+    SpeedwireDevice device;
+    device.deviceAddress = SpeedwireAddress(0x017a, 1901234567);
+    device.deviceModel = "STP 10.0-3AV-40";
+    return device;
+}
+
+// test interval back-off on stable values and tightening on changed values
+TEST(SpeedwirePollingSchedulerTest, AdaptiveInterval) {
+    std::vector<SpeedwireDevice> devices;
+    SpeedwireCommand command(LocalHost::getInstance(), devices);
+    SpeedwirePollingScheduler scheduler(command, 1000.0, 100);
+    SpeedwireDevice device = getDevice();
+    scheduler.add(device, SpeedwireData::InverterPowerL1, 1000, 8000);
+    ASSERT_EQ(scheduler.getInterval(device, SpeedwireData::InverterPowerL1), 1000);
+    ASSERT_EQ(scheduler.getNextPollTime(), 0);
+
+    uint64_t now = 10000;
+    std::vector<SpeedwireScheduledQuery> queries = scheduler.getDueQueries(now);
+    ASSERT_EQ(queries.size(), 1);
+    ASSERT_TRUE(queries[0].range.command == Command::AC_QUERY);
+    ASSERT_EQ(queries[0].range.firstRegister, 0x00464000);
+    ASSERT_EQ(queries[0].range.lastRegister, 0x004640ff);
+    ASSERT_EQ(scheduler.getDueQueries(now).size(), 0);
+
+    // the first reply sets the reference value, stable replies double the interval up to the maximum
+    ASSERT_EQ(scheduler.update(device, getReply(SpeedwireData::InverterPowerL1, 100), now), 1);
+    ASSERT_EQ(scheduler.getInterval(device, SpeedwireData::InverterPowerL1), 1000);
+    ASSERT_EQ(scheduler.getNextPollTime(), now + 1000);
+    const uint32_t expected[] = { 2000, 4000, 8000, 8000 };
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i) {
+        now = scheduler.getNextPollTime();
+        ASSERT_EQ(scheduler.getDueQueries(now).size(), 1);
+        scheduler.update(device, getReply(SpeedwireData::InverterPowerL1, 100), now);
+        ASSERT_EQ(scheduler.getInterval(device, SpeedwireData::InverterPowerL1), expected[i]);
+        ASSERT_EQ(scheduler.getDueQueries(now + expected[i] - 1).size(), 0);
+    }
+
+    // a changed value resets the interval to the minimum
+    now = scheduler.getNextPollTime();
+    scheduler.update(device, getReply(SpeedwireData::InverterPowerL1, 101), now);
+    ASSERT_EQ(scheduler.getInterval(device, SpeedwireData::InverterPowerL1), 1000);
+    ASSERT_EQ(scheduler.getNextPollTime(), now + 1000);
+
+    // replies for other devices or registers are ignored
+    SpeedwireDevice other = getDevice();
+    other.deviceAddress.serialNumber = 1;
+    ASSERT_EQ(scheduler.update(other, getReply(SpeedwireData::InverterPowerL1, 100), now), 0);
+    ASSERT_EQ(scheduler.update(device, getReply(SpeedwireData::InverterPowerL2, 100), now), 0);
+
+    // a failed query is retried after the minimum interval
+    scheduler.failed(queries[0], now);
+    ASSERT_EQ(scheduler.getNextPollTime(), now + 1000);
+}
+
+// test coalescing of due items and the per-device request budget
+TEST(SpeedwirePollingSchedulerTest, Budget) {
+    std::vector<SpeedwireDevice> devices;
+    SpeedwireCommand command(LocalHost::getInstance(), devices);
+    SpeedwirePollingScheduler scheduler(command, 1.0, 2);
+    SpeedwireDevice device = getDevice();
+    scheduler.add(device, SpeedwireData::InverterPowerL1);
+    scheduler.add(device, SpeedwireData::InverterPowerL2);
+    scheduler.add(device, SpeedwireData::InverterPowerMPP1);
+    scheduler.add(device, SpeedwireData::InverterRelay);
+    scheduler.add(device, SpeedwireData::InverterEnergyTotal);
+    ASSERT_EQ(scheduler.getInterval(device, SpeedwireData::InverterRelay), 2000);
+
+    // four queries are due, but the budget permits only two back to back
+    uint64_t now = 100000;
+    std::vector<SpeedwireScheduledQuery> queries = scheduler.getDueQueries(now);
+    ASSERT_EQ(queries.size(), 2);
+    ASSERT_EQ(scheduler.getDeferredCount(), 2);
+    ASSERT_EQ(scheduler.getDueQueries(now + 500).size(), 0);
+    ASSERT_EQ(scheduler.getDueQueries(now + 1000).size(), 1);
+    ASSERT_EQ(scheduler.getDueQueries(now + 2000).size(), 1);
+    ASSERT_EQ(scheduler.getRequestCount(), 4);
+
+    // the power items of both phases have been coalesced into one query
+    size_t num_items = 0;
+    for (const auto& query : queries) {
+        num_items += query.range.numItems;
+        ASSERT_EQ(query.device.deviceAddress.serialNumber, device.deviceAddress.serialNumber);
+    }
+    ASSERT_GE(num_items, 2);
+
+    scheduler.remove(device);
+    ASSERT_EQ(scheduler.getDueQueries(now + 10000).size(), 0);
+}
@@ -0,0 +1,282 @@
+#include <gtest/gtest.h>
+#include <set>
+#include <thread>
+#include <vector>
+#include <LocalHost.hpp>
+#include <SpeedwireQueryEngine.hpp>
+#include <SpeedwireSessionManager.hpp>
+#include "SpeedwireTestReplies.hpp"
+
+using namespace libspeedwire;
+
+// query engine with access to its per-request and per-device state
+class TestQueryEngine : public SpeedwireQueryEngine {
+public:
+    TestQueryEngine(SpeedwireCommand& command, const unsigned max_in_flight_per_device, const unsigned max_in_flight) : SpeedwireQueryEngine(command, max_in_flight_per_device, max_in_flight) {}
+    void reply(const uint32_t id, const uint16_t error_code) {
+        ASSERT_GE(requests[id].token, 0);
+        ReplyInjector::inject(command.getDemultiplexer(), command.getTokenRepository().at(requests[id].token), error_code);
+    }
+    unsigned getDeviceInFlightCount(const uint32_t serial) {
+        std::map<uint32_t, DeviceQueue>::const_iterator it = devices.find(serial);
+        return (it != devices.end() ? it->second.inFlight : 0);
+    }
+    size_t getDeadlineCount(void) const { return deadlines.size(); }
+};
+
+// callback collecting all query results
+class ResultCollector : public SpeedwireQueryCallback {
+public:
+    std::vector<SpeedwireQueryResult> results;
+    virtual void onQueryComplete(const SpeedwireQueryResult& result) {
+        results.push_back(result);
+        results.back().packet = nullptr;
+    }
+};
+
+static SpeedwireDevice getDevice(const uint32_t serial, const char* interface_address) {
+    SpeedwireDevice device;
+    device.deviceAddress.susyID = 1;
+    device.deviceAddress.serialNumber = serial;
+    device.deviceIpAddress = IpAddress("127.0.0.1");
+    device.interfaceIpAddress = IpAddress(interface_address);
+    return device;
+}
+
+// test per-device and global in-flight limits and round-robin sending across devices
+TEST(SpeedwireQueryEngineTest, InFlightLimits) {
+    std::vector<SpeedwireDevice> devices;
+    devices.push_back(getDevice(100, "127.0.0.1"));
+    devices.push_back(getDevice(200, "127.0.0.1"));
+    SpeedwireCommand command(LocalHost::getInstance(), devices);
+    TestQueryEngine engine(command, 2, 3);
+    ResultCollector collector;
+    for (int i = 0; i < 3; ++i) {
+        engine.submit(devices[0], Command::AC_QUERY, 0x00464000, 0x004642FF, collector, 5000);      // ids 1, 2, 3
+    }
+    for (int i = 0; i < 3; ++i) {
+        engine.submit(devices[1], Command::AC_QUERY, 0x00464000, 0x004642FF, collector, 5000);      // ids 4, 5, 6
+    }
+    ASSERT_EQ(engine.getPendingCount(), 6);
+
+    // devices are served alternately until the global limit is reached
+    ASSERT_EQ(engine.poll(0), 0);
+    ASSERT_EQ(engine.getInFlightCount(), 3);
+    ASSERT_EQ(engine.getDeviceInFlightCount(100), 2);
+    ASSERT_EQ(engine.getDeviceInFlightCount(200), 1);
+
+    // a freed slot goes to the device following the one served last
+    engine.reply(1, 0x0000);
+    ASSERT_EQ(engine.poll(0), 1);
+    ASSERT_EQ(collector.results.size(), 1);
+    ASSERT_EQ(collector.results[0].requestId, 1);
+    ASSERT_EQ(collector.results[0].status, SpeedwireQueryStatus::OK);
+    ASSERT_EQ(engine.getInFlightCount(), 3);
+    ASSERT_EQ(engine.getDeviceInFlightCount(100), 1);
+    ASSERT_EQ(engine.getDeviceInFlightCount(200), 2);
+
+    // device 200 is at its per-device limit, hence the next slot goes to device 100
+    engine.reply(4, 0x0000);
+    ASSERT_EQ(engine.poll(0), 1);
+    ASSERT_EQ(engine.getDeviceInFlightCount(100), 2);
+    ASSERT_EQ(engine.getDeviceInFlightCount(200), 1);
+
+    engine.reply(2, 0x0000);
+    engine.reply(3, 0x0000);
+    engine.reply(5, 0x0000);
+    ASSERT_EQ(engine.poll(0), 3);
+    ASSERT_EQ(collector.results.size(), 5);
+    ASSERT_EQ(engine.getInFlightCount(), 1);    // request 6 is sent, but not yet answered
+    engine.reply(6, 0x0000);
+    ASSERT_EQ(engine.poll(0), 1);
+    ASSERT_EQ(collector.results.size(), 6);
+    ASSERT_EQ(engine.getPendingCount(), 0);
+    ASSERT_EQ(engine.getInFlightCount(), 0);
+    ASSERT_EQ(command.getTokenRepository().size(), 0);
+}
+
+// test deadline expiry; deadlines of completed requests are removed lazily from the heap
+TEST(SpeedwireQueryEngineTest, Deadlines) {
+    std::vector<SpeedwireDevice> devices;
+    devices.push_back(getDevice(100, "127.0.0.1"));
+    SpeedwireCommand command(LocalHost::getInstance(), devices);
+    TestQueryEngine engine(command, 2, 32);
+    ResultCollector collector;
+    const uint32_t first = engine.submit(devices[0], Command::AC_QUERY, 0x00464000, 0x004642FF, collector, 50);
+    const uint32_t second = engine.submit(devices[0], Command::AC_QUERY, 0x00464000, 0x004642FF, collector, 150);
+    ASSERT_EQ(engine.poll(0), 0);
+    engine.reply(first, 0x0000);
+    ASSERT_EQ(engine.poll(0), 1);
+    ASSERT_EQ(engine.getDeadlineCount(), 2);    // the completed request leaves its deadline behind
+
+    const uint64_t start = LocalHost::getTickCountInMs();
+    ASSERT_EQ(engine.run(1000), 1);             // the stale deadline is skipped and not counted
+    ASSERT_GE(LocalHost::getTickCountInMs() - start, 100);
+    ASSERT_EQ(collector.results.size(), 2);
+    ASSERT_EQ(collector.results[1].requestId, second);
+    ASSERT_EQ(collector.results[1].status, SpeedwireQueryStatus::TIMEOUT);
+    ASSERT_EQ(engine.getDeadlineCount(), 0);
+    ASSERT_EQ(engine.getInFlightCount(), 0);
+    ASSERT_EQ(command.getTokenRepository().size(), 0);
+}
+
+// test requests that cannot be sent complete immediately
+TEST(SpeedwireQueryEngineTest, SendFailed) {
+    std::vector<SpeedwireDevice> devices;
+    SpeedwireCommand command(LocalHost::getInstance(), devices);
+    TestQueryEngine engine(command, 2, 32);
+    ResultCollector collector;
+    const SpeedwireDevice device = getDevice(300, "10.255.255.1");     // no socket for this interface
+    engine.submit(device, Command::AC_QUERY, 0x00464000, 0x004642FF, collector, 1000);
+    ASSERT_EQ(engine.poll(0), 0);
+    ASSERT_EQ(collector.results.size(), 1);
+    ASSERT_EQ(collector.results[0].status, SpeedwireQueryStatus::SEND_FAILED);
+    ASSERT_EQ(collector.results[0].peer.serialNumber, 300);
+    ASSERT_EQ(engine.getPendingCount(), 0);
+    ASSERT_EQ(engine.getInFlightCount(), 0);
+}
+
+// test futures are fulfilled from within poll() with a copy of the reply packet
+TEST(SpeedwireQueryEngineTest, Futures) {
+    std::vector<SpeedwireDevice> devices;
+    devices.push_back(getDevice(100, "127.0.0.1"));
+    SpeedwireCommand command(LocalHost::getInstance(), devices);
+    TestQueryEngine engine(command, 2, 32);
+    std::future<SpeedwireQueryResponse> ok = engine.submit(devices[0], Command::AC_QUERY, 0x00464000, 0x004642FF, 1000);
+    std::future<SpeedwireQueryResponse> error = engine.submit(devices[0], Command::DC_QUERY, 0x00251E00, 0x00251EFF, 1000);
+    ASSERT_EQ(engine.poll(0), 0);
+    ASSERT_EQ(ok.wait_for(std::chrono::milliseconds(0)), std::future_status::timeout);
+    engine.reply(1, 0x0000);
+    engine.reply(2, 0x0015);
+    ASSERT_EQ(engine.poll(0), 2);
+
+    ASSERT_EQ(ok.wait_for(std::chrono::milliseconds(0)), std::future_status::ready);
+    const SpeedwireQueryResponse ok_response = ok.get();
+    ASSERT_EQ(ok_response.status, SpeedwireQueryStatus::OK);
+    ASSERT_EQ(ok_response.packet.size(), 58);
+    const SpeedwireQueryResponse error_response = error.get();
+    ASSERT_EQ(error_response.status, SpeedwireQueryStatus::ERROR_CODE);
+    ASSERT_EQ(error_response.errorCode, 0x0015);
+}
+
+// test a request answered with error code 0x0017 is queued again once, with a new deadline, and sent after the re-login
+TEST(SpeedwireQueryEngineTest, Relogin) {
+    std::vector<SpeedwireDevice> devices;
+    devices.push_back(getDevice(100, "127.0.0.1"));
+    devices.push_back(getDevice(200, "127.0.0.1"));
+    SpeedwireAuthentication authentication(LocalHost::getInstance(), devices);
+    TestSessionManager sessions(authentication, 600000, 1000, 60000);
+    sessions.add(devices[0]);
+    TestQueryEngine engine(authentication, 2, 32);
+    engine.setSessionManager(&sessions);
+    ResultCollector collector;
+
+    // requests to a managed device are held back until its login succeeded
+    const uint32_t id = engine.submit(devices[0], Command::AC_QUERY, 0x00464000, 0x004642FF, collector, 300);
+    const uint32_t other = engine.submit(devices[1], Command::AC_QUERY, 0x00464000, 0x004642FF, collector, 5000);
+    ASSERT_EQ(engine.poll(0), 0);
+    ASSERT_EQ(engine.getInFlightCount(), 1);
+    ASSERT_TRUE(sessions.reply(devices[0], 0x0000));
+    ASSERT_EQ(engine.poll(0), 0);
+    ASSERT_TRUE(sessions.isAuthenticated(devices[0]));
+    ASSERT_EQ(engine.getInFlightCount(), 2);
+
+    // error code 0x0017 invalidates the session and queues the request again
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    engine.reply(id, 0x0017);
+    ASSERT_EQ(engine.poll(0), 0);
+    ASSERT_EQ(collector.results.size(), 0);
+    ASSERT_TRUE(sessions.needsLogin(devices[0]));
+    ASSERT_EQ(engine.getDeviceInFlightCount(100), 0);
+    ASSERT_EQ(engine.getDeviceInFlightCount(200), 1);   // other devices are not affected
+
+    // the original deadline passes during the re-login without expiring the request
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    ASSERT_EQ(engine.poll(0), 0);
+    ASSERT_EQ(sessions.getPendingCount(), 1);
+    ASSERT_EQ(engine.getPendingCount(), 2);
+    ASSERT_TRUE(sessions.reply(devices[0], 0x0000));
+    ASSERT_EQ(engine.poll(0), 0);
+    ASSERT_EQ(sessions.getLoginCount(), 2);
+    ASSERT_EQ(engine.getDeviceInFlightCount(100), 1);
+
+    // a second 0x0017 completes the request
+    engine.reply(id, 0x0017);
+    engine.reply(other, 0x0000);
+    ASSERT_EQ(engine.poll(0), 2);
+    ASSERT_EQ(collector.results.size(), 2);
+    for (const auto& result : collector.results) {
+        if (result.requestId == id) {
+            ASSERT_EQ(result.status, SpeedwireQueryStatus::NOT_AUTHENTICATED);
+        }
+        else {
+            ASSERT_EQ(result.status, SpeedwireQueryStatus::OK);
+        }
+    }
+    ASSERT_EQ(engine.getPendingCount(), 0);
+    ASSERT_EQ(authentication.getTokenRepository().size(), 0);
+}
+
+// callback checking each reply packet is the reply to its own request
+class MatchingCollector : public SpeedwireQueryCallback {
+public:
+    int numOk, numMismatched;
+    MatchingCollector(void) : numOk(0), numMismatched(0) {}
+    virtual void onQueryComplete(const SpeedwireQueryResult& result) {
+        if (result.status != SpeedwireQueryStatus::OK || result.packet == nullptr) {
+            return;
+        }
+        const SpeedwireHeader header(result.packet, (unsigned long)result.packetSize);
+        const SpeedwireInverterProtocol inverter(header);
+        if (inverter.getSrcSerialNumber() == result.peer.serialNumber && inverter.getCommandID() == (result.command | Command::QUERY_RESPONSE)) {
+            ++numOk;
+        }
+        else {
+            ++numMismatched;
+        }
+    }
+};
+
+// test engines polled on different threads share one command instance and each receives the replies to its own requests
+TEST(SpeedwireQueryEngineTest, MultipleThreads) {
+    std::set<uint32_t> answered;
+    answered.insert(100);
+    answered.insert(200);
+    FakeInverter inverter("127.0.0.2", answered);
+    ASSERT_TRUE(inverter.isRunning());
+
+    std::vector<SpeedwireDevice> devices;
+    devices.push_back(getDevice(100, "127.0.0.1"));
+    devices.push_back(getDevice(200, "127.0.0.1"));
+    for (auto& device : devices) {
+        device.deviceIpAddress = IpAddress("127.0.0.2");
+    }
+    SpeedwireCommand command(LocalHost::getInstance(), devices);
+
+    // each thread queries both devices with its own command; the inverter echoes the command in its reply
+    const Command commands[4] = { Command::AC_QUERY, Command::DC_QUERY, Command::ENERGY_QUERY, Command::STATUS_QUERY };
+    const int num_queries = 100;
+    MatchingCollector collectors[4];
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.push_back(std::thread([&, t]() {
+            SpeedwireQueryEngine engine(command, 4, 8);
+            for (int i = 0; i < num_queries; ++i) {
+                engine.submit(devices[i % devices.size()], commands[t], 0x00464000, 0x004642FF, collectors[t], 5000);
+            }
+            const uint64_t deadline = LocalHost::getTickCountInMs() + 10000;
+            while (engine.getPendingCount() > 0 && LocalHost::getTickCountInMs() < deadline) {
+                engine.poll(10);
+            }
+        }));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (int t = 0; t < 4; ++t) {
+        ASSERT_EQ(collectors[t].numMismatched, 0);
+        ASSERT_EQ(collectors[t].numOk, num_queries);
+    }
+    ASSERT_EQ(inverter.getRequestCount(), 4 * num_queries);
+    ASSERT_EQ(command.getTokenRepository().size(), 0);
+}
@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+#include <SpeedwireQueryPlanner.hpp>
+
+using namespace libspeedwire;
+
+static SpeedwireDataMap getAcItems(void) {
+    return SpeedwireDataMap(std::vector<SpeedwireData>({
+        SpeedwireData::InverterPowerL1, SpeedwireData::InverterPowerL2, SpeedwireData::InverterPowerL3,
+        SpeedwireData::InverterVoltageL1, SpeedwireData::InverterVoltageL2, SpeedwireData::InverterVoltageL3,
+        SpeedwireData::InverterVoltageL1toL2, SpeedwireData::InverterVoltageL2toL3, SpeedwireData::InverterVoltageL3toL1,
+        SpeedwireData::InverterPowerFactor,
+        SpeedwireData::InverterCurrentL1, SpeedwireData::InverterCurrentL2, SpeedwireData::InverterCurrentL3,
+        SpeedwireData::InverterFrequency }));
+}
+
+// test merging of nearby register groups into a single request
+TEST(SpeedwireQueryPlannerTest, MergeNearbyRegisters) {
+    SpeedwireQueryPlanner planner;
+    SpeedwireQueryPlan plan = planner.createPlan(getAcItems());
+    ASSERT_EQ(plan.size(), 1);
+    ASSERT_TRUE(plan[0].command == Command::AC_QUERY);
+    ASSERT_EQ(plan[0].firstRegister, 0x00464000);
+    ASSERT_EQ(plan[0].lastRegister, 0x004657ff);
+    ASSERT_EQ(plan[0].numItems, 14);
+    // 0x4640 ... 0x4657 are 24 registers of 28 bytes each
+    ASSERT_EQ(plan[0].estimatedSize, 24 * 28);
+}
+
+// test grouping by command, connectors and register gaps
+TEST(SpeedwireQueryPlannerTest, GroupByCommand) {
+    SpeedwireQueryPlanner planner;
+    SpeedwireDataMap items(std::vector<SpeedwireData>({
+        SpeedwireData::InverterPowerMPP1, SpeedwireData::InverterPowerMPP2,
+        SpeedwireData::InverterVoltageMPP1, SpeedwireData::InverterVoltageMPP2,
+        SpeedwireData::InverterCurrentMPP1, SpeedwireData::InverterCurrentMPP2,
+        SpeedwireData::InverterPowerL1, SpeedwireData::InverterRelay,
+        SpeedwireData::YieldByDay, SpeedwireData::Event }));
+    SpeedwireQueryPlan plan = planner.createPlan(items);
+    ASSERT_EQ(plan.size(), 4);
+    ASSERT_TRUE(plan[0].command == Command::AC_QUERY);
+    ASSERT_EQ(plan[0].firstRegister, 0x00464000);
+    ASSERT_EQ(plan[0].lastRegister, 0x004640ff);
+    ASSERT_TRUE(plan[1].command == Command::STATUS_QUERY);
+    ASSERT_EQ(plan[1].firstRegister, 0x00416400);
+    ASSERT_EQ(plan[1].estimatedSize, 40);
+    ASSERT_TRUE(plan[2].command == Command::DC_QUERY);
+    ASSERT_EQ(plan[2].firstRegister, 0x00251e00);
+    ASSERT_EQ(plan[2].lastRegister, 0x00251eff);
+    ASSERT_EQ(plan[2].numItems, 2);
+    ASSERT_TRUE(plan[3].command == Command::DC_QUERY);
+    ASSERT_EQ(plan[3].firstRegister, 0x00451f00);
+    ASSERT_EQ(plan[3].lastRegister, 0x004521ff);
+    ASSERT_EQ(plan[3].numItems, 4);
+    // two connectors each for 0x451f and 0x4521, one record for 0x4520 in the gap
+    ASSERT_EQ(plan[3].estimatedSize, 5 * 28);
+}
+
+// test splitting of requests at the maximum response size
+TEST(SpeedwireQueryPlannerTest, MaxResponseSize) {
+    SpeedwireQueryPlanner planner;
+    planner.setMaxResponseSize(Command::AC_QUERY, 8 * 28);
+    ASSERT_EQ(planner.getMaxResponseSize(Command::AC_QUERY), 8 * 28);
+    ASSERT_EQ(planner.getMaxResponseSize(Command::DC_QUERY), 1024);
+
+    SpeedwireQueryPlan plan = planner.createPlan(getAcItems());
+    ASSERT_EQ(plan.size(), 3);
+    size_t num_items = 0;
+    for (size_t i = 0; i < plan.size(); ++i) {
+        ASSERT_LE(plan[i].estimatedSize, 8 * 28);
+        if (i > 0) {
+            ASSERT_GT(plan[i].firstRegister, plan[i - 1].lastRegister);
+        }
+        num_items += plan[i].numItems;
+    }
+    ASSERT_EQ(num_items, 14);
+    ASSERT_EQ(plan[0].firstRegister, 0x00464000);
+    ASSERT_EQ(plan[0].lastRegister, 0x004642ff);
+    ASSERT_EQ(plan[2].lastRegister, 0x004657ff);
+
+    // a zero register gap only merges adjacent registers
+    SpeedwireQueryPlanner strict(1024, 0);
+    plan = strict.createPlan(getAcItems());
+    ASSERT_EQ(plan.size(), 4);
+}
+
+// test plan caching by item signature
+TEST(SpeedwireQueryPlannerTest, Cache) {
+    SpeedwireQueryPlanner planner;
+    SpeedwireDataMap items = getAcItems();
+    SpeedwireDataMap more_items = getAcItems();
+    more_items.add(SpeedwireData::InverterPowerACTotal);
+
+    const SpeedwireQueryPlan& plan1 = planner.getPlan(items);
+    const SpeedwireQueryPlan& plan2 = planner.getPlan(getAcItems());
+    ASSERT_EQ(&plan1, &plan2);
+    ASSERT_EQ(plan1.size(), 1);
+    ASSERT_EQ(planner.getCacheSize(), 1);
+
+    // alternating item sets, e.g. of two devices of the same model, do not evict each other's plans
+    const SpeedwireQueryPlan& plan3 = planner.getPlan(more_items);
+    ASSERT_EQ(plan3.size(), 2);
+    ASSERT_EQ(plan3[0].firstRegister, 0x00263f00);
+    ASSERT_EQ(&planner.getPlan(items), &plan1);
+    ASSERT_EQ(&planner.getPlan(more_items), &plan3);
+    ASSERT_EQ(planner.getCacheSize(), 2);
+
+    // changed limits discard all cached plans
+    planner.setMaxResponseSize(Command::AC_QUERY, 2048);
+    ASSERT_EQ(planner.getCacheSize(), 0);
+    planner.getPlan(items);
+    planner.clear();
+    ASSERT_EQ(planner.getCacheSize(), 0);
+}
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include <SpeedwireRequestTemplates.hpp>
+#include <SpeedwireInverterProtocol.hpp>
+
+using namespace libspeedwire;
+
+// test that template copies are identical to packets assembled field by field
+TEST(SpeedwireRequestTemplatesTest, QueryRequest) {
+    const SpeedwireAddress dst(0x017a, 1901234567);
+    const SpeedwireAddress src(0x0078, 0x3a28be52);
+    SpeedwireRequestTemplates templates(4 * SpeedwireRequestTemplates::query_request_size);
+
+    uint8_t expected[SpeedwireRequestTemplates::query_request_size];
+    memset(expected, 0, sizeof(expected));
+    SpeedwireHeader expected_header(expected, sizeof(expected));
+    expected_header.setDefaultHeader(1, sizeof(expected) - 20, SpeedwireData2Packet::sma_inverter_protocol_id);
+    SpeedwireData2Packet(expected_header).setControl(0xa0);
+    SpeedwireInverterProtocol request(expected_header);
+    request.setDstSusyID(dst.susyID);
+    request.setDstSerialNumber(dst.serialNumber);
+    request.setDstControl(0x0100);
+    request.setSrcSusyID(src.susyID);
+    request.setSrcSerialNumber(src.serialNumber);
+    request.setSrcControl(0x0100);
+    request.setCommandID(Command::STATUS_QUERY);
+    request.setFirstRegisterID(0x00214800);
+    request.setLastRegisterID(0x002148ff);
+
+    uint8_t buffer[128];
+    for (uint16_t packet_id = 0x8001; packet_id < 0x8004; ++packet_id) {
+        request.setPacketID(packet_id);
+        ASSERT_EQ(templates.getQueryRequest(dst, src, Command::STATUS_QUERY, 0x00214800, 0x002148ff, packet_id, buffer, sizeof(buffer)), sizeof(expected));
+        ASSERT_EQ(memcmp(buffer, expected, sizeof(expected)), 0);
+    }
+    ASSERT_EQ(templates.size(), 1);
+    ASSERT_EQ(templates.getArenaSize(), SpeedwireRequestTemplates::query_request_size);
+    ASSERT_EQ(templates.getQueryRequest(dst, src, Command::STATUS_QUERY, 0x00214800, 0x002148ff, 0x8001, buffer, 16), 0);
+
+    // the arena is refilled once it is full
+    for (uint32_t i = 1; i <= 4; ++i) {
+        templates.getQueryRequest(dst, src, Command::AC_QUERY, i << 8, (i << 8) | 0xff, 0x8001, buffer, sizeof(buffer));
+    }
+    ASSERT_EQ(templates.size(), 1);
+    request.setPacketID(0x8123);
+    ASSERT_EQ(templates.getQueryRequest(dst, src, Command::STATUS_QUERY, 0x00214800, 0x002148ff, 0x8123, buffer, sizeof(buffer)), sizeof(expected));
+    ASSERT_EQ(memcmp(buffer, expected, sizeof(expected)), 0);
+}
+
+// test patching of the login time and password
+TEST(SpeedwireRequestTemplatesTest, LoginRequest) {
+    const SpeedwireAddress dst(0x017a, 1901234567);
+    const SpeedwireAddress src(0x0078, 0x3a28be52);
+    SpeedwireRequestTemplates templates;
+    std::array<uint8_t, 12> password;
+    password.fill(0x88);
+
+    uint8_t buffer[SpeedwireRequestTemplates::login_request_size];
+    ASSERT_EQ(templates.getLoginRequest(dst, src, 0x7, 0x384, password, 0x8005, 0x5fdf9ae8, buffer, sizeof(buffer)), sizeof(buffer));
+    SpeedwireHeader header(buffer, sizeof(buffer));
+    SpeedwireInverterProtocol login(header);
+    ASSERT_EQ(login.getPacketID(), 0x8005);
+    ASSERT_TRUE(login.getCommandID() == Command::LOGIN);
+    ASSERT_EQ(login.getFirstRegisterID(), 0x7);
+    ASSERT_EQ(login.getLastRegisterID(), 0x384);
+    ASSERT_EQ(login.getDataUint32(0), 0x5fdf9ae8);
+    ASSERT_EQ(login.getDataUint32(4), 0);
+    ASSERT_EQ(buffer[sizeof(buffer) - 5], 0x88);
+
+    password.fill(0xc1);
+    ASSERT_EQ(templates.getLoginRequest(dst, src, 0x7, 0x384, password, 0x8006, 0x5fdf9b00, buffer, sizeof(buffer)), sizeof(buffer));
+    ASSERT_EQ(login.getPacketID(), 0x8006);
+    ASSERT_EQ(login.getDataUint32(0), 0x5fdf9b00);
+    ASSERT_EQ(buffer[sizeof(buffer) - 5], 0xc1);
+    ASSERT_EQ(buffer[sizeof(buffer) - 4], 0x00);
+    ASSERT_EQ(templates.size(), 1);
+}
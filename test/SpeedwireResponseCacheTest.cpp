@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <SpeedwireResponseCache.hpp>
+#include <SpeedwireData.hpp>
+
+using namespace libspeedwire;
+
+static SpeedwireDevice getDevice(const uint32_t serial) {
+    SpeedwireDevice device;
+    device.deviceAddress = SpeedwireAddress(0x017a, serial);
+    return device;
+}
+
+static SpeedwireRawData getStatus(const SpeedwireData& data, const uint32_t value) {
+    uint8_t payload[32] = { 0 };
+    SpeedwireByteEncoding::setUint32LittleEndian(payload, value | 0x01000000);
+    return SpeedwireRawData(data.command, data.id, data.conn, data.type, 0, payload, sizeof(payload));
+}
+
+// test time-to-live rules, hits, misses and expiry
+TEST(SpeedwireResponseCacheTest, PutGet) {
+    SpeedwireResponseCache cache;
+    ASSERT_EQ(cache.getTimeToLive(Command::DEVICE_QUERY, 0x00821E00, 0x008220FF), 3600000);
+    ASSERT_EQ(cache.getTimeToLive(Command::AC_QUERY, 0x00411E00, 0x00411EFF), 3600000);
+    ASSERT_EQ(cache.getTimeToLive(Command::AC_QUERY, 0x00464000, 0x004642FF), 0);
+
+    const SpeedwireDevice device = getDevice(1901234567);
+    const uint8_t packet[] = { 0x53, 0x4d, 0x41, 0x00, 0x01, 0x02, 0x03 };
+    uint8_t buffer[2048];
+    uint64_t now = 1700000000000ull;
+
+    // replies not covered by a rule are not cached
+    ASSERT_FALSE(cache.put(device, Command::AC_QUERY, 0x00464000, 0x004642FF, packet, sizeof(packet), now));
+    ASSERT_TRUE(cache.put(device, Command::DEVICE_QUERY, 0x00821E00, 0x008220FF, packet, sizeof(packet), now));
+    ASSERT_EQ(cache.size(), 1);
+
+    ASSERT_EQ(cache.get(device, Command::DEVICE_QUERY, 0x00821E00, 0x008220FF, buffer, sizeof(buffer), now + 1000), (int32_t)sizeof(packet));
+    ASSERT_EQ(memcmp(buffer, packet, sizeof(packet)), 0);
+    ASSERT_EQ(cache.get(device, Command::DEVICE_QUERY, 0x00823400, 0x008234FF, buffer, sizeof(buffer), now + 1000), -1);
+    ASSERT_EQ(cache.get(getDevice(1), Command::DEVICE_QUERY, 0x00821E00, 0x008220FF, buffer, sizeof(buffer), now + 1000), -1);
+    ASSERT_EQ(cache.get(device, Command::DEVICE_QUERY, 0x00821E00, 0x008220FF, buffer, 4, now + 1000), -1);
+    ASSERT_EQ(cache.getHitCount(), 1);
+    ASSERT_EQ(cache.getMissCount(), 3);
+
+    // expired replies are removed
+    ASSERT_EQ(cache.get(device, Command::DEVICE_QUERY, 0x00821E00, 0x008220FF, buffer, sizeof(buffer), now + 3600000), -1);
+    ASSERT_EQ(cache.size(), 0);
+
+    // rules added first take precedence
+    SpeedwireResponseCache custom;
+    custom.addRule(Command::AC_QUERY, 0x00464000, 0x004642FF, 5000);
+    ASSERT_EQ(custom.getTimeToLive(Command::AC_QUERY, 0x00464000, 0x004640FF), 5000);
+    ASSERT_EQ(custom.getTimeToLive(Command::AC_QUERY, 0x00464000, 0x004648FF), 0);
+}
+
+// test invalidation on status changes
+TEST(SpeedwireResponseCacheTest, Invalidate) {
+    SpeedwireResponseCache cache;
+    const SpeedwireDevice device1 = getDevice(1901234567);
+    const SpeedwireDevice device2 = getDevice(1901234568);
+    const uint8_t packet[] = { 0x53, 0x4d, 0x41, 0x00 };
+    const uint64_t now = 1700000000000ull;
+    cache.put(device1, Command::DEVICE_QUERY, 0x00821E00, 0x008220FF, packet, sizeof(packet), now);
+    cache.put(device1, Command::DEVICE_QUERY, 0x00823400, 0x008234FF, packet, sizeof(packet), now);
+    cache.put(device2, Command::DEVICE_QUERY, 0x00821E00, 0x008220FF, packet, sizeof(packet), now);
+    ASSERT_EQ(cache.size(), 3);
+
+    // the first observation and unchanged or unrelated status values keep the cached replies
+    ASSERT_FALSE(cache.observe(device1, getStatus(SpeedwireData::InverterUpdateStatus, 0x133)));
+    ASSERT_FALSE(cache.observe(device1, getStatus(SpeedwireData::InverterUpdateStatus, 0x133)));
+    ASSERT_FALSE(cache.observe(device1, getStatus(SpeedwireData::InverterRelay, 0x33)));
+    ASSERT_FALSE(cache.observe(device1, getStatus(SpeedwireData::InverterRelay, 0x137)));
+    ASSERT_EQ(cache.size(), 3);
+
+    // a changed update status invalidates all replies of the device
+    ASSERT_TRUE(cache.observe(device1, getStatus(SpeedwireData::InverterUpdateStatus, 0x134)));
+    ASSERT_EQ(cache.size(), 1);
+
+    cache.invalidate(device2, Command::DEVICE_QUERY, 0x00821E00, 0x008220FF);
+    ASSERT_EQ(cache.size(), 0);
+}
+
+// test persistence
+TEST(SpeedwireResponseCacheTest, SaveLoad) {
+    const std::string path = "speedwire_response_cache_test.txt";
+    const SpeedwireDevice device = getDevice(1901234567);
+    const uint8_t packet[] = { 0x53, 0x4d, 0x41, 0x00, 0xff, 0x10 };
+    uint8_t buffer[64];
+    const uint64_t now = 1700000000000ull;
+
+    SpeedwireResponseCache cache;
+    cache.put(device, Command::DEVICE_QUERY, 0x00821E00, 0x008220FF, packet, sizeof(packet), now);
+    cache.put(device, Command::AC_QUERY, 0x00411E00, 0x00411EFF, packet, 2, now - 3000000);
+    ASSERT_TRUE(cache.save(path));
+
+    // replies expired at load time are skipped
+    SpeedwireResponseCache loaded;
+    ASSERT_TRUE(loaded.load(path, now + 1000000));
+    ASSERT_EQ(loaded.size(), 1);
+    ASSERT_EQ(loaded.get(device, Command::DEVICE_QUERY, 0x00821E00, 0x008220FF, buffer, sizeof(buffer), now + 1000000), (int32_t)sizeof(packet));
+    ASSERT_EQ(memcmp(buffer, packet, sizeof(packet)), 0);
+    ASSERT_EQ(loaded.get(device, Command::DEVICE_QUERY, 0x00821E00, 0x008220FF, buffer, sizeof(buffer), now + 3600000), -1);
+    remove(path.c_str());
+
+    ASSERT_FALSE(loaded.load(path, now));
+}
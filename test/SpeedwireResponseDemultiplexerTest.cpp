@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include <SpeedwireResponseDemultiplexer.hpp>
+#include <SpeedwireCommand.hpp>
+#include <SpeedwireInverterProtocol.hpp>
+
+using namespace libspeedwire;
+
+// demultiplexer with access to the routing method, such that it can be tested without sockets
+class TestDemultiplexer : public SpeedwireResponseDemultiplexer {
+public:
+    TestDemultiplexer(const std::vector<SpeedwireSocket>& sockets, const size_t max_late_replies) : SpeedwireResponseDemultiplexer(sockets, max_late_replies) {}
+    void inject(const uint16_t susyid, const uint32_t serial, const uint16_t packetid) {
+        SpeedwireReply reply;
+        reply.packet.resize(24 + 8 + 8 + 6 + 4 + 4 + 4);
+        SpeedwireHeader header(reply.packet.data(), (unsigned long)reply.packet.size());
+        header.setDefaultHeader(1, (uint16_t)(reply.packet.size() - 20), SpeedwireData2Packet::sma_inverter_protocol_id);
+        SpeedwireData2Packet data2_packet(header);
+        data2_packet.setControl(0xa0);
+        SpeedwireInverterProtocol inverter(header);
+        inverter.setSrcSusyID(susyid);
+        inverter.setSrcSerialNumber(serial);
+        inverter.setPacketID(packetid);
+        memset(&reply.src, 0, sizeof(reply.src));
+        reply.time = 0;
+        route(reply);
+    }
+};
+
+// test routing of replies to expected keys and to the late-reply queue
+TEST(SpeedwireResponseDemultiplexerTest, Route) {
+    std::vector<SpeedwireSocket> sockets;
+    TestDemultiplexer demultiplexer(sockets, 2);
+    const uint64_t key_a = SpeedwireCommandTokenRepository::getKey(1, 100, 0x8001);
+    const uint64_t key_b = SpeedwireCommandTokenRepository::getKey(1, 100, 0x8002);
+    demultiplexer.expect(key_a);
+    demultiplexer.expect(key_b);
+
+    // replies arrive in the opposite order of the waiting requests
+    demultiplexer.inject(1, 100, 0x0002);
+    demultiplexer.inject(1, 100, 0x0001);
+    SpeedwireReply reply;
+    ASSERT_TRUE(demultiplexer.takeReply(key_a, reply));
+    ASSERT_EQ(SpeedwireResponseDemultiplexer::getReplyKey(reply.packet.data(), reply.packet.size()), key_a);
+    ASSERT_FALSE(demultiplexer.takeReply(key_a, reply));
+    ASSERT_TRUE(demultiplexer.waitForReply(key_b, reply, 0));
+    ASSERT_EQ(SpeedwireResponseDemultiplexer::getReplyKey(reply.packet.data(), reply.packet.size()), key_b);
+    ASSERT_EQ(demultiplexer.getRoutedCount(), 2);
+
+    // replies for cancelled or unknown keys go to the bounded late-reply queue
+    demultiplexer.cancel(key_a);
+    demultiplexer.inject(1, 100, 0x0001);
+    demultiplexer.inject(2, 200, 0x0003);
+    demultiplexer.inject(2, 200, 0x0004);
+    ASSERT_EQ(demultiplexer.getLateCount(), 3);
+    ASSERT_EQ(demultiplexer.getLateDroppedCount(), 1);
+    ASSERT_TRUE(demultiplexer.takeLateReply(reply));
+    ASSERT_EQ(SpeedwireResponseDemultiplexer::getReplyKey(reply.packet.data(), reply.packet.size()), SpeedwireCommandTokenRepository::getKey(2, 200, 0x8003));
+    ASSERT_TRUE(demultiplexer.takeLateReply(reply));
+    ASSERT_FALSE(demultiplexer.takeLateReply(reply));
+    ASSERT_EQ(demultiplexer.getReceivedCount(), 5);
+    ASSERT_EQ(demultiplexer.getIgnoredCount(), 0);
+}
+
+// test replies to broadcast requests are routed by packet id, regardless of the replying device
+TEST(SpeedwireResponseDemultiplexerTest, RouteBroadcast) {
+    std::vector<SpeedwireSocket> sockets;
+    TestDemultiplexer demultiplexer(sockets, 2);
+    const uint64_t broadcast_key = SpeedwireCommandTokenRepository::getKey(0xffff, 0xffffffff, 0x8005);
+    const uint64_t unicast_key = SpeedwireCommandTokenRepository::getKey(2, 200, 0x8005);
+    ASSERT_EQ(SpeedwireResponseDemultiplexer::getBroadcastKey(unicast_key), broadcast_key);
+    demultiplexer.expect(broadcast_key);
+    demultiplexer.expect(unicast_key);
+
+    demultiplexer.inject(1, 100, 0x0005);
+    demultiplexer.inject(2, 200, 0x0005);     // an exact match takes precedence
+    demultiplexer.inject(3, 300, 0x0005);
+    demultiplexer.inject(3, 300, 0x0006);     // other packet ids are late replies
+    SpeedwireReply reply;
+    ASSERT_TRUE(demultiplexer.takeReply(broadcast_key, reply));
+    ASSERT_EQ(SpeedwireResponseDemultiplexer::getReplyKey(reply.packet.data(), reply.packet.size()), SpeedwireCommandTokenRepository::getKey(1, 100, 0x8005));
+    ASSERT_TRUE(demultiplexer.takeReply(broadcast_key, reply));
+    ASSERT_EQ(SpeedwireResponseDemultiplexer::getReplyKey(reply.packet.data(), reply.packet.size()), SpeedwireCommandTokenRepository::getKey(3, 300, 0x8005));
+    ASSERT_FALSE(demultiplexer.takeReply(broadcast_key, reply));
+    ASSERT_TRUE(demultiplexer.takeReply(unicast_key, reply));
+    ASSERT_EQ(demultiplexer.getRoutedCount(), 3);
+    ASSERT_EQ(demultiplexer.getLateCount(), 1);
+}
@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <LocalHost.hpp>
+#include <SpeedwireSessionManager.hpp>
+#include "SpeedwireTestReplies.hpp"
+
+using namespace libspeedwire;
+
+static SpeedwireDevice getDevice(const uint32_t serial) {
+    SpeedwireDevice device;
+    device.deviceAddress.susyID = 1;
+    device.deviceAddress.serialNumber = serial;
+    device.deviceIpAddress = IpAddress("127.0.0.1");
+    device.interfaceIpAddress = IpAddress("127.0.0.1");
+    return device;
+}
+
+// test session bookkeeping for a device that cannot be reached
+TEST(SpeedwireSessionManagerTest, Unreachable) {
+    std::vector<SpeedwireDevice> devices;
+    SpeedwireAuthentication authentication(LocalHost::getInstance(), devices);
+    SpeedwireSessionManager sessions(authentication, Credentials(UserName::USER, "0000"), 600000, 200, 60000);
+
+    SpeedwireDevice device;
+    device.deviceAddress.susyID = 0x7d;
+    device.deviceAddress.serialNumber = 3401;
+    device.deviceIpAddress = IpAddress("192.168.182.18");
+    device.interfaceIpAddress = IpAddress("192.168.182.1");
+
+    // unmanaged devices never wait for a login
+    ASSERT_FALSE(sessions.isManaged(device));
+    ASSERT_FALSE(sessions.needsLogin(device));
+
+    sessions.add(device);
+    ASSERT_TRUE(sessions.isManaged(device));
+    ASSERT_TRUE(sessions.needsLogin(device));
+    ASSERT_FALSE(sessions.isAuthenticated(device));
+    ASSERT_EQ(sessions.getSessionAge(device, LocalHost::getTickCountInMs()), UINT64_MAX);
+
+    // there is no socket for the interface, hence the login fails without a request in flight
+    ASSERT_EQ(sessions.login(100), 0);
+    ASSERT_EQ(sessions.getPendingCount(), 0);
+    ASSERT_EQ(sessions.getLoginCount(), 0);
+    ASSERT_EQ(sessions.getFailureCount(), 1);
+
+    // the retry interval suppresses further attempts from poll(), but not from login()
+    ASSERT_EQ(sessions.poll(0), 0);
+    ASSERT_EQ(sessions.getFailureCount(), 1);
+    ASSERT_EQ(sessions.login(100), 0);
+    ASSERT_EQ(sessions.getFailureCount(), 2);
+
+    sessions.remove(device);
+    ASSERT_FALSE(sessions.isManaged(device));
+}
+
+// test login requests to all devices are in flight at once and each device is authenticated by its own reply
+TEST(SpeedwireSessionManagerTest, ConcurrentLogin) {
+    std::vector<SpeedwireDevice> devices;
+    devices.push_back(getDevice(100));
+    devices.push_back(getDevice(200));
+    devices.push_back(getDevice(300));
+    SpeedwireAuthentication authentication(LocalHost::getInstance(), devices);
+    TestSessionManager sessions(authentication, 600000, 1000, 60000);
+    for (const auto& device : devices) {
+        sessions.add(device);
+    }
+
+    ASSERT_EQ(sessions.poll(0), 0);
+    ASSERT_EQ(sessions.getPendingCount(), 3);
+    ASSERT_EQ(authentication.getTokenRepository().size(), 3);
+
+    // replies arrive in any order; a rejected login does not affect the other devices
+    ASSERT_TRUE(sessions.reply(devices[2], 0x0000));
+    ASSERT_TRUE(sessions.reply(devices[1], 0x0100));
+    ASSERT_TRUE(sessions.reply(devices[0], 0x0000));
+    ASSERT_EQ(sessions.poll(0), 3);
+    ASSERT_EQ(sessions.getPendingCount(), 0);
+    ASSERT_EQ(authentication.getTokenRepository().size(), 0);
+    ASSERT_TRUE(sessions.isAuthenticated(devices[0]));
+    ASSERT_FALSE(sessions.isAuthenticated(devices[1]));
+    ASSERT_TRUE(sessions.needsLogin(devices[1]));
+    ASSERT_TRUE(sessions.isAuthenticated(devices[2]));
+    ASSERT_EQ(sessions.getLoginCount(), 2);
+    ASSERT_EQ(sessions.getFailureCount(), 1);
+    ASSERT_EQ(authentication.getPacketIdAllocator().getSession(1, 100), 1);
+    ASSERT_EQ(authentication.getPacketIdAllocator().getSession(1, 200), 0);
+
+    // the rejected device is retried only after the retry interval
+    ASSERT_EQ(sessions.poll(0), 0);
+    ASSERT_EQ(sessions.getPendingCount(), 0);
+}
+
+// test sessions are renewed once they reach the refresh age, while the device stays authenticated
+TEST(SpeedwireSessionManagerTest, Renewal) {
+    std::vector<SpeedwireDevice> devices;
+    devices.push_back(getDevice(100));
+    SpeedwireAuthentication authentication(LocalHost::getInstance(), devices);
+    TestSessionManager sessions(authentication, 100, 1000, 60000);
+    sessions.add(devices[0]);
+
+    ASSERT_EQ(sessions.poll(0), 0);
+    ASSERT_TRUE(sessions.reply(devices[0], 0x0000));
+    ASSERT_EQ(sessions.poll(0), 1);
+    ASSERT_TRUE(sessions.isAuthenticated(devices[0]));
+    ASSERT_LT(sessions.getSessionAge(devices[0], LocalHost::getTickCountInMs()), 100);
+
+    // the session is still fresh
+    ASSERT_EQ(sessions.poll(0), 0);
+    ASSERT_EQ(sessions.getPendingCount(), 0);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    ASSERT_EQ(sessions.poll(0), 0);
+    ASSERT_EQ(sessions.getPendingCount(), 1);
+    ASSERT_TRUE(sessions.isAuthenticated(devices[0]));     // requests are not held back during the renewal
+    ASSERT_FALSE(sessions.needsLogin(devices[0]));
+    ASSERT_GE(sessions.getSessionAge(devices[0], LocalHost::getTickCountInMs()), 150);
+
+    ASSERT_TRUE(sessions.reply(devices[0], 0x0000));
+    ASSERT_EQ(sessions.poll(0), 1);
+    ASSERT_EQ(sessions.getLoginCount(), 2);
+    ASSERT_LT(sessions.getSessionAge(devices[0], LocalHost::getTickCountInMs()), 100);
+    ASSERT_EQ(authentication.getPacketIdAllocator().getSession(1, 100), 2);
+}
@@ -0,0 +1,39 @@
+#include <gtest/gtest.h>
+#include <string.h>
+#include <vector>
+#include <LocalHost.hpp>
+#include <AddressConversion.hpp>
+#include <SpeedwireSocket.hpp>
+
+using namespace libspeedwire;
+
+// test batched transmission of datagrams across the loopback interface
+TEST(SpeedwireSocketTest, SendBatch) {
+    SpeedwireSocket sender(LocalHost::getInstance());
+    SpeedwireSocket receiver(LocalHost::getInstance());
+    ASSERT_GE(sender.openSocket("127.0.0.1", false), 0);
+    ASSERT_GE(receiver.openSocket("127.0.0.1", false), 0);
+
+    // determine the port chosen for the receiver
+    struct sockaddr_in dest;
+    socklen_t dest_length = sizeof(dest);
+    memset(&dest, 0, sizeof(dest));
+    ASSERT_EQ(getsockname(receiver.getSocketFd(), (struct sockaddr*)&dest, &dest_length), 0);
+
+    const char payloads[3][8] = { "first", "second", "third" };
+    std::vector<SpeedwireSocket::Datagram> datagrams;
+    for (size_t i = 0; i < 3; ++i) {
+        datagrams.push_back(SpeedwireSocket::Datagram(payloads[i], (unsigned long)strlen(payloads[i]) + 1, AddressConversion::toSockAddr(dest)));
+    }
+    ASSERT_EQ(sender.sendmmsg(datagrams), 3);
+
+    for (size_t i = 0; i < 3; ++i) {
+        ASSERT_EQ(datagrams[i].nbytes, (int)strlen(payloads[i]) + 1);
+        char buffer[16];
+        struct sockaddr_in src;
+        ASSERT_EQ(receiver.recvfrom(buffer, sizeof(buffer), src), datagrams[i].nbytes);
+        ASSERT_STREQ(buffer, payloads[i]);
+    }
+    sender.closeSocket();
+    receiver.closeSocket();
+}
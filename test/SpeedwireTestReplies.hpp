@@ -0,0 +1,164 @@
+#ifndef __LIBSPEEDWIRE_SPEEDWIRETESTREPLIES_HPP__
+#define __LIBSPEEDWIRE_SPEEDWIRETESTREPLIES_HPP__
+
+#include <string.h>
+#include <atomic>
+#include <set>
+#include <thread>
+#include <vector>
+#ifndef _WIN32
+#include <poll.h>
+#include <unistd.h>
+#endif
+#include <LocalHost.hpp>
+#include <SpeedwireInverterProtocol.hpp>
+#include <SpeedwireResponseDemultiplexer.hpp>
+#include <SpeedwireSessionManager.hpp>
+
+using namespace libspeedwire;
+
+// demultiplexer subclass granting access to the protected routing method, such that replies can be injected without a peer
+class ReplyInjector : public SpeedwireResponseDemultiplexer {
+public:
+    static void setReply(std::vector<uint8_t>& packet, const uint16_t susyid, const uint32_t serialnumber, const uint16_t packetid, const Command command, const uint16_t error_code,
+                         const size_t payload_size = 0) {
+        packet.assign(24 + 8 + 8 + 6 + 4 + 4 + 4 + payload_size, 0);
+        SpeedwireHeader header(packet.data(), (unsigned long)packet.size());
+        header.setDefaultHeader(1, (uint16_t)(packet.size() - 20), SpeedwireData2Packet::sma_inverter_protocol_id);
+        SpeedwireData2Packet data2_packet(header);
+        data2_packet.setControl(0xa0);
+        SpeedwireInverterProtocol inverter(header);
+        inverter.setDstSusyID(SpeedwireAddress::getLocalAddress().susyID);
+        inverter.setDstSerialNumber(SpeedwireAddress::getLocalAddress().serialNumber);
+        inverter.setSrcSusyID(susyid);
+        inverter.setSrcSerialNumber(serialnumber);
+        inverter.setErrorCode(error_code);
+        inverter.setPacketID(packetid);
+        inverter.setCommandID(command);
+    }
+
+    static void inject(SpeedwireResponseDemultiplexer& demultiplexer, const SpeedwireCommandToken& token, const uint16_t error_code) {
+        SpeedwireReply reply;
+        setReply(reply.packet, token.susyid, token.serialnumber, token.packetid, token.command, error_code);
+        memset(&reply.src, 0, sizeof(reply.src));
+        struct sockaddr_in& src = (struct sockaddr_in&)reply.src;
+        src.sin_family = AF_INET;
+        src.sin_port = htons(SpeedwireSocket::speedwire_port_9522);
+        src.sin_addr = token.peer_ip_address.getInAddress();
+        reply.time = LocalHost::getTickCountInMs();
+        void (SpeedwireResponseDemultiplexer::*route_reply)(SpeedwireReply&) = &ReplyInjector::route;
+        (demultiplexer.*route_reply)(reply);
+    }
+};
+
+// inverter stand-in answering the requests sent to port 9522 of a loopback address from a background thread;
+// only devices with the given serial numbers reply, device type queries are answered with a pv inverter STP-5.0-3AV-40
+class FakeInverter {
+protected:
+    int fd;
+    std::set<uint32_t> serials;
+    std::atomic<bool> running;
+    std::atomic<int> numRequests;
+    std::thread thread;
+
+    void run(void) {
+        std::vector<uint8_t> packet;
+        uint8_t buffer[2048];
+        while (running) {
+            struct ::pollfd poll_fd = { fd, POLLIN, 0 };
+            if (::poll(&poll_fd, 1, 10) <= 0) {
+                continue;
+            }
+            struct sockaddr_in src;
+            socklen_t src_length = sizeof(src);
+            const int nbytes = (int)::recvfrom(fd, (char*)buffer, sizeof(buffer), 0, (struct sockaddr*)&src, &src_length);
+            const SpeedwireHeader request(buffer, (unsigned long)(nbytes > 0 ? nbytes : 0));
+            if (nbytes <= 0 || request.isValidData2Packet() == false) {
+                continue;
+            }
+            const SpeedwireInverterProtocol inverter(request);
+            ++numRequests;
+            if (serials.find(inverter.getDstSerialNumber()) != serials.end()) {
+                if (inverter.getCommandID() == Command::DEVICE_QUERY) {
+                    setDeviceTypeReply(packet, inverter.getDstSusyID(), inverter.getDstSerialNumber(), inverter.getPacketID());
+                }
+                else {
+                    ReplyInjector::setReply(packet, inverter.getDstSusyID(), inverter.getDstSerialNumber(), inverter.getPacketID(), inverter.getCommandID() | Command::QUERY_RESPONSE, 0x0000);
+                }
+                ::sendto(fd, (const char*)packet.data(), (int)packet.size(), 0, (struct sockaddr*)&src, src_length);
+            }
+        }
+    }
+
+    // device type reply holding the name, device class and device model registers, 40 bytes each
+    static void setDeviceTypeReply(std::vector<uint8_t>& packet, const uint16_t susyid, const uint32_t serialnumber, const uint16_t packetid) {
+        const size_t element_size = 8 + 8 * 4;
+        ReplyInjector::setReply(packet, susyid, serialnumber, packetid, Command::DEVICE_QUERY | Command::QUERY_RESPONSE, 0x0000, 3 * element_size);
+        SpeedwireHeader header(packet.data(), (unsigned long)packet.size());
+        SpeedwireInverterProtocol reply(header);
+        reply.setFirstRegisterID(1);
+        reply.setLastRegisterID(3);
+        uint8_t* const data = packet.data() + 24 + 8 + 8 + 6 + 4 + 4 + 4 - 4;
+        const uint32_t codes[3] = { 0x10821e01, 0x08821f01, 0x08822001 };
+        const uint32_t selections[3] = { 0x00000000, 0x01000000 | 8001, 0x01000000 | 9345 };
+        for (size_t i = 0; i < 3; ++i) {
+            uint8_t* const element = data + i * element_size;
+            SpeedwireByteEncoding::setUint32LittleEndian(element, codes[i]);
+            SpeedwireByteEncoding::setUint32LittleEndian(element + 4, (uint32_t)LocalHost::getUnixEpochTimeInMs() / 1000);
+            for (size_t j = 0; j < 8; ++j) {
+                SpeedwireByteEncoding::setUint32LittleEndian(element + 8 + j * 4, (j == 0 ? selections[i] : 0x00fffffe));
+            }
+        }
+    }
+
+public:
+    FakeInverter(const char* address, const std::set<uint32_t>& answered_serials) : fd(-1), serials(answered_serials), running(false), numRequests(0) {
+        struct sockaddr_in saddr;
+        memset(&saddr, 0, sizeof(saddr));
+        saddr.sin_family = AF_INET;
+        saddr.sin_port = htons(SpeedwireSocket::speedwire_port_9522);
+        saddr.sin_addr = IpAddress(address).getInAddress();
+        // share the port with the multicast sockets bound to the wildcard address; unicast requests go to the more specific binding
+        const int reuseaddr = 1;
+        fd = (int)::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (fd >= 0 && setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuseaddr, sizeof(reuseaddr)) == 0 &&
+            ::bind(fd, (struct sockaddr*)&saddr, sizeof(saddr)) == 0) {
+            running = true;
+            thread = std::thread(&FakeInverter::run, this);
+        }
+    }
+
+    ~FakeInverter(void) {
+        if (running) {
+            running = false;
+            thread.join();
+        }
+        if (fd >= 0) {
+#ifdef _WIN32
+            closesocket(fd);
+#else
+            close(fd);
+#endif
+        }
+    }
+
+    bool isRunning(void) const { return running; }
+    int  getRequestCount(void) const { return numRequests; }
+};
+
+// session manager with access to the command tokens of its login requests
+class TestSessionManager : public SpeedwireSessionManager {
+public:
+    TestSessionManager(SpeedwireAuthentication& authentication, const uint32_t refresh_age_in_ms, const uint32_t login_timeout_in_ms, const uint32_t retry_interval_in_ms) :
+        SpeedwireSessionManager(authentication, Credentials(UserName::USER, "0000"), refresh_age_in_ms, login_timeout_in_ms, retry_interval_in_ms) {}
+    bool reply(const SpeedwireDevice& device, const uint16_t error_code) {
+        std::map<uint32_t, Session>::const_iterator it = sessions.find(device.deviceAddress.serialNumber);
+        if (it == sessions.end() || it->second.token < 0) {
+            return false;
+        }
+        ReplyInjector::inject(authentication.getDemultiplexer(), authentication.getTokenRepository().at(it->second.token), error_code);
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <TimeAlignedJoinProcessor.hpp>
+#include "ProcessorTestHelpers.hpp"
+
+using namespace libspeedwire;
+
+// consumer collecting all emitted rows
+class RowCollector : public JoinedRowConsumer {
+public:
+    std::vector<JoinedRow> rows;
+    virtual void consume(const JoinedRow& row) {
+        rows.push_back(row);
+    }
+};
+
+// test rows of several devices are aligned to the grid and emitted once the latency has passed
+TEST(TimeAlignedJoinProcessorTest, Alignment) {
+    SpeedwireDevice device1 = getDevice(1);
+    SpeedwireDevice device2 = getDevice(2);
+    ObisData element1(ObisData::PositiveActivePowerTotal);
+    ObisData element2(ObisData::NegativeActivePowerTotal);
+    ObisData unused(ObisData::NegativeActivePowerTotal);
+    TimeAlignedJoinProcessor processor(1000, 1000, 2000);
+    RowCollector collector;
+    processor.addConsumer(collector);
+    ASSERT_EQ(processor.addColumn(1, element1), 0);
+    ASSERT_EQ(processor.addColumn(2, element2), 1);
+    ASSERT_EQ(processor.getNumberOfColumns(), 2);
+    ASSERT_EQ(processor.getColumnSerialNumber(1), 2);
+
+    addValue(processor, device1, element1, 10.0, 0);
+    addValue(processor, device2, element2, 20.0, 300);
+    ASSERT_EQ(collector.rows.size(), 0);
+    addValue(processor, device1, unused, 99.0, 5000);       // not a selected column
+    ASSERT_EQ(collector.rows.size(), 0);
+    addValue(processor, device1, element1, 11.0, 1000);
+    ASSERT_EQ(collector.rows.size(), 1);
+    ASSERT_EQ(collector.rows[0].time, 0);
+    ASSERT_TRUE(collector.rows[0].isComplete());
+    ASSERT_DOUBLE_EQ(collector.rows[0].values[0], 10.0);
+    ASSERT_DOUBLE_EQ(collector.rows[0].values[1], 20.0);
+
+    addValue(processor, device1, element1, 11.0, 1000);     // duplicates are ignored
+    ASSERT_EQ(collector.rows.size(), 1);
+    addValue(processor, device2, element2, 22.0, 2300);
+    ASSERT_EQ(collector.rows.size(), 2);
+    ASSERT_EQ(collector.rows[1].time, 1000);
+}
+
+// test column values are interpolated between the two time-wise closest values
+TEST(TimeAlignedJoinProcessorTest, Interpolation) {
+    SpeedwireDevice device = getDevice(1);
+    ObisData element(ObisData::PositiveActivePowerTotal);
+    TimeAlignedJoinProcessor processor(1000, 0, 1000);
+    RowCollector collector;
+    processor.addConsumer(collector);
+    processor.addColumn(1, element);
+
+    addValue(processor, device, element, 0.0, 500);
+    ASSERT_EQ(collector.rows.size(), 1);
+    ASSERT_EQ(collector.rows[0].time, 0);
+    ASSERT_DOUBLE_EQ(collector.rows[0].values[0], 0.0);
+    addValue(processor, device, element, 100.0, 1500);
+    ASSERT_EQ(collector.rows.size(), 2);
+    ASSERT_EQ(collector.rows[1].time, 1000);
+    ASSERT_DOUBLE_EQ(collector.rows[1].values[0], 50.0);
+    addValue(processor, device, element, 300.0, 2000);
+    ASSERT_EQ(collector.rows.size(), 3);
+    ASSERT_EQ(collector.rows[2].time, 2000);
+    ASSERT_DOUBLE_EQ(collector.rows[2].values[0], 300.0);
+}
+
+// test columns without a value within maxAgeInMs of the grid point are invalid
+TEST(TimeAlignedJoinProcessorTest, MaxAge) {
+    SpeedwireDevice device1 = getDevice(1);
+    SpeedwireDevice device2 = getDevice(2);
+    ObisData element1(ObisData::PositiveActivePowerTotal);
+    ObisData element2(ObisData::PositiveActivePowerTotal);
+    TimeAlignedJoinProcessor processor(1000, 0, 500);
+    RowCollector collector;
+    processor.addConsumer(collector);
+    processor.addColumn(1, element1);
+    processor.addColumn(2, element2);
+
+    addValue(processor, device2, element2, 5.0, 0);
+    ASSERT_EQ(collector.rows.size(), 1);
+    ASSERT_FALSE(collector.rows[0].isComplete());
+    ASSERT_FALSE(collector.rows[0].valid[0]);
+    ASSERT_TRUE(collector.rows[0].valid[1]);
+    addValue(processor, device1, element1, 2.0, 1000);
+    addValue(processor, device1, element1, 3.0, 2000);
+    ASSERT_EQ(collector.rows.size(), 3);
+    for (size_t i = 1; i < 3; ++i) {
+        ASSERT_FALSE(collector.rows[i].isComplete());
+        ASSERT_TRUE(collector.rows[i].valid[0]);
+        ASSERT_FALSE(collector.rows[i].valid[1]);     // the only value is 1000 ms or more away
+        ASSERT_DOUBLE_EQ(collector.rows[i].values[1], 0.0);
+    }
+    ASSERT_DOUBLE_EQ(collector.rows[2].values[0], 3.0);
+}
+
+// test the number of rows per packet is bounded and older grid points are skipped
+TEST(TimeAlignedJoinProcessorTest, MaxRowsPerPacket) {
+    SpeedwireDevice device = getDevice(1);
+    ObisData element(ObisData::PositiveActivePowerTotal);
+    TimeAlignedJoinProcessor processor(1000, 0, 100000, 16, 2);
+    RowCollector collector;
+    processor.addConsumer(collector);
+    processor.addColumn(1, element);
+
+    addValue(processor, device, element, 1.0, 0);
+    ASSERT_EQ(collector.rows.size(), 1);
+    addValue(processor, device, element, 2.0, 10000);
+    ASSERT_EQ(collector.rows.size(), 3);
+    ASSERT_EQ(collector.rows[1].time, 9000);
+    ASSERT_EQ(collector.rows[2].time, 10000);
+}
@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+#include <WindowAggregate.hpp>
+
+using namespace libspeedwire;
+
+static bool approximatelyEqual(double lhs, double rhs) {
+    double diff = abs(lhs - rhs);
+    return diff < 1e-7;
+}
+
+// test basic statistics and time-weighted mean
+TEST(WindowAggregateTest, AddValues) {
+    WindowAggregate agg;
+    ASSERT_TRUE(agg.isEmpty());
+    agg.add(10.0, 1000);
+    agg.add(20.0, 2000);
+    agg.add(0.0, 5000);
+    ASSERT_EQ(agg.count, 3);
+    ASSERT_TRUE(approximatelyEqual(agg.getMean(), 10.0));
+    ASSERT_EQ(agg.min, 0.0);
+    ASSERT_EQ(agg.max, 20.0);
+    ASSERT_EQ(agg.last, 0.0);
+    ASSERT_EQ(agg.firstTime, 1000);
+    ASSERT_EQ(agg.lastTime, 5000);
+    // 10 held for 1000, 20 held for 3000
+    ASSERT_TRUE(approximatelyEqual(agg.getTimeWeightedMean(), 70000.0 / 4000.0));
+}
+
+// test merging of consecutive aggregates
+TEST(WindowAggregateTest, Merge) {
+    WindowAggregate a, b, all;
+    a.add(10.0, 1000); a.add(20.0, 2000);
+    b.add(30.0, 4000); b.add(40.0, 5000);
+    all.add(10.0, 1000); all.add(20.0, 2000); all.add(30.0, 4000); all.add(40.0, 5000);
+    a.merge(b);
+    ASSERT_EQ(a.count, all.count);
+    ASSERT_TRUE(approximatelyEqual(a.sum, all.sum));
+    ASSERT_EQ(a.min, all.min);
+    ASSERT_EQ(a.max, all.max);
+    ASSERT_EQ(a.last, all.last);
+    ASSERT_TRUE(approximatelyEqual(a.getTimeWeightedMean(), all.getTimeWeightedMean()));
+}
+
+// test percentile sketch
+TEST(WindowAggregateTest, PercentileSketch) {
+    PercentileSketch disabled;
+    ASSERT_FALSE(disabled.isEnabled());
+    disabled.add(1.0);
+    ASSERT_EQ(disabled.getCount(), 0);
+
+    PercentileSketch sketch(0.0, 100.0, 100);
+    for (int i = 0; i < 100; ++i) {
+        sketch.add((double)i + 0.5);
+    }
+    ASSERT_EQ(sketch.getCount(), 100);
+    ASSERT_NEAR(sketch.getPercentile(50.0), 50.0, 1.0);
+    ASSERT_NEAR(sketch.getPercentile(90.0), 90.0, 1.0);
+    sketch.remove(99.5);
+    ASSERT_EQ(sketch.getCount(), 99);
+}
+
+// test sliding window eviction including min/max tracking
+TEST(WindowAggregateTest, SlidingWindow) {
+    SlidingWindow window(3000);
+    window.add(5.0, 0);
+    window.add(1.0, 1000);
+    window.add(3.0, 2000);
+    ASSERT_EQ(window.size(), 3);
+    ASSERT_EQ(window.getAggregate().min, 1.0);
+    ASSERT_EQ(window.getAggregate().max, 5.0);
+
+    window.add(2.0, 3000);     // evicts 5.0
+    ASSERT_EQ(window.size(), 3);
+    ASSERT_EQ(window.getAggregate().max, 3.0);
+    ASSERT_TRUE(approximatelyEqual(window.getAggregate().getMean(), 2.0));
+
+    window.add(4.0, 5000);     // evicts 1.0 and 3.0
+    ASSERT_EQ(window.size(), 2);
+    ASSERT_EQ(window.getAggregate().min, 2.0);
+    ASSERT_EQ(window.getAggregate().max, 4.0);
+    ASSERT_EQ(window.getAggregate().firstTime, 3000);
+    ASSERT_TRUE(approximatelyEqual(window.getAggregate().getTimeWeightedMean(), 2.0));
+}
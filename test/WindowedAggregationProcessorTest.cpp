@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include <WindowedAggregationProcessor.hpp>
+#include "ProcessorTestHelpers.hpp"
+
+using namespace libspeedwire;
+
+// consumer collecting all emitted window aggregates
+class WindowCollector : public WindowAggregateConsumer {
+public:
+    struct Window {
+        WindowAggregate aggregate;
+        uint32_t start;
+        uint32_t end;
+    };
+    std::vector<Window> windows;
+    int numEndOfAggregates;
+
+    WindowCollector(void) : numEndOfAggregates(0) {}
+
+    virtual void consume(const SpeedwireDevice& /*device*/, const Measurement& /*measurement*/, const WindowAggregate& aggregate, const uint32_t window_start, const uint32_t window_end) {
+        Window window;
+        window.aggregate = aggregate;
+        window.start = window_start;
+        window.end = window_end;
+        windows.push_back(window);
+    }
+    virtual void endOfWindowAggregates(const SpeedwireDevice& /*device*/, const uint32_t /*timestamp*/) {
+        ++numEndOfAggregates;
+    }
+};
+
+// test tumbling windows aligned to multiples of the window length
+TEST(WindowedAggregationProcessorTest, Tumbling) {
+    SpeedwireDevice device = getDevice();
+    ObisData element(ObisData::PositiveActivePowerTotal);
+    WindowedAggregationProcessor processor(WindowType::TUMBLING, 1000);
+    WindowCollector collector;
+    processor.addConsumer(collector);
+
+    addValue(processor, device, element, 10.0, 100);
+    addValue(processor, device, element, 20.0, 600);
+    ASSERT_EQ(collector.windows.size(), 0);
+    addValue(processor, device, element, 30.0, 1100);
+    ASSERT_EQ(collector.windows.size(), 1);
+    ASSERT_EQ(collector.numEndOfAggregates, 1);
+    ASSERT_EQ(collector.windows[0].start, 0);
+    ASSERT_EQ(collector.windows[0].end, 1000);
+    ASSERT_EQ(collector.windows[0].aggregate.count, 2);
+    ASSERT_EQ(collector.windows[0].aggregate.min, 10.0);
+    ASSERT_EQ(collector.windows[0].aggregate.max, 20.0);
+}
+
+// test that sliding windows never include samples older than the window
+TEST(WindowedAggregationProcessorTest, Sliding) {
+    SpeedwireDevice device = getDevice();
+    ObisData element(ObisData::PositiveActivePowerTotal);
+    WindowedAggregationProcessor processor(WindowType::SLIDING, 1000);
+    WindowCollector collector;
+    processor.addConsumer(collector);
+
+    addValue(processor, device, element, 50.0, 1000);
+    addValue(processor, device, element, 10.0, 1500);
+    ASSERT_EQ(collector.windows.back().aggregate.count, 2);
+    ASSERT_EQ(collector.windows.back().aggregate.max, 50.0);
+
+    // both previous samples are older than the window
+    addValue(processor, device, element, 20.0, 5000);
+    ASSERT_EQ(collector.windows.back().aggregate.count, 1);
+    ASSERT_EQ(collector.windows.back().aggregate.min, 20.0);
+    ASSERT_EQ(collector.windows.back().aggregate.max, 20.0);
+    ASSERT_EQ(collector.windows.back().aggregate.getMean(), 20.0);
+
+    // an explicit eviction can empty the window
+    SlidingWindow window(1000);
+    window.add(1.0, 100);
+    window.evict(1100);
+    ASSERT_EQ(window.size(), 0);
+    ASSERT_TRUE(window.getAggregate().isEmpty());
+}
+
+// test that hopping windows emit once per crossed hop boundary
+TEST(WindowedAggregationProcessorTest, Hopping) {
+    SpeedwireDevice device = getDevice();
+    ObisData element(ObisData::PositiveActivePowerTotal);
+    WindowedAggregationProcessor processor(WindowType::HOPPING, 2000, 500);
+    WindowCollector collector;
+    processor.addConsumer(collector);
+
+    addValue(processor, device, element, 10.0, 100);
+    addValue(processor, device, element, 20.0, 400);
+    ASSERT_EQ(collector.windows.size(), 0);
+
+    // the value skips the boundaries at 500, 1000 and 1500
+    addValue(processor, device, element, 30.0, 1600);
+    ASSERT_EQ(collector.windows.size(), 3);
+    for (size_t i = 0; i < 3; ++i) {
+        ASSERT_EQ(collector.windows[i].end, 500 * (i + 1));
+        ASSERT_EQ(collector.windows[i].aggregate.count, 2);
+    }
+    ASSERT_EQ(collector.numEndOfAggregates, 1);
+
+    // after a long gap, only windows holding samples are emitted
+    collector.windows.clear();
+    addValue(processor, device, element, 40.0, 100000);
+    ASSERT_EQ(collector.windows.size(), 4);
+    ASSERT_EQ(collector.windows.back().end, 3500);
+    ASSERT_EQ(collector.windows.back().aggregate.count, 1);
+    ASSERT_EQ(collector.windows.back().aggregate.last, 30.0);
+    addValue(processor, device, element, 50.0, 100600);
+    ASSERT_EQ(collector.windows.back().end, 100500);
+    ASSERT_EQ(collector.windows.back().aggregate.count, 1);
+    ASSERT_EQ(collector.windows.back().aggregate.last, 40.0);
+}